@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#ifndef __ETHPORTBACKEND_H__
+#define __ETHPORTBACKEND_H__ 1
+
+#include "pktqueue.h"
+
+#define MAC_ADDR_LEN	6
+
+typedef struct ethPortInfo ETH_PORT_INFO;
+
+/* Operations of a type of port. A port is handled by the backend whose
+   prefix its name starts with. Ports without a known prefix are
+   Ethernet interfaces. A backend without 'receive' puts the incoming
+   packets in the receive queues of the port, see EthPortRxQueuesCreate().
+   A backend with 'receive' hands over its packets only when asked,
+   they are never looked at for unexpected packets.
+   'send' writes the time every packet sent left the port in 'txTime',
+   or zero if not known. 'receive' writes the time the packet arrived.
+   'workerSend' is 'send' for a transmit worker, 0 to TxWorkerCount-1,
+   with the port open for as many. Workers call it at the same time.
+   'sendAt' hands a packet to the kernel to leave at a CLOCK_TAI launch
+   time, returning EDPAT_NOTFOUND when the port cannot do it.
+   'workerSend', 'sendAt', 'filterUpdate' and 'stats' are optional */
+typedef struct {
+	const char	*prefix;
+	EDPAT_RETVAL	(*open)(ETH_PORT_INFO *p);
+	void		(*close)(ETH_PORT_INFO *p);
+	EDPAT_RETVAL	(*send)(ETH_PORT_INFO *p,
+				unsigned char * const *data, const int *dataLen,
+				const int count, int *queuedCount,
+				int *sentCount, struct timespec *txTime);
+	EDPAT_RETVAL	(*workerSend)(ETH_PORT_INFO *p, const int worker,
+				unsigned char * const *data, const int *dataLen,
+				const int count, int *queuedCount,
+				int *sentCount, struct timespec *txTime);
+	EDPAT_RETVAL	(*sendAt)(ETH_PORT_INFO *p,
+					unsigned char *data, const int dataLen,
+					const struct timespec *launchTime);
+	EDPAT_RETVAL	(*receive)(ETH_PORT_INFO *p,
+				unsigned char *data, int *dataLen,
+				const int waitMs, struct timespec *rxTime);
+	void		(*stats)(ETH_PORT_INFO *p,
+				unsigned long *received,
+				unsigned long *dropped);
+	void		(*filterUpdate)(ETH_PORT_INFO *p);
+} ETH_PORT_BACKEND;
+
+struct ethPortInfo {
+	char		portName[MAX_ETH_PORT_NAME_LEN+1];
+	unsigned char	macAddr[MAC_ADDR_LEN];
+	const ETH_PORT_BACKEND *backend;
+	void		*backendData;	// owned by the backend
+	PKT_QUEUE	*rxQueue[MAX_RX_THREAD_COUNT];	// backend -> interpreter
+	int		rxQueueCount;
+};
+
+extern const ETH_PORT_BACKEND EthPortPacketBackend;
+extern const ETH_PORT_BACKEND EthPortVirtualBackend;
+extern const ETH_PORT_BACKEND EthPortTapBackend;
+extern const ETH_PORT_BACKEND EthPortPcapBackend;
+
+ETH_PORT_INFO *EthPortFindByName(const char *portName);
+EDPAT_RETVAL EthPortRxQueuesCreate(ETH_PORT_INFO *p, const int count);
+
+#endif
@@ -6,47 +6,78 @@
  */
 
 
+#define _GNU_SOURCE	// pthread_attr_setaffinity_np()
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <errno.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <arpa/inet.h>
-#include <sys/socket.h>
-#include <sys/ioctl.h>
-#include <net/if.h>
-#include <linux/if_packet.h>
-#include <netinet/if_ether.h>
-#include <net/ethernet.h>
 #include <unistd.h>
-#include <stdarg.h>
-#include <math.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <time.h>
+#include <math.h>
 #include <pthread.h>
-#include <mqueue.h>
+#include <sched.h>
 #include "edpat.h"
 #include "print.h"
-
-#define MAC_ADDR_LEN	6
-
+#include "utils.h"
+#include "EthPortBackend.h"
+#include "EthPortIO.h"
+
+// extra time in ms a packet is held back to let the other threads catch up
+#define RX_MERGE_SLACK	1
+
+// depth of the token bucket of a paced send, the largest batch it sends
+#define PACE_BURST		32
+// a paced send spins instead of sleeping this close to the next packet
+#define PACE_SPIN_NS		50000
+// how long before its launch time a packet is handed to the kernel
+#define PACE_LAUNCH_LEAD_NS	1000000
+
+/* A transmit worker of a paced or stream send. It sends every
+   'stride'-th packet of the send from packet 'idx' on, at its share of
+   the rate, on a sending socket of the port of its own */
 typedef struct {
-	char		portName[MAX_ETH_PORT_NAME_LEN+1];
-	char		mqName[MAX_FILE_NAME_LEN+1];
-	unsigned char	macAddr[MAC_ADDR_LEN];
-	int		ethPortSocketFd;
-	int		ifIndex;
-	mqd_t		mqRcvFd;
-	mqd_t		mqSendFd;
+	ETH_PORT_INFO	*port;
+	int		idx;		// 0 for the interpreter's socket
+	int		stride;		// workers of the send
 	pthread_t	pThread;
-} ETH_PORT_INFO;
+	int		cpu;		// pinned to, -1 if not
+	unsigned char	data[MAX_PKT_SIZE];	// its own copy of the packet
+	int		dataLen;
+	ETH_PORT_PACE	pace;		// its share of the send
+	double		gapNs;		// between its packets, 0 for no pacing
+	ETH_PORT_PACE_STATS stats;
+	struct timespec	first, last;	// times its first and last packets left
+	EDPAT_RETVAL	retVal;
+	unsigned char	batchBuf[PACE_BURST][MAX_PKT_SIZE];
+} TX_WORKER;
+
+// The paced send in progress, see EthPortSendPacedStart()
+typedef struct {
+	int		workerCount;	// 0 once they are joined
+	EDPAT_BOOL	started[MAX_TX_WORKER_COUNT];
+	volatile int	busyCount;	// workers still sending
+	double		wireBits;	// a packet takes on the wire
+	ETH_PORT_PACE_STATS stats;
+	struct timespec	first, last;
+	EDPAT_RETVAL	retVal;
+} PACED_SEND;
 
 static ETH_PORT_INFO EthPortInfoTable[MAX_ETH_PORT_COUNT];
+static TX_WORKER TxWorker[MAX_TX_WORKER_COUNT];
+static PACED_SEND PacedSend;
 static int EthPortCount = 0;
 static EDPAT_BOOL ArrayInitFlag = EDPAT_FALSE;
-static int MqMsgSize = 0;
+static int EthPortEpollFd = (-1);	// eventfds of all the receive queues
+
+// Types of ports with a name prefix. Others are Ethernet interfaces
+static const ETH_PORT_BACKEND *EthPortBackendTable[] = {
+	&EthPortVirtualBackend,
+	&EthPortTapBackend,
+	&EthPortPcapBackend,
+	NULL
+};
 
 
 /***********************
@@ -74,10 +105,64 @@ static EDPAT_RETVAL ethPortIdxFindByName(const char *portName)
 }
 
 
+
 /***********************
- *   ethPortClose()
  *
- *   Close the port.
+ *   EthPortFindByName()
+ *
+ *   Get the table record of an opened port
+ *
+ *   Arguments 		: portName - name of port to be found
+ *			
+ *   Return		: pointer to the record or NULL
+ *
+ ********/
+ETH_PORT_INFO *EthPortFindByName(const char *portName)
+{
+	int portIdx;
+
+	portIdx = ethPortIdxFindByName(portName);
+	if (0 > portIdx)
+	{
+		return NULL;
+	}
+	return &EthPortInfoTable[portIdx];
+}
+
+
+/***********************
+ *
+ *   ethPortBackendFind()
+ *
+ *   Get the backend handling a port from the prefix of its name.
+ *
+ *   Arguments 		: portName - name of port
+ *			
+ *   Return		: the backend
+ *
+ ********/
+static const ETH_PORT_BACKEND *ethPortBackendFind(const char *portName)
+{
+	int i;
+
+	for (i=0; NULL != EthPortBackendTable[i]; i++)
+	{
+		if (0 == strncmp(portName, EthPortBackendTable[i]->prefix,
+				strlen(EthPortBackendTable[i]->prefix)))
+		{
+			return EthPortBackendTable[i];
+		}
+	}
+	return &EthPortPacketBackend;
+}
+
+
+/***********************
+ *   ethPortStatsPrint()
+ *
+ *   Print the receive statistics of the port. Packets dropped by the
+ *   backend or because a receive queue was full are reported in the
+ *   log, else only in verbose mode.
  *
  *   Arguments : 
  *	p	-	INPUT. pointer to port info table record.
@@ -85,270 +170,185 @@ static EDPAT_RETVAL ethPortIdxFindByName(const char *portName)
  *   Return:	-	None
  *
  ********/
-static void ethPortClose(ETH_PORT_INFO *p)
+static void ethPortStatsPrint(ETH_PORT_INFO *p)
 {
-	if ((-1) != p->pThread)
+	unsigned long received = 0;
+	unsigned long dropped = 0;
+	unsigned long queued = 0;
+	unsigned long queueDrops = 0;
+	int i;
+
+	if ((NULL == p->backend) || (NULL == p->backendData))
 	{
-		pthread_cancel(p->pThread);
-		p->pThread = (-1);
-		VerboseStringPrint(
-			"Receiver thread stopped for %s", p->portName);
+		return;
 	}
-	if ( 0 <= p->ethPortSocketFd)
+	if (NULL != p->backend->stats)
 	{
-		close(p->ethPortSocketFd);
-		p->ethPortSocketFd = (-1);
-		VerboseStringPrint("Ethernet Port '%s' closed",p->portName);
+		p->backend->stats(p, &received, &dropped);
 	}
-	if ( 0 <= p->mqRcvFd)
+	for (i=0; i < p->rxQueueCount; i++)
 	{
-		mq_close(p->mqRcvFd);
-		mq_unlink(p->mqName);
-		p->mqRcvFd = (-1);
+		queued += p->rxQueue[i]->enqueueCount;
+		queueDrops += PktQueueDropCountGet(p->rxQueue[i]);
 	}
-	if ( 0 <= p->mqSendFd)
+	if ((0 == received) && (0 == queued) && (0 == queueDrops))
 	{
-		mq_close(p->mqSendFd);
-		p->mqSendFd = (-1);
+		return;
 	}
 
-	p->portName[0] = 0;
-	p->mqName[0] = 0;
-	p->ifIndex = (-1);
-	return ;
+	if ((0 != dropped) || (0 != queueDrops))
+	{
+		TestCaseStringPrint("Port '%s' dropped packets. "
+			"Port drops %lu, receive queue full drops %lu",
+			p->portName, dropped, queueDrops);
+	}
+	VerboseStringPrint("Port '%s' statistics. Port received %lu, "
+		"dropped %lu. Queued %lu, dropped %lu",
+		p->portName, received, dropped, queued, queueDrops);
+	return;
 }
 
 
-
 /***********************
- *   isPacketToBeFiltered()
+ *   ethPortClose()
  *
- *   Inspect a receved packet and check whether it need to be filtered
+ *   Close the port.
  *
  *   Arguments : 
- *	pkt	- INPUT. pointer to the packet buffer.
- *	pktLen	- INPUT. leghth of packet.
- *
- *   Return:
- *	EDPAT_TRUE	- packet need to be filtered/discarded
- *	EDPAT_FALSE	- packet should not be filtered
+ *	p	-	INPUT. pointer to port info table record.
+ *		
+ *   Return:	-	None
  *
  ********/
-static EDPAT_BOOL isPacketToBeFiltered(unsigned char *pkt,int pktLen)
+static void ethPortClose(ETH_PORT_INFO *p)
 {
-	unsigned short ethType;
-	unsigned short srcPort;
-	unsigned short dstPort;
+	int i;
 
-	if (EDPAT_TRUE != EnableBroadcastPacketFiltering)
+	ethPortStatsPrint(p);
+	// Stop the backend first, it may be filling the queues
+	if (NULL != p->backend)
 	{
-		// filtering disabled. Do not do anything.
-		return EDPAT_FALSE;
+		p->backend->close(p);
+		p->backend = NULL;
 	}
-
-	ethType = ((pkt[12] << 8) | pkt[13]);
-	switch(ethType)
+	for (i=0; i < MAX_RX_THREAD_COUNT; i++)
 	{
-		case 0x0806:	// ARP
-			VerboseStringPrint(
-				"Received ARP packet filtered");
-			return EDPAT_TRUE;
-		case 0x88CC:	//LLDP
-			VerboseStringPrint(
-				"Received LLDP packet filtered");
-			return EDPAT_TRUE;
-		case 0x0800:	// IPv4
-			switch(pkt[23]) //based on protocol
-			{
-			   case 0x02:	// IGMP
-				VerboseStringPrint(
-				    "Received IGMP packet filtered");
-				return EDPAT_TRUE;
-			   case 0x11:	// UDP
-				srcPort = ((pkt[34] << 8) | pkt[35]);	
-				dstPort = ((pkt[36] << 8) | pkt[37]);
-				switch(srcPort)
-				{
-				   case 0x0043:	// DHCP
-				   case 0x0044:	// DHCP
-				      VerboseStringPrint(
-					"Received DHCP packet filtered");
-				      return EDPAT_TRUE;
-				   case 0xd7e8:	// SSDP
-				   case 0x076c:	// SSDP
-				      VerboseStringPrint(
-					"Received SSDP packet filtered");
-				      return EDPAT_TRUE;
-				   case 0x14e9:	// MDNS
-				      VerboseStringPrint(
-					"Received MDNS packet filtered");
-				      return EDPAT_TRUE;
-				}
-				switch(dstPort)
-				{
-				   case 0x0043:	// DHCP
-				   case 0x0044:	// DHCP
-				      VerboseStringPrint(
-					"Received DHCP packet filtered");
-				return EDPAT_TRUE;
-				   case 0xd7e8:	// SSDP
-				   case 0x076c:	// SSDP
-				      VerboseStringPrint(
-					"Received SSDP packet filtered");
-				return EDPAT_TRUE;
-				   case 0x14e9:	// MDNS
-				      VerboseStringPrint(
-					"Received MDNS packet filtered");
-				return EDPAT_TRUE;
-			   	}
-			}
-			break;
-		case 0x86dd:	// IPv6
-			VerboseStringPrint("Received IPv6 packet filtered");
-			return EDPAT_TRUE;
-		
+		if (NULL != p->rxQueue[i])
+		{
+			PktQueueDestroy(p->rxQueue[i]);
+			p->rxQueue[i] = NULL;
+		}
 	}
-	return EDPAT_FALSE;
+	p->rxQueueCount = 0;
+	p->portName[0] = 0;
+	return ;
 }
 
 
 /***********************
- *   ReceiverPthreadFunc()
+ *   EthPortFilterUpdate()
  *
- *   This function will run as a child thread. It will read any packet
- *   receved on the eth port and put it in message queue so that the
- *   message will not be lost.
+ *   Recompile and attach the packet filter of all the open ports. To be
+ *   called when the filter rules change.
  *
- *   Arguments : 
- *	vargp	-  INPUT. Point to the port into table.
+ *   Arguments :	None
  *
  *   Return:	- None
  *
  ********/
-static void *ReceiverPthreadFunc(void *vargp)
+void EthPortFilterUpdate(void)
 {
-	ETH_PORT_INFO *p = (ETH_PORT_INFO *) vargp;
-	unsigned char	pkt[MAX_PKT_SIZE];
-	size_t	pktLen = 10;
-	EDPAT_RETVAL	retVal;
-	int	lastEthErrno = 0;
-	int	lastMqErrno = 0;
-	struct sockaddr_ll addr={0};
-	socklen_t	addrLen;
-
-	addr.sll_family=AF_PACKET;
-	addr.sll_ifindex=p->ifIndex;
-	addr.sll_halen=ETHER_ADDR_LEN;
-	addr.sll_protocol=htons(ETH_P_ALL);
-	memcpy(addr.sll_addr,pkt,ETHER_ADDR_LEN);
-
+	int i;
 
-	while(1) // do for ever
+	for (i=0; i < EthPortCount; i++)
 	{
-		addrLen = sizeof(addr);
-		// Receive packet formo given port
-		pktLen = recvfrom(p->ethPortSocketFd,
-				pkt,sizeof(pkt),
-                		0,
-				(struct sockaddr*)&addr,&addrLen);
-
-		if (0 > pktLen)
+		if (NULL != EthPortInfoTable[i].backend->filterUpdate)
 		{
-			if (errno != lastEthErrno)
-			{
-				// print the error message only once
-				ExecErrorMsgPrint("recvfrom() failed "
-					"while receiving packet from '%s'",
-					p->portName);
-				lastEthErrno = errno;
-			}
-			continue;
+			EthPortInfoTable[i].backend->filterUpdate(
+						&EthPortInfoTable[i]);
 		}
+	}
+	return;
+}
 
-		if (0 == pktLen)
-		{
-			VerboseStringPrint("Empty packet receieved");
-			continue;
-		}
-		/* If Promiscuous drop packets not addressed to the MAC 
-		   of the ethernet port */
-		if (	(PromiscuousModeEnabled) && 
-			(0 != memcmp(pkt,p->macAddr,MAC_ADDR_LEN)) )
-		{
-			VerboseStringPrint("Packet not addressed to '%s' "
-						"is discarded",p->portName);
-			continue;
-		}
-		
-		// Drop packets if it is to be filtered
 
-		retVal = isPacketToBeFiltered(pkt,pktLen);
-		if (EDPAT_TRUE == retVal)
+/***********************
+ *   EthPortRxQueuesCreate()
+ *
+ *   Create the receive queues of a port, through which the backend
+ *   hands over the incoming packets to ethportread/receive. To be
+ *   called by the open of the backend. Each queue is to be filled by
+ *   one thread only.
+ *
+ *   Arguments : 
+ *	p	- INPUT/OUTPUT. Point to the port into table.
+ *	count	- INPUT. Number of queues, up to MAX_RX_THREAD_COUNT.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+EDPAT_RETVAL EthPortRxQueuesCreate(ETH_PORT_INFO *p, const int count)
+{
+	struct epoll_event event;
+	int i;
+
+	for (i=0; i < count; i++)
+	{
+		p->rxQueue[i] = PktQueueCreate(RX_QUEUE_LEN,
+					RX_QUEUE_DATA_SIZE);
+		if (NULL == p->rxQueue[i])
 		{
-			// discard the packt as it needs to be fintered.
-			continue;
+			return EDPAT_FAILED;
 		}
-		
-		//  Enqueue the packt to the message queue
-		retVal = mq_send(p->mqSendFd,pkt,pktLen,0);
-		if ( 0 > retVal)
+		p->rxQueueCount = i + 1;
+
+		// Wait for this queue as well in EthPortReceiveAny()
+		memset(&event,0,sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = p;
+		if (0 > epoll_ctl(EthPortEpollFd, EPOLL_CTL_ADD,
+				p->rxQueue[i]->eventFd, &event))
 		{
-			if (errno != lastMqErrno)
-			{
-				// print the error message only once
-				ExecErrorMsgPrint("mq_send() failed "
-					"while sending packet to '%s'",
-					p->mqName);
-				lastMqErrno = errno;
-			}
+			ExecErrorMsgPrint("epoll_ctl() failed for '%s'",
+				p->portName);
+			return EDPAT_FAILED;
 		}
-
 	}
+	return EDPAT_SUCCESS;
 }
 
 
 /***********************
  *   EthPortOpen()
  *
- *   Open the specifed ethernet port. It will open the eth port.
- *   In addtion it will open the message queue and start the recever thead
- *   to receve incomming packets.
+ *   Open the specifed port. The type of the port is told by the prefix
+ *   of its name, ports without a known prefix are ethernet interfaces.
+ *   The backend of the type opens the port and starts filling its
+ *   receive queues.
  *
  *   Arguments : 
  *	portName	- INPUT.  Name of the port to be opned.
  *
- *					$<varName>=<varVal>
  *   Return:		
  *	>= 0	- port opened sucessfully. The return value is the index
  *		  to port into array
  *	< 0	- failed to open port.
  *
  *********************************/
-
-extern char *XXX;
-
 int EthPortOpen(const char *portName)
 {
-	int socketOpt;
-	struct ifreq portOpts;
-	size_t portNameLen;
-	char mqName[MAX_FILE_NAME_LEN];
-	int portNameLenAllowed;
-	EDPAT_RETVAL retVal;
+	ETH_PORT_INFO *p;
 	int portIdx;
-	struct mq_attr mqAttr;
+
 	// Just do this the first time clear te full table
 	if (EDPAT_FALSE == ArrayInitFlag)
 	{
-		for (portIdx=0; portIdx < MAX_ETH_PORT_COUNT; portIdx++)
+		memset(EthPortInfoTable,0,sizeof(EthPortInfoTable));
+		EthPortEpollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (0 > EthPortEpollFd)
 		{
-			EthPortInfoTable[portIdx].portName[0] = 0;
-			EthPortInfoTable[portIdx].mqName[0] = 0;
-			EthPortInfoTable[portIdx].ethPortSocketFd = -1;
-			EthPortInfoTable[portIdx].ifIndex = -1;
-			EthPortInfoTable[portIdx].mqRcvFd = -1;
-			EthPortInfoTable[portIdx].mqSendFd = -1;
-			EthPortInfoTable[portIdx].pThread = -1;
+			ExecErrorMsgPrint("epoll_create1() failed");
+			return -1;
 		}
 		ArrayInitFlag = EDPAT_TRUE;
 		VerboseStringPrint(
@@ -365,263 +365,194 @@ int EthPortOpen(const char *portName)
 			portName);
 		return portIdx;
 	}
-	// Save name
-	strncpy(EthPortInfoTable[EthPortCount].portName,
-			portName,MAX_ETH_PORT_NAME_LEN);
-	EthPortInfoTable[EthPortCount].portName[MAX_ETH_PORT_NAME_LEN]=0;
-
-	// Stoer socketfd
-	EthPortInfoTable[EthPortCount].ethPortSocketFd =
-			socket(AF_PACKET,SOCK_RAW,htons(ETH_P_ALL));
-	if (0 > EthPortInfoTable[EthPortCount].ethPortSocketFd)
-	{
-		ExecErrorMsgPrint("socket(%s) failed. "
-			"Re-execute with root privilage",portName);
-		return	-1;
-	}
-	
-	VerboseStringPrint("Socket opened for outgoing packets of '%s'",
-			portName);
-	/* Get ethernet port index number */
-	portNameLen=strlen(portName);
-
-	// Lowest is the allowed interface name length
-	portNameLenAllowed = sizeof(portOpts.ifr_name);
-	if (portNameLenAllowed > MAX_ETH_PORT_NAME_LEN)
-		portNameLenAllowed = MAX_ETH_PORT_NAME_LEN;
-
-	if (	portNameLen > portNameLenAllowed )
+	if (MAX_ETH_PORT_COUNT <= EthPortCount)
 	{
-		ScriptErrorMsgPrint("Ethernet Port name '%s' too long. "
-					"Max allowed is %d",
-					portName,portNameLenAllowed);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
+		ScriptErrorMsgPrint("Too many ports. Max allowed is %d",
+			MAX_ETH_PORT_COUNT);
 		return -1;
 	}
-	strncpy(portOpts.ifr_name,portName,sizeof(portOpts.ifr_name));
-	portOpts.ifr_name[sizeof(portOpts.ifr_name)-1] = 0;
 
-	/* Get the port details using the ioctl interface */
-        if (0 > ioctl(EthPortInfoTable[EthPortCount].ethPortSocketFd,
-			SIOCGIFHWADDR,&portOpts))
-	{
-		ExecErrorMsgPrint("ioctl(SIOCGIFHWADDR) failed "
-				"for Eth Port '%s'",
-				portName);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
-	}
+	// Save name
+	p = &EthPortInfoTable[EthPortCount];
+	strncpy(p->portName,portName,MAX_ETH_PORT_NAME_LEN);
+	p->portName[MAX_ETH_PORT_NAME_LEN]=0;
 
-	// It is ARP protocol hardware
-	if (portOpts.ifr_hwaddr.sa_family!=ARPHRD_ETHER)
+	p->backend = ethPortBackendFind(portName);
+	if (EDPAT_SUCCESS != p->backend->open(p))
 	{
-		ExecErrorMsgPrint("Interface in not  Ethernet. "
-				"%d is reported as interface type",
-				portOpts.ifr_hwaddr.sa_family);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
-	}
-	
-	// store the MAC we got to the table
-	memcpy(EthPortInfoTable[EthPortCount].macAddr,
-		portOpts.ifr_hwaddr.sa_data,MAC_ADDR_LEN);
-	VerboseStringPrint("MAC address of '%s' is "
-		"%02X:%02X:%02X:%02X:%02X:%02X",
-		EthPortInfoTable[EthPortCount].portName,
-		EthPortInfoTable[EthPortCount].macAddr[0],
-		EthPortInfoTable[EthPortCount].macAddr[1],
-		EthPortInfoTable[EthPortCount].macAddr[2],
-		EthPortInfoTable[EthPortCount].macAddr[3],
-		EthPortInfoTable[EthPortCount].macAddr[4],
-		EthPortInfoTable[EthPortCount].macAddr[5]);
-/*
-		(unsigned int) EthPortInfoTable[EthPortCount].macAddr[0],
-		(unsigned int) EthPortInfoTable[EthPortCount].macAddr[1],
-		(unsigned int) EthPortInfoTable[EthPortCount].macAddr[2],
-		(unsigned int) EthPortInfoTable[EthPortCount].macAddr[3],
-		(unsigned int) EthPortInfoTable[EthPortCount].macAddr[4],
-		(unsigned int) EthPortInfoTable[EthPortCount].macAddr[5]);
-*/
-	// Get the interface index using ioctl
-        if (0 > ioctl(EthPortInfoTable[EthPortCount].ethPortSocketFd,
-			SIOCGIFINDEX,&portOpts))
-	{
-		ExecErrorMsgPrint("ioctl(SIOCGIFINDEX) failed "
-				"for Eth Port '%s'",
-				portName);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
+		ethPortClose(p);
 		return -1;
 	}
-	EthPortInfoTable[EthPortCount].ifIndex = portOpts.ifr_ifindex;
+	VerboseStringPrint("Ethernet Port '%s' opened successfully",portName);
+	EthPortCount++;
 
-	VerboseStringPrint("Interface Index of '%s' is %d", portName,
-		EthPortInfoTable[EthPortCount].ifIndex);
-	/* Set interface to promiscuous mode */
-	strncpy(portOpts.ifr_name,portName,sizeof(portOpts.ifr_name));
-	portOpts.ifr_name[sizeof(portOpts.ifr_name)-1] = 0;
-	if (0 > ioctl(EthPortInfoTable[EthPortCount].ethPortSocketFd,
-			SIOCGIFFLAGS, &portOpts))
-	{
-		ExecErrorMsgPrint("ioctl(SIOCGIFFLAGS) failed "
-			"for Eth Port '%s'", portName);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
-	}
+	return (EthPortCount-1);
+}
 
-	if (EDPAT_TRUE ==PromiscuousModeEnabled)
-	{
-		portOpts.ifr_flags |= IFF_PROMISC;
-		VerboseStringPrint("Enabled promiscuous mode for '%s'",
-			portName);
-	}
-	else
+/***********************
+ *   EthPortCloseAll()
+ *
+ *   Closs all open ports.
+ *
+ *   Arguments : None
+ *
+ *   Return:	- EDPAT_SUCESS or EDPAT_FAULED
+ *
+ ********/
+EDPAT_RETVAL EthPortCloseAll(void)
+{
+	int i;
+	if (EDPAT_FALSE == ArrayInitFlag)
 	{
-		portOpts.ifr_flags &= ~IFF_PROMISC;
-		VerboseStringPrint("Disabled promiscuous mode for '%s'",
-			portName);
+		// Nothing to cleanup.
+		return EDPAT_SUCCESS;
 	}
-	if (0 > ioctl(EthPortInfoTable[EthPortCount].ethPortSocketFd,
-	SIOCSIFFLAGS, &portOpts))
+	for(i=0; i < EthPortCount; i++)
 	{
-		ExecErrorMsgPrint("ioctl(SIOCSIFFLAGS) failed for "
-			"Eth Port '%s'",portName);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
+		ethPortClose(&EthPortInfoTable[i]);
 	}
-
-	/* Allow the socket to be reused,
-	   incase connection is closed prematurely */
-	if (0 > setsockopt(EthPortInfoTable[EthPortCount].ethPortSocketFd,
-			SOL_SOCKET, SO_REUSEADDR,
-			&socketOpt, sizeof socketOpt))
+	if (0 <= EthPortEpollFd)
 	{
-		ExecErrorMsgPrint("setsockopt(SO_REUSEADDR) failed for "
-			"Eth Port '%s'",portName);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
+		close(EthPortEpollFd);
+		EthPortEpollFd = (-1);
 	}
+	return EDPAT_SUCCESS;
+}
 
-	VerboseStringPrint("Socket Re-use option set for '%s'",portName);
-        /* Bind to device */
-        if (0 > setsockopt(EthPortInfoTable[EthPortCount].ethPortSocketFd,
-		SOL_SOCKET,
-                SO_BINDTODEVICE, portName, IFNAMSIZ-1))
-        {
-		ScriptErrorMsgPrint(
-			"Ethernet Port name '%s' does not exists",
-			portName);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
-        }
-
-	VerboseStringPrint("Socket binding successful for '%s'",portName);
-
-
-	/* Open Message queue for communcation between reciever thread and
-	   ethportread/receive
-	   First open the receive FD from which teh packets are dequeued
-	   from MQ */
-	sprintf(mqName,"/mq.%s.%d",portName,getpid());
-	strncpy(EthPortInfoTable[EthPortCount].mqName,
-			mqName,MAX_FILE_NAME_LEN);
-	EthPortInfoTable[EthPortCount].mqName[MAX_FILE_NAME_LEN]=0;
 
-	EthPortInfoTable[EthPortCount].mqRcvFd =
-		mq_open(mqName, O_CREAT | O_RDONLY, 0644, NULL);
-	if ( 0 > EthPortInfoTable[EthPortCount].mqRcvFd)
-	{
-		ExecErrorMsgPrint("mq_open(%s) failed",mqName);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
-	}
-	VerboseStringPrint(
-		"Mq opened for de-queuing incoming packets from '%s'.",
-		portName);
+/***********************
+ *   ethPortOldestQueue()
+ *
+ *   Find the receive queue of the port whose first packet arrived
+ *   earliest. With more than one receiver thread a packet that arrived
+ *   earlier may still be on its way to the queue of another thread.
+ *   When a queue of the port is empty the oldest packet is therefore
+ *   held back till it is older than the receive ring block timeout.
+ *
+ *   Arguments : 
+ *	p		- INPUT. Point to the port into table.
+ *	holdMs		- OUTPUT. How long the packet is to be held back,
+ *			  0 if it can be read now.
+ *	readyMask	- OUTPUT. Bit i is set if queue of thread i has
+ *			  packets.
+ *
+ *   Return:	- the queue or NULL if all the queues are empty
+ *
+ ***********************/
+static PKT_QUEUE *ethPortOldestQueue(ETH_PORT_INFO *p, int *holdMs,
+		unsigned int *readyMask)
+{
+	const struct timespec *rxTime;
+	const struct timespec *oldestTime = NULL;
+	PKT_QUEUE *oldest = NULL;
+	struct timespec now;
+	long ageMs;
+	int i;
 
-	/* Find the Message queue size. 
-	   Configired at system level in /proc/sys/fs/mqueue/msgsize_max
-	   or per message queue using mq_setattr(). Default value is 8192*/
-	if (0 == MqMsgSize)
+	*holdMs = 0;
+	*readyMask = 0;
+	for (i=0; i < p->rxQueueCount; i++)
 	{
-		retVal = mq_getattr(EthPortInfoTable[EthPortCount].mqRcvFd,
-					&mqAttr);
-		if (0 > retVal)
+		rxTime = PktQueueHeadTimeGet(p->rxQueue[i]);
+		if (NULL == rxTime)
 		{
-			ExecErrorMsgPrint("mq_getattr(%s) failed",mqName);
-			ethPortClose(&EthPortInfoTable[EthPortCount]);
-			return -1;
+			continue;
+		}
+		*readyMask |= (1U << i);
+		if ((NULL == oldestTime) ||
+		    (rxTime->tv_sec < oldestTime->tv_sec) ||
+		    ((rxTime->tv_sec == oldestTime->tv_sec) &&
+		     (rxTime->tv_nsec < oldestTime->tv_nsec)))
+		{
+			oldestTime = rxTime;
+			oldest = p->rxQueue[i];
 		}
-		MqMsgSize = mqAttr.mq_msgsize;
-		VerboseStringPrint("Mq msgsize is detected as  %d",MqMsgSize);
 	}
 
-	/* Open the send FD thoruggh which the receiver thread loads
-		packes to the MQ */
-	EthPortInfoTable[EthPortCount].mqSendFd =
-			mq_open(mqName, O_WRONLY|O_NONBLOCK);
-	if ( 0 > EthPortInfoTable[EthPortCount].mqSendFd)
+	if ((NULL == oldest) ||
+	    (*readyMask == ((1U << p->rxQueueCount) - 1)))
 	{
-		ExecErrorMsgPrint("mq_open(%s) failed",mqName);
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
+		// Every queue is in order by itself
+		return oldest;
 	}
-	VerboseStringPrint(
-		"Mq opened for queuing incoming packets from '%s'",
-		portName);
 
-	// Start a receiving thread for each PORT
-	retVal  = pthread_create( &EthPortInfoTable[EthPortCount].pThread,
-			NULL,
-			ReceiverPthreadFunc,
-			&EthPortInfoTable[EthPortCount]);
-
-	if ( 0 > retVal)
+	clock_gettime(CLOCK_REALTIME, &now);
+	ageMs = (now.tv_sec - oldestTime->tv_sec) * 1000 +
+			(now.tv_nsec - oldestTime->tv_nsec) / 1000000L;
+	if (ageMs < (RxRingBlockTimeout + RX_MERGE_SLACK))
 	{
-		ExecErrorMsgPrint("pthread() failed");
-		ethPortClose(&EthPortInfoTable[EthPortCount]);
-		return -1;
+		*holdMs = RxRingBlockTimeout + RX_MERGE_SLACK - ageMs;
 	}
-	VerboseStringPrint("Ethernet Port '%s' opened successfully",portName);
-	EthPortCount++;
-
-	return (EthPortCount-1);
+	return oldest;
 }
 
+
 /***********************
- *   EthPortCloseAll()
+ *   ethPortWaitPrepare()
  *
- *   Closs all open ports.
+ *   Tell the receiver threads of the port that the interpreter is about
+ *   to sleep on their queues.
  *
- *   Arguments : None
+ *   Arguments : 
+ *	p		- INPUT. Point to the port into table.
+ *	readyMask	- INPUT. Queues that already had packets.
  *
- *   Return:	- EDPAT_SUCESS or EDPAT_FAULED
+ *   Return:	- EDPAT_TRUE if a packet arrived meanwhile to one of
+ *		  the other queues and the interpreter should not sleep.
  *
- ********/
-EDPAT_RETVAL EthPortCloseAll(void)
+ ***********************/
+static EDPAT_BOOL ethPortWaitPrepare(ETH_PORT_INFO *p,
+		const unsigned int readyMask)
 {
+	EDPAT_BOOL arrived = EDPAT_FALSE;
 	int i;
-	if (EDPAT_FALSE == ArrayInitFlag)
+
+	for (i=0; i < p->rxQueueCount; i++)
 	{
-		// Nothing to cleanup.
-		return EDPAT_SUCCESS;
+		if ((EDPAT_TRUE ==
+		     PktQueueWaitPrepare(p->rxQueue[i])) &&
+		    (0 == (readyMask & (1U << i))))
+		{
+			arrived = EDPAT_TRUE;
+		}
 	}
-	for(i=0; i < EthPortCount; i++)
+	return arrived;
+}
+
+
+/***********************
+ *   ethPortWaitDone()
+ *
+ *   The interpreter is awake again. See ethPortWaitPrepare().
+ *
+ *   Arguments : 
+ *	p		- INPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ***********************/
+static void ethPortWaitDone(ETH_PORT_INFO *p)
+{
+	int i;
+
+	for (i=0; i < p->rxQueueCount; i++)
 	{
-		ethPortClose(&EthPortInfoTable[i]);
+		PktQueueWaitDone(p->rxQueue[i]);
 	}
-	return EDPAT_SUCCESS;
+	return;
 }
 
 
 /***********************
  *   ethPortRead()
  *
- *   Read a packet from the MQ associated to the Ethport that the receiver
- *   thread had filled
+ *   Read a packet from the receive queues associated to the Ethport
+ *   that the backend had filled. The packets of the queues are read in
+ *   the order they arrived. Backends without receive queues are asked
+ *   for the packet instead.
  *
  *   Arguments : 
- *	SocketFd	- INPUT. Index to the portInfo table from where
- *			  Pkt to be read.
+ *	p		- INPUT. Port from where Pkt to be read.
  *      data		- INPUT/OUTPU. pointer to buffer where read data
  *			  need to be stored. The receved packet is returned
  *			  to the coller in this buffer.
@@ -630,62 +561,96 @@ EDPAT_RETVAL EthPortCloseAll(void)
  *			  returned
  *	waitTime	- INPUT. How long to wait for packet befor timeout.
  *			  specified in seconds.
+ *	rxTime		- OUTPUT. time the packet arrived, NULL if not
+ *			  needed.
  *
- *   Return:	- EDPAT_SUCESS or EDPAT_FAULED
+ *   Return:	- EDPAT_SUCESS, EDPAT_NOTFOUND or EDPAT_FAULED
  *
  ***********************/
-static EDPAT_RETVAL ethPortRead( const int SocketFd,
-		unsigned char *data, int *dataLen, const int waitTime)
+static EDPAT_RETVAL ethPortRead(ETH_PORT_INFO *p,
+		unsigned char *data, int *dataLen, const int waitTime,
+		struct timespec *rxTime)
 {
-	struct timespec readTime;
-	int 	rcvDataLen;
+	struct timespec dummyTime;
+	struct pollfd pfd[MAX_RX_THREAD_COUNT];
+	struct timespec end;
+	unsigned int readyMask;
+	PKT_QUEUE *q;
+	int remainingMs;
+	int sleepMs;
+	int holdMs;
+	int i;
 
-	if ((*dataLen) < MqMsgSize)
+	if (NULL != p->backend->receive)
 	{
-		ExecErrorMsgPrint("MQ Receive buffer size too small(%d). "
-			"Should be greater than %d which is configured in"
-			" /proc/sys/fs/mqueue/msgsize_max",
-			(*dataLen),MqMsgSize);
-		return EDPAT_FAILED;
+		return p->backend->receive(p, data, dataLen, waitTime * 1000,
+				(NULL != rxTime) ? rxTime : &dummyTime);
+	}
+	if (1 == p->rxQueueCount)
+	{
+		// Wait till waittime to receive packet
+		return PktQueueDequeue(p->rxQueue[0],
+				data, dataLen, waitTime * 1000, rxTime);
 	}
-	clock_gettime(CLOCK_REALTIME, &readTime);
-	readTime.tv_sec += waitTime;
 
-	// Wait till waittime to receive packet
-	rcvDataLen = mq_timedreceive(SocketFd,
-			data, *dataLen, NULL,
-			&readTime);
-	if (0 > rcvDataLen)
+	for (i=0; i < p->rxQueueCount; i++)
+	{
+		pfd[i].fd = p->rxQueue[i]->eventFd;
+		pfd[i].events = POLLIN;
+	}
+	DeadlineSet(&end, waitTime * 1000);
+	while (1)
 	{
-		if (ETIMEDOUT == errno)
+		remainingMs = DeadlineRemainingMs(&end);
+		q = ethPortOldestQueue(p, &holdMs, &readyMask);
+		if ((NULL != q) && ((0 == holdMs) || (0 >= remainingMs)))
+		{
+			return PktQueueDequeue(q, data, dataLen, 0, rxTime);
+		}
+		if (0 >= remainingMs)
 		{
 			return EDPAT_NOTFOUND;
 		}
-		ExecErrorMsgPrint("pthread() failed");
-		return EDPAT_FAILED;
-	}
-	*dataLen = rcvDataLen;
 
-	return EDPAT_SUCCESS;
+		sleepMs = remainingMs;
+		if ((NULL != q) && (holdMs < sleepMs))
+		{
+			sleepMs = holdMs;
+		}
+		if ((EDPAT_FALSE == ethPortWaitPrepare(p, readyMask)) &&
+		    (0 > poll(pfd, p->rxQueueCount, sleepMs)) &&
+		    (EINTR != errno))
+		{
+			ethPortWaitDone(p);
+			ExecErrorMsgPrint("poll() failed");
+			return EDPAT_FAILED;
+		}
+		ethPortWaitDone(p);
+	}
 }
 
 /*****************************
  *
  * 	EthPortReceive
  *
- * 	Read the packets in the MQ and load it into data
+ * 	Read the packets in the receive queue and load it into data
  *
  * 	Arguments: portName -	Name of the port to receive packets form 
- * 		   data	    -	the data that is read from the mq is
+ * 		   data	    -	the data that is read from the queue is
 				filled here
  * 		   datalen  -	Length of data filled
+ * 		   rxTime   -	time the packet arrived is written back
+ *				here, NULL if not needed
  * 	Return 		: EDPAT_RETVAL
  *
  * ***************************/
 
 EDPAT_RETVAL EthPortReceive(const char *portName,
-			unsigned char *data, int *dataLen)
+			unsigned char *data, int *dataLen,
+			struct timespec *rxTime)
 {
+	char timeStr[MAX_TIMESPEC_STR_LEN];
+	struct timespec arrival;
 	int portIdx;
 	EDPAT_RETVAL retVal;
 
@@ -699,13 +664,18 @@ EDPAT_RETVAL EthPortReceive(const char *portName,
 		return EDPAT_NOTFOUND;
 	}
 
-	retVal = ethPortRead(EthPortInfoTable[portIdx].mqRcvFd,
-			data,dataLen,PacketReceiveTimeout);
+	retVal = ethPortRead(&EthPortInfoTable[portIdx],
+			data,dataLen,PacketReceiveTimeout,&arrival);
 	if (EDPAT_SUCCESS == retVal)
 	{
+		if (NULL != rxTime)
+		{
+			*rxTime = arrival;
+		}
 		VerboseStringPrint("Packet of length %d "
-					"received at port '%s'",
-					*dataLen, portName);
+					"received at port '%s' at %s",
+					*dataLen, portName,
+					TimespecFormat(&arrival,timeStr));
 		VerbosePacketHeaderPrint(data);
 		VerbosePacketPrint(data,*dataLen);
 	}
@@ -719,49 +689,226 @@ EDPAT_RETVAL EthPortReceive(const char *portName,
  *
  *	Read from all the ports we have stored in EthPortInfoTable,
  *	this is used to find if even one extra unwanted packet is in the
- *	queue 
+ *	queue. If all the queues are empty, a single epoll_wait() on the
+ *	eventfds of all the queues waits for whichever port delivers first.
+ *	The queues of the receiver threads of a port are read in the order
+ *	the packets arrived. Ports whose backend has no receive queues are
+ *	skipped, their packets are only taken by EthPortReceive() in the
+ *	order of the script.
  *	
  *	Arguments: 	portname - it is used to writeback the portname
  *				   that received data
  *			data	 - it is used to vriteback the data received
  *			datalen	 - it is used to writeback the datalen of
  *				   dat received
+ *			waitMs	 - how long to wait for a packet, in
+ *				   milliseconds. 0 returns at once.
+ *			rxTime	 - it is used to writeback the time the
+ *				   packet arrived, NULL if not needed
  *
  *	Return 		: 	EDPAT_RETVAL
  *
  ******************************/
 
 EDPAT_RETVAL EthPortReceiveAny(char *portName,
-			unsigned char *data, int *dataLen)
+			unsigned char *data, int *dataLen, const int waitMs,
+			struct timespec *rxTime)
 {
+	char timeStr[MAX_TIMESPEC_STR_LEN];
+	struct timespec arrival;
+	struct epoll_event events[MAX_ETH_PORT_COUNT * MAX_RX_THREAD_COUNT];
+	struct timespec end;
+	unsigned int readyMask[MAX_ETH_PORT_COUNT];
+	int remainingMs;
+	int sleepMs;
+	int holdMs;
 	int portIdx;
+	EDPAT_BOOL arrived;
 	EDPAT_RETVAL retVal;
+	PKT_QUEUE *q;
 
-	for (portIdx=0; portIdx < EthPortCount; portIdx++)
-	{
-		retVal = ethPortRead(EthPortInfoTable[portIdx].mqRcvFd,
-					data,dataLen,0);
-		switch(retVal)
-		{
-			case EDPAT_SUCCESS:
-				strncpy(portName,
-					EthPortInfoTable[portIdx].portName,
-					MAX_ETH_PORT_NAME_LEN);
-	EthPortInfoTable[portIdx].portName[MAX_ETH_PORT_NAME_LEN]=0;
-				VerboseStringPrint(
-					"Packet of length %d "
-					"received at port '%s'",
-					*dataLen, portName);
-				VerbosePacketHeaderPrint(data);
-				VerbosePacketPrint(data,*dataLen);
-				return EDPAT_SUCCESS;
-			case EDPAT_NOTFOUND:
-				break;
-			default:
+	DeadlineSet(&end, waitMs);
+	while (1)
+	{
+		remainingMs = DeadlineRemainingMs(&end);
+		sleepMs = remainingMs;
+		for (portIdx=0; portIdx < EthPortCount; portIdx++)
+		{
+			q = ethPortOldestQueue(&EthPortInfoTable[portIdx],
+					&holdMs, &readyMask[portIdx]);
+			if (NULL == q)
+			{
+				continue;
+			}
+			else if ((0 != holdMs) && (0 < remainingMs))
+			{
+				// Wait for the other threads of the port
+				if (holdMs < sleepMs)
+				{
+					sleepMs = holdMs;
+				}
+				continue;
+			}
+			else
+			{
+				retVal = PktQueueDequeue(q, data, dataLen, 0,
+						&arrival);
+			}
+			if (EDPAT_NOTFOUND == retVal)
+			{
+				continue;
+			}
+			if (EDPAT_SUCCESS != retVal)
+			{
 				return EDPAT_FAILED;
+			}
+			strncpy(portName,
+				EthPortInfoTable[portIdx].portName,
+				MAX_ETH_PORT_NAME_LEN);
+			portName[MAX_ETH_PORT_NAME_LEN]=0;
+			if (NULL != rxTime)
+			{
+				*rxTime = arrival;
+			}
+			VerboseStringPrint(
+				"Packet of length %d "
+				"received at port '%s' at %s",
+				*dataLen, portName,
+				TimespecFormat(&arrival,timeStr));
+			VerbosePacketHeaderPrint(data);
+			VerbosePacketPrint(data,*dataLen);
+			return EDPAT_SUCCESS;
+		}
+
+		if ((0 >= sleepMs) || (0 > EthPortEpollFd))
+		{
+			return EDPAT_NOTFOUND;
+		}
+
+		// Sleep till any of the ports has a packet
+		arrived = EDPAT_FALSE;
+		for (portIdx=0; portIdx < EthPortCount; portIdx++)
+		{
+			if (EDPAT_TRUE ==
+			    ethPortWaitPrepare(&EthPortInfoTable[portIdx],
+					readyMask[portIdx]))
+			{
+				arrived = EDPAT_TRUE;
+			}
+		}
+		if ((EDPAT_FALSE == arrived) &&
+		    (0 > epoll_wait(EthPortEpollFd, events,
+				MAX_ETH_PORT_COUNT * MAX_RX_THREAD_COUNT,
+				sleepMs)) &&
+		    (EINTR != errno))
+		{
+			ExecErrorMsgPrint("epoll_wait() failed");
+		}
+		for (portIdx=0; portIdx < EthPortCount; portIdx++)
+		{
+			ethPortWaitDone(&EthPortInfoTable[portIdx]);
 		}
 	}
-	return EDPAT_NOTFOUND;
+}
+
+/*************************
+ *
+ *	EthPortSendBatch
+ *
+ *	Used to send a batch of packets to the specified port. The batch
+ *	is handed over to the backend of the port in one go.
+ *
+ *	Arguments:	portName - the name of the port for packets to
+ *				   be send to 
+ *			data	 - array of pointers to the packets
+ *			dataLen	 - array of lengths of the packets
+ *			count	 - number of packets in the batch
+ *			queuedCount - number of packets handed over to
+ *				   the kernel is written back here
+ *			sentCount - number of packets that actually left
+ *				   the port is written back here
+ *			txTime	 - array of 'count' times, the time each
+ *				   packet left the port is written back
+ *				   here. When the port does not tell, the
+ *				   time they were handed to the backend is
+ *				   used, as they cannot leave before it
+ *
+ *	return: 	EDPAT_SUCCESS if all the packets are sent
+ *
+ *
+ *************************/
+
+EDPAT_RETVAL EthPortSendBatch(const char *portName,
+			unsigned char * const *data, const int *dataLen,
+			const int count, int *queuedCount, int *sentCount,
+			struct timespec *txTime)
+{
+	char timeStr[MAX_TIMESPEC_STR_LEN];
+	struct timespec now;
+	ETH_PORT_INFO *p;
+	EDPAT_RETVAL retVal;
+	int portIdx;
+	int n;
+
+	*queuedCount = 0;
+	*sentCount = 0;
+	portIdx = ethPortIdxFindByName(portName);
+
+	if (0 > portIdx)
+	{
+		ScriptErrorMsgPrint(
+			"Trying to send to '%s' which is not yet opened",
+			portName);
+		return EDPAT_NOTFOUND;
+	}
+	p = &EthPortInfoTable[portIdx];
+
+	for (n=0; n < count; n++)
+	{
+		// A mimimum of 1 bytes is needed
+		if (14 > dataLen[n])
+		{
+			ScriptErrorMsgPrint(
+				"Insufficent Bytes in send packet. "
+				"Minimum 14 is needed");
+			return EDPAT_NOTFOUND;
+		}
+	}
+
+	memset(txTime,0,count * sizeof(*txTime));
+	clock_gettime(CLOCK_REALTIME, &now);
+	retVal = p->backend->send(p,data,dataLen,count,queuedCount,sentCount,
+			txTime);
+
+	if (1 != count)
+	{
+		VerboseStringPrint("Batch of %d packets to port '%s'. "
+			"Queued %d, sent %d", count, portName,
+			*queuedCount, *sentCount);
+	}
+	for (n=0; n < (*sentCount); n++)
+	{
+		if ((0 == txTime[n].tv_sec) && (0 == txTime[n].tv_nsec))
+		{
+			txTime[n] = now;
+		}
+		VerboseStringPrint(
+			"Packet of length %d send successfuly at port '%s' "
+			"at %s", dataLen[n],portName,
+			TimespecFormat(&txTime[n],timeStr));
+		// A packet repeated in the batch is printed once
+		if ((0 != n) && (data[n] == data[n-1]))
+		{
+			continue;
+		}
+		VerbosePacketHeaderPrint(data[n]);
+		VerbosePacketPrint(data[n],dataLen[n]);
+	}
+	if ((*sentCount) != count)
+	{
+		return EDPAT_FAILED;
+	}
+	return retVal;
 }
 
 /*************************
@@ -774,6 +921,8 @@ EDPAT_RETVAL EthPortReceiveAny(char *portName,
  *				   be send to 
  *			data	 - the data to be sent to the port
  *			dataLen	 - the length of data to be sent
+ *			txTime	 - the time the packet left the port is
+ *				   written back here, NULL if not needed
  *
  *	return: 	EDPAT_RETVAL
  *
@@ -781,14 +930,532 @@ EDPAT_RETVAL EthPortReceiveAny(char *portName,
  *************************/
 
 EDPAT_RETVAL EthPortSend(const char *portName,
-			unsigned char *data, const int dataLen)
+			unsigned char *data, const int dataLen,
+			struct timespec *txTime)
+{
+	struct timespec dummyTime;
+	int queuedCount;
+	int sentCount;
+
+	return EthPortSendBatch(portName,&data,&dataLen,1,
+			&queuedCount,&sentCount,
+			(NULL != txTime) ? txTime : &dummyTime);
+}
+
+/***********************
+ *   paceWait()
+ *
+ *   Wait till a time for a paced send. Sleeping may overshoot by tens
+ *   of microseconds, so the thread sleeps till PACE_SPIN_NS before the
+ *   time and spins on the clock after that.
+ *
+ *   Arguments :
+ *	clockId		- INPUT. clock of the time.
+ *	until		- INPUT. time to wait till.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void paceWait(const clockid_t clockId, const struct timespec *until)
+{
+	struct timespec wake = *until;
+	struct timespec now;
+
+	TimespecAddNs(&wake, -PACE_SPIN_NS);
+	clock_gettime(clockId, &now);
+	if (0 < TimespecDiffNs(&now, &wake))
+	{
+		clock_nanosleep(clockId, TIMER_ABSTIME, &wake, NULL);
+	}
+	do
+	{
+		clock_gettime(clockId, &now);
+	} while (0 < TimespecDiffNs(&now, until));
+	return;
+}
+
+
+/***********************
+ *   paceGapAdd()
+ *
+ *   Add the time a paced packet left to the statistics of the send.
+ *   Until the send ends, gapMeanNs and gapJitterNs hold the sum and the
+ *   sum of squares of the gaps.
+ *
+ *   Arguments :
+ *	stats		- INPUT/OUTPUT. statistics of the send.
+ *	first		- INPUT/OUTPUT. time the first packet left.
+ *	last		- INPUT/OUTPUT. time the last packet left.
+ *	txTime		- INPUT. time the packet left.
+ *	targetGapNs	- INPUT. gap asked for.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void paceGapAdd(ETH_PORT_PACE_STATS *stats, struct timespec *first,
+			struct timespec *last, const struct timespec *txTime,
+			const double targetGapNs)
+{
+	long long gap;
+	long long err;
+
+	if (0 == stats->sent)
+	{
+		*first = *txTime;
+	}
+	else
+	{
+		gap = TimespecDiffNs(last, txTime);
+		err = llabs(gap - (long long) targetGapNs);
+		stats->gapMeanNs += gap;
+		stats->gapJitterNs += (double) gap * gap;
+		if (err > stats->gapMaxErrNs)
+		{
+			stats->gapMaxErrNs = err;
+		}
+	}
+	*last = *txTime;
+	stats->sent++;
+	return;
+}
+
+
+/***********************
+ *   paceLaunchSend()
+ *
+ *   Send the packets of a paced send with launch times, so that the
+ *   qdisc of the port sends them at the right time whatever the delays
+ *   of EDpAT. Each packet is handed to the kernel PACE_LAUNCH_LEAD_NS
+ *   before it is to leave. The launch times are taken as the times the
+ *   packets left.
+ *
+ *   Arguments :
+ *	p		- INPUT. the port.
+ *	data		- INPUT. the packet.
+ *	dataLen		- INPUT. length of the packet.
+ *	pace		- INPUT. count and duration of the send.
+ *	gapNs		- INPUT. time between the packets.
+ *	stats		- OUTPUT. what was sent.
+ *	first, last	- OUTPUT. time the first and the last packets left.
+ *
+ *   Return:	- EDPAT_SUCCESS, EDPAT_FAILED or EDPAT_NOTFOUND if the
+ *		  port does not support launch times
+ *
+ ********/
+static EDPAT_RETVAL paceLaunchSend(ETH_PORT_INFO *p,
+			unsigned char *data, const int dataLen,
+			const ETH_PORT_PACE *pace, const double gapNs,
+			ETH_PORT_PACE_STATS *stats,
+			struct timespec *first, struct timespec *last)
 {
-	struct sockaddr_ll addr={0};
+	struct timespec start, launch, handOver, now, realNow;
+	long long taiToRealNs;
+	long long offsetNs;
 	EDPAT_RETVAL retVal;
+	unsigned long n;
+
+	if (NULL == p->backend->sendAt)
+	{
+		return EDPAT_NOTFOUND;
+	}
+	clock_gettime(CLOCK_REALTIME, &realNow);
+	clock_gettime(CLOCK_TAI, &now);
+	taiToRealNs = TimespecDiffNs(&now, &realNow);
+	start = now;
+	TimespecAddNs(&start, PACE_LAUNCH_LEAD_NS);
+	stats->workers = 1;
+
+	for (n=0; (0 == pace->count) || (n < pace->count); n++)
+	{
+		offsetNs = (long long) (n * gapNs);
+		if ((0 != pace->durationMs) &&
+		    (offsetNs >= pace->durationMs * 1000000LL))
+		{
+			break;
+		}
+		launch = start;
+		TimespecAddNs(&launch, offsetNs);
+		handOver = launch;
+		TimespecAddNs(&handOver, -PACE_LAUNCH_LEAD_NS);
+		paceWait(CLOCK_TAI, &handOver);
+		if ((0 != n) && (NULL != pace->nextPkt))
+		{
+			pace->nextPkt(data, n);
+		}
+
+		retVal = p->backend->sendAt(p, data, dataLen, &launch);
+		if (EDPAT_SUCCESS != retVal)
+		{
+			// only the first packet tells if it is supported
+			return ((EDPAT_NOTFOUND == retVal) && (0 != n)) ?
+				EDPAT_FAILED : retVal;
+		}
+		TimespecAddNs(&launch, taiToRealNs);
+		paceGapAdd(stats, first, last, &launch, gapNs);
+		if (NULL != pace->txTimeSet)
+		{
+			pace->txTimeSet(n, &launch);
+		}
+	}
+	stats->launchTime = EDPAT_TRUE;
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   paceBucketSend()
+ *
+ *   Send the packets of a transmit worker through a token bucket.
+ *   Tokens are added at the rate of the worker, and a packet is sent
+ *   for every whole token. Up to PACE_BURST tokens are kept, so that a
+ *   send delayed by the scheduler catches up with a short batch.
+ *   Without a rate the bucket is always full. The times the packets
+ *   left are taken from the port, or else the time they were handed to
+ *   it.
+ *
+ *   Arguments :
+ *	w	- INPUT/OUTPUT. the worker, what it sent is written to
+ *		  its stats, first and last.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL paceBucketSend(TX_WORKER *w)
+{
+	ETH_PORT_INFO *p = w->port;
+	const ETH_PORT_PACE *pace = &w->pace;
+	unsigned char *batchData[PACE_BURST];
+	int batchLen[PACE_BURST];
+	struct timespec txTime[PACE_BURST];
+	struct timespec start, now, lastFill, next, realNow;
+	unsigned long sent = 0;
+	unsigned long k = w->idx;	// number of the next packet
+	double tokens = 1.0;	// the first packet goes at once
+	EDPAT_RETVAL retVal;
+	int queuedCount, sentCount;
+	int batch, n;
+
+	for (n=0; n < PACE_BURST; n++)
+	{
+		batchData[n] = w->data;
+		batchLen[n] = w->dataLen;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	lastFill = start;
+
+	while ((0 == pace->count) || (sent < pace->count))
+	{
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((0 != pace->durationMs) &&
+		    (TimespecDiffNs(&start, &now) >=
+				pace->durationMs * 1000000LL))
+		{
+			break;
+		}
+		if (0 == w->gapNs)
+		{
+			tokens = PACE_BURST;
+		}
+		else
+		{
+			tokens += TimespecDiffNs(&lastFill, &now) / w->gapNs;
+			lastFill = now;
+		}
+		if (PACE_BURST < tokens)
+		{
+			tokens = PACE_BURST;
+		}
+		if (1.0 > tokens)
+		{
+			next = now;
+			TimespecAddNs(&next,
+				(long long) ((1.0 - tokens) * w->gapNs));
+			paceWait(CLOCK_MONOTONIC, &next);
+			continue;
+		}
+
+		batch = (int) tokens;
+		if ((0 != pace->count) &&
+		    (pace->count - sent < (unsigned long) batch))
+		{
+			batch = pace->count - sent;
+		}
+		// Every packet of the batch is different if they change
+		for (n=0; (NULL != pace->nextPkt) && (n < batch); n++)
+		{
+			if (0 != k)
+			{
+				pace->nextPkt(w->data, k);
+			}
+			memcpy(w->batchBuf[n], w->data, w->dataLen);
+			batchData[n] = w->batchBuf[n];
+			k += w->stride;
+		}
+		memset(txTime,0,batch * sizeof(*txTime));
+		queuedCount = 0;
+		sentCount = 0;
+		clock_gettime(CLOCK_REALTIME, &realNow);
+		if (NULL != p->backend->workerSend)
+		{
+			retVal = p->backend->workerSend(p, w->idx, batchData,
+				batchLen, batch, &queuedCount, &sentCount,
+				txTime);
+		}
+		else
+		{
+			retVal = p->backend->send(p, batchData, batchLen,
+				batch, &queuedCount, &sentCount, txTime);
+		}
+		for (n=0; n < sentCount; n++)
+		{
+			if ((0 == txTime[n].tv_sec) && (0 == txTime[n].tv_nsec))
+			{
+				txTime[n] = realNow;
+			}
+			paceGapAdd(&w->stats, &w->first, &w->last, &txTime[n],
+				w->gapNs);
+			if (NULL != pace->txTimeSet)
+			{
+				pace->txTimeSet(w->idx +
+					(sent + n) * w->stride, &txTime[n]);
+			}
+		}
+		sent += sentCount;
+		tokens -= sentCount;
+		if ((EDPAT_SUCCESS != retVal) || (sentCount != batch))
+		{
+			w->stats.failed += batch - sentCount;
+			return EDPAT_FAILED;
+		}
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   TxWorkerPthreadFunc()
+ *
+ *   Thread of a transmit worker. It sends its share of the packets
+ *   and ends.
+ *
+ *   Arguments :
+ *	vargp	- INPUT/OUTPUT. the worker.
+ *
+ *   Return:	- NULL
+ *
+ ********/
+static void *TxWorkerPthreadFunc(void *vargp)
+{
+	TX_WORKER *w = vargp;
+
+	w->retVal = paceBucketSend(w);
+	__sync_fetch_and_sub(&PacedSend.busyCount, 1);
+	return NULL;
+}
+
+
+/***********************
+ *   paceWorkersStart()
+ *
+ *   Start sending the packets of a paced or stream send from
+ *   TxWorkerCount transmit workers, each pinned to a CPU of its own and
+ *   sending on a socket of its own. Worker w sends packets w, w+n,
+ *   w+2n... of the n workers at 1/n of the rate, so together they send
+ *   the packets of the statement at the rate asked for. Ports without
+ *   a socket for every worker, and sends of fewer packets than
+ *   workers, have one worker. See paceWorkersWait().
+ *
+ *   Arguments :
+ *	p		- INPUT. the port.
+ *	data		- INPUT. the packet.
+ *	dataLen		- INPUT. length of the packet.
+ *	pace		- INPUT. count and duration of the send.
+ *	gapNs		- INPUT. time between the packets, 0 for no pacing.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void paceWorkersStart(ETH_PORT_INFO *p,
+			unsigned char *data, const int dataLen,
+			const ETH_PORT_PACE *pace, const double gapNs)
+{
+	pthread_attr_t attr;
+	cpu_set_t allowed, cpus;
+	TX_WORKER *w;
+	int count = 1;
+	int cpu = (-1);
+	int i;
+
+	if (NULL != p->backend->workerSend)
+	{
+		count = TxWorkerCount;
+	}
+	if ((0 != pace->count) && (pace->count < (unsigned long) count))
+	{
+		count = pace->count;
+	}
+	PacedSend.workerCount = count;
+	PacedSend.busyCount = count;
+
+	// Every worker gets the next CPU EDpAT may run on
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	for (i=0; i < count; i++)
+	{
+		w = &TxWorker[i];
+		w->port = p;
+		w->idx = i;
+		w->stride = count;
+		w->cpu = (-1);
+		memcpy(w->data, data, dataLen);
+		w->dataLen = dataLen;
+		w->pace = *pace;
+		w->pace.count = (pace->count / count) +
+			((unsigned long) i < (pace->count % count) ? 1 : 0);
+		w->gapNs = gapNs * count;
+		memset(&w->stats,0,sizeof(w->stats));
+		memset(&w->first,0,sizeof(w->first));
+		memset(&w->last,0,sizeof(w->last));
+		w->retVal = EDPAT_SUCCESS;
+
+		pthread_attr_init(&attr);
+		if ((1 < count) && (0 < CPU_COUNT(&allowed)))
+		{
+			do
+			{
+				cpu = (cpu + 1) % CPU_SETSIZE;
+			} while (!CPU_ISSET(cpu, &allowed));
+			CPU_ZERO(&cpus);
+			CPU_SET(cpu, &cpus);
+			if (0 == pthread_attr_setaffinity_np(&attr,
+					sizeof(cpus), &cpus))
+			{
+				w->cpu = cpu;
+			}
+		}
+		PacedSend.started[i] = EDPAT_FALSE;
+		if (0 != pthread_create(&w->pThread, &attr,
+				TxWorkerPthreadFunc, w))
+		{
+			ExecErrorMsgPrint("pthread_create() failed for "
+				"transmit worker %d of '%s'", i, p->portName);
+			w->retVal = EDPAT_FAILED;
+			__sync_fetch_and_sub(&PacedSend.busyCount, 1);
+		}
+		else
+		{
+			PacedSend.started[i] = EDPAT_TRUE;
+		}
+		pthread_attr_destroy(&attr);
+	}
+	return;
+}
+
+
+/***********************
+ *   paceWorkersWait()
+ *
+ *   Wait till the transmit workers of a paced or stream send are done
+ *   and sum up what they sent.
+ *
+ *   Arguments :
+ *	stats		- OUTPUT. what was sent.
+ *	first, last	- OUTPUT. time the first and the last packets left.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL paceWorkersWait(ETH_PORT_PACE_STATS *stats,
+			struct timespec *first, struct timespec *last)
+{
+	EDPAT_RETVAL retVal = EDPAT_SUCCESS;
+	TX_WORKER *w;
+	int i;
+
+	stats->workers = PacedSend.workerCount;
+	for (i=0; i < PacedSend.workerCount; i++)
+	{
+		w = &TxWorker[i];
+		if (EDPAT_TRUE == PacedSend.started[i])
+		{
+			pthread_join(w->pThread, NULL);
+			PacedSend.started[i] = EDPAT_FALSE;
+		}
+		if (1 < PacedSend.workerCount)
+		{
+			VerboseStringPrint("Transmit worker %d of '%s' on CPU "
+				"%d sent %lu packets, %lu failed", i,
+				w->port->portName, w->cpu, w->stats.sent,
+				w->stats.failed);
+		}
+		if (EDPAT_SUCCESS != w->retVal)
+		{
+			retVal = EDPAT_FAILED;
+		}
+		if (0 == w->stats.sent)
+		{
+			continue;
+		}
+		if ((0 == stats->sent) ||
+		    (0 > TimespecDiffNs(first, &w->first)))
+		{
+			*first = w->first;
+		}
+		if ((0 == stats->sent) ||
+		    (0 < TimespecDiffNs(last, &w->last)))
+		{
+			*last = w->last;
+		}
+		stats->sent += w->stats.sent;
+		stats->failed += w->stats.failed;
+		stats->gapMeanNs += w->stats.gapMeanNs;
+		stats->gapJitterNs += w->stats.gapJitterNs;
+		if (w->stats.gapMaxErrNs > stats->gapMaxErrNs)
+		{
+			stats->gapMaxErrNs = w->stats.gapMaxErrNs;
+		}
+	}
+	PacedSend.workerCount = 0;
+	return retVal;
+}
+
+
+/*************************
+ *
+ *	EthPortSendPacedStart
+ *
+ *	Start sending a packet again and again to the specified port at
+ *	a rate, till the count or the duration asked for is reached. With
+ *	launch times the qdisc of the port paces the packets, and they
+ *	are all handed to the kernel before it returns. Else the token
+ *	buckets of the transmit workers pace them while the interpreter
+ *	goes on. Without a rate the workers send as fast as the port
+ *	takes the packets, a stream send. One send can be in progress at
+ *	a time, it ends with EthPortSendPacedWait().
+ *
+ *	Arguments:	portName - the name of the port for packets to
+ *				   be send to 
+ *			data	 - the packet to be sent
+ *			dataLen	 - the length of the packet
+ *			pace	 - rate, count and duration of the send
+ *
+ *	return: 	EDPAT_SUCCESS if the send is started, else
+ *			EDPAT_NOTFOUND
+ *
+ *
+ *************************/
+
+EDPAT_RETVAL EthPortSendPacedStart(const char *portName,
+			unsigned char *data, const int dataLen,
+			const ETH_PORT_PACE *pace)
+{
+	ETH_PORT_INFO *p;
+	EDPAT_RETVAL retVal = EDPAT_NOTFOUND;
+	double pps;
+	double gapNs;
 	int portIdx;
 
 	portIdx = ethPortIdxFindByName(portName);
-
 	if (0 > portIdx)
 	{
 		ScriptErrorMsgPrint(
@@ -796,43 +1463,170 @@ EDPAT_RETVAL EthPortSend(const char *portName,
 			portName);
 		return EDPAT_NOTFOUND;
 	}
-
-	// A mimimum of 1 bytes is needed
+	p = &EthPortInfoTable[portIdx];
 	if (14 > dataLen)
 	{
-		ScriptErrorMsgPrint(
-			"Insufficent Bytes in send packet. "
+		ScriptErrorMsgPrint("Insufficent Bytes in send packet. "
 			"Minimum 14 is needed");
 		return EDPAT_NOTFOUND;
 	}
 
-	addr.sll_family=AF_PACKET;
-	addr.sll_ifindex=EthPortInfoTable[portIdx].ifIndex;
-	addr.sll_halen=ETHER_ADDR_LEN;
-	addr.sll_protocol=htons(ETH_P_ALL);
-	memcpy(addr.sll_addr,data,ETHER_ADDR_LEN);
-
-	retVal = sendto(EthPortInfoTable[portIdx].ethPortSocketFd,
-				data,dataLen,
-				0,(struct sockaddr*)&addr,sizeof(addr));
-	if ( 0 > retVal)
+	memset(&PacedSend.stats,0,sizeof(PacedSend.stats));
+	memset(&PacedSend.first,0,sizeof(PacedSend.first));
+	memset(&PacedSend.last,0,sizeof(PacedSend.last));
+	PacedSend.wireBits = (((ETH_MIN_FRAME_LEN > dataLen) ?
+			ETH_MIN_FRAME_LEN : dataLen) + ETH_WIRE_OVERHEAD) * 8.0;
+	pps = (0 < pace->pps) ? pace->pps : (pace->bps / PacedSend.wireBits);
+	gapNs = (0 < pps) ? (1000000000.0 / pps) : 0;
+	if (0 < pps)
 	{
-		ExecErrorMsgPrint("sendto(%s) failed",portName);
-		return EDPAT_FAILED;
+		VerboseStringPrint("Paced send of packets of length %d to "
+			"port '%s' at %.0f pps", dataLen, portName, pps);
+	}
+	else
+	{
+		VerboseStringPrint("Stream send of packets of length %d to "
+			"port '%s'", dataLen, portName);
 	}
-
-	VerboseStringPrint(
-			"Packet of length %d send successfuly at port '%s'",
-			dataLen,portName);
 	VerbosePacketHeaderPrint(data);
-	VerbosePacketPrint(data,dataLen);
+	VerbosePacketPrint(data, dataLen);
+
+	if ((EDPAT_TRUE == pace->launchTime) && (0 < pps))
+	{
+		retVal = paceLaunchSend(p, data, dataLen, pace, gapNs,
+				&PacedSend.stats, &PacedSend.first,
+				&PacedSend.last);
+		if (EDPAT_NOTFOUND == retVal)
+		{
+			VerboseStringPrint("Port '%s' does not support launch "
+				"times. Pacing in EDpAT",portName);
+		}
+	}
+	PacedSend.retVal = retVal;
+	if (EDPAT_NOTFOUND == retVal)
+	{
+		PacedSend.retVal = EDPAT_SUCCESS;
+		paceWorkersStart(p, data, dataLen, pace, gapNs);
+	}
 	return EDPAT_SUCCESS;
 }
 
+
+/*************************
+ *
+ *	EthPortSendPacedBusy
+ *
+ *	Check if the paced send started last is still sending.
+ *
+ *	Arguments:	None
+ *
+ *	return: 	EDPAT_TRUE if a transmit worker is still sending
+ *
+ *************************/
+
+EDPAT_BOOL EthPortSendPacedBusy(void)
+{
+	return (0 < PacedSend.busyCount) ? EDPAT_TRUE : EDPAT_FALSE;
+}
+
+
+/*************************
+ *
+ *	EthPortSendPacedWait
+ *
+ *	Wait till the paced send started last is done. What was achieved
+ *	is computed from the times the packets left the port.
+ *
+ *	Arguments:	stats	 - what was achieved is written back here
+ *			lastTxTime - the time the last packet left the
+ *				   port is written back here
+ *
+ *	return: 	EDPAT_SUCCESS if all the packets are sent
+ *
+ *************************/
+
+EDPAT_RETVAL EthPortSendPacedWait(ETH_PORT_PACE_STATS *stats,
+			struct timespec *lastTxTime)
+{
+	EDPAT_RETVAL retVal = PacedSend.retVal;
+	double gapCount;
+
+	if ((0 != PacedSend.workerCount) &&
+	    (EDPAT_SUCCESS != paceWorkersWait(&PacedSend.stats,
+			&PacedSend.first, &PacedSend.last)))
+	{
+		retVal = EDPAT_FAILED;
+	}
+	*stats = PacedSend.stats;
+
+	/* Turn the sums of the gaps into their mean and standard deviation.
+	   Every worker has a gap less than packets */
+	if ((unsigned long) stats->workers < stats->sent)
+	{
+		gapCount = stats->sent - stats->workers;
+		stats->gapMeanNs /= gapCount;
+		stats->gapJitterNs = sqrt(fmax(0.0, stats->gapJitterNs /
+			gapCount - stats->gapMeanNs * stats->gapMeanNs));
+	}
+	if (1 < stats->sent)
+	{
+		stats->elapsedNs = TimespecDiffNs(&PacedSend.first,
+				&PacedSend.last);
+	}
+	if (0 < stats->elapsedNs)
+	{
+		stats->pps = (stats->sent - 1) * 1000000000.0 /
+				stats->elapsedNs;
+		stats->bps = stats->pps * PacedSend.wireBits;
+	}
+	stats->firstTxTime = PacedSend.first;
+	if (NULL != lastTxTime)
+	{
+		*lastTxTime = PacedSend.last;
+	}
+	return retVal;
+}
+
+
+/*************************
+ *
+ *	EthPortSendPaced
+ *
+ *	Send a packet again and again to the specified port at a rate,
+ *	and wait till it is done, see EthPortSendPacedStart().
+ *
+ *	Arguments:	portName - the name of the port for packets to
+ *				   be send to 
+ *			data	 - the packet to be sent
+ *			dataLen	 - the length of the packet
+ *			pace	 - rate, count and duration of the send
+ *			stats	 - what was achieved is written back here
+ *			lastTxTime - the time the last packet left the
+ *				   port is written back here
+ *
+ *	return: 	EDPAT_SUCCESS if all the packets are sent
+ *
+ *
+ *************************/
+
+EDPAT_RETVAL EthPortSendPaced(const char *portName,
+			unsigned char *data, const int dataLen,
+			const ETH_PORT_PACE *pace, ETH_PORT_PACE_STATS *stats,
+			struct timespec *lastTxTime)
+{
+	memset(stats,0,sizeof(*stats));
+	if (EDPAT_SUCCESS != EthPortSendPacedStart(portName, data, dataLen,
+			pace))
+	{
+		return EDPAT_NOTFOUND;
+	}
+	return EthPortSendPacedWait(stats, lastTxTime);
+}
+
 /****************************
  * 	EthPortClearBuf
  *
- * 	This is used to cleanup the memory queue after the testcases have
+ * 	This is used to cleanup the receive queues after the testcases have
  *	been run
  * 	
  * 	Arguments	:	void
@@ -848,7 +1642,8 @@ EDPAT_RETVAL EthPortClearBuf(void)
 	// Keep doing receive any as long as there are packets in the queue
 	do {
 		pktLen = MAX_PKT_SIZE;
-		retVal = EthPortReceiveAny(portName, pkt, &pktLen);
+		retVal = EthPortReceiveAny(portName, pkt, &pktLen,
+				PacketSettleTime, NULL);
 	} while(EDPAT_SUCCESS == retVal);
 	VerboseStringPrint("All receive buffers cleared");
 	return retVal;
@@ -9,15 +9,72 @@
 #ifndef __PETHPORTIO_H__
 #define __PETHPORTIO_H__ 1
 
+#include <time.h>
+
+// bytes an Ethernet frame takes on the wire besides its data: FCS,
+// preamble and inter frame gap
+#define ETH_WIRE_OVERHEAD	24
+#define ETH_MIN_FRAME_LEN	60	// without FCS, shorter ones are padded
+
+// Rate and length of a paced send. A limit of 0 is no limit, a rate of
+// 0 is as fast as the port takes them
+typedef struct {
+	double		pps;		// packets per second, or
+	double		bps;		// bits per second on the wire
+	unsigned long	count;		// packets to send
+	int		durationMs;	// time to keep sending
+	EDPAT_BOOL	launchTime;	// let the qdisc send at SO_TXTIME
+	// changes an earlier packet into packet k, NULL if they are the same
+	void		(*nextPkt)(unsigned char *pkt, const unsigned long k);
+	// keeps the time packet k left, NULL if not needed
+	void		(*txTimeSet)(const unsigned long k,
+				const struct timespec *txTime);
+} ETH_PORT_PACE;
+
+// What a paced send achieved, from the times the packets left
+typedef struct {
+	unsigned long	sent;
+	unsigned long	failed;		// handed to the port but not sent
+	int		workers;	// transmit workers that sent them
+	long long	elapsedNs;	// first to last packet
+	double		pps;
+	double		bps;
+	// between the packets of a worker
+	double		gapMeanNs;
+	double		gapJitterNs;	// standard deviation of the gaps
+	long long	gapMaxErrNs;	// furthest a gap was from the target
+	EDPAT_BOOL	launchTime;	// sent with SO_TXTIME
+	struct timespec	firstTxTime;	// the first packet left
+} ETH_PORT_PACE_STATS;
+
 int EthPortOpen(const char *ifName);
 EDPAT_RETVAL EthPortCloseAll(void);
 EDPAT_RETVAL EthPortReceive(const char *ifName,
-			unsigned char *data, int *dataLen);
+			unsigned char *data, int *dataLen,
+			struct timespec *rxTime);
 EDPAT_RETVAL EthPortReceiveAny(char *ifName,
-			unsigned char *data, int *dataLen);
+			unsigned char *data, int *dataLen, const int waitMs,
+			struct timespec *rxTime);
 EDPAT_RETVAL EthPortSend(const char *ifName,
-			unsigned char *data, const int dataLen);
+			unsigned char *data, const int dataLen,
+			struct timespec *txTime);
+EDPAT_RETVAL EthPortSendBatch(const char *ifName,
+			unsigned char * const *data, const int *dataLen,
+			const int count, int *queuedCount, int *sentCount,
+			struct timespec *txTime);
+EDPAT_RETVAL EthPortSendPaced(const char *ifName,
+			unsigned char *data, const int dataLen,
+			const ETH_PORT_PACE *pace, ETH_PORT_PACE_STATS *stats,
+			struct timespec *lastTxTime);
+EDPAT_RETVAL EthPortSendPacedStart(const char *ifName,
+			unsigned char *data, const int dataLen,
+			const ETH_PORT_PACE *pace);
+EDPAT_BOOL EthPortSendPacedBusy(void);
+EDPAT_RETVAL EthPortSendPacedWait(ETH_PORT_PACE_STATS *stats,
+			struct timespec *lastTxTime);
 EDPAT_RETVAL EthPortClearBuf(void);
+void EthPortFilterUpdate(void);
+EDPAT_RETVAL EthPortWire(const char *ifName, const char *peerName);
 
 
 #endif
@@ -0,0 +1,1748 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ * 
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#define _GNU_SOURCE	// sendmmsg()
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <linux/sockios.h>
+#include <netinet/if_ether.h>
+#include <net/ethernet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "edpat.h"
+#include "print.h"
+#include "filter.h"
+#include "utils.h"
+#include "seqtag.h"
+#include "EthPortBackend.h"
+
+// Older headers do not have it
+#ifndef PACKET_FANOUT_FLAG_IGNORE_OUTGOING
+#define PACKET_FANOUT_FLAG_IGNORE_OUTGOING	0x4000
+#endif
+
+// packets handed to the kernel by one sendmmsg()
+#define TX_MMSG_BATCH			256
+
+// how long to wait for the transmit times of a batch
+#define TX_TIMESTAMP_WAIT_MS		10
+#define TX_TIMESTAMP_CONTROL_LEN	256	// cmsgs of an error queue report
+#define TX_TIMESTAMP_REPORT_SIZE	2048	// buffer a queued report takes
+
+typedef struct packetPort PACKET_PORT;
+
+/* A receiver thread of a port. With more than one thread every thread
+   has its own socket in the PACKET_FANOUT group of the port, and the
+   kernel spreads the incoming packets over them */
+typedef struct {
+	ETH_PORT_INFO	*port;
+	PACKET_PORT	*pp;
+	int		socketFd;	// the first thread uses ethPortSocketFd
+	PKT_QUEUE	*rxQueue;	// receiver thread -> interpreter
+	pthread_t	pThread;
+	unsigned char	*rxRing;	// TPACKET_V3 ring, NULL for recvmsg()
+	size_t		rxRingLen;
+	struct tpacket_req3 rxRingReq;
+	EDPAT_BOOL	kernelFilter;	// filtering done by BPF program
+} RX_THREAD_INFO;
+
+/* A socket the port sends with. The interpreter sends with the first
+   one, and every transmit worker of a stream or paced send with its
+   own, so that they never wait for each other */
+typedef struct {
+	int		socketFd;
+	unsigned char	*txRing;	// PACKET_TX_RING, NULL for sendto()
+	size_t		txRingLen;
+	struct tpacket_req txRingReq;
+	unsigned int	txRingHead;	// next frame to be filled
+	EDPAT_BOOL	txTimestamps;	// sent packets are timestamped
+	unsigned int	txTimestampId;	// OPT_ID of the next packet sent
+} TX_CHANNEL;
+
+// AF_PACKET sockets of an Ethernet interface
+struct packetPort {
+	int		ethPortSocketFd;
+	int		ifIndex;
+	RX_THREAD_INFO	rxThread[MAX_RX_THREAD_COUNT];
+	int		rxThreadCount;
+	int		fanoutArg;	// PACKET_FANOUT group of the threads
+	TX_CHANNEL	txChannel[MAX_TX_WORKER_COUNT];	// TxWorkerCount used
+	EDPAT_BOOL	txTimeTried;	// SO_TXTIME set up, see txTimeEnabled
+	EDPAT_BOOL	txTimeEnabled;
+	EDPAT_BOOL	hwTsChanged;	// hwTsSaved to be restored
+	struct hwtstamp_config hwTsSaved;
+};
+
+/***********************
+ *   packetPortStats()
+ *
+ *   Get the receive statistics of the sockets of the port from the
+ *   kernel, summed over its receiver threads.
+ *
+ *   Arguments : 
+ *	p		- INPUT. pointer to port info table record.
+ *	received	- OUTPUT. packets received by the kernel.
+ *	dropped		- OUTPUT. packets dropped by the kernel.
+ *		
+ *   Return:	-	None
+ *
+ ********/
+static void packetPortStats(ETH_PORT_INFO *p,
+		unsigned long *received, unsigned long *dropped)
+{
+	PACKET_PORT *pp = p->backendData;
+	struct tpacket_stats_v3 kStats;
+	socklen_t kStatsLen;
+	int i;
+
+	for (i=0; i < pp->rxThreadCount; i++)
+	{
+		if (0 > pp->rxThread[i].socketFd)
+		{
+			continue;
+		}
+		/* tpacket_stats_v3 starts with tpacket_stats, fine for V1
+		   as well */
+		memset(&kStats,0,sizeof(kStats));
+		kStatsLen = sizeof(kStats);
+		getsockopt(pp->rxThread[i].socketFd, SOL_PACKET,
+				PACKET_STATISTICS, &kStats, &kStatsLen);
+		*received += kStats.tp_packets;
+		*dropped += kStats.tp_drops;
+	}
+	return;
+}
+
+
+/***********************
+ *   packetPortClose()
+ *
+ *   Stop the receiver threads and close the sockets of the port. The
+ *   hardware timestamping of the NIC is set back as it was found.
+ *
+ *   Arguments : 
+ *	p	-	INPUT. pointer to port info table record.
+ *		
+ *   Return:	-	None
+ *
+ ********/
+static void packetPortClose(ETH_PORT_INFO *p)
+{
+	PACKET_PORT *pp = p->backendData;
+	struct ifreq ifr;
+	RX_THREAD_INFO *t;
+	TX_CHANNEL *c;
+	int i;
+
+	if (NULL == pp)
+	{
+		return;
+	}
+	for (i=0; i < MAX_RX_THREAD_COUNT; i++)
+	{
+		t = &pp->rxThread[i];
+		if ((pthread_t) (-1) != t->pThread)
+		{
+			pthread_cancel(t->pThread);
+			// wait for it, the thread may be walking the ring
+			pthread_join(t->pThread,NULL);
+			t->pThread = (-1);
+			VerboseStringPrint("Receiver thread %d stopped for %s",
+				i, p->portName);
+		}
+		if (NULL != t->rxRing)
+		{
+			munmap(t->rxRing,t->rxRingLen);
+			t->rxRing = NULL;
+			t->rxRingLen = 0;
+		}
+		// The socket of the first thread is closed below
+		if ((0 <= t->socketFd) && (t->socketFd != pp->ethPortSocketFd))
+		{
+			close(t->socketFd);
+		}
+		t->socketFd = (-1);
+	}
+	for (i=0; i < MAX_TX_WORKER_COUNT; i++)
+	{
+		c = &pp->txChannel[i];
+		if (NULL != c->txRing)
+		{
+			munmap(c->txRing,c->txRingLen);
+		}
+		if ( 0 <= c->socketFd)
+		{
+			close(c->socketFd);
+		}
+	}
+	if ( EDPAT_TRUE == pp->hwTsChanged)
+	{
+		memset(&ifr,0,sizeof(ifr));
+		snprintf(ifr.ifr_name,sizeof(ifr.ifr_name),"%.*s",
+			(int) sizeof(ifr.ifr_name)-1,p->portName);
+		ifr.ifr_data = (void *) &pp->hwTsSaved;
+		ioctl(pp->ethPortSocketFd, SIOCSHWTSTAMP, &ifr);
+	}
+	if ( 0 <= pp->ethPortSocketFd)
+	{
+		close(pp->ethPortSocketFd);
+		VerboseStringPrint("Ethernet Port '%s' closed",p->portName);
+	}
+	free(pp);
+	p->backendData = NULL;
+	return ;
+}
+
+
+/***********************
+ *   rxThreadFilterAttach()
+ *
+ *   Compile the current filter rules, and in promiscuous mode the MAC
+ *   of the port, into a BPF program and attach it to the socket of the
+ *   receiver thread. If the kernel does not accept it, the thread
+ *   filters in user space.
+ *
+ *   Arguments : 
+ *	t	- INPUT. Point to the receiver thread of the port.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void rxThreadFilterAttach(RX_THREAD_INFO *t)
+{
+	ETH_PORT_INFO *p = t->port;
+	struct sock_filter prog[MAX_FILTER_PROG_LEN];
+	struct sock_fprog fprog;
+	int dummy = 0;
+
+	if ((FILTER_NONE == PacketFilterRules) &&
+	    (EDPAT_TRUE != PromiscuousModeEnabled))
+	{
+		// Nothing to filter
+		setsockopt(t->socketFd, SOL_SOCKET, SO_DETACH_FILTER,
+				&dummy, sizeof(dummy));
+		t->kernelFilter = EDPAT_TRUE;
+		VerboseStringPrint("No packet filter for '%s'",p->portName);
+		return;
+	}
+
+	fprog.len = FilterProgramBuild(PacketFilterRules,
+			(EDPAT_TRUE == PromiscuousModeEnabled) ? p->macAddr : NULL,
+			prog);
+	fprog.filter = prog;
+	if (0 > setsockopt(t->socketFd, SOL_SOCKET, SO_ATTACH_FILTER,
+			&fprog, sizeof(fprog)))
+	{
+		t->kernelFilter = EDPAT_FALSE;
+		VerboseStringPrint("setsockopt(SO_ATTACH_FILTER) failed for "
+			"'%s'. Filtering in user space",p->portName);
+		return;
+	}
+	t->kernelFilter = EDPAT_TRUE;
+	VerboseStringPrint("Packet filter of %d instructions attached to "
+		"'%s'. Filtered: %s",
+		fprog.len, p->portName, FilterRulesString(PacketFilterRules));
+	return;
+}
+
+
+/***********************
+ *   packetPortFilterUpdate()
+ *
+ *   Recompile and attach the packet filter of all the receiver threads
+ *   of the port.
+ *
+ *   Arguments : 
+ *	p	- INPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void packetPortFilterUpdate(ETH_PORT_INFO *p)
+{
+	PACKET_PORT *pp = p->backendData;
+	int i;
+
+	for (i=0; i < pp->rxThreadCount; i++)
+	{
+		rxThreadFilterAttach(&pp->rxThread[i]);
+	}
+	return;
+}
+
+
+/***********************
+ *   rxThreadPacketDeliver()
+ *
+ *   Filter a packet read from the eth port and put the ones to be kept
+ *   in the receive queue of the thread. Packets that do not fit in the
+ *   queue are counted as dropped.
+ *
+ *   Arguments : 
+ *	t		- INPUT. Point to the receiver thread of the port.
+ *	pkt		- INPUT. pointer to the packet buffer.
+ *	pktLen		- INPUT. leghth of packet.
+ *	rxTime		- INPUT. time the packet arrived.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void rxThreadPacketDeliver(RX_THREAD_INFO *t,
+		unsigned char *pkt, size_t pktLen,
+		const struct timespec *rxTime)
+{
+	ETH_PORT_INFO *p = t->port;
+
+	if (0 == pktLen)
+	{
+		VerboseStringPrint("Empty packet receieved");
+		return;
+	}
+
+	/* Drop packets if it is to be filtered and the kernel has not
+	   done it already. If Promiscuous drop packets not addressed to
+	   the MAC of the ethernet port */
+	if ((EDPAT_TRUE != t->kernelFilter) &&
+	    (EDPAT_TRUE == FilterPacketCheck(PacketFilterRules,
+		(EDPAT_TRUE == PromiscuousModeEnabled) ? p->macAddr : NULL,
+		pkt, pktLen)))
+	{
+		// discard the packt as it needs to be fintered.
+		return;
+	}
+
+	// Packets of a stream are tracked instead of being queued
+	if (EDPAT_TRUE == SeqTagReceive(pkt, pktLen, rxTime))
+	{
+		return;
+	}
+	
+	//  Enqueue the packt to the receive queue
+	PktQueueEnqueue(t->rxQueue,pkt,pktLen,rxTime);
+	return;
+}
+
+
+/***********************
+ *   receiveByRecvfrom()
+ *
+ *   Receive loop used when the thread has no receive ring. Every
+ *   packet is read with a recvmsg() into a local buffer, along with the
+ *   time the NIC or the kernel received it.
+ *
+ *   Arguments : 
+ *	t	-  INPUT. Point to the receiver thread of the port.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void receiveByRecvfrom(RX_THREAD_INFO *t)
+{
+	ETH_PORT_INFO *p = t->port;
+	unsigned char	pkt[MAX_PKT_SIZE];
+	struct timespec	rxTime;
+	ssize_t	pktLen;
+	int	lastEthErrno = 0;
+	struct sockaddr_ll addr={0};
+	struct iovec	iov;
+	struct msghdr	msg;
+	struct cmsghdr	*cmsg;
+	struct scm_timestamping *tss;
+	char	control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+	iov.iov_base = pkt;
+	iov.iov_len = sizeof(pkt);
+	while(1) // do for ever
+	{
+		memset(&msg,0,sizeof(msg));
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		// Receive packet formo given port
+		pktLen = recvmsg(t->socketFd, &msg, 0);
+
+		if (0 > pktLen)
+		{
+			if (errno != lastEthErrno)
+			{
+				// print the error message only once
+				ExecErrorMsgPrint("recvmsg() failed "
+					"while receiving packet from '%s'",
+					p->portName);
+				lastEthErrno = errno;
+			}
+			continue;
+		}
+
+		// Without SO_TIMESTAMPING take the time the packet is read
+		clock_gettime(CLOCK_REALTIME, &rxTime);
+		for (cmsg = CMSG_FIRSTHDR(&msg); NULL != cmsg;
+				cmsg = CMSG_NXTHDR(&msg,cmsg))
+		{
+			if ((SOL_SOCKET != cmsg->cmsg_level) ||
+			    (SCM_TIMESTAMPING != cmsg->cmsg_type))
+			{
+				continue;
+			}
+			// [0] is the software time, [2] the raw hardware time
+			tss = (struct scm_timestamping *) CMSG_DATA(cmsg);
+			if (0 != tss->ts[2].tv_sec)
+			{
+				rxTime = tss->ts[2];
+			}
+			else if (0 != tss->ts[0].tv_sec)
+			{
+				rxTime = tss->ts[0];
+			}
+		}
+		rxThreadPacketDeliver(t,pkt,pktLen,&rxTime);
+	}
+}
+
+
+/***********************
+ *   receiveByRing()
+ *
+ *   Receive loop used when the thread has a TPACKET_V3 receive ring.
+ *   The kernel fills blocks of the ring and hands them over by setting
+ *   TP_STATUS_USER. All the packets in a block are walked in place and
+ *   the block is given back to the kernel afterwards. No syscall is
+ *   made while there are filled blocks.
+ *
+ *   Arguments : 
+ *	t	-  INPUT. Point to the receiver thread of the port.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void receiveByRing(RX_THREAD_INFO *t)
+{
+	ETH_PORT_INFO *p = t->port;
+	struct timespec	rxTime;
+	struct tpacket_block_desc *blk;
+	struct tpacket3_hdr *hdr;
+	struct pollfd	pfd;
+	unsigned int	blkIdx = 0;
+	unsigned int	i;
+	int	lastEthErrno = 0;
+
+	pfd.fd = t->socketFd;
+	pfd.events = POLLIN | POLLERR;
+	pfd.revents = 0;
+
+	while(1) // do for ever
+	{
+		blk = (struct tpacket_block_desc *)
+			(t->rxRing + (blkIdx * t->rxRingReq.tp_block_size));
+
+		if (0 == (blk->hdr.bh1.block_status & TP_STATUS_USER))
+		{
+			// Nothing filled yet. Wait for the kernel
+			if ((0 > poll(&pfd,1,-1)) && (errno != lastEthErrno))
+			{
+				// print the error message only once
+				ExecErrorMsgPrint("poll() failed "
+					"while receiving packet from '%s'",
+					p->portName);
+				lastEthErrno = errno;
+			}
+			continue;
+		}
+		__sync_synchronize();
+
+		hdr = (struct tpacket3_hdr *) ((unsigned char *) blk +
+				blk->hdr.bh1.offset_to_first_pkt);
+		for (i=0; i < blk->hdr.bh1.num_pkts; i++)
+		{
+			rxTime.tv_sec = hdr->tp_sec;
+			rxTime.tv_nsec = hdr->tp_nsec;
+			rxThreadPacketDeliver(t,
+				(unsigned char *) hdr + hdr->tp_mac,
+				hdr->tp_snaplen, &rxTime);
+			hdr = (struct tpacket3_hdr *)
+				((unsigned char *) hdr + hdr->tp_next_offset);
+		}
+
+		// Give the block back to the kernel
+		__sync_synchronize();
+		blk->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		blkIdx = (blkIdx + 1) % t->rxRingReq.tp_block_nr;
+	}
+}
+
+
+/***********************
+ *   ReceiverPthreadFunc()
+ *
+ *   This function will run as a child thread. It will read any packet
+ *   receved on its socket of the eth port and put it in its queue so
+ *   that the message will not be lost.
+ *
+ *   Arguments : 
+ *	vargp	-  INPUT. Point to the receiver thread of the port.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void *ReceiverPthreadFunc(void *vargp)
+{
+	RX_THREAD_INFO *t = (RX_THREAD_INFO *) vargp;
+
+	if (NULL != t->rxRing)
+	{
+		receiveByRing(t);
+	}
+	else
+	{
+		receiveByRecvfrom(t);
+	}
+	return NULL;
+}
+
+
+/***********************
+ *   rxThreadRingSetup()
+ *
+ *   Map a TPACKET_V3 receive ring of RxRingSize KB to the socket of the
+ *   receiver thread. If the kernel refuses, the thread is left without
+ *   a ring and falls back to recvmsg().
+ *
+ *   Arguments : 
+ *	t	-  INPUT/OUTPUT. Point to the receiver thread of the port.
+ *
+ *   Return:	- EDPAT_SUCCESS if the ring is mapped, else EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL rxThreadRingSetup(RX_THREAD_INFO *t)
+{
+	ETH_PORT_INFO *p = t->port;
+	struct tpacket_req3 *req = &t->rxRingReq;
+	int version = TPACKET_V3;
+	void *ring;
+
+	if (0 == RxRingSize)
+	{
+		VerboseStringPrint("Receive ring disabled for '%s'",
+			p->portName);
+		return EDPAT_FAILED;
+	}
+
+	if (0 > setsockopt(t->socketFd, SOL_PACKET, PACKET_VERSION,
+			&version, sizeof(version)))
+	{
+		VerboseStringPrint("setsockopt(PACKET_VERSION) failed for '%s'."
+			" Using recvmsg()",p->portName);
+		return EDPAT_FAILED;
+	}
+
+	memset(req,0,sizeof(*req));
+	req->tp_block_size = RX_RING_BLOCK_SIZE;
+	req->tp_block_nr = ((size_t) RxRingSize * 1024) / RX_RING_BLOCK_SIZE;
+	req->tp_frame_size = TPACKET_ALIGN(TPACKET3_HDRLEN + MAX_PKT_SIZE);
+	// frame size must divide the block size
+	while (0 != (req->tp_block_size % req->tp_frame_size))
+	{
+		req->tp_frame_size += TPACKET_ALIGNMENT;
+	}
+	req->tp_frame_nr = (req->tp_block_size / req->tp_frame_size) *
+				req->tp_block_nr;
+	req->tp_retire_blk_tov = RxRingBlockTimeout;
+	req->tp_feature_req_word = 0;
+
+	if (0 > setsockopt(t->socketFd, SOL_PACKET, PACKET_RX_RING,
+			req, sizeof(*req)))
+	{
+		VerboseStringPrint("setsockopt(PACKET_RX_RING) failed for '%s'."
+			" Using recvmsg()",p->portName);
+		version = TPACKET_V1;
+		setsockopt(t->socketFd, SOL_PACKET, PACKET_VERSION,
+			&version, sizeof(version));
+		return EDPAT_FAILED;
+	}
+
+	t->rxRingLen = (size_t) req->tp_block_size * req->tp_block_nr;
+	ring = mmap(NULL, t->rxRingLen, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_LOCKED, t->socketFd, 0);
+	if (MAP_FAILED == ring)
+	{
+		// MAP_LOCKED may hit RLIMIT_MEMLOCK, retry without it
+		ring = mmap(NULL, t->rxRingLen, PROT_READ | PROT_WRITE,
+				MAP_SHARED, t->socketFd, 0);
+	}
+	if (MAP_FAILED == ring)
+	{
+		ExecErrorMsgPrint("mmap() of receive ring failed for '%s'",
+			p->portName);
+		// release the ring so that recvmsg() gets the packets
+		memset(req,0,sizeof(*req));
+		setsockopt(t->socketFd, SOL_PACKET, PACKET_RX_RING,
+			req, sizeof(*req));
+		t->rxRingLen = 0;
+		return EDPAT_FAILED;
+	}
+	t->rxRing = ring;
+
+	VerboseStringPrint("Receive ring of %d blocks of %d bytes "
+		"mapped for '%s'. Block timeout %d ms",
+		req->tp_block_nr, req->tp_block_size,
+		p->portName, req->tp_retire_blk_tov);
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   txRingSetup()
+ *
+ *   Map a TPACKET_V2 PACKET_TX_RING of TxRingSize KB to a sending
+ *   socket of the port. Packets to be sent are copied into the ring and
+ *   the kernel is kicked once per batch. If the kernel refuses, the
+ *   socket keeps using sendto().
+ *
+ *   Arguments : 
+ *	p	-  INPUT. Point to the port into table.
+ *	c	-  INPUT/OUTPUT. the sending socket.
+ *
+ *   Return:	- EDPAT_SUCCESS if the ring is mapped, else EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL txRingSetup(ETH_PORT_INFO *p, TX_CHANNEL *c)
+{
+	struct tpacket_req *req = &c->txRingReq;
+	int version = TPACKET_V2;
+	int opt = 1;
+	void *ring;
+
+	if (0 == TxRingSize)
+	{
+		return EDPAT_FAILED;
+	}
+
+	if (0 > setsockopt(c->socketFd, SOL_PACKET, PACKET_VERSION,
+			&version, sizeof(version)))
+	{
+		VerboseStringPrint("setsockopt(PACKET_VERSION) failed for '%s'."
+			" Using sendto()",p->portName);
+		return EDPAT_FAILED;
+	}
+	if ((EDPAT_TRUE == TxQdiscBypassEnabled) &&
+	    (0 > setsockopt(c->socketFd, SOL_PACKET, PACKET_QDISC_BYPASS,
+			&opt, sizeof(opt))))
+	{
+		VerboseStringPrint("setsockopt(PACKET_QDISC_BYPASS) failed "
+			"for '%s'",p->portName);
+	}
+
+	memset(req,0,sizeof(*req));
+	req->tp_block_size = TX_RING_BLOCK_SIZE;
+	req->tp_block_nr = ((size_t) TxRingSize * 1024) / TX_RING_BLOCK_SIZE;
+	req->tp_frame_size = TPACKET_ALIGN(TPACKET2_HDRLEN + MAX_PKT_SIZE);
+	req->tp_frame_nr = (req->tp_block_size / req->tp_frame_size) *
+				req->tp_block_nr;
+	if (0 > setsockopt(c->socketFd, SOL_PACKET, PACKET_TX_RING,
+			req, sizeof(*req)))
+	{
+		VerboseStringPrint("setsockopt(PACKET_TX_RING) failed for '%s'."
+			" Using sendto()",p->portName);
+		return EDPAT_FAILED;
+	}
+
+	c->txRingLen = (size_t) req->tp_block_size * req->tp_block_nr;
+	ring = mmap(NULL, c->txRingLen, PROT_READ | PROT_WRITE,
+			MAP_SHARED, c->socketFd, 0);
+	if (MAP_FAILED == ring)
+	{
+		ExecErrorMsgPrint("mmap() of transmit ring failed for '%s'",
+			p->portName);
+		// release the ring so that sendto() can be used
+		memset(req,0,sizeof(*req));
+		setsockopt(c->socketFd, SOL_PACKET, PACKET_TX_RING,
+			req, sizeof(*req));
+		c->txRingLen = 0;
+		return EDPAT_FAILED;
+	}
+	c->txRing = ring;
+	c->txRingHead = 0;
+
+	VerboseStringPrint("Transmit ring of %d frames of %d bytes "
+		"mapped for '%s'%s",
+		req->tp_frame_nr, req->tp_frame_size, p->portName,
+		(EDPAT_TRUE == TxQdiscBypassEnabled) ?
+			". Qdisc bypassed" : "");
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   txSocketOpen()
+ *
+ *   Open a socket the port sends with, with the transmit ring if asked
+ *   for. With -H the kernel is asked to timestamp every packet sent on
+ *   it and to report the times on its error queue, see
+ *   txTimestampsCollect(). Having a socket of its own keeps these
+ *   reports away from the receiver threads. Without it, a send does not
+ *   wait for the reports and the time it returned is taken.
+ *
+ *   Arguments : 
+ *	p	-  INPUT. Point to the port into table.
+ *	c	-  OUTPUT. the sending socket.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL txSocketOpen(ETH_PORT_INFO *p, TX_CHANNEL *c)
+{
+	PACKET_PORT *pp = p->backendData;
+	struct sockaddr_ll portAddr;
+	int tsFlags;
+	int bufLen;
+
+	// Protocol 0, this socket is used only for sending
+	c->socketFd = socket(AF_PACKET,SOCK_RAW,0);
+	if (0 > c->socketFd)
+	{
+		ExecErrorMsgPrint("socket() for sending failed for '%s'",
+			p->portName);
+		return EDPAT_FAILED;
+	}
+
+	/* Map the transmit ring if asked for. On failure packets are
+	   sent with sendto() */
+	txRingSetup(p, c);
+
+	/* OPT_ID numbers the reports in the order the packets were sent,
+	   OPT_TSONLY leaves the packet out of them. Only asked for with -H,
+	   as each send waits for them */
+	tsFlags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+		SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY |
+		SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+	if ((EDPAT_TRUE == HwTimestampEnabled) &&
+	    (0 > setsockopt(c->socketFd, SOL_SOCKET, SO_TIMESTAMPING,
+			&tsFlags, sizeof(tsFlags))))
+	{
+		VerboseStringPrint("setsockopt(SO_TIMESTAMPING) failed for "
+			"sending on '%s'",p->portName);
+	}
+	else if (EDPAT_TRUE == HwTimestampEnabled)
+	{
+		c->txTimestamps = EDPAT_TRUE;
+		/* The reports are queued on the receive buffer of the socket,
+		   a report that does not fit is dropped. Make room for a
+		   sendmmsg() worth of them, the kernel caps it at rmem_max */
+		bufLen = TX_MMSG_BATCH * TX_TIMESTAMP_REPORT_SIZE;
+		setsockopt(c->socketFd, SOL_SOCKET, SO_RCVBUF,
+			&bufLen, sizeof(bufLen));
+	}
+
+	// The ring sends on the interface the socket is bound to
+	memset(&portAddr,0,sizeof(portAddr));
+	portAddr.sll_family = AF_PACKET;
+	portAddr.sll_protocol = 0;
+	portAddr.sll_ifindex = pp->ifIndex;
+	if (0 > bind(c->socketFd,
+			(struct sockaddr *) &portAddr, sizeof(portAddr)))
+	{
+		ExecErrorMsgPrint("bind() of sending socket failed for '%s'",
+			p->portName);
+		return EDPAT_FAILED;
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   txTimestampsCollect()
+ *
+ *   Read the times the packets of a batch left the port from the error
+ *   queue of the sending socket. The kernel reports them once the driver
+ *   has the packet, which is after the send returned when a ring or a
+ *   qdisc is in between, so they are waited for a short while. A
+ *   hardware time is taken over a software one of the same packet.
+ *   Reports of earlier batches that came too late are dropped.
+ *
+ *   Arguments : 
+ *	c	- INPUT. the sending socket of the batch.
+ *	firstId	- INPUT. OPT_ID of the first packet of the batch.
+ *	count	- INPUT. number of packets of the batch.
+ *	txTime	- OUTPUT. time each packet left, zero if not reported.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void txTimestampsCollect(TX_CHANNEL *c, const unsigned int firstId,
+		const int count, struct timespec *txTime)
+{
+	char control[TX_TIMESTAMP_CONTROL_LEN];
+	struct scm_timestamping *tss;
+	struct sock_extended_err *ee;
+	struct timespec end;
+	struct pollfd pfd;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	unsigned int idx;
+	int remainingMs;
+	int done = 0;
+
+	pfd.fd = c->socketFd;
+	pfd.events = 0;		// POLLERR is always reported
+	DeadlineSet(&end, TX_TIMESTAMP_WAIT_MS);
+	while (done < count)
+	{
+		memset(&msg,0,sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (0 > recvmsg(c->socketFd, &msg,
+				MSG_ERRQUEUE | MSG_DONTWAIT))
+		{
+			remainingMs = DeadlineRemainingMs(&end);
+			if ((EAGAIN != errno) || (0 >= remainingMs) ||
+			    (0 >= poll(&pfd, 1, remainingMs)))
+			{
+				break;
+			}
+			continue;
+		}
+
+		tss = NULL;
+		ee = NULL;
+		for (cmsg = CMSG_FIRSTHDR(&msg); NULL != cmsg;
+				cmsg = CMSG_NXTHDR(&msg,cmsg))
+		{
+			if ((SOL_SOCKET == cmsg->cmsg_level) &&
+			    (SCM_TIMESTAMPING == cmsg->cmsg_type))
+			{
+				tss = (struct scm_timestamping *)
+					CMSG_DATA(cmsg);
+			}
+			else if ((SOL_PACKET == cmsg->cmsg_level) &&
+			    (PACKET_TX_TIMESTAMP == cmsg->cmsg_type))
+			{
+				ee = (struct sock_extended_err *)
+					CMSG_DATA(cmsg);
+			}
+		}
+		if ((NULL == tss) || (NULL == ee) ||
+		    (SO_EE_ORIGIN_TIMESTAMPING != ee->ee_origin))
+		{
+			continue;
+		}
+		idx = ee->ee_data - firstId;
+		if (idx >= (unsigned int) count)
+		{
+			continue;
+		}
+		if ((0 == txTime[idx].tv_sec) && (0 == txTime[idx].tv_nsec))
+		{
+			done++;
+		}
+		// [0] is the software time, [2] the raw hardware time
+		if (0 != tss->ts[2].tv_sec)
+		{
+			txTime[idx] = tss->ts[2];
+		}
+		else if (0 != tss->ts[0].tv_sec)
+		{
+			txTime[idx] = tss->ts[0];
+		}
+	}
+	return;
+}
+
+
+/***********************
+ *   hwTimestampSetup()
+ *
+ *   Turn on hardware timestamping of all the packets in the NIC of the
+ *   port. The configuration found is kept to be restored when the port
+ *   is closed. If the NIC does not support it, the software timestamps
+ *   of the kernel are used.
+ *
+ *   Arguments : 
+ *	p	-  INPUT/OUTPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void hwTimestampSetup(ETH_PORT_INFO *p)
+{
+	PACKET_PORT *pp = p->backendData;
+	struct hwtstamp_config config;
+	struct ifreq ifr;
+
+	memset(&ifr,0,sizeof(ifr));
+	snprintf(ifr.ifr_name,sizeof(ifr.ifr_name),"%.*s",
+			(int) sizeof(ifr.ifr_name)-1,p->portName);
+	ifr.ifr_data = (void *) &pp->hwTsSaved;
+	if (0 > ioctl(pp->ethPortSocketFd, SIOCGHWTSTAMP, &ifr))
+	{
+		memset(&pp->hwTsSaved,0,sizeof(pp->hwTsSaved));
+	}
+
+	memset(&config,0,sizeof(config));
+	config.tx_type = HWTSTAMP_TX_ON;
+	config.rx_filter = HWTSTAMP_FILTER_ALL;
+	ifr.ifr_data = (void *) &config;
+	if (0 > ioctl(pp->ethPortSocketFd, SIOCSHWTSTAMP, &ifr))
+	{
+		VerboseStringPrint("Hardware timestamping not supported by "
+			"'%s'. Using software timestamps",p->portName);
+		return;
+	}
+	pp->hwTsChanged = EDPAT_TRUE;
+	VerboseStringPrint("Hardware timestamping enabled for '%s'%s",
+		p->portName, (HWTSTAMP_FILTER_ALL != config.rx_filter) ?
+			". Not all received packets are timestamped" : "");
+	return;
+}
+
+
+/***********************
+ *   txRingFrame()
+ *
+ *   Get the address of a frame in the transmit ring of a sending socket.
+ *   The frames do not cross block boundaries.
+ *
+ *   Arguments : 
+ *	c	- INPUT. the sending socket.
+ *	idx	- INPUT. Index of the frame in the ring.
+ *
+ *   Return:	- pointer to the tpacket2_hdr of the frame
+ *
+ ********/
+static struct tpacket2_hdr *txRingFrame(TX_CHANNEL *c, unsigned int idx)
+{
+	unsigned int framesPerBlock;
+
+	framesPerBlock = c->txRingReq.tp_block_size / c->txRingReq.tp_frame_size;
+	return (struct tpacket2_hdr *) (c->txRing +
+		((idx / framesPerBlock) * c->txRingReq.tp_block_size) +
+		((idx % framesPerBlock) * c->txRingReq.tp_frame_size));
+}
+
+
+/***********************
+ *   txRingFrameDone()
+ *
+ *   Account a frame of the transmit ring whose packet was handed to the
+ *   kernel and make it available again.
+ *
+ *   Arguments : 
+ *	p		- INPUT. Point to the port into table.
+ *	hdr		- INPUT. the frame.
+ *	sentCount	- OUTPUT. incremented if the packet left the ring.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void txRingFrameDone(ETH_PORT_INFO *p, struct tpacket2_hdr *hdr,
+		int *sentCount)
+{
+	if (TP_STATUS_AVAILABLE == hdr->tp_status)
+	{
+		(*sentCount)++;
+	}
+	else if (TP_STATUS_WRONG_FORMAT & hdr->tp_status)
+	{
+		VerboseStringPrint("Kernel rejected a packet of %d bytes in "
+			"transmit ring of '%s'",hdr->tp_len,p->portName);
+		hdr->tp_status = TP_STATUS_AVAILABLE;
+	}
+	return;
+}
+
+
+/***********************
+ *   txRingSend()
+ *
+ *   Send a batch of packets through the transmit ring of a sending
+ *   socket of the port. The packets are copied into free frames and the
+ *   kernel is kicked once when the batch is queued, or earlier if the
+ *   ring is full. The last kick waits for the kernel to complete the
+ *   transmission so that the frames that actually left the ring can be
+ *   counted.
+ *
+ *   Arguments : 
+ *	p		- INPUT. Point to the port into table.
+ *	c		- INPUT. the sending socket.
+ *	data		- INPUT. array of pointers to the packets.
+ *	dataLen		- INPUT. array of lengths of the packets.
+ *	count		- INPUT. number of packets.
+ *	queuedCount	- OUTPUT. number of packets put in the ring.
+ *	sentCount	- OUTPUT. number of packets that left the ring.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void txRingSend(ETH_PORT_INFO *p, TX_CHANNEL *c,
+		unsigned char * const *data, const int *dataLen,
+		const int count, int *queuedCount, int *sentCount)
+{
+	struct tpacket2_hdr *hdr;
+	struct pollfd	pfd;
+	unsigned int	frameCount = c->txRingReq.tp_frame_nr;
+	unsigned int	i, last;
+	int	n;
+
+	pfd.fd = c->socketFd;
+	pfd.events = POLLOUT;
+
+	for (n=0; n < count; n++)
+	{
+		hdr = txRingFrame(c,c->txRingHead);
+		while ((TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING) &
+				hdr->tp_status)
+		{
+			// Ring full. Kick the kernel and wait for a frame
+			if ((0 > send(c->socketFd,NULL,0,MSG_DONTWAIT)) &&
+			    (EAGAIN != errno) && (ENOBUFS != errno))
+			{
+				ExecErrorMsgPrint("send() failed for transmit "
+					"ring of '%s'",p->portName);
+				goto done;
+			}
+			if (0 >= poll(&pfd,1,PacketReceiveTimeout*1000))
+			{
+				ExecErrorMsgPrint("Transmit ring of '%s' "
+					"is stuck",p->portName);
+				goto done;
+			}
+		}
+		if ((unsigned int) n >= frameCount)
+		{
+			// frame is reused within this batch
+			txRingFrameDone(p,hdr,sentCount);
+		}
+		memcpy((unsigned char *) hdr + TPACKET2_HDRLEN -
+				sizeof(struct sockaddr_ll),
+			data[n], dataLen[n]);
+		hdr->tp_len = dataLen[n];
+		__sync_synchronize();
+		hdr->tp_status = TP_STATUS_SEND_REQUEST;
+		(*queuedCount)++;
+		c->txRingHead = (c->txRingHead + 1) % frameCount;
+	}
+
+	// Kick once for the batch and wait till the kernel is done
+	if (0 > send(c->socketFd,NULL,0,0))
+	{
+		ExecErrorMsgPrint("send() failed for transmit ring of '%s'",
+			p->portName);
+	}
+
+done:
+	// Account the frames not yet reused within this batch
+	last = ((unsigned int) (*queuedCount) < frameCount) ?
+			(unsigned int) (*queuedCount) : frameCount;
+	for (i=0; i < last; i++)
+	{
+		hdr = txRingFrame(c,
+			(c->txRingHead + frameCount - last + i) % frameCount);
+		txRingFrameDone(p,hdr,sentCount);
+	}
+	return;
+}
+
+
+/***********************
+ *   rxThreadFanoutJoin()
+ *
+ *   Add the socket of a receiver thread to the PACKET_FANOUT group of
+ *   the port. The first thread creates the group with an id picked by
+ *   the kernel, the others join it. The kernel then spreads the
+ *   packets of the port over the threads by flow hash, or by the CPU
+ *   that received them.
+ *
+ *   Arguments : 
+ *	t	-  INPUT. Point to the receiver thread of the port.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL rxThreadFanoutJoin(RX_THREAD_INFO *t)
+{
+	ETH_PORT_INFO *p = t->port;
+	PACKET_PORT *pp = t->pp;
+	int mode;
+	int flags;
+	socklen_t argLen = sizeof(pp->fanoutArg);
+
+	if (t != &pp->rxThread[0])
+	{
+		if (0 > setsockopt(t->socketFd, SOL_PACKET, PACKET_FANOUT,
+				&pp->fanoutArg, sizeof(pp->fanoutArg)))
+		{
+			ExecErrorMsgPrint("setsockopt(PACKET_FANOUT) failed "
+				"for '%s'",p->portName);
+			return EDPAT_FAILED;
+		}
+		return EDPAT_SUCCESS;
+	}
+
+	mode = (EDPAT_TRUE == RxFanoutByCpu) ?
+			PACKET_FANOUT_CPU : PACKET_FANOUT_HASH;
+	/* PACKET_IGNORE_OUTGOING of the sockets is not used by a fanout
+	   group, the group has its own flag */
+	flags = PACKET_FANOUT_FLAG_IGNORE_OUTGOING;
+	pp->fanoutArg = (mode | flags | PACKET_FANOUT_FLAG_UNIQUEID) << 16;
+	if ((0 > setsockopt(t->socketFd, SOL_PACKET, PACKET_FANOUT,
+			&pp->fanoutArg, sizeof(pp->fanoutArg))) &&
+	    (0 != flags))
+	{
+		VerboseStringPrint("PACKET_FANOUT_FLAG_IGNORE_OUTGOING not "
+			"supported for '%s'. Sent packets may be received "
+			"back",p->portName);
+		pp->fanoutArg = (mode | PACKET_FANOUT_FLAG_UNIQUEID) << 16;
+		flags = 0;
+		if (0 > setsockopt(t->socketFd, SOL_PACKET, PACKET_FANOUT,
+				&pp->fanoutArg, sizeof(pp->fanoutArg)))
+		{
+			pp->fanoutArg = (-1);
+		}
+	}
+	// Read back the id of the group for the other threads
+	if ((0 > pp->fanoutArg) ||
+	    (0 > getsockopt(t->socketFd, SOL_PACKET, PACKET_FANOUT,
+			&pp->fanoutArg, &argLen)))
+	{
+		ExecErrorMsgPrint("setsockopt(PACKET_FANOUT) failed for '%s'",
+			p->portName);
+		return EDPAT_FAILED;
+	}
+	pp->fanoutArg = (pp->fanoutArg & 0xffff) | ((mode | flags) << 16);
+
+	VerboseStringPrint("Fanout group %d of %d threads created for '%s'. "
+		"Packets spread by %s", pp->fanoutArg & 0xffff,
+		pp->rxThreadCount, p->portName,
+		(PACKET_FANOUT_CPU == mode) ? "CPU" : "flow hash");
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   rxThreadTimestampSetup()
+ *
+ *   Ask the kernel for the receive time of every packet of the thread,
+ *   from the NIC if hardware timestamping is asked for. The ring has the
+ *   time in the header of each packet, recvmsg() gets it along with the
+ *   packet.
+ *
+ *   Arguments : 
+ *	t	-  INPUT. Point to the receiver thread of the port.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void rxThreadTimestampSetup(RX_THREAD_INFO *t)
+{
+	ETH_PORT_INFO *p = t->port;
+	int tsFlags;
+
+	if (NULL != t->rxRing)
+	{
+		// Software time is used when there is no hardware time
+		tsFlags = SOF_TIMESTAMPING_RAW_HARDWARE;
+		if ((EDPAT_TRUE == HwTimestampEnabled) &&
+		    (0 > setsockopt(t->socketFd, SOL_PACKET, PACKET_TIMESTAMP,
+				&tsFlags, sizeof(tsFlags))))
+		{
+			VerboseStringPrint("setsockopt(PACKET_TIMESTAMP) "
+				"failed for '%s'",p->portName);
+		}
+		return;
+	}
+
+	tsFlags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+	if (EDPAT_TRUE == HwTimestampEnabled)
+	{
+		tsFlags |= SOF_TIMESTAMPING_RX_HARDWARE |
+			SOF_TIMESTAMPING_RAW_HARDWARE;
+	}
+	if (0 > setsockopt(t->socketFd, SOL_SOCKET, SO_TIMESTAMPING,
+			&tsFlags, sizeof(tsFlags)))
+	{
+		VerboseStringPrint("setsockopt(SO_TIMESTAMPING) failed for "
+			"'%s'",p->portName);
+	}
+	return;
+}
+
+
+/***********************
+ *   rxThreadOpen()
+ *
+ *   Set up a receiver thread of the port. Every thread but the first
+ *   opens its own socket. The socket gets the packet filter and the
+ *   receive ring, is bound to the port and, when the port has more
+ *   than one thread, put in the fanout group of the port. The thread
+ *   is then started to fill its own receive queue of the port.
+ *
+ *   Arguments : 
+ *	p		- INPUT/OUTPUT. Point to the port into table.
+ *	threadIdx	- INPUT. Index of the thread in the port.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL rxThreadOpen(ETH_PORT_INFO *p, const int threadIdx)
+{
+	PACKET_PORT *pp = p->backendData;
+	RX_THREAD_INFO *t = &pp->rxThread[threadIdx];
+	struct sockaddr_ll portAddr;
+	int opt = 1;
+
+	t->port = p;
+	t->pp = pp;
+	t->rxQueue = p->rxQueue[threadIdx];
+	if (0 == threadIdx)
+	{
+		t->socketFd = pp->ethPortSocketFd;
+	}
+	else
+	{
+		t->socketFd = socket(AF_PACKET,SOCK_RAW,htons(ETH_P_ALL));
+		if (0 > t->socketFd)
+		{
+			ExecErrorMsgPrint("socket() of receiver thread %d "
+				"failed for '%s'",threadIdx,p->portName);
+			return EDPAT_FAILED;
+		}
+	}
+
+	// Drop the noise packets in the kernel
+	rxThreadFilterAttach(t);
+
+	/* Map the receive ring if possible. On failure the receiver
+	   thread uses recvmsg() */
+	rxThreadRingSetup(t);
+
+	/* Timestamp every received packet, to merge the queues of the
+	   port and for the logs */
+	rxThreadTimestampSetup(t);
+
+	/* Packets sent by the sending socket are passed to the receiving
+	   socket of the port. Do not receive them back */
+	if (0 > setsockopt(t->socketFd, SOL_PACKET,
+			PACKET_IGNORE_OUTGOING, &opt, sizeof(opt)))
+	{
+		VerboseStringPrint("setsockopt(PACKET_IGNORE_OUTGOING) failed "
+			"for '%s'. Sent packets may be received back",
+			p->portName);
+	}
+
+	/* SO_BINDTODEVICE does not restrict what a packet socket receives.
+	   Bind to the interface so that only packets of this port are
+	   seen by its socket and ring */
+	memset(&portAddr,0,sizeof(portAddr));
+	portAddr.sll_family = AF_PACKET;
+	portAddr.sll_protocol = htons(ETH_P_ALL);
+	portAddr.sll_ifindex = pp->ifIndex;
+	if (0 > bind(t->socketFd,
+			(struct sockaddr *) &portAddr, sizeof(portAddr)))
+	{
+		ExecErrorMsgPrint("bind() failed for Eth Port '%s'",
+			p->portName);
+		return EDPAT_FAILED;
+	}
+
+	if ((1 < pp->rxThreadCount) &&
+	    (EDPAT_SUCCESS != rxThreadFanoutJoin(t)))
+	{
+		return EDPAT_FAILED;
+	}
+
+	if (0 != pthread_create(&t->pThread, NULL, ReceiverPthreadFunc, t))
+	{
+		ExecErrorMsgPrint("pthread() failed");
+		t->pThread = (-1);
+		return EDPAT_FAILED;
+	}
+	VerboseStringPrint("Receiver thread %d with a queue of %d packets "
+		"started for '%s'",
+		threadIdx, t->rxQueue->slotCount, p->portName);
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   packetPortOpen()
+ *
+ *   Open the specifed ethernet port with AF_PACKET sockets. In addtion
+ *   it will start the recever theads to receve incomming packets in
+ *   the receive queues of the port.
+ *
+ *   Arguments : 
+ *	p	- INPUT/OUTPUT. Point to the port into table. The name
+ *		  is already filled in.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ *********************************/
+static EDPAT_RETVAL packetPortOpen(ETH_PORT_INFO *p)
+{
+	const char *portName = p->portName;
+	PACKET_PORT *pp;
+	int socketOpt;
+	struct ifreq portOpts;
+	size_t portNameLen;
+	int portNameLenAllowed;
+	int i;
+
+	pp = calloc(1,sizeof(*pp));
+	if (NULL == pp)
+	{
+		ExecErrorMsgPrint("Failed to allocate port '%s'",portName);
+		return EDPAT_FAILED;
+	}
+	pp->ethPortSocketFd = -1;
+	pp->ifIndex = -1;
+	for (i=0; i < MAX_RX_THREAD_COUNT; i++)
+	{
+		pp->rxThread[i].socketFd = -1;
+		pp->rxThread[i].pThread = -1;
+	}
+	for (i=0; i < MAX_TX_WORKER_COUNT; i++)
+	{
+		pp->txChannel[i].socketFd = -1;
+	}
+	p->backendData = pp;
+
+	// Stoer socketfd
+	pp->ethPortSocketFd =
+			socket(AF_PACKET,SOCK_RAW,htons(ETH_P_ALL));
+	if (0 > pp->ethPortSocketFd)
+	{
+		ExecErrorMsgPrint("socket(%s) failed. "
+			"Re-execute with root privilage",portName);
+		return EDPAT_FAILED;
+	}
+	
+	VerboseStringPrint("Socket opened for outgoing packets of '%s'",
+			portName);
+	/* Get ethernet port index number */
+	portNameLen=strlen(portName);
+
+	// Lowest is the allowed interface name length
+	portNameLenAllowed = sizeof(portOpts.ifr_name);
+	if (portNameLenAllowed > MAX_ETH_PORT_NAME_LEN)
+		portNameLenAllowed = MAX_ETH_PORT_NAME_LEN;
+
+	if (	portNameLen > (size_t) portNameLenAllowed )
+	{
+		ScriptErrorMsgPrint("Ethernet Port name '%s' too long. "
+					"Max allowed is %d",
+					portName,portNameLenAllowed);
+		return EDPAT_FAILED;
+	}
+	strncpy(portOpts.ifr_name,portName,sizeof(portOpts.ifr_name));
+	portOpts.ifr_name[sizeof(portOpts.ifr_name)-1] = 0;
+
+	/* Get the port details using the ioctl interface */
+        if (0 > ioctl(pp->ethPortSocketFd,
+			SIOCGIFHWADDR,&portOpts))
+	{
+		ExecErrorMsgPrint("ioctl(SIOCGIFHWADDR) failed "
+				"for Eth Port '%s'",
+				portName);
+		return EDPAT_FAILED;
+	}
+
+	// It is ARP protocol hardware
+	if (portOpts.ifr_hwaddr.sa_family!=ARPHRD_ETHER)
+	{
+		ExecErrorMsgPrint("Interface in not  Ethernet. "
+				"%d is reported as interface type",
+				portOpts.ifr_hwaddr.sa_family);
+		return EDPAT_FAILED;
+	}
+	
+	// store the MAC we got to the table
+	memcpy(p->macAddr,
+		portOpts.ifr_hwaddr.sa_data,MAC_ADDR_LEN);
+	VerboseStringPrint("MAC address of '%s' is "
+		"%02X:%02X:%02X:%02X:%02X:%02X",
+		p->portName,
+		p->macAddr[0],
+		p->macAddr[1],
+		p->macAddr[2],
+		p->macAddr[3],
+		p->macAddr[4],
+		p->macAddr[5]);
+/*
+		(unsigned int) p->macAddr[0],
+		(unsigned int) p->macAddr[1],
+		(unsigned int) p->macAddr[2],
+		(unsigned int) p->macAddr[3],
+		(unsigned int) p->macAddr[4],
+		(unsigned int) p->macAddr[5]);
+*/
+	// Get the interface index using ioctl
+        if (0 > ioctl(pp->ethPortSocketFd,
+			SIOCGIFINDEX,&portOpts))
+	{
+		ExecErrorMsgPrint("ioctl(SIOCGIFINDEX) failed "
+				"for Eth Port '%s'",
+				portName);
+		return EDPAT_FAILED;
+	}
+	pp->ifIndex = portOpts.ifr_ifindex;
+
+	VerboseStringPrint("Interface Index of '%s' is %d", portName,
+		pp->ifIndex);
+	/* Set interface to promiscuous mode */
+	strncpy(portOpts.ifr_name,portName,sizeof(portOpts.ifr_name));
+	portOpts.ifr_name[sizeof(portOpts.ifr_name)-1] = 0;
+	if (0 > ioctl(pp->ethPortSocketFd,
+			SIOCGIFFLAGS, &portOpts))
+	{
+		ExecErrorMsgPrint("ioctl(SIOCGIFFLAGS) failed "
+			"for Eth Port '%s'", portName);
+		return EDPAT_FAILED;
+	}
+
+	if (EDPAT_TRUE ==PromiscuousModeEnabled)
+	{
+		portOpts.ifr_flags |= IFF_PROMISC;
+		VerboseStringPrint("Enabled promiscuous mode for '%s'",
+			portName);
+	}
+	else
+	{
+		portOpts.ifr_flags &= ~IFF_PROMISC;
+		VerboseStringPrint("Disabled promiscuous mode for '%s'",
+			portName);
+	}
+	if (0 > ioctl(pp->ethPortSocketFd,
+	SIOCSIFFLAGS, &portOpts))
+	{
+		ExecErrorMsgPrint("ioctl(SIOCSIFFLAGS) failed for "
+			"Eth Port '%s'",portName);
+		return EDPAT_FAILED;
+	}
+
+	/* Allow the socket to be reused,
+	   incase connection is closed prematurely */
+	if (0 > setsockopt(pp->ethPortSocketFd,
+			SOL_SOCKET, SO_REUSEADDR,
+			&socketOpt, sizeof socketOpt))
+	{
+		ExecErrorMsgPrint("setsockopt(SO_REUSEADDR) failed for "
+			"Eth Port '%s'",portName);
+		return EDPAT_FAILED;
+	}
+
+	VerboseStringPrint("Socket Re-use option set for '%s'",portName);
+        /* Bind to device */
+        if (0 > setsockopt(pp->ethPortSocketFd,
+		SOL_SOCKET,
+                SO_BINDTODEVICE, portName, IFNAMSIZ-1))
+        {
+		ScriptErrorMsgPrint(
+			"Ethernet Port name '%s' does not exists",
+			portName);
+		return EDPAT_FAILED;
+        }
+
+	VerboseStringPrint("Socket binding successful for '%s'",portName);
+
+	if (EDPAT_TRUE == HwTimestampEnabled)
+	{
+		hwTimestampSetup(p);
+	}
+
+	/* Open the sockets for sending, with their rings if asked for.
+	   One for each transmit worker, the first is the interpreter's */
+	for (i=0; i < TxWorkerCount; i++)
+	{
+		if (EDPAT_SUCCESS != txSocketOpen(p, &pp->txChannel[i]))
+		{
+			return EDPAT_FAILED;
+		}
+	}
+
+	/* Create the queues through which the receiver threads hand over
+	   the incoming packets to ethportread/receive */
+	if (EDPAT_SUCCESS != EthPortRxQueuesCreate(p, RxThreadCount))
+	{
+		return EDPAT_FAILED;
+	}
+
+	// Start the receiving threads of the port
+	pp->rxThreadCount = RxThreadCount;
+	for (i=0; i < RxThreadCount; i++)
+	{
+		if (EDPAT_SUCCESS != rxThreadOpen(p,i))
+		{
+			return EDPAT_FAILED;
+		}
+	}
+	return EDPAT_SUCCESS;
+}
+
+/*************************
+ *
+ *	packetPortWorkerSend
+ *
+ *	Send a batch of packets to the port on the sending socket of a
+ *	transmit worker. With a transmit ring the packets are queued in
+ *	the ring and the kernel is kicked once for the batch, else they
+ *	are sent with a sendmmsg() per TX_MMSG_BATCH packets. The times
+ *	the packets left are then read from the kernel. Workers with
+ *	different sockets can send at the same time.
+ *
+ *	Arguments:	p	 - the port for packets to be send to
+ *			worker	 - the transmit worker, 0 for the
+ *				   interpreter
+ *			data	 - array of pointers to the packets
+ *			dataLen	 - array of lengths of the packets
+ *			count	 - number of packets in the batch
+ *			queuedCount - number of packets handed over to
+ *				   the kernel is written back here
+ *			sentCount - number of packets that actually left
+ *				   the port is written back here
+ *			txTime	 - the time each packet left the port is
+ *				   written back here
+ *
+ *	return: 	EDPAT_SUCCESS if all the packets are sent
+ *
+ *************************/
+static EDPAT_RETVAL packetPortWorkerSend(ETH_PORT_INFO *p, const int worker,
+			unsigned char * const *data, const int *dataLen,
+			const int count, int *queuedCount, int *sentCount,
+			struct timespec *txTime)
+{
+	PACKET_PORT *pp = p->backendData;
+	TX_CHANNEL *c = &pp->txChannel[worker];
+	struct sockaddr_ll addr={0};
+	struct mmsghdr msg[TX_MMSG_BATCH];
+	struct iovec iov[TX_MMSG_BATCH];
+	unsigned int firstId = c->txTimestampId;
+	EDPAT_RETVAL retVal = EDPAT_SUCCESS;
+	int batch;
+	int sent;
+	int n;
+
+	if (NULL != c->txRing)
+	{
+		txRingSend(p,c,data,dataLen,count,queuedCount,sentCount);
+		if ((*sentCount) != count)
+		{
+			retVal = EDPAT_FAILED;
+		}
+		goto timestamps;
+	}
+
+	/* The packets carry their Ethernet header, sll_addr is not used
+	   by a SOCK_RAW socket */
+	addr.sll_family=AF_PACKET;
+	addr.sll_ifindex=pp->ifIndex;
+	addr.sll_halen=ETHER_ADDR_LEN;
+	addr.sll_protocol=htons(ETH_P_ALL);
+	memcpy(addr.sll_addr,data[0],ETHER_ADDR_LEN);
+
+	while ((*sentCount) < count)
+	{
+		batch = count - (*sentCount);
+		if (TX_MMSG_BATCH < batch)
+		{
+			batch = TX_MMSG_BATCH;
+		}
+		memset(msg,0,batch * sizeof(msg[0]));
+		for (n=0; n < batch; n++)
+		{
+			iov[n].iov_base = data[(*sentCount) + n];
+			iov[n].iov_len = dataLen[(*sentCount) + n];
+			msg[n].msg_hdr.msg_name = &addr;
+			msg[n].msg_hdr.msg_namelen = sizeof(addr);
+			msg[n].msg_hdr.msg_iov = &iov[n];
+			msg[n].msg_hdr.msg_iovlen = 1;
+		}
+		(*queuedCount) += batch;
+		sent = sendmmsg(c->socketFd, msg, batch, 0);
+		if (0 < sent)
+		{
+			(*sentCount) += sent;
+		}
+		// it stops at the first packet that failed
+		if (sent != batch)
+		{
+			// the packet that failed was handed over
+			(*queuedCount) -= batch - ((0 < sent) ? sent : 0) - 1;
+			ExecErrorMsgPrint("sendmmsg(%s) failed for packet %d "
+				"of %d",p->portName,(*sentCount)+1,count);
+			retVal = EDPAT_FAILED;
+			break;
+		}
+	}
+
+timestamps:
+	// The kernel numbers every packet it took from the socket
+	c->txTimestampId += (*sentCount);
+	if (EDPAT_TRUE == c->txTimestamps)
+	{
+		txTimestampsCollect(c, firstId, *sentCount, txTime);
+	}
+	return retVal;
+}
+
+
+/*************************
+ *
+ *	packetPortSend
+ *
+ *	Send a batch of packets to the port on the sending socket of the
+ *	interpreter, see packetPortWorkerSend().
+ *
+ *	Arguments:	p	 - the port for packets to be send to
+ *			data	 - array of pointers to the packets
+ *			dataLen	 - array of lengths of the packets
+ *			count	 - number of packets in the batch
+ *			queuedCount - number of packets handed over to
+ *				   the kernel is written back here
+ *			sentCount - number of packets that actually left
+ *				   the port is written back here
+ *			txTime	 - the time each packet left the port is
+ *				   written back here
+ *
+ *	return: 	EDPAT_SUCCESS if all the packets are sent
+ *
+ *************************/
+static EDPAT_RETVAL packetPortSend(ETH_PORT_INFO *p,
+			unsigned char * const *data, const int *dataLen,
+			const int count, int *queuedCount, int *sentCount,
+			struct timespec *txTime)
+{
+	return packetPortWorkerSend(p, 0, data, dataLen, count,
+			queuedCount, sentCount, txTime);
+}
+
+
+/*************************
+ *
+ *	packetPortSendAt
+ *
+ *	Hand a packet to the kernel to be sent at a launch time. The
+ *	launch time is kept by the qdisc of the port, which needs to be
+ *	etf (or fq) for it to be used. SO_TXTIME is set up on the
+ *	sending socket the first time. A transmit ring cannot carry
+ *	launch times, a port with one does not support it.
+ *
+ *	The kernel does not hold the packet back for the timestamp of
+ *	the packet, it is not read. Its report is dropped by the next
+ *	txTimestampsCollect().
+ *
+ *	Arguments:	p	   - the port for packet to be send to
+ *			data	   - the packet
+ *			dataLen	   - length of the packet
+ *			launchTime - CLOCK_TAI time the packet is to
+ *				     leave the port
+ *
+ *	return: 	EDPAT_SUCCESS, EDPAT_FAILED or EDPAT_NOTFOUND
+ *			if launch times are not supported
+ *
+ *************************/
+static EDPAT_RETVAL packetPortSendAt(ETH_PORT_INFO *p,
+			unsigned char *data, const int dataLen,
+			const struct timespec *launchTime)
+{
+	PACKET_PORT *pp = p->backendData;
+	TX_CHANNEL *c = &pp->txChannel[0];
+	struct sockaddr_ll addr={0};
+	struct sock_txtime txTimeCfg;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(sizeof(unsigned long long))];
+	unsigned long long launchNs;
+
+	if (EDPAT_TRUE != pp->txTimeTried)
+	{
+		pp->txTimeTried = EDPAT_TRUE;
+		txTimeCfg.clockid = CLOCK_TAI;
+		txTimeCfg.flags = 0;
+		if ((NULL == c->txRing) &&
+		    (0 == setsockopt(c->socketFd, SOL_SOCKET, SO_TXTIME,
+				&txTimeCfg, sizeof(txTimeCfg))))
+		{
+			pp->txTimeEnabled = EDPAT_TRUE;
+		}
+		VerboseStringPrint("Launch times %ssupported by '%s'",
+			(EDPAT_TRUE == pp->txTimeEnabled) ? "" : "not ",
+			p->portName);
+	}
+	if (EDPAT_TRUE != pp->txTimeEnabled)
+	{
+		return EDPAT_NOTFOUND;
+	}
+
+	addr.sll_family=AF_PACKET;
+	addr.sll_ifindex=pp->ifIndex;
+	addr.sll_halen=ETHER_ADDR_LEN;
+	addr.sll_protocol=htons(ETH_P_ALL);
+	memcpy(addr.sll_addr,data,ETHER_ADDR_LEN);
+
+	iov.iov_base = data;
+	iov.iov_len = dataLen;
+	memset(&msg,0,sizeof(msg));
+	msg.msg_name = &addr;
+	msg.msg_namelen = sizeof(addr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_TXTIME;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(launchNs));
+	launchNs = (unsigned long long) launchTime->tv_sec * 1000000000ULL +
+			launchTime->tv_nsec;
+	memcpy(CMSG_DATA(cmsg), &launchNs, sizeof(launchNs));
+
+	if (0 > sendmsg(c->socketFd, &msg, 0))
+	{
+		ExecErrorMsgPrint("sendmsg(%s) failed",p->portName);
+		return EDPAT_FAILED;
+	}
+	c->txTimestampId++;
+	return EDPAT_SUCCESS;
+}
+
+
+// Ethernet interfaces, used for ports without a known prefix
+const ETH_PORT_BACKEND EthPortPacketBackend = {
+	.prefix		= NULL,
+	.open		= packetPortOpen,
+	.close		= packetPortClose,
+	.send		= packetPortSend,
+	.workerSend	= packetPortWorkerSend,
+	.sendAt		= packetPortSendAt,
+	.receive	= NULL,
+	.stats		= packetPortStats,
+	.filterUpdate	= packetPortFilterUpdate,
+};
+
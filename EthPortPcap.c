@@ -0,0 +1,675 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "edpat.h"
+#include "print.h"
+#include "filter.h"
+#include "seqtag.h"
+#include "EthPortBackend.h"
+
+#define PCAP_PORT_PREFIX	"pcap:"
+#define PCAP_IN_SUFFIX		".in.pcap"	// frames to be received
+#define PCAP_OUT_SUFFIX		".out.pcapng"	// frames sent are appended
+
+#define PCAP_MAGIC_US		0xa1b2c3d4	// pcap, microseconds
+#define PCAP_MAGIC_NS		0xa1b23c4d	// pcap, nanoseconds
+#define PCAP_FILE_HDR_LEN	24
+#define PCAP_REC_HDR_LEN	16
+
+#define PCAPNG_SHB		0x0a0d0d0a	// Section Header Block
+#define PCAPNG_IDB		0x00000001	// Interface Description Block
+#define PCAPNG_SPB		0x00000003	// Simple Packet Block
+#define PCAPNG_EPB		0x00000006	// Enhanced Packet Block
+#define PCAPNG_BYTE_ORDER	0x1a2b3c4d
+#define PCAPNG_MAX_IF		16	// interfaces tracked per section
+#define PCAPNG_IF_TSRESOL	9	// option of IDB
+#define PCAPNG_TSRESOL_DEFAULT	6	// microseconds
+
+#define LINKTYPE_ETHERNET	1
+
+#define PCAP_PAD4(len)		(((len) + 3) & ~3)
+
+/* An offline port. Packets sent are appended to <name>.out.pcapng and
+   packets received are the frames of <name>.in.pcap one after the
+   other. The input is mapped into memory and walked in place. It can
+   be a pcap or a pcapng file */
+typedef struct {
+	FILE		*outFp;
+	unsigned char	*in;		// mapped input, or NULL
+	size_t		inLen;
+	size_t		inOff;		// next record or block
+	EDPAT_BOOL	inPcapng;
+	EDPAT_BOOL	inSwapped;	// input is of the other byte order
+	EDPAT_BOOL	inNsec;		// pcap timestamps in nanoseconds
+	int		ifLinkType[PCAPNG_MAX_IF];	// of current section
+	unsigned char	ifTsResol[PCAPNG_MAX_IF];	// if_tsresol option
+	int		ifCount;
+	unsigned long	received;
+	unsigned long	dropped;	// frames not Ethernet or truncated
+} PCAP_PORT;
+
+
+/***********************
+ *   pcapU32()
+ *
+ *   Read a 32 bit field of the input in its byte order.
+ *
+ *   Arguments :
+ *	pp	- INPUT. Offline port.
+ *	ptr	- INPUT. Point to the field, need not be aligned.
+ *
+ *   Return:	- value of the field
+ *
+ ********/
+static uint32_t pcapU32(const PCAP_PORT *pp, const unsigned char *ptr)
+{
+	uint32_t val;
+
+	memcpy(&val, ptr, sizeof(val));
+	return (EDPAT_TRUE == pp->inSwapped) ? __builtin_bswap32(val) : val;
+}
+
+
+/***********************
+ *   pcapU16()
+ *
+ *   Read a 16 bit field of the input in its byte order.
+ *
+ *   Arguments :
+ *	pp	- INPUT. Offline port.
+ *	ptr	- INPUT. Point to the field, need not be aligned.
+ *
+ *   Return:	- value of the field
+ *
+ ********/
+static uint16_t pcapU16(const PCAP_PORT *pp, const unsigned char *ptr)
+{
+	uint16_t val;
+
+	memcpy(&val, ptr, sizeof(val));
+	return (EDPAT_TRUE == pp->inSwapped) ? __builtin_bswap16(val) : val;
+}
+
+
+/***********************
+ *   pcapInputOpen()
+ *
+ *   Map the input capture of the port and check its file header. A
+ *   port without an input capture only sends.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *	path	- INPUT. Path of the input capture.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL pcapInputOpen(ETH_PORT_INFO *p, const char *path)
+{
+	PCAP_PORT *pp = p->backendData;
+	struct stat st;
+	uint32_t magic;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (0 > fd)
+	{
+		VerboseStringPrint("No input capture '%s' for '%s'",
+			path, p->portName);
+		return EDPAT_SUCCESS;
+	}
+	if ((0 > fstat(fd, &st)) || (PCAP_FILE_HDR_LEN > st.st_size))
+	{
+		ScriptErrorMsgPrint("Input capture '%s' is too short",path);
+		close(fd);
+		return EDPAT_FAILED;
+	}
+	pp->in = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == pp->in)
+	{
+		pp->in = NULL;
+		ExecErrorMsgPrint("mmap() failed for '%s'",path);
+		return EDPAT_FAILED;
+	}
+	pp->inLen = st.st_size;
+	madvise(pp->in, pp->inLen, MADV_SEQUENTIAL);
+
+	memcpy(&magic, pp->in, sizeof(magic));
+	if (PCAPNG_SHB == magic)
+	{
+		// Byte order is set by each Section Header Block
+		pp->inPcapng = EDPAT_TRUE;
+		pp->inOff = 0;
+		return EDPAT_SUCCESS;
+	}
+	if ((PCAP_MAGIC_US == __builtin_bswap32(magic)) ||
+	    (PCAP_MAGIC_NS == __builtin_bswap32(magic)))
+	{
+		pp->inSwapped = EDPAT_TRUE;
+		magic = __builtin_bswap32(magic);
+	}
+	else if ((PCAP_MAGIC_US != magic) && (PCAP_MAGIC_NS != magic))
+	{
+		ScriptErrorMsgPrint("'%s' is not a pcap or pcapng file",path);
+		return EDPAT_FAILED;
+	}
+	if (LINKTYPE_ETHERNET != pcapU32(pp, pp->in + 20))
+	{
+		ScriptErrorMsgPrint("'%s' is not an Ethernet capture",path);
+		return EDPAT_FAILED;
+	}
+	pp->inNsec = (PCAP_MAGIC_NS == magic) ? EDPAT_TRUE : EDPAT_FALSE;
+	pp->inOff = PCAP_FILE_HDR_LEN;
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   pcapOutputOpen()
+ *
+ *   Open the output capture of the port for appending and start a new
+ *   section in it with one Ethernet interface, whose timestamps are in
+ *   nanoseconds.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *	path	- INPUT. Path of the output capture.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL pcapOutputOpen(ETH_PORT_INFO *p, const char *path)
+{
+	PCAP_PORT *pp = p->backendData;
+	uint32_t shb[7] = {
+		PCAPNG_SHB, sizeof(shb), PCAPNG_BYTE_ORDER,
+		1,			// version 1.0
+		0xffffffff, 0xffffffff,	// section length not known
+		sizeof(shb) };
+	uint32_t idb[8] = {
+		PCAPNG_IDB, sizeof(idb),
+		LINKTYPE_ETHERNET,	// and 16 bits reserved
+		MAX_PKT_SIZE,		// snap length
+		0x00010009, 9,		// if_tsresol, 10^-9
+		0,			// opt_endofopt
+		sizeof(idb) };
+
+	pp->outFp = fopen(path, "ae");
+	if (NULL == pp->outFp)
+	{
+		ExecErrorMsgPrint("Failed to open output capture '%s'",path);
+		return EDPAT_FAILED;
+	}
+	if ((1 != fwrite(shb, sizeof(shb), 1, pp->outFp)) ||
+	    (1 != fwrite(idb, sizeof(idb), 1, pp->outFp)))
+	{
+		ExecErrorMsgPrint("Failed to write '%s'",path);
+		return EDPAT_FAILED;
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   pcapPortOpen()
+ *
+ *   Open an offline port. For 'pcap:<name>' the frames to be received
+ *   are read from <name>.in.pcap and the frames sent are appended to
+ *   <name>.out.pcapng.
+ *
+ *   Arguments :
+ *	p	- INPUT/OUTPUT. Point to the port into table.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL pcapPortOpen(ETH_PORT_INFO *p)
+{
+	const char *name = p->portName + strlen(PCAP_PORT_PREFIX);
+	char path[MAX_ETH_PORT_NAME_LEN + sizeof(PCAP_OUT_SUFFIX) + 1];
+	PCAP_PORT *pp;
+
+	pp = calloc(1,sizeof(*pp));
+	if (NULL == pp)
+	{
+		ExecErrorMsgPrint("Failed to allocate port '%s'",p->portName);
+		return EDPAT_FAILED;
+	}
+	p->backendData = pp;
+	if (0 == strlen(name))
+	{
+		ScriptErrorMsgPrint("Capture name missing in '%s'",p->portName);
+		return EDPAT_FAILED;
+	}
+
+	snprintf(path, sizeof(path), "%s%s", name, PCAP_IN_SUFFIX);
+	if (EDPAT_SUCCESS != pcapInputOpen(p, path))
+	{
+		return EDPAT_FAILED;
+	}
+	snprintf(path, sizeof(path), "%s%s", name, PCAP_OUT_SUFFIX);
+	return pcapOutputOpen(p, path);
+}
+
+
+/***********************
+ *   pcapPortClose()
+ *
+ *   Close the offline port, flushing its output capture.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void pcapPortClose(ETH_PORT_INFO *p)
+{
+	PCAP_PORT *pp = p->backendData;
+
+	if (NULL == pp)
+	{
+		return;
+	}
+	if (NULL != pp->outFp)
+	{
+		fclose(pp->outFp);
+	}
+	if (NULL != pp->in)
+	{
+		munmap(pp->in, pp->inLen);
+	}
+	free(pp);
+	p->backendData = NULL;
+	VerboseStringPrint("Offline Port '%s' closed",p->portName);
+	return;
+}
+
+
+/***********************
+ *   pcapPortSend()
+ *
+ *   Append a batch of packets to the output capture of the port, each
+ *   as an Enhanced Packet Block stamped with the current time.
+ *
+ *   Arguments :
+ *	p		- INPUT. Point to the port into table.
+ *	data		- INPUT. array of pointers to the packets.
+ *	dataLen		- INPUT. array of lengths of the packets.
+ *	count		- INPUT. number of packets.
+ *	queuedCount	- OUTPUT. number of packets written.
+ *	sentCount	- OUTPUT. number of packets written.
+ *	txTime		- OUTPUT. timestamp of each packet in the capture.
+ *
+ *   Return:	- EDPAT_SUCCESS if all the packets are written
+ *
+ ********/
+static EDPAT_RETVAL pcapPortSend(ETH_PORT_INFO *p,
+			unsigned char * const *data, const int *dataLen,
+			const int count, int *queuedCount, int *sentCount,
+			struct timespec *txTime)
+{
+	static const unsigned char pad[4];
+	PCAP_PORT *pp = p->backendData;
+	uint64_t ts;
+	uint32_t epb[7];
+	uint32_t blockLen;
+	int n;
+
+	for (n=0; n < count; n++)
+	{
+		clock_gettime(CLOCK_REALTIME, &txTime[n]);
+		ts = (uint64_t) txTime[n].tv_sec * 1000000000ull +
+			txTime[n].tv_nsec;
+		blockLen = sizeof(epb) + PCAP_PAD4(dataLen[n]) + 4;
+		epb[0] = PCAPNG_EPB;
+		epb[1] = blockLen;
+		epb[2] = 0;			// interface
+		epb[3] = ts >> 32;
+		epb[4] = ts & 0xffffffff;
+		epb[5] = dataLen[n];		// captured
+		epb[6] = dataLen[n];		// on the wire
+		(*queuedCount)++;
+		if ((1 != fwrite(epb, sizeof(epb), 1, pp->outFp)) ||
+		    (1 != fwrite(data[n], dataLen[n], 1, pp->outFp)) ||
+		    ((0 != (dataLen[n] & 3)) &&
+		     (1 != fwrite(pad, 4 - (dataLen[n] & 3), 1, pp->outFp))) ||
+		    (1 != fwrite(&blockLen, sizeof(blockLen), 1, pp->outFp)))
+		{
+			ExecErrorMsgPrint("Failed to write capture of '%s'",
+				p->portName);
+			return EDPAT_FAILED;
+		}
+		(*sentCount)++;
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   pcapngTimeConvert()
+ *
+ *   Convert a timestamp of an Enhanced Packet Block, counted in the
+ *   units given by the if_tsresol option of its interface.
+ *
+ *   Arguments :
+ *	ts	- INPUT. timestamp of the block.
+ *	resol	- INPUT. if_tsresol, 10^-resol or with the MSB set
+ *		  2^-(resol & 0x7f) seconds.
+ *	out	- OUTPUT. the time.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void pcapngTimeConvert(const uint64_t ts, const unsigned char resol,
+		struct timespec *out)
+{
+	uint64_t perSec = 1;
+	uint64_t frac;
+	int exp = resol & 0x7f;
+	int i;
+
+	if (resol & 0x80)
+	{
+		if (63 < exp)
+		{
+			exp = 63;
+		}
+		out->tv_sec = ts >> exp;
+		frac = ts & ((1ull << exp) - 1);
+		out->tv_nsec = ((unsigned __int128) frac * 1000000000u) >> exp;
+		return;
+	}
+	if (19 < exp)
+	{
+		exp = 19;
+	}
+	for (i=0; i < exp; i++)
+	{
+		perSec *= 10;
+	}
+	out->tv_sec = ts / perSec;
+	frac = ts % perSec;
+	out->tv_nsec = (9 >= exp) ? (frac * (1000000000u / perSec)) :
+				(frac / (perSec / 1000000000u));
+	return;
+}
+
+
+/***********************
+ *   pcapngIfOptionsRead()
+ *
+ *   Read the options of an Interface Description Block that matter,
+ *   the timestamp resolution.
+ *
+ *   Arguments :
+ *	pp	- INPUT/OUTPUT. Offline port.
+ *	blk	- INPUT. the block.
+ *	blkLen	- INPUT. length of the block.
+ *	ifId	- INPUT. index of the interface in the section.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void pcapngIfOptionsRead(PCAP_PORT *pp, const unsigned char *blk,
+		const uint32_t blkLen, const int ifId)
+{
+	uint32_t off = 16;	// options follow the snap length
+	uint16_t code;
+	uint16_t len;
+
+	pp->ifTsResol[ifId] = PCAPNG_TSRESOL_DEFAULT;
+	while (off + 4 <= blkLen - 4)
+	{
+		code = pcapU16(pp, blk + off);
+		len = pcapU16(pp, blk + off + 2);
+		if ((0 == code) || (off + 4 + len > blkLen - 4))
+		{
+			break;
+		}
+		if ((PCAPNG_IF_TSRESOL == code) && (1 <= len))
+		{
+			pp->ifTsResol[ifId] = blk[off + 4];
+		}
+		off += 4 + PCAP_PAD4(len);
+	}
+	return;
+}
+
+
+/***********************
+ *   pcapNextFrame()
+ *
+ *   Walk the input to its next Ethernet frame. Records of other link
+ *   types and the blocks that are not packets are skipped.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *	frame	- OUTPUT. Point to the frame in the mapped input.
+ *	len	- OUTPUT. Captured length of the frame.
+ *	ts	- OUTPUT. Time the frame was captured, zero if the
+ *		  block does not have it.
+ *
+ *   Return:	- EDPAT_SUCCESS, or EDPAT_NOTFOUND at the end of input
+ *
+ ********/
+static EDPAT_RETVAL pcapNextFrame(ETH_PORT_INFO *p,
+		const unsigned char **frame, uint32_t *len,
+		struct timespec *ts)
+{
+	PCAP_PORT *pp = p->backendData;
+	const unsigned char *blk;
+	uint32_t type;
+	uint32_t blkLen;
+	uint32_t ifId;
+	uint32_t magic;
+
+	if (EDPAT_TRUE != pp->inPcapng)
+	{
+		if (PCAP_REC_HDR_LEN > pp->inLen - pp->inOff)
+		{
+			return EDPAT_NOTFOUND;
+		}
+		blk = pp->in + pp->inOff;
+		*len = pcapU32(pp, blk + 8);
+		if (*len > pp->inLen - pp->inOff - PCAP_REC_HDR_LEN)
+		{
+			ScriptErrorMsgPrint("Input capture of '%s' is "
+				"truncated", p->portName);
+			pp->inOff = pp->inLen;
+			return EDPAT_NOTFOUND;
+		}
+		*frame = blk + PCAP_REC_HDR_LEN;
+		ts->tv_sec = pcapU32(pp, blk);
+		ts->tv_nsec = pcapU32(pp, blk + 4);
+		if (EDPAT_TRUE != pp->inNsec)
+		{
+			ts->tv_nsec *= 1000;
+		}
+		pp->inOff += PCAP_REC_HDR_LEN + *len;
+		return EDPAT_SUCCESS;
+	}
+
+	while (12 <= pp->inLen - pp->inOff)
+	{
+		blk = pp->in + pp->inOff;
+		memcpy(&type, blk, sizeof(type));
+		if (PCAPNG_SHB == type)
+		{
+			// A new section, may be of the other byte order
+			memcpy(&magic, blk + 8, sizeof(magic));
+			pp->inSwapped = (PCAPNG_BYTE_ORDER == magic) ?
+					EDPAT_FALSE : EDPAT_TRUE;
+			pp->ifCount = 0;
+		}
+		type = pcapU32(pp, blk);
+		blkLen = pcapU32(pp, blk + 4);
+		if ((12 > blkLen) || (0 != (blkLen & 3)) ||
+		    (blkLen > pp->inLen - pp->inOff))
+		{
+			ScriptErrorMsgPrint("Input capture of '%s' is "
+				"corrupted", p->portName);
+			pp->inOff = pp->inLen;
+			return EDPAT_NOTFOUND;
+		}
+		pp->inOff += blkLen;
+
+		if ((PCAPNG_IDB == type) && (16 <= blkLen))
+		{
+			if (PCAPNG_MAX_IF > pp->ifCount)
+			{
+				pp->ifLinkType[pp->ifCount] =
+					pcapU16(pp, blk + 8);
+				pcapngIfOptionsRead(pp, blk, blkLen,
+					pp->ifCount);
+			}
+			pp->ifCount++;
+			continue;
+		}
+		if ((PCAPNG_EPB == type) && (32 <= blkLen))
+		{
+			ifId = pcapU32(pp, blk + 8);
+			*len = pcapU32(pp, blk + 20);
+			*frame = blk + 28;
+			if ((*len > blkLen - 32) ||
+			    (ifId >= (uint32_t) pp->ifCount) ||
+			    (PCAPNG_MAX_IF <= ifId) ||
+			    (LINKTYPE_ETHERNET != pp->ifLinkType[ifId]))
+			{
+				pp->dropped++;
+				continue;
+			}
+			pcapngTimeConvert(
+				((uint64_t) pcapU32(pp, blk + 12) << 32) |
+					pcapU32(pp, blk + 16),
+				pp->ifTsResol[ifId], ts);
+			return EDPAT_SUCCESS;
+		}
+		if ((PCAPNG_SPB == type) && (16 <= blkLen))
+		{
+			*len = pcapU32(pp, blk + 8);
+			*frame = blk + 12;
+			if (*len > blkLen - 16)
+			{
+				*len = blkLen - 16;
+			}
+			if ((0 == pp->ifCount) ||
+			    (LINKTYPE_ETHERNET != pp->ifLinkType[0]))
+			{
+				pp->dropped++;
+				continue;
+			}
+			// Simple Packet Blocks carry no time
+			ts->tv_sec = 0;
+			ts->tv_nsec = 0;
+			return EDPAT_SUCCESS;
+		}
+	}
+	return EDPAT_NOTFOUND;
+}
+
+
+/***********************
+ *   pcapPortReceive()
+ *
+ *   Receive the next frame of the input capture. The frames the packet
+ *   filter rules apply to are skipped as the filter of an Ethernet port
+ *   would drop them. There is nothing to wait for, at the end of the
+ *   input it returns at once.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *	data	- OUTPUT. buffer for the frame.
+ *	dataLen	- INPUT/OUTPUT. size of 'data' / length of the frame.
+ *	waitMs	- INPUT. Not used.
+ *	rxTime	- OUTPUT. time the frame was captured.
+ *
+ *   Return:	- EDPAT_SUCCESS, or EDPAT_NOTFOUND at the end of input
+ *
+ ********/
+static EDPAT_RETVAL pcapPortReceive(ETH_PORT_INFO *p,
+		unsigned char *data, int *dataLen, const int waitMs,
+		struct timespec *rxTime)
+{
+	PCAP_PORT *pp = p->backendData;
+	const unsigned char *frame;
+	uint32_t len;
+
+	// The next frame is there at once or never
+	(void) waitMs;
+	if (NULL == pp->in)
+	{
+		return EDPAT_NOTFOUND;
+	}
+	while (EDPAT_SUCCESS == pcapNextFrame(p, &frame, &len, rxTime))
+	{
+		pp->received++;
+		if ((EDPAT_TRUE == FilterPacketCheck(PacketFilterRules, NULL,
+				frame, len)) ||
+		    (EDPAT_TRUE == SeqTagReceive(frame, len, rxTime)))
+		{
+			continue;
+		}
+		if (len > (uint32_t) *dataLen)
+		{
+			len = *dataLen;
+		}
+		memcpy(data, frame, len);
+		*dataLen = len;
+		return EDPAT_SUCCESS;
+	}
+	return EDPAT_NOTFOUND;
+}
+
+
+/***********************
+ *   pcapPortStats()
+ *
+ *   Get the receive statistics of the offline port.
+ *
+ *   Arguments :
+ *	p		- INPUT. Point to the port into table.
+ *	received	- OUTPUT. frames read from the input capture.
+ *	dropped		- OUTPUT. frames that are not Ethernet.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void pcapPortStats(ETH_PORT_INFO *p,
+		unsigned long *received, unsigned long *dropped)
+{
+	PCAP_PORT *pp = p->backendData;
+
+	*received += pp->received;
+	*dropped += pp->dropped;
+	return;
+}
+
+
+// Offline ports, "pcap:<name>"
+const ETH_PORT_BACKEND EthPortPcapBackend = {
+	.prefix		= PCAP_PORT_PREFIX,
+	.open		= pcapPortOpen,
+	.close		= pcapPortClose,
+	.send		= pcapPortSend,
+	.workerSend	= NULL,
+	.sendAt		= NULL,
+	.receive	= pcapPortReceive,
+	.stats		= pcapPortStats,
+	.filterUpdate	= NULL,
+};
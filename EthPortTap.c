@@ -0,0 +1,415 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include "edpat.h"
+#include "print.h"
+#include "filter.h"
+#include "seqtag.h"
+#include "EthPortBackend.h"
+
+#define TAP_PORT_PREFIX		"tap:"
+#define TAP_CLONE_DEV		"/dev/net/tun"
+#define TAP_QUEUE_COUNT		2	// one to receive, one to send
+
+/* A TAP device read and written directly. The device is multi-queue so
+   that sending does not share a queue with receiving. The kernel may
+   still steer a flow to the sending queue, so the receiver thread
+   reads both */
+typedef struct {
+	int		fd[TAP_QUEUE_COUNT];	// [0] receive, [1] send
+	int		queueCount;
+	pthread_t	pThread;
+	EDPAT_BOOL	kernelFilter;	// filtering done by TUNATTACHFILTER
+	unsigned long	received;
+} TAP_PORT;
+
+
+/***********************
+ *   tapPortFilterUpdate()
+ *
+ *   Compile the current filter rules into a BPF program and attach it
+ *   to the TAP device, so that the noise packets of the kernel are
+ *   dropped before they are queued to us. If the kernel does not
+ *   accept it, the receiver thread filters in user space.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void tapPortFilterUpdate(ETH_PORT_INFO *p)
+{
+	TAP_PORT *tp = p->backendData;
+	struct sock_filter prog[MAX_FILTER_PROG_LEN];
+	struct sock_fprog fprog;
+
+	ioctl(tp->fd[0], TUNDETACHFILTER, &fprog);
+	if (FILTER_NONE == PacketFilterRules)
+	{
+		tp->kernelFilter = EDPAT_TRUE;
+		VerboseStringPrint("No packet filter for '%s'",p->portName);
+		return;
+	}
+
+	fprog.len = FilterProgramBuild(PacketFilterRules, NULL, prog);
+	fprog.filter = prog;
+	if (0 > ioctl(tp->fd[0], TUNATTACHFILTER, &fprog))
+	{
+		tp->kernelFilter = EDPAT_FALSE;
+		VerboseStringPrint("ioctl(TUNATTACHFILTER) failed for "
+			"'%s'. Filtering in user space",p->portName);
+		return;
+	}
+	tp->kernelFilter = EDPAT_TRUE;
+	VerboseStringPrint("Packet filter of %d instructions attached to "
+		"'%s'. Filtered: %s",
+		fprog.len, p->portName, FilterRulesString(PacketFilterRules));
+	return;
+}
+
+
+/***********************
+ *   tapReceiverPthreadFunc()
+ *
+ *   This function will run as a child thread. It will read any packet
+ *   the kernel queued to the TAP device and put it in the receive queue
+ *   of the port.
+ *
+ *   Arguments :
+ *	vargp	-  INPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void *tapReceiverPthreadFunc(void *vargp)
+{
+	ETH_PORT_INFO *p = (ETH_PORT_INFO *) vargp;
+	TAP_PORT *tp = p->backendData;
+	struct pollfd pfd[TAP_QUEUE_COUNT];
+	unsigned char pkt[MAX_PKT_SIZE];
+	struct timespec rxTime;
+	ssize_t pktLen;
+	int lastEthErrno = 0;
+	int i;
+
+	for (i=0; i < tp->queueCount; i++)
+	{
+		pfd[i].fd = tp->fd[i];
+		pfd[i].events = POLLIN;
+	}
+
+	while(1) // do for ever
+	{
+		if ((0 > poll(pfd, tp->queueCount, -1)) &&
+		    (errno != lastEthErrno))
+		{
+			// print the error message only once
+			ExecErrorMsgPrint("poll() failed "
+				"while receiving packet from '%s'",
+				p->portName);
+			lastEthErrno = errno;
+			continue;
+		}
+		for (i=0; i < tp->queueCount; i++)
+		{
+			if (0 == (pfd[i].revents & POLLIN))
+			{
+				continue;
+			}
+			pktLen = read(tp->fd[i], pkt, sizeof(pkt));
+			if (0 >= pktLen)
+			{
+				continue;
+			}
+			clock_gettime(CLOCK_REALTIME, &rxTime);
+			tp->received++;
+
+			if ((EDPAT_TRUE != tp->kernelFilter) &&
+			    (EDPAT_TRUE == FilterPacketCheck(PacketFilterRules,
+					NULL, pkt, pktLen)))
+			{
+				continue;
+			}
+			if (EDPAT_TRUE == SeqTagReceive(pkt, pktLen, &rxTime))
+			{
+				continue;
+			}
+			PktQueueEnqueue(p->rxQueue[0], pkt, pktLen, &rxTime);
+		}
+	}
+	return NULL;
+}
+
+
+/***********************
+ *   tapQueueOpen()
+ *
+ *   Open a queue of the TAP device. The device is created if it does
+ *   not exist yet.
+ *
+ *   Arguments :
+ *	ifName	- INPUT. Name of the TAP device.
+ *	flags	- INPUT. IFF_ flags of the device.
+ *
+ *   Return:	- file descriptor of the queue or -1
+ *
+ ********/
+static int tapQueueOpen(const char *ifName, const short flags)
+{
+	struct ifreq ifr;
+	int fd;
+
+	fd = open(TAP_CLONE_DEV, O_RDWR | O_CLOEXEC);
+	if (0 > fd)
+	{
+		return -1;
+	}
+	memset(&ifr,0,sizeof(ifr));
+	strncpy(ifr.ifr_name,ifName,IFNAMSIZ-1);
+	ifr.ifr_flags = flags;
+	if (0 > ioctl(fd, TUNSETIFF, &ifr))
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+/***********************
+ *   tapPortOpen()
+ *
+ *   Create or attach the TAP device named after the prefix of the port
+ *   and start the receiver thread. A device created by somebody else
+ *   without multi-queue support is used with a single queue.
+ *
+ *   Arguments :
+ *	p	- INPUT/OUTPUT. Point to the port into table.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL tapPortOpen(ETH_PORT_INFO *p)
+{
+	const char *ifName = p->portName + strlen(TAP_PORT_PREFIX);
+	TAP_PORT *tp;
+	struct ifreq ifr;
+	int sockFd;
+	int i;
+
+	tp = calloc(1,sizeof(*tp));
+	if (NULL == tp)
+	{
+		ExecErrorMsgPrint("Failed to allocate port '%s'",p->portName);
+		return EDPAT_FAILED;
+	}
+	for (i=0; i < TAP_QUEUE_COUNT; i++)
+	{
+		tp->fd[i] = -1;
+	}
+	tp->pThread = -1;
+	p->backendData = tp;
+
+	if ((0 == strlen(ifName)) || (IFNAMSIZ <= strlen(ifName)))
+	{
+		ScriptErrorMsgPrint("Invalid TAP device name '%s'",ifName);
+		return EDPAT_FAILED;
+	}
+
+	tp->fd[0] = tapQueueOpen(ifName, IFF_TAP | IFF_NO_PI | IFF_MULTI_QUEUE);
+	if (0 <= tp->fd[0])
+	{
+		tp->fd[1] = tapQueueOpen(ifName,
+				IFF_TAP | IFF_NO_PI | IFF_MULTI_QUEUE);
+	}
+	else
+	{
+		tp->fd[0] = tapQueueOpen(ifName, IFF_TAP | IFF_NO_PI);
+	}
+	if (0 > tp->fd[0])
+	{
+		ExecErrorMsgPrint("Failed to open TAP device '%s'. Re-execute "
+			"with root privilage or create it for this user",
+			ifName);
+		return EDPAT_FAILED;
+	}
+	tp->queueCount = (0 <= tp->fd[1]) ? 2 : 1;
+	VerboseStringPrint("TAP device '%s' attached with %d queues",
+		ifName, tp->queueCount);
+
+	// A device we created is down. Does not matter if it fails
+	sockFd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (0 <= sockFd)
+	{
+		memset(&ifr,0,sizeof(ifr));
+		strncpy(ifr.ifr_name,ifName,IFNAMSIZ-1);
+		if ((0 == ioctl(sockFd, SIOCGIFFLAGS, &ifr)) &&
+		    (0 == (ifr.ifr_flags & IFF_UP)))
+		{
+			ifr.ifr_flags |= IFF_UP;
+			if (0 > ioctl(sockFd, SIOCSIFFLAGS, &ifr))
+			{
+				VerboseStringPrint("Failed to bring up TAP "
+					"device '%s'",ifName);
+			}
+		}
+		close(sockFd);
+	}
+
+	tapPortFilterUpdate(p);
+
+	if (EDPAT_SUCCESS != EthPortRxQueuesCreate(p, 1))
+	{
+		return EDPAT_FAILED;
+	}
+	if (0 != pthread_create(&tp->pThread, NULL, tapReceiverPthreadFunc, p))
+	{
+		ExecErrorMsgPrint("pthread() failed");
+		tp->pThread = (-1);
+		return EDPAT_FAILED;
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   tapPortClose()
+ *
+ *   Stop the receiver thread and detach from the TAP device. A device
+ *   created by us goes away with the last queue.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void tapPortClose(ETH_PORT_INFO *p)
+{
+	TAP_PORT *tp = p->backendData;
+	int i;
+
+	if (NULL == tp)
+	{
+		return;
+	}
+	if ((pthread_t) (-1) != tp->pThread)
+	{
+		pthread_cancel(tp->pThread);
+		pthread_join(tp->pThread,NULL);
+		VerboseStringPrint("Receiver thread stopped for %s",
+			p->portName);
+	}
+	for (i=0; i < TAP_QUEUE_COUNT; i++)
+	{
+		if (0 <= tp->fd[i])
+		{
+			close(tp->fd[i]);
+		}
+	}
+	free(tp);
+	p->backendData = NULL;
+	VerboseStringPrint("TAP Port '%s' closed",p->portName);
+	return;
+}
+
+
+/***********************
+ *   tapPortSend()
+ *
+ *   Write a batch of packets to the send queue of the TAP device.
+ *
+ *   Arguments :
+ *	p		- INPUT. Point to the port into table.
+ *	data		- INPUT. array of pointers to the packets.
+ *	dataLen		- INPUT. array of lengths of the packets.
+ *	count		- INPUT. number of packets.
+ *	queuedCount	- OUTPUT. number of packets written.
+ *	sentCount	- OUTPUT. number of packets written.
+ *	txTime		- OUTPUT. time each packet was written.
+ *
+ *   Return:	- EDPAT_SUCCESS if all the packets are written
+ *
+ ********/
+static EDPAT_RETVAL tapPortSend(ETH_PORT_INFO *p,
+			unsigned char * const *data, const int *dataLen,
+			const int count, int *queuedCount, int *sentCount,
+			struct timespec *txTime)
+{
+	TAP_PORT *tp = p->backendData;
+	int fd = tp->fd[tp->queueCount - 1];
+	int n;
+
+	for (n=0; n < count; n++)
+	{
+		(*queuedCount)++;
+		/* write() runs the packet through the kernel, up to a bridge
+		   port it is forwarded to. Take the time before it */
+		clock_gettime(CLOCK_REALTIME, &txTime[n]);
+		if (0 > write(fd, data[n], dataLen[n]))
+		{
+			ExecErrorMsgPrint("write(%s) failed",p->portName);
+			return EDPAT_FAILED;
+		}
+		(*sentCount)++;
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   tapPortStats()
+ *
+ *   Get the receive statistics of the TAP port.
+ *
+ *   Arguments :
+ *	p		- INPUT. Point to the port into table.
+ *	received	- OUTPUT. packets read from the device.
+ *	dropped		- OUTPUT. not known, left as is.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void tapPortStats(ETH_PORT_INFO *p,
+		unsigned long *received, unsigned long *dropped)
+{
+	TAP_PORT *tp = p->backendData;
+
+	// The device counts the packets its filter drops as dropped too
+	(void) dropped;
+	*received += tp->received;
+	return;
+}
+
+
+// TUN/TAP devices, "tap:<device>"
+const ETH_PORT_BACKEND EthPortTapBackend = {
+	.prefix		= TAP_PORT_PREFIX,
+	.open		= tapPortOpen,
+	.close		= tapPortClose,
+	.send		= tapPortSend,
+	.workerSend	= NULL,
+	.sendAt		= NULL,
+	.receive	= NULL,
+	.stats		= tapPortStats,
+	.filterUpdate	= tapPortFilterUpdate,
+};
@@ -0,0 +1,340 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <dlfcn.h>
+#include "edpat.h"
+#include "print.h"
+#include "filter.h"
+#include "seqtag.h"
+#include "EthPortBackend.h"
+#include "EthPortIO.h"
+
+#define VIRTUAL_PORT_PREFIX	"vw:"
+// function looked up in the responder library
+#define VIRTUAL_RESPONDER_NAME	"EdpatResponder"
+
+/* Called for every packet sent to a port looped through a responder.
+   Returns the length of the reply put in 'reply', 0 for no reply */
+typedef int (*VIRTUAL_RESPONDER)(const char *portName,
+			const unsigned char *pkt, const int pktLen,
+			unsigned char *reply, const int replySize);
+
+/* A port on an in-process virtual wire. Packets sent to the port are
+   put straight in the receive queue of the other end of the wire, or
+   handed to the responder whose reply is received back on the port */
+typedef struct {
+	ETH_PORT_INFO	*peer;		// other end of the wire, or NULL
+	void		*dlHandle;	// responder library, or NULL
+	VIRTUAL_RESPONDER responder;
+	unsigned long	received;
+	unsigned long	dropped;	// sent while not wired
+} VIRTUAL_PORT;
+
+
+/***********************
+ *   virtualPortOpen()
+ *
+ *   Open a virtual port. It is not wired to anything till
+ *   EthPortWire() is called, packets sent to it meanwhile are dropped.
+ *
+ *   Arguments :
+ *	p	- INPUT/OUTPUT. Point to the port into table.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL virtualPortOpen(ETH_PORT_INFO *p)
+{
+	VIRTUAL_PORT *vp;
+
+	vp = calloc(1,sizeof(*vp));
+	if (NULL == vp)
+	{
+		ExecErrorMsgPrint("Failed to allocate port '%s'",p->portName);
+		return EDPAT_FAILED;
+	}
+	p->backendData = vp;
+	return EthPortRxQueuesCreate(p, 1);
+}
+
+
+/***********************
+ *   virtualPortUnwire()
+ *
+ *   Disconnect the port from the other end of its wire, or from its
+ *   responder.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void virtualPortUnwire(ETH_PORT_INFO *p)
+{
+	VIRTUAL_PORT *vp = p->backendData;
+	VIRTUAL_PORT *peer;
+
+	if (NULL != vp->peer)
+	{
+		peer = vp->peer->backendData;
+		if ((NULL != peer) && (p == peer->peer))
+		{
+			peer->peer = NULL;
+		}
+		vp->peer = NULL;
+	}
+	if (NULL != vp->dlHandle)
+	{
+		dlclose(vp->dlHandle);
+		vp->dlHandle = NULL;
+		vp->responder = NULL;
+	}
+	return;
+}
+
+
+/***********************
+ *   virtualPortClose()
+ *
+ *   Close the virtual port.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void virtualPortClose(ETH_PORT_INFO *p)
+{
+	if (NULL == p->backendData)
+	{
+		return;
+	}
+	virtualPortUnwire(p);
+	free(p->backendData);
+	p->backendData = NULL;
+	VerboseStringPrint("Virtual Port '%s' closed",p->portName);
+	return;
+}
+
+
+/***********************
+ *   virtualPortDeliver()
+ *
+ *   Receive a packet on the virtual port. Packets to be filtered are
+ *   dropped as the filter of an ethernet port would do.
+ *
+ *   Arguments :
+ *	p	- INPUT. Point to the port into table.
+ *	pkt	- INPUT. pointer to the packet buffer.
+ *	pktLen	- INPUT. length of packet.
+ *	rxTime	- INPUT. time the packet arrived.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void virtualPortDeliver(ETH_PORT_INFO *p,
+		const unsigned char *pkt, const int pktLen,
+		const struct timespec *rxTime)
+{
+	VIRTUAL_PORT *vp = p->backendData;
+
+	vp->received++;
+	if (EDPAT_TRUE == FilterPacketCheck(PacketFilterRules, NULL,
+			pkt, pktLen))
+	{
+		return;
+	}
+	if (EDPAT_TRUE == SeqTagReceive(pkt, pktLen, rxTime))
+	{
+		return;
+	}
+	PktQueueEnqueue(p->rxQueue[0], pkt, pktLen, rxTime);
+	return;
+}
+
+
+/***********************
+ *   virtualPortSend()
+ *
+ *   Send a batch of packets on the virtual wire of the port.
+ *
+ *   Arguments :
+ *	p		- INPUT. Point to the port into table.
+ *	data		- INPUT. array of pointers to the packets.
+ *	dataLen		- INPUT. array of lengths of the packets.
+ *	count		- INPUT. number of packets.
+ *	queuedCount	- OUTPUT. number of packets sent.
+ *	sentCount	- OUTPUT. number of packets sent.
+ *	txTime		- OUTPUT. time each packet was sent.
+ *
+ *   Return:	- EDPAT_SUCCESS
+ *
+ ********/
+static EDPAT_RETVAL virtualPortSend(ETH_PORT_INFO *p,
+			unsigned char * const *data, const int *dataLen,
+			const int count, int *queuedCount, int *sentCount,
+			struct timespec *txTime)
+{
+	static unsigned char reply[MAX_PKT_SIZE];
+	VIRTUAL_PORT *vp = p->backendData;
+	struct timespec replyTime;
+	int replyLen;
+	int n;
+
+	for (n=0; n < count; n++)
+	{
+		// The wire has no length, a packet arrives as it is sent
+		clock_gettime(CLOCK_REALTIME, &txTime[n]);
+		if (NULL != vp->peer)
+		{
+			virtualPortDeliver(vp->peer, data[n], dataLen[n],
+				&txTime[n]);
+		}
+		else if (NULL != vp->responder)
+		{
+			replyLen = vp->responder(p->portName,
+					data[n], dataLen[n],
+					reply, sizeof(reply));
+			if (0 < replyLen)
+			{
+				clock_gettime(CLOCK_REALTIME, &replyTime);
+				virtualPortDeliver(p, reply, replyLen,
+					&replyTime);
+			}
+		}
+		else
+		{
+			// Like a cable that is not plugged in
+			vp->dropped++;
+		}
+		(*queuedCount)++;
+		(*sentCount)++;
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   virtualPortStats()
+ *
+ *   Get the receive statistics of the virtual port.
+ *
+ *   Arguments :
+ *	p		- INPUT. Point to the port into table.
+ *	received	- OUTPUT. packets received.
+ *	dropped		- OUTPUT. packets sent while not wired.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void virtualPortStats(ETH_PORT_INFO *p,
+		unsigned long *received, unsigned long *dropped)
+{
+	VIRTUAL_PORT *vp = p->backendData;
+
+	*received += vp->received;
+	*dropped += vp->dropped;
+	return;
+}
+
+
+/***********************
+ *   EthPortWire()
+ *
+ *   Wire a virtual port back to back with another virtual port, or loop
+ *   it through a responder in a shared library. Both ports are opened
+ *   if needed and their earlier wiring is removed.
+ *
+ *   Arguments :
+ *	portName	- INPUT. Name of the virtual port.
+ *	peerName	- INPUT. Name of the other virtual port, or path of
+ *			  the shared library of the responder.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+EDPAT_RETVAL EthPortWire(const char *portName, const char *peerName)
+{
+	ETH_PORT_INFO *p;
+	ETH_PORT_INFO *peer;
+	VIRTUAL_PORT *vp;
+	void *dlHandle;
+	void *responder;
+
+	if ((0 > EthPortOpen(portName)) ||
+	    (NULL == (p = EthPortFindByName(portName))))
+	{
+		return EDPAT_FAILED;
+	}
+	if (&EthPortVirtualBackend != p->backend)
+	{
+		ScriptErrorMsgPrint("'%s' is not a virtual port. "
+			"Expecting '%s<name>'",portName,VIRTUAL_PORT_PREFIX);
+		return EDPAT_FAILED;
+	}
+	vp = p->backendData;
+
+	if (0 == strncmp(peerName, VIRTUAL_PORT_PREFIX,
+			strlen(VIRTUAL_PORT_PREFIX)))
+	{
+		if ((0 > EthPortOpen(peerName)) ||
+		    (NULL == (peer = EthPortFindByName(peerName))))
+		{
+			return EDPAT_FAILED;
+		}
+		virtualPortUnwire(p);
+		virtualPortUnwire(peer);
+		vp->peer = peer;
+		((VIRTUAL_PORT *) peer->backendData)->peer = p;
+		VerboseStringPrint("Virtual Port '%s' wired to '%s'",
+			portName, peerName);
+		return EDPAT_SUCCESS;
+	}
+
+	dlHandle = dlopen(peerName, RTLD_NOW | RTLD_LOCAL);
+	if (NULL == dlHandle)
+	{
+		ScriptErrorMsgPrint("Failed to load responder '%s'. %s",
+			peerName, dlerror());
+		return EDPAT_FAILED;
+	}
+	responder = dlsym(dlHandle, VIRTUAL_RESPONDER_NAME);
+	if (NULL == responder)
+	{
+		ScriptErrorMsgPrint("Responder '%s' has no %s()",
+			peerName, VIRTUAL_RESPONDER_NAME);
+		dlclose(dlHandle);
+		return EDPAT_FAILED;
+	}
+	virtualPortUnwire(p);
+	vp->dlHandle = dlHandle;
+	vp->responder = (VIRTUAL_RESPONDER) responder;
+	VerboseStringPrint("Virtual Port '%s' looped through responder '%s'",
+		portName, peerName);
+	return EDPAT_SUCCESS;
+}
+
+
+// In-process ports, "vw:<name>"
+const ETH_PORT_BACKEND EthPortVirtualBackend = {
+	.prefix		= VIRTUAL_PORT_PREFIX,
+	.open		= virtualPortOpen,
+	.close		= virtualPortClose,
+	.send		= virtualPortSend,
+	.workerSend	= NULL,
+	.sendAt		= NULL,
+	.receive	= NULL,
+	.stats		= virtualPortStats,
+	.filterUpdate	= NULL,
+};
@@ -0,0 +1,258 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "edpat.h"
+#include "print.h"
+#include "utils.h"
+#include "EthPortIO.h"
+#include "benchmark.h"
+
+/* What a trial of a search achieved. Latencies are of the first and
+   the last frames, -1 if not known */
+typedef struct {
+	double		pps;		// offered, from the times the frames left
+	unsigned long	sent;
+	unsigned long	failed;		// handed to the port but not sent
+	unsigned long	received;	// frames matching the one expected
+	struct timespec	firstRxTime;
+	struct timespec	lastRxTime;
+	long long	firstLatencyNs;
+	long long	lastLatencyNs;
+} BENCHMARK_TRIAL;
+
+
+/***********************
+ *   benchmarkReceive()
+ *
+ *   Receive a packet from any port and count it in the trial if it is
+ *   the frame expected at the receiving port of the search. Other
+ *   packets are dropped.
+ *
+ *   Arguments :
+ *	b	- INPUT. the search.
+ *	waitMs	- INPUT. how long to wait for a packet.
+ *	t	- INPUT/OUTPUT. the trial, NULL to drop every packet.
+ *
+ *   Return:	- EDPAT_SUCCESS if a packet was received, EDPAT_NOTFOUND if
+ *		  none came in time, else EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL benchmarkReceive(const BENCHMARK *b, const int waitMs,
+			BENCHMARK_TRIAL *t)
+{
+	static unsigned char pkt[MAX_PKT_SIZE];
+	char portName[MAX_ETH_PORT_NAME_LEN+1];
+	struct timespec rxTime;
+	int pktLen = MAX_PKT_SIZE;
+	EDPAT_RETVAL retVal;
+
+	retVal = EthPortReceiveAny(portName, pkt, &pktLen, waitMs, &rxTime);
+	if ((EDPAT_SUCCESS != retVal) || (NULL == t) ||
+	    (0 != strcmp(portName, b->rxPortName)) ||
+	    (EDPAT_TRUE != b->match(pkt, pktLen)))
+	{
+		return retVal;
+	}
+	if (0 == t->received)
+	{
+		t->firstRxTime = rxTime;
+	}
+	t->lastRxTime = rxTime;
+	t->received++;
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   benchmarkTrial()
+ *
+ *   Send the frame of a search at a rate for the length of a trial and
+ *   count the frames expected that come back. Packets left over from
+ *   before are dropped first, and late ones are waited for till the
+ *   ports are quiet for the settle time, BENCHMARK_SETTLE_MS if it is 0.
+ *
+ *   Arguments :
+ *	b	- INPUT. the search.
+ *	pace	- INPUT. rate and length of the trial.
+ *	t	- OUTPUT. what the trial achieved.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL benchmarkTrial(const BENCHMARK *b,
+			const ETH_PORT_PACE *pace, BENCHMARK_TRIAL *t)
+{
+	ETH_PORT_PACE_STATS stats;
+	struct timespec lastTxTime;
+	int settleMs;
+	EDPAT_RETVAL retVal;
+
+	memset(t,0,sizeof(*t));
+	settleMs = (0 < PacketSettleTime) ?
+			PacketSettleTime : BENCHMARK_SETTLE_MS;
+
+	do
+	{
+		retVal = benchmarkReceive(b, 0, NULL);
+	} while (EDPAT_SUCCESS == retVal);
+	if (EDPAT_NOTFOUND != retVal)
+	{
+		return EDPAT_FAILED;
+	}
+
+	if (EDPAT_SUCCESS != EthPortSendPacedStart(b->txPortName, b->data,
+			b->dataLen, pace))
+	{
+		return EDPAT_FAILED;
+	}
+	while (EDPAT_TRUE == EthPortSendPacedBusy())
+	{
+		if (EDPAT_FAILED == benchmarkReceive(b, 1, t))
+		{
+			EthPortSendPacedWait(&stats, &lastTxTime);
+			return EDPAT_FAILED;
+		}
+	}
+	EthPortSendPacedWait(&stats, &lastTxTime);
+	do
+	{
+		retVal = benchmarkReceive(b, settleMs, t);
+	} while (EDPAT_SUCCESS == retVal);
+	if (EDPAT_NOTFOUND != retVal)
+	{
+		return EDPAT_FAILED;
+	}
+
+	t->pps = (0 < stats.pps) ? stats.pps : pace->pps;
+	t->sent = stats.sent;
+	t->failed = stats.failed;
+	t->firstLatencyNs = (-1);
+	t->lastLatencyNs = (-1);
+	if ((0 != t->received) && (0 != stats.firstTxTime.tv_sec))
+	{
+		t->firstLatencyNs = TimespecDiffNs(&stats.firstTxTime,
+				&t->firstRxTime);
+		t->lastLatencyNs = TimespecDiffNs(&lastTxTime,
+				&t->lastRxTime);
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   BenchmarkSearch()
+ *
+ *   Find the highest rate a frame is forwarded at without loss, as the
+ *   throughput test of RFC 2544. Trials are run at the highest rate
+ *   of the search and then by a binary search between the highest
+ *   rate without loss and the lowest with loss, till they are within
+ *   BENCHMARK_RESOLUTION of each other. A trial is without loss if
+ *   every frame sent came back as expected. It ends at once if the port
+ *   does not send the frame at all. The rate and the latencies
+ *   of the last trial without loss are printed to the report, and the
+ *   test case fails if there was none.
+ *
+ *   Arguments :
+ *	b	- INPUT. the search.
+ *
+ *   Return:	- EDPAT_SUCCESS, or EDPAT_FAILED if a trial could not be
+ *		  run
+ *
+ ********/
+EDPAT_RETVAL BenchmarkSearch(const BENCHMARK *b)
+{
+	BENCHMARK_TRIAL trial, best;
+	ETH_PORT_PACE pace = b->pace;
+	double wireBits;
+	double maxPps;
+	double lowPps = 0;
+	double highPps;
+	int frameSize = b->dataLen + BENCHMARK_FCS_LEN;
+	int trialCount;
+
+	wireBits = (((ETH_MIN_FRAME_LEN > b->dataLen) ?
+			ETH_MIN_FRAME_LEN : b->dataLen) + ETH_WIRE_OVERHEAD) * 8.0;
+	maxPps = (0 < pace.pps) ? pace.pps : (pace.bps / wireBits);
+	pace.bps = 0;
+	if ((0 == pace.count) && (0 == pace.durationMs))
+	{
+		pace.durationMs = BENCHMARK_TRIAL_MS;
+	}
+
+	memset(&best,0,sizeof(best));
+	highPps = maxPps;
+	pace.pps = maxPps;
+	for (trialCount=1; ; trialCount++)
+	{
+		if (EDPAT_SUCCESS != benchmarkTrial(b, &pace, &trial))
+		{
+			return EDPAT_FAILED;
+		}
+		TestCaseStringPrint("Trial of %d byte frames at %.0f pps. "
+			"Sent %lu at %.0f pps, received %lu", frameSize,
+			pace.pps, trial.sent, trial.pps, trial.received);
+		if (0 == trial.sent)
+		{
+			TestCaseStringPrint("Port '%s' did not send %d byte "
+				"frames", b->txPortName, frameSize);
+			break;
+		}
+		if ((0 == trial.failed) &&
+		    (trial.sent <= trial.received))
+		{
+			lowPps = pace.pps;
+			best = trial;
+		}
+		else
+		{
+			highPps = pace.pps;
+		}
+		if ((BENCHMARK_MAX_TRIALS <= trialCount) ||
+		    ((highPps - lowPps) <= (highPps * BENCHMARK_RESOLUTION)))
+		{
+			break;
+		}
+		pace.pps = (lowPps + highPps) / 2;
+	}
+
+	if (0 == best.sent)
+	{
+		CurrentTestResult = EDPAT_TEST_RESULT_FAILED;
+		TestCaseStringPrint("No rate without loss for %d byte frames "
+			"from '%s' to '%s'", frameSize, b->txPortName,
+			b->rxPortName);
+		TestCaseReportPrint("%s\tthroughput of %d byte frames from "
+			"'%s' to '%s': none without loss in %d trials",
+			CurrentTestCaseId, frameSize, b->txPortName,
+			b->rxPortName, trialCount);
+		return EDPAT_SUCCESS;
+	}
+	if ((0 > best.firstLatencyNs) || (0 > best.lastLatencyNs))
+	{
+		TestCaseReportPrint("%s\tthroughput of %d byte frames from "
+			"'%s' to '%s': %.0f pps, %.3f Mbps, %.2f%% of %.0f "
+			"pps in %d trials, latency not known",
+			CurrentTestCaseId, frameSize, b->txPortName,
+			b->rxPortName, best.pps, best.pps * wireBits / 1000000.0,
+			best.pps * 100.0 / maxPps, maxPps, trialCount);
+		return EDPAT_SUCCESS;
+	}
+	TestCaseReportPrint("%s\tthroughput of %d byte frames from '%s' to "
+		"'%s': %.0f pps, %.3f Mbps, %.2f%% of %.0f pps in %d trials, "
+		"latency first=%.3f last=%.3f us", CurrentTestCaseId,
+		frameSize, b->txPortName, b->rxPortName, best.pps,
+		best.pps * wireBits / 1000000.0, best.pps * 100.0 / maxPps,
+		maxPps, trialCount, best.firstLatencyNs / 1000.0,
+		best.lastLatencyNs / 1000.0);
+	return EDPAT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__ 1
+
+#define BENCHMARK_TRIAL_MS	1000	// length of a trial
+#define BENCHMARK_SETTLE_MS	100	// wait for late packets after a trial
+#define BENCHMARK_RESOLUTION	0.001	// of the rate, when the search ends
+#define BENCHMARK_MAX_TRIALS	20	// per frame size
+#define BENCHMARK_FCS_LEN	4	// frame sizes include the FCS
+#define BENCHMARK_MIN_FRAME_SIZE	64
+#define BENCHMARK_MAX_FRAME_SIZE	(MAX_PKT_SIZE)
+#define MAX_BENCHMARK_SIZE_COUNT	16	// frame sizes of a search
+
+/* A search for the highest rate a frame is forwarded at without loss,
+   from one port to another */
+typedef struct {
+	const char	*txPortName;
+	const char	*rxPortName;
+	unsigned char	*data;		// the frame sent, without FCS
+	int		dataLen;
+	ETH_PORT_PACE	pace;		// highest rate, and length of a trial
+	// checks if a packet received is the frame expected
+	EDPAT_BOOL	(*match)(const unsigned char *pkt, const int pktLen);
+} BENCHMARK;
+
+EDPAT_RETVAL BenchmarkSearch(const BENCHMARK *b);
+
+#endif
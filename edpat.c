@@ -32,13 +32,27 @@
 #include "packet.h"
 #include "print.h"
 #include "EthPortIO.h"
+#include "filter.h"
+#include "setting.h"
+#include "latency.h"
+#include "program.h"
 
 char CurrentTestCaseId[MAX_TESTCASE_ID_LEN+1];
 EDPAT_TEST_RESULT CurrentTestResult	= EDPAT_TEST_RESULT_UNKNOWN;
 int PacketReceiveTimeout = PKT_RECEIVE_TIMEOUT;
-EDPAT_BOOL EnableBroadcastPacketFiltering =  EDPAT_TRUE;
+int PacketSettleTime = PKT_SETTLE_TIME;
+unsigned int PacketFilterRules = FILTER_ALL;
 EDPAT_BOOL SyntaxCheckOnly = EDPAT_FALSE;
 EDPAT_BOOL PromiscuousModeEnabled = EDPAT_FALSE;
+int RxRingSize = RX_RING_SIZE;
+int RxRingBlockTimeout = RX_RING_BLOCK_TIMEOUT;
+int RxThreadCount = RX_THREAD_COUNT;
+EDPAT_BOOL RxFanoutByCpu = EDPAT_FALSE;
+int TxRingSize = TX_RING_SIZE;
+EDPAT_BOOL TxQdiscBypassEnabled = EDPAT_FALSE;
+int TxWorkerCount = TX_WORKER_COUNT;
+EDPAT_BOOL HwTimestampEnabled = EDPAT_FALSE;
+EDPAT_BOOL ScriptCacheEnabled = EDPAT_FALSE;
 
 unsigned char PktBuf[MAX_PKT_SIZE];
 
@@ -48,7 +62,12 @@ unsigned char PktBuf[MAX_PKT_SIZE];
  *
  *   TestScriptProcess()
  *
- *   Read test script line-by-line and process.
+ *   Compile the test script, with the files it includes, into a
+ *   program and run it. When only the syntax is checked, the program
+ *   is run without sending or receiving packets. With the cache, the
+ *   program is loaded from the cache of the script instead if none of
+ *   its files have changed, and saved to it when compiled for a run
+ *   that is not only a syntax check.
  *
  *   Arguments 		: fileName - INPUT. Name of the test script file
  *			  to be processsed.
@@ -62,100 +81,28 @@ unsigned char PktBuf[MAX_PKT_SIZE];
 EDPAT_RETVAL TestScriptProcess(const char *fileName)
 {
 	EDPAT_RETVAL retVal;
-	FILE *fp;
-	int lineLen;
-	int statementLen;
-	static char testScriptStatement[MAX_SCRIPT_STATEMENT_LEN+1];
-	
-	/* Open the file handle for the script file and add details to
-	   the scriptinfo table */
-	fp = ScriptOpen(fileName);
-	if (NULL == fp)
-	{
-		return EDPAT_FAILED;
-	};
 
-	retVal = 1;
-	// Keep reading statements from the opened filepointer 
-	while ( 0 < (statementLen =
-			ScriptReadStatement(fp,testScriptStatement)))
+	retVal = EDPAT_FAILED;
+	if (EDPAT_TRUE == ScriptCacheEnabled)
 	{
-		/* Substitute each occurence of a variable with its
-		   coressponding value */
-		retVal = ScriptSubstituteVariables(testScriptStatement);
-		if (0 > retVal)
-		{
-			CurrentTestResult = EDPAT_TEST_RESULT_SKIPPED;
-			continue;
-		}
-
-		/* If test case fails or is faulty skip until the next
-		   testcase ID */
-		if (( '@' != testScriptStatement[0] ) &&
-		    ( ( EDPAT_TEST_RESULT_SKIPPED == CurrentTestResult) ||
-		      ( EDPAT_TEST_RESULT_FAILED ==  CurrentTestResult)))
-		{
-			/* if test case is not passed. Skip to next test
-			   statement */
-			continue;
-		}
-
-		switch(testScriptStatement[0])
-		{
-			case '#':
-				/* include file an recursivily process the
-				   included file as well */
-				retVal = 
-				   ScriptIncludeFile(testScriptStatement);
-				break;
-			case '@':	// test case ID
-				retVal = GetTestCaseID(testScriptStatement);
-				break;
-			case '<':	// Receive packet
-			case '>':	// Send packet
-
-				if ( EDPAT_TEST_RESULT_UNKNOWN == 
-							CurrentTestResult)
-				{	
-					/*Set to passed when you see the
-					  first send case or receive case */
-					CleanupLastTestExecution();
-					CurrentTestResult =
-						EDPAT_TEST_RESULT_PASSED;
-				}
-				if (EDPAT_TRUE != SyntaxCheckOnly)
-				{	
-					/* Process the packet given in the
-					   receive or send test statement */
-					retVal =
-					 PacketProcess(testScriptStatement);
-				}
-				else
-				{
-					retVal = EDPAT_SUCCESS;
-				}
-				break;
-			case '$':	// assign value to variable
-				retVal =
-				   VariableStoreValue(testScriptStatement);
-				break;
-			default:
-				// Unknown command
-				ScriptErrorMsgPrint(
-					"Unknown statement '%c(%d)'",
-					testScriptStatement[0],
-					testScriptStatement[0]);
-				retVal = EDPAT_FAILED;
-				
-				break;
-
-		}
-		if ( EDPAT_SUCCESS != retVal)
+		retVal = ProgramCacheLoad(fileName);
+	}
+	if (EDPAT_SUCCESS != retVal)
+	{
+		retVal = ProgramCompile(fileName);
+		VariablePrintValues();
+		if ((EDPAT_SUCCESS == retVal) &&
+		    (EDPAT_TRUE == ScriptCacheEnabled) &&
+		    (EDPAT_TRUE != SyntaxCheckOnly))
 		{
-			CurrentTestResult = EDPAT_TEST_RESULT_SKIPPED;
+			ProgramCacheSave(fileName);
 		}
-	};
-	ScriptClose(fp);
+	}
+	if (EDPAT_SUCCESS == retVal)
+	{
+		ProgramExecute();
+	}
+	ProgramFree();
 	return retVal;
 }
 
@@ -186,25 +133,109 @@ int main(int argc, char *argv[])
 	printf(LICENSE_PROMPT);
 
 	//Extract the different flags and commandline parameters
-	while ((c = getopt (argc, argv, "fhpstvw:")) != -1)
+	while ((c = getopt (argc, argv, "b:cCfF:hHn:pqr:stT:u:vw:x:")) != -1)
 	{
 		switch (c)
 		{
+			case 'b':
+				RxRingBlockTimeout = atoi(optarg);
+				if (0 >= RxRingBlockTimeout)
+				{
+					printf("\nERROR: Invalid block timeout "
+						"value for '-b' option");
+					PrintUsageInfo(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'c':
+				RxFanoutByCpu = EDPAT_TRUE;
+				break;
+			case 'C':
+				ScriptCacheEnabled = EDPAT_TRUE;
+				break;
 			case 'f':
-				EnableBroadcastPacketFiltering=EDPAT_FALSE;
+				PacketFilterRules = FILTER_NONE;
+				break;
+			case 'F':
+				if (EDPAT_SUCCESS !=
+				    FilterRulesParse(optarg,&PacketFilterRules))
+				{
+					printf("\nERROR: Invalid filter rules "
+						"'%s' for '-F' option",optarg);
+					PrintUsageInfo(argv[0]);
+					exit(EXIT_FAILURE);
+				}
 				break;
 			case 'h':
 				PrintUsageInfo(argv[0]);
 				exit(0);
+			case 'H':
+				HwTimestampEnabled = EDPAT_TRUE;
+				break;
+			case 'n':
+				RxThreadCount = atoi(optarg);
+				if ((0 >= RxThreadCount) ||
+				    (MAX_RX_THREAD_COUNT < RxThreadCount))
+				{
+					printf("\nERROR: Invalid thread count "
+						"value for '-n' option. "
+						"Use 1 to %d",
+						MAX_RX_THREAD_COUNT);
+					PrintUsageInfo(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
 			case 'p':
 				PromiscuousModeEnabled = EDPAT_TRUE;
 				break;
+			case 'q':
+				TxQdiscBypassEnabled = EDPAT_TRUE;
+				break;
+			case 'r':
+				RxRingSize = atoi(optarg);
+				if ((0 > RxRingSize) ||
+				    (MAX_RX_RING_SIZE < RxRingSize) ||
+				    ((0 != RxRingSize) &&
+				     ((2*RX_RING_BLOCK_SIZE/1024) > RxRingSize)))
+				{
+					printf("\nERROR: Invalid ring size "
+						"value for '-r' option. "
+						"Use 0 or %d to %d",
+						2*RX_RING_BLOCK_SIZE/1024,
+						MAX_RX_RING_SIZE);
+					PrintUsageInfo(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
 			case 's':
 				SyntaxCheckOnly = EDPAT_TRUE;
 				break;
 			case 't':
 				MsgTimestampEnable();
 				break;
+			case 'T':
+				TxWorkerCount = atoi(optarg);
+				if ((0 >= TxWorkerCount) ||
+				    (MAX_TX_WORKER_COUNT < TxWorkerCount))
+				{
+					printf("\nERROR: Invalid thread count "
+						"value for '-T' option. "
+						"Use 1 to %d",
+						MAX_TX_WORKER_COUNT);
+					PrintUsageInfo(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'u':
+				PacketSettleTime = atoi(optarg);
+				if (0 > PacketSettleTime)
+				{
+					printf("\nERROR: Invalid settle time "
+						"value for '-u' option");
+					PrintUsageInfo(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
 			case 'v':
 				VerboseMsgEnable();
 				break;
@@ -218,8 +249,25 @@ int main(int argc, char *argv[])
 					exit(EXIT_FAILURE);
 				}
 				break;
+			case 'x':
+				TxRingSize = atoi(optarg);
+				if ((0 > TxRingSize) ||
+				    (MAX_TX_RING_SIZE < TxRingSize) ||
+				    ((0 != TxRingSize) &&
+				     ((TX_RING_BLOCK_SIZE/1024) > TxRingSize)))
+				{
+					printf("\nERROR: Invalid ring size "
+						"value for '-x' option. "
+						"Use 0 or %d to %d",
+						TX_RING_BLOCK_SIZE/1024,
+						MAX_TX_RING_SIZE);
+					PrintUsageInfo(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
 			case ':':
-				printf("\nERROR: '-w' option need a value");
+				printf("\nERROR: option '-%c' need a value",
+						optopt);
 				PrintUsageInfo(argv[0]);
 				exit(EXIT_FAILURE);
 			case '?':
@@ -301,6 +349,7 @@ int main(int argc, char *argv[])
 
 	/* Print result of last test specification */
 	CleanupLastTestExecution();
+	LatencyPortReportPrint();
 
 	EthPortCloseAll();
 	if( logFileFp != stdout)
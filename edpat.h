@@ -14,15 +14,36 @@
 #define MAX_ETH_PORT_COUNT	10	// Max Eth interaces supported
 #define MAX_FILE_NAME_LEN	50
 #define MAX_SCRIPT_FILE_DEPTH	5
-#define MAX_SCRIPT_STATEMENT_LEN	9000
-#define MAX_SCRIPT_LINE_LEN	200
 #define MAX_TESTCASE_ID_LEN	11
 #define MAX_TIMESTAMP_LEN        40
-#define MAX_VAR_COUNT		100
 #define MAX_CS_SIZE		10
 #define LICENSE_PROMPT "Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)\nAll rights reserved\n\n"
 // timeout period while wating from reading pkt from interface.
 #define PKT_RECEIVE_TIMEOUT	3	
+// time in ms to wait for late packets before a port is taken as quiet
+#define PKT_SETTLE_TIME		0
+// default size of the TPACKET_V3 receive ring of a port in KB, 0 = recvmsg()
+#define RX_RING_SIZE		4096
+#define RX_RING_BLOCK_SIZE	(256*1024)	// must hold a MAX_PKT_SIZE frame
+#define MAX_RX_RING_SIZE	(1024*1024)	// in KB
+// default time in ms after which kernel hands a partly filled block to us
+#define RX_RING_BLOCK_TIMEOUT	1
+// packets a port can hold till the interpreter reads them
+#define RX_QUEUE_LEN		1024
+// and their bytes, at least 2 MAX_PKT_SIZE frames
+#define RX_QUEUE_DATA_SIZE	(2*1024*1024)
+// default receiver threads per port, more than 1 forms a PACKET_FANOUT group
+#define RX_THREAD_COUNT		1
+#define MAX_RX_THREAD_COUNT	8
+// default size of the PACKET_TX_RING of a port in KB, 0 = sendto()
+#define TX_RING_SIZE		0
+#define TX_RING_BLOCK_SIZE	(256*1024)	// must hold a MAX_PKT_SIZE frame
+#define MAX_TX_RING_SIZE	(1024*1024)	// in KB
+// packets of a repeated send handed to the port at a time
+#define SEND_REPEAT_BATCH	256
+// default transmit worker threads per port for stream and paced sends
+#define TX_WORKER_COUNT		1
+#define MAX_TX_WORKER_COUNT	8
 
 typedef enum {
 	EDPAT_FALSE	= 0,
@@ -46,9 +67,19 @@ typedef enum {
 extern char CurrentTestCaseId[];
 extern EDPAT_TEST_RESULT CurrentTestResult;
 extern int PacketReceiveTimeout;
-extern EDPAT_BOOL EnableBroadcastPacketFiltering;
+extern int PacketSettleTime;
+extern unsigned int PacketFilterRules;
 extern EDPAT_BOOL SyntaxCheckOnly;
 extern EDPAT_BOOL PromiscuousModeEnabled;
+extern int RxRingSize;
+extern int RxRingBlockTimeout;
+extern int RxThreadCount;
+extern EDPAT_BOOL RxFanoutByCpu;
+extern int TxRingSize;
+extern EDPAT_BOOL TxQdiscBypassEnabled;
+extern int TxWorkerCount;
+extern EDPAT_BOOL HwTimestampEnabled;
+extern EDPAT_BOOL ScriptCacheEnabled;
 
 int TestScriptProcess(const char *fileName);
 
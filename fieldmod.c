@@ -0,0 +1,631 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "edpat.h"
+#include "print.h"
+#include "seqtag.h"
+#include "fieldmod.h"
+
+#define MAX_FIELD_MOD_STR_LEN	400
+
+typedef enum {
+	FIELD_MOD_INC,
+	FIELD_MOD_DEC,
+	FIELD_MOD_RAND,
+	FIELD_MOD_LIST,
+	FIELD_MOD_SEQ
+} FIELD_MOD_OP;
+
+/* A field of the packets of a send statement that changes from one
+   packet to the next. The value of the k-th packet is
+	inc	start + (k % count) * step
+	dec	start - (k % count) * step
+	rand	a random value from start to start + count - 1
+	list	list[k % listLen]
+   wrapping at the width of the field. A count of 0 is no limit. A seq
+   field is the sequence tag of packet k of stream 'start', made by
+   SeqTagWrite(). The stream is added to the test case when the
+   statement is loaded to run */
+typedef struct {
+	FIELD_MOD_OP	op;
+	int		pos;		// first byte of the field in the packet
+	int		width;		// bytes, the value is big endian
+	unsigned long long start;
+	unsigned long long step;
+	unsigned long long count;
+	unsigned long long list[MAX_FIELD_MOD_LIST_LEN];
+	int		listLen;
+	int		stream;		// seq, index from SeqTagStreamAdd()
+} FIELD_MOD;
+
+// The modifiers of a compiled send statement
+struct fieldModTable {
+	int		count;
+	FIELD_MOD	mod[];
+};
+
+static FIELD_MOD FieldMod[MAX_FIELD_MOD_COUNT];
+static int FieldModTotal = 0;
+static unsigned long long RandSeed = 0;		// 0 = not seeded
+
+
+/***********************
+ *   fieldModRand()
+ *
+ *   Get the pseudo random number of a field in a packet. It is the
+ *   splitmix64 hash of the packet and field numbers, so any packet can
+ *   be made without the ones before it, by any thread. The seed is
+ *   taken from the clock the first time, it is in the verbose log.
+ *
+ *   Arguments :
+ *	m	- INPUT. the field.
+ *	k	- INPUT. number of the packet, from 0.
+ *
+ *   Return:	- the number
+ *
+ ********/
+static unsigned long long fieldModRand(const FIELD_MOD *m,
+			const unsigned long long k)
+{
+	unsigned long long z;
+
+	z = RandSeed + (k * MAX_FIELD_MOD_COUNT + (m - FieldMod)) *
+		0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+
+/***********************
+ *   fieldModSeed()
+ *
+ *   Seed the random field values from the clock, the first time a
+ *   rand field is parsed or loaded.
+ *
+ *   Arguments : None
+ *
+ *   Return:	- None
+ *
+ ********/
+static void fieldModSeed(void)
+{
+	struct timespec now;
+
+	if (0 != RandSeed)
+	{
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	RandSeed = ((unsigned long long) now.tv_sec * 1000000000ULL +
+			now.tv_nsec) | 1;
+	VerboseStringPrint("Random field values seeded with %llu", RandSeed);
+	return;
+}
+
+
+/***********************
+ *   fieldModValue()
+ *
+ *   Get the value of a field in a packet.
+ *
+ *   Arguments :
+ *	m	- INPUT. the field.
+ *	k	- INPUT. number of the packet, from 0.
+ *
+ *   Return:	- the value
+ *
+ ********/
+static unsigned long long fieldModValue(const FIELD_MOD *m,
+			const unsigned long long k)
+{
+	unsigned long long n = (0 != m->count) ? (k % m->count) : k;
+	unsigned long long v;
+
+	switch (m->op)
+	{
+		case FIELD_MOD_INC:
+			v = m->start + n * m->step;
+			break;
+		case FIELD_MOD_DEC:
+			v = m->start - n * m->step;
+			break;
+		case FIELD_MOD_RAND:
+			v = fieldModRand(m, k);
+			v = m->start + ((0 != m->count) ? (v % m->count) : v);
+			break;
+		case FIELD_MOD_LIST:
+		default:
+			v = m->list[k % m->listLen];
+			break;
+	}
+	if (MAX_FIELD_MOD_WIDTH > m->width)
+	{
+		v &= (1ULL << (8 * m->width)) - 1;
+	}
+	return v;
+}
+
+
+/***********************
+ *   fieldModBytes()
+ *
+ *   Get the bytes of a field in a packet.
+ *
+ *   Arguments :
+ *	m	- INPUT. the field.
+ *	k	- INPUT. number of the packet, from 0.
+ *	bytes	- OUTPUT. the bytes of the field.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void fieldModBytes(const FIELD_MOD *m, const unsigned long long k,
+			unsigned char *bytes)
+{
+	unsigned long long v;
+	int i;
+
+	if (FIELD_MOD_SEQ == m->op)
+	{
+		SeqTagWrite(m->stream, k, bytes);
+		return;
+	}
+	v = fieldModValue(m, k);
+	for (i = m->width - 1; i >= 0; i--, v >>= 8)
+	{
+		bytes[i] = (unsigned char) v;
+	}
+	return;
+}
+
+
+/***********************
+ *   fieldModHexRead()
+ *
+ *   Read a value of a field. It is given in hex, 2 digits for every
+ *   byte of the field.
+ *
+ *   Arguments :
+ *	str	- INPUT. the value.
+ *	value	- OUTPUT. the value read.
+ *	width	- INPUT/OUTPUT. bytes of the field, 0 if not known yet.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL fieldModHexRead(const char *str,
+			unsigned long long *value, int *width)
+{
+	int len = strlen(str);
+	char *q;
+
+	*value = strtoull(str,&q,16);
+	if ((str == q) || (0 != q[0]) || (0 != (len % 2)) ||
+	    ((2 * MAX_FIELD_MOD_WIDTH) < len) || ('-' == str[0]) ||
+	    ('+' == str[0]))
+	{
+		ScriptErrorMsgPrint("'%s' is not a field value. Expecting 2 "
+			"hex digits for each byte, up to %d bytes",
+			str, MAX_FIELD_MOD_WIDTH);
+		return EDPAT_FAILED;
+	}
+	if ((0 != *width) && ((len / 2) != *width))
+	{
+		ScriptErrorMsgPrint("'%s' is not %d bytes like the other "
+			"values of the field", str, *width);
+		return EDPAT_FAILED;
+	}
+	*width = len / 2;
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   fieldModDecRead()
+ *
+ *   Read the step or the count of a field, in decimal.
+ *
+ *   Arguments :
+ *	str	- INPUT. the number, NULL if not given.
+ *	value	- OUTPUT. the number, unchanged if not given.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+static EDPAT_RETVAL fieldModDecRead(const char *str, unsigned long long *value)
+{
+	char *q;
+
+	if (NULL == str)
+	{
+		return EDPAT_SUCCESS;
+	}
+	*value = strtoull(str,&q,10);
+	if ((str == q) || (0 != q[0]) || ('-' == str[0]))
+	{
+		ScriptErrorMsgPrint("'%s' is not a decimal number",str);
+		return EDPAT_FAILED;
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   FieldModReset()
+ *
+ *   Remove the field modifiers of the previous send statement.
+ *
+ *   Arguments : None
+ *
+ *   Return:	- None
+ *
+ ********/
+void FieldModReset(void)
+{
+	FieldModTotal = 0;
+	return;
+}
+
+
+/***********************
+ *   FieldModCount()
+ *
+ *   Get the number of field modifiers of the send statement.
+ *
+ *   Arguments : None
+ *
+ *   Return:	- number of modifiers, 0 if all the packets are the same
+ *
+ ********/
+int FieldModCount(void)
+{
+	return FieldModTotal;
+}
+
+
+/***********************
+ *   FieldModParse()
+ *
+ *   Parse a field modifier of a send statement and add it to the
+ *   statement. It is one of
+ *	{inc,<start>[,<step>[,<count>]]}
+ *	{dec,<start>[,<step>[,<count>]]}
+ *	{rand,<min>,<max>}
+ *	{list,<value>,<value>...}
+ *	{seq,<stream>}
+ *   The values are in hex and give the width of the field, the step
+ *   and count are in decimal. A seq field is the SEQ_TAG_LEN bytes
+ *   sequence tag of a stream, 0 to MAX_SEQ_TAG_STREAM_ID, there can be
+ *   one in a statement. Its bytes are 0 till FieldModLoad() adds the
+ *   stream.
+ *
+ *   Arguments :
+ *	token	- INPUT. the modifier.
+ *	pos	- INPUT. position of the field in the packet.
+ *	bytes	- OUTPUT. value of the field in the first packet.
+ *	width	- OUTPUT. bytes of the field.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+EDPAT_RETVAL FieldModParse(const char *token, const int pos,
+			unsigned char *bytes, int *width)
+{
+	char str[MAX_FIELD_MOD_STR_LEN+1];
+	char *arg[MAX_FIELD_MOD_LIST_LEN+2];	// the name and the values
+	char *savePtr;
+	unsigned long long max;
+	unsigned long long id;
+	FIELD_MOD *m;
+	int argCount = 0;
+	int len = strlen(token);
+	int i;
+
+	if ((MAX_FIELD_MOD_STR_LEN < len) || ('}' != token[len-1]))
+	{
+		ScriptErrorMsgPrint("Invalid field modifier '%s'. Expecting "
+			"{<op>,<value>...} without spaces",token);
+		return EDPAT_FAILED;
+	}
+	if (MAX_FIELD_MOD_COUNT <= FieldModTotal)
+	{
+		ScriptErrorMsgPrint("Too many field modifiers. Maximum is %d",
+			MAX_FIELD_MOD_COUNT);
+		return EDPAT_FAILED;
+	}
+	strncpy(str,&token[1],len-2);
+	str[len-2] = 0;
+	// The statement is being split with strtok()
+	for (arg[0] = strtok_r(str,",",&savePtr); NULL != arg[argCount];
+			arg[argCount] = strtok_r(NULL,",",&savePtr))
+	{
+		if ((MAX_FIELD_MOD_LIST_LEN + 1) < ++argCount)
+		{
+			ScriptErrorMsgPrint("Too many values in '%s'. "
+				"Maximum is %d",token,MAX_FIELD_MOD_LIST_LEN);
+			return EDPAT_FAILED;
+		}
+	}
+	if (2 > argCount)
+	{
+		ScriptErrorMsgPrint("Value of field modifier '%s' is "
+			"missing",token);
+		return EDPAT_FAILED;
+	}
+
+	m = &FieldMod[FieldModTotal];
+	memset(m,0,sizeof(*m));
+	m->pos = pos;
+	m->step = 1;
+	if ((0 == strcmp(arg[0],"inc")) || (0 == strcmp(arg[0],"dec")))
+	{
+		m->op = ('i' == arg[0][0]) ? FIELD_MOD_INC : FIELD_MOD_DEC;
+		if ((4 < argCount) ||
+		    (EDPAT_SUCCESS != fieldModHexRead(arg[1],&m->start,
+				&m->width)) ||
+		    (EDPAT_SUCCESS != fieldModDecRead(arg[2],&m->step)) ||
+		    (EDPAT_SUCCESS != fieldModDecRead(
+				(3 < argCount) ? arg[3] : NULL, &m->count)))
+		{
+			ScriptErrorMsgPrint("Expecting {%s,<start>[,<step>"
+				"[,<count>]]}",arg[0]);
+			return EDPAT_FAILED;
+		}
+	}
+	else if (0 == strcmp(arg[0],"rand"))
+	{
+		m->op = FIELD_MOD_RAND;
+		fieldModSeed();
+		if ((3 != argCount) ||
+		    (EDPAT_SUCCESS != fieldModHexRead(arg[1],&m->start,
+				&m->width)) ||
+		    (EDPAT_SUCCESS != fieldModHexRead(arg[2],&max,
+				&m->width)) ||
+		    (max < m->start))
+		{
+			ScriptErrorMsgPrint("Expecting {rand,<min>,<max>}");
+			return EDPAT_FAILED;
+		}
+		// 0 when the range is all the 64 bit values
+		m->count = max - m->start + 1;
+	}
+	else if (0 == strcmp(arg[0],"list"))
+	{
+		m->op = FIELD_MOD_LIST;
+		for (i=1; i < argCount; i++)
+		{
+			if (EDPAT_SUCCESS != fieldModHexRead(arg[i],
+					&m->list[m->listLen++], &m->width))
+			{
+				return EDPAT_FAILED;
+			}
+		}
+	}
+	else if (0 == strcmp(arg[0],"seq"))
+	{
+		m->op = FIELD_MOD_SEQ;
+		m->width = SEQ_TAG_LEN;
+		if ((2 != argCount) ||
+		    (EDPAT_SUCCESS != fieldModDecRead(arg[1],&id)) ||
+		    (MAX_SEQ_TAG_STREAM_ID < id))
+		{
+			ScriptErrorMsgPrint("Expecting {seq,<stream>}, the "
+				"stream 0 to %d",MAX_SEQ_TAG_STREAM_ID);
+			return EDPAT_FAILED;
+		}
+		m->start = id;
+		for (i=0; i < FieldModTotal; i++)
+		{
+			if (FIELD_MOD_SEQ == FieldMod[i].op)
+			{
+				ScriptErrorMsgPrint("A send statement can have "
+					"one {seq,<stream>}");
+				return EDPAT_FAILED;
+			}
+		}
+	}
+	else
+	{
+		ScriptErrorMsgPrint("Unknown field modifier '%s'. Expecting "
+			"inc, dec, rand, list or seq",arg[0]);
+		return EDPAT_FAILED;
+	}
+
+	if (MAX_PKT_SIZE < (pos + m->width))
+	{
+		ScriptErrorMsgPrint("Pkt too large");
+		return EDPAT_FAILED;
+	}
+	if (FIELD_MOD_SEQ == m->op)
+	{
+		memset(bytes, 0, m->width);
+	}
+	else
+	{
+		fieldModBytes(m, 0, bytes);
+	}
+	*width = m->width;
+	FieldModTotal++;
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   FieldModSet()
+ *
+ *   Change the fields of a packet of the send statement to the values
+ *   of packet k. The values of a packet depend only on its number, so
+ *   threads sending different packets of the statement can call it at
+ *   the same time.
+ *
+ *   Arguments :
+ *	pkt	- INPUT/OUTPUT. a packet of the statement, usually the
+ *		  one before, changed in place.
+ *	k	- INPUT. number of the packet, from 0.
+ *	changes	- OUTPUT. the bytes changed, for updating checksums.
+ *		  Room for MAX_FIELD_MOD_CHANGES.
+ *
+ *   Return:	- number of bytes changed
+ *
+ ********/
+int FieldModSet(unsigned char *pkt, const unsigned long long k,
+			FIELD_MOD_CHANGE *changes)
+{
+	FIELD_MOD *m;
+	unsigned char bytes[SEQ_TAG_LEN];
+	unsigned char byte;
+	int changeCount = 0;
+	int i, j;
+
+	for (i=0; i < FieldModTotal; i++)
+	{
+		m = &FieldMod[i];
+		fieldModBytes(m, k, bytes);
+		for (j = m->width - 1; j >= 0; j--)
+		{
+			byte = bytes[j];
+			if (byte == pkt[m->pos + j])
+			{
+				continue;
+			}
+			changes[changeCount].pos = m->pos + j;
+			changes[changeCount].oldByte = pkt[m->pos + j];
+			changes[changeCount].newByte = byte;
+			changeCount++;
+			pkt[m->pos + j] = byte;
+		}
+	}
+	return changeCount;
+}
+
+
+/***********************
+ *   FieldModSent()
+ *
+ *   Count the packets the send statement sent, for the stream of its
+ *   sequence tag.
+ *
+ *   Arguments :
+ *	sent	- INPUT. packets sent.
+ *
+ *   Return:	- None
+ *
+ ********/
+void FieldModSent(const unsigned long sent)
+{
+	int i;
+
+	for (i=0; i < FieldModTotal; i++)
+	{
+		if (FIELD_MOD_SEQ == FieldMod[i].op)
+		{
+			SeqTagSent(FieldMod[i].stream, sent);
+		}
+	}
+	return;
+}
+
+
+/***********************
+ *   FieldModSaveSize()
+ *
+ *   Get the size of the field modifiers of the send statement parsed,
+ *   as kept by FieldModSave().
+ *
+ *   Arguments : None
+ *
+ *   Return:	- size in bytes, 0 if there are none
+ *
+ ********/
+size_t FieldModSaveSize(void)
+{
+	if (0 == FieldModTotal)
+	{
+		return 0;
+	}
+	return sizeof(FIELD_MOD_TABLE) + FieldModTotal * sizeof(FIELD_MOD);
+}
+
+
+/***********************
+ *   FieldModSave()
+ *
+ *   Keep the field modifiers of the send statement parsed, for the
+ *   statement compiled. The table has no pointers, it can be copied
+ *   or mapped from a file as it is.
+ *
+ *   Arguments :
+ *	table	- OUTPUT. the modifiers, FieldModSaveSize() bytes.
+ *
+ *   Return:	- None
+ *
+ ********/
+void FieldModSave(FIELD_MOD_TABLE *table)
+{
+	table->count = FieldModTotal;
+	memcpy(table->mod, FieldMod, FieldModTotal * sizeof(FIELD_MOD));
+	return;
+}
+
+
+/***********************
+ *   FieldModLoad()
+ *
+ *   Make the field modifiers of a compiled send statement the ones of
+ *   the statement run, adding the stream of its sequence tag to the
+ *   test case.
+ *
+ *   Arguments :
+ *	table	- INPUT. the modifiers, NULL if none.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+EDPAT_RETVAL FieldModLoad(const FIELD_MOD_TABLE *table)
+{
+	FIELD_MOD *m;
+	int i;
+
+	FieldModTotal = 0;
+	if (NULL == table)
+	{
+		return EDPAT_SUCCESS;
+	}
+	if ((0 > table->count) || (MAX_FIELD_MOD_COUNT < table->count))
+	{
+		ScriptErrorMsgPrint("Invalid count %d of field modifiers",
+			table->count);
+		return EDPAT_FAILED;
+	}
+	memcpy(FieldMod, table->mod, table->count * sizeof(FIELD_MOD));
+	for (i=0; i < table->count; i++)
+	{
+		m = &FieldMod[i];
+		if (FIELD_MOD_RAND == m->op)
+		{
+			fieldModSeed();
+		}
+		if (FIELD_MOD_SEQ != m->op)
+		{
+			continue;
+		}
+		m->stream = SeqTagStreamAdd((unsigned int) m->start, m->pos);
+		if (0 > m->stream)
+		{
+			return EDPAT_FAILED;
+		}
+	}
+	FieldModTotal = table->count;
+	return EDPAT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#ifndef __FIELDMOD_H__
+#define __FIELDMOD_H__ 1
+
+#define MAX_FIELD_MOD_COUNT	16	// modifiers in a send statement
+#define MAX_FIELD_MOD_WIDTH	8	// bytes of a field
+#define MAX_FIELD_MOD_LIST_LEN	32	// values of a list modifier
+// bytes a call to FieldModSet() can change, a sequence tag is wider
+#define MAX_FIELD_MOD_CHANGES	(MAX_FIELD_MOD_COUNT * MAX_FIELD_MOD_WIDTH + \
+					SEQ_TAG_LEN)
+
+// A byte of the packet changed by FieldModSet()
+typedef struct {
+	int		pos;
+	unsigned char	oldByte;
+	unsigned char	newByte;
+} FIELD_MOD_CHANGE;
+
+// The field modifiers of a compiled send statement
+typedef struct fieldModTable FIELD_MOD_TABLE;
+
+void FieldModReset(void);
+int FieldModCount(void);
+EDPAT_RETVAL FieldModParse(const char *token, const int pos,
+			unsigned char *bytes, int *width);
+int FieldModSet(unsigned char *pkt, const unsigned long long k,
+			FIELD_MOD_CHANGE *changes);
+void FieldModSent(const unsigned long sent);
+size_t FieldModSaveSize(void);
+void FieldModSave(FIELD_MOD_TABLE *table);
+EDPAT_RETVAL FieldModLoad(const FIELD_MOD_TABLE *table);
+
+#endif
@@ -0,0 +1,425 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "edpat.h"
+#include "print.h"
+#include "filter.h"
+
+#define MAC_ADDR_LEN	6
+
+/* Labels used while building a BPF program. Conditional jumps either
+   fall through to the next instruction or go to one of these */
+#define LABEL_NEXT	0
+#define LABEL_ACCEPT	1
+#define LABEL_DROP	2
+
+typedef struct {
+	const char	*name;
+	unsigned int	rule;
+} FILTER_RULE_NAME;
+
+static const FILTER_RULE_NAME FilterRuleNames[] = {
+	{ "arp",	FILTER_ARP },
+	{ "lldp",	FILTER_LLDP },
+	{ "igmp",	FILTER_IGMP },
+	{ "dhcp",	FILTER_DHCP },
+	{ "ssdp",	FILTER_SSDP },
+	{ "mdns",	FILTER_MDNS },
+	{ "ipv6",	FILTER_IPV6 },
+	{ "all",	FILTER_ALL },
+	{ "none",	FILTER_NONE },
+	{ NULL,		0 }
+};
+
+// UDP ports of the DHCP, SSDP and MDNS packets
+static const struct {
+	unsigned short	port;
+	unsigned int	rule;
+	const char	*name;
+} FilterUdpPorts[] = {
+	{ 0x0043,	FILTER_DHCP,	"DHCP" },
+	{ 0x0044,	FILTER_DHCP,	"DHCP" },
+	{ 0xd7e8,	FILTER_SSDP,	"SSDP" },
+	{ 0x076c,	FILTER_SSDP,	"SSDP" },
+	{ 0x14e9,	FILTER_MDNS,	"MDNS" },
+	{ 0,		0,		NULL }
+};
+
+typedef struct {
+	struct sock_filter	*prog;
+	int			len;
+	unsigned char		jt[MAX_FILTER_PROG_LEN];	// labels
+	unsigned char		jf[MAX_FILTER_PROG_LEN];
+} FILTER_BUILD;
+
+
+/***********************
+ *   FilterRulesParse()
+ *
+ *   Convert a comma or space seperated list of rule names like
+ *   "arp,lldp,ipv6" into a rule bitmap. "all" and "none" are accepted
+ *   as well.
+ *
+ *   Arguments :
+ *	ruleStr	- INPUT. list of rule names.
+ *	rules	- OUTPUT. bitmap of FILTER_xxx.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED for an unknown name.
+ *		  The caller prints the error as it can be a command line
+ *		  option or a script statement.
+ *
+ ********/
+EDPAT_RETVAL FilterRulesParse(const char *ruleStr, unsigned int *rules)
+{
+	char *str;
+	char *name;
+	int i;
+
+	str = strdup(ruleStr);
+	if (NULL == str)
+	{
+		return EDPAT_FAILED;
+	}
+
+	*rules = FILTER_NONE;
+	for (name = strtok(str,", "); NULL != name; name = strtok(NULL,", "))
+	{
+		for (i=0; NULL != FilterRuleNames[i].name; i++)
+		{
+			if (0 == strcasecmp(name,FilterRuleNames[i].name))
+			{
+				*rules |= FilterRuleNames[i].rule;
+				break;
+			}
+		}
+		if (NULL == FilterRuleNames[i].name)
+		{
+			free(str);
+			return EDPAT_FAILED;
+		}
+	}
+	free(str);
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   FilterRulesString()
+ *
+ *   Get the rule names of a rule bitmap for printing.
+ *
+ *   Arguments :
+ *	rules	- INPUT. bitmap of FILTER_xxx.
+ *
+ *   Return:	- comma seperated rule names, "none" if empty
+ *
+ ********/
+const char *FilterRulesString(const unsigned int rules)
+{
+	static char str[MAX_FILTER_STR_LEN+1];
+	int i;
+
+	str[0] = 0;
+	for (i=0; FILTER_ALL != FilterRuleNames[i].rule; i++)
+	{
+		if (0 != (rules & FilterRuleNames[i].rule))
+		{
+			if (0 != str[0])
+			{
+				strcat(str,",");
+			}
+			strcat(str,FilterRuleNames[i].name);
+		}
+	}
+	if (0 == str[0])
+	{
+		strcpy(str,"none");
+	}
+	return str;
+}
+
+
+/***********************
+ *   filterEmit()
+ *
+ *   Append an instruction to the BPF program being built. Jump targets
+ *   are given as labels and resolved by filterResolve().
+ *
+ *   Arguments :
+ *	b	- INPUT/OUTPUT. program being built.
+ *	code	- INPUT. BPF opcode.
+ *	k	- INPUT. operand.
+ *	jt	- INPUT. label to jump to if condition is true.
+ *	jf	- INPUT. label to jump to if condition is false.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void filterEmit(FILTER_BUILD *b, const unsigned short code,
+		const unsigned int k,
+		const unsigned char jt, const unsigned char jf)
+{
+	b->prog[b->len].code = code;
+	b->prog[b->len].k = k;
+	b->jt[b->len] = jt;
+	b->jf[b->len] = jf;
+	b->len++;
+	return;
+}
+
+
+/***********************
+ *   filterResolve()
+ *
+ *   Add the accept and drop instructions at the end of the program and
+ *   convert the jump labels into relative offsets.
+ *
+ *   Arguments :
+ *	b	- INPUT/OUTPUT. program being built.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void filterResolve(FILTER_BUILD *b)
+{
+	int acceptIdx, dropIdx;
+	int i;
+
+	acceptIdx = b->len;
+	filterEmit(b, BPF_RET | BPF_K, 0xffffffff, LABEL_NEXT, LABEL_NEXT);
+	dropIdx = b->len;
+	filterEmit(b, BPF_RET | BPF_K, 0, LABEL_NEXT, LABEL_NEXT);
+
+	for (i=0; i < acceptIdx; i++)
+	{
+		if (BPF_JMP != BPF_CLASS(b->prog[i].code))
+		{
+			b->prog[i].jt = 0;
+			b->prog[i].jf = 0;
+			continue;
+		}
+		b->prog[i].jt = (LABEL_ACCEPT == b->jt[i]) ? (acceptIdx - i - 1) :
+				(LABEL_DROP == b->jt[i]) ? (dropIdx - i - 1) : 0;
+		b->prog[i].jf = (LABEL_ACCEPT == b->jf[i]) ? (acceptIdx - i - 1) :
+				(LABEL_DROP == b->jf[i]) ? (dropIdx - i - 1) : 0;
+	}
+	b->prog[acceptIdx].jt = b->prog[acceptIdx].jf = 0;
+	b->prog[dropIdx].jt = b->prog[dropIdx].jf = 0;
+	return;
+}
+
+
+/***********************
+ *   FilterProgramBuild()
+ *
+ *   Compile the filter rules into a classic BPF program to be attached
+ *   to a packet socket with SO_ATTACH_FILTER. Packets matching a rule
+ *   are dropped in the kernel and never reach the receiver thread.
+ *
+ *   Arguments :
+ *	rules	- INPUT. bitmap of FILTER_xxx.
+ *	macAddr	- INPUT. If not NULL, packets whose destination MAC is
+ *		  not this address are dropped as well.
+ *	prog	- OUTPUT. array of MAX_FILTER_PROG_LEN instructions.
+ *
+ *   Return:	- number of instructions in the program
+ *
+ ********/
+int FilterProgramBuild(const unsigned int rules, const unsigned char *macAddr,
+			struct sock_filter *prog)
+{
+	FILTER_BUILD b;
+	int i, j;
+
+	b.prog = prog;
+	b.len = 0;
+
+	if (NULL != macAddr)
+	{
+		// Destination MAC is in bytes 0-5
+		filterEmit(&b, BPF_LD | BPF_W | BPF_ABS, 0,
+				LABEL_NEXT, LABEL_NEXT);
+		filterEmit(&b, BPF_JMP | BPF_JEQ | BPF_K,
+				(macAddr[0] << 24) | (macAddr[1] << 16) |
+				(macAddr[2] << 8) | macAddr[3],
+				LABEL_NEXT, LABEL_DROP);
+		filterEmit(&b, BPF_LD | BPF_H | BPF_ABS, 4,
+				LABEL_NEXT, LABEL_NEXT);
+		filterEmit(&b, BPF_JMP | BPF_JEQ | BPF_K,
+				(macAddr[4] << 8) | macAddr[5],
+				LABEL_NEXT, LABEL_DROP);
+	}
+
+	// EtherType
+	filterEmit(&b, BPF_LD | BPF_H | BPF_ABS, 12, LABEL_NEXT, LABEL_NEXT);
+	if (rules & FILTER_ARP)
+	{
+		filterEmit(&b, BPF_JMP | BPF_JEQ | BPF_K, 0x0806,
+				LABEL_DROP, LABEL_NEXT);
+	}
+	if (rules & FILTER_LLDP)
+	{
+		filterEmit(&b, BPF_JMP | BPF_JEQ | BPF_K, 0x88cc,
+				LABEL_DROP, LABEL_NEXT);
+	}
+	if (rules & FILTER_IPV6)
+	{
+		filterEmit(&b, BPF_JMP | BPF_JEQ | BPF_K, 0x86dd,
+				LABEL_DROP, LABEL_NEXT);
+	}
+
+	if (rules & (FILTER_IGMP | FILTER_DHCP | FILTER_SSDP | FILTER_MDNS))
+	{
+		filterEmit(&b, BPF_JMP | BPF_JEQ | BPF_K, 0x0800,
+				LABEL_NEXT, LABEL_ACCEPT);
+		// IPv4 protocol
+		filterEmit(&b, BPF_LD | BPF_B | BPF_ABS, 23,
+				LABEL_NEXT, LABEL_NEXT);
+		if (rules & FILTER_IGMP)
+		{
+			filterEmit(&b, BPF_JMP | BPF_JEQ | BPF_K, 0x02,
+					LABEL_DROP, LABEL_NEXT);
+		}
+		if (rules & (FILTER_DHCP | FILTER_SSDP | FILTER_MDNS))
+		{
+			filterEmit(&b, BPF_JMP | BPF_JEQ | BPF_K, 0x11,
+					LABEL_NEXT, LABEL_ACCEPT);
+			// X = IPv4 header length
+			filterEmit(&b, BPF_LDX | BPF_B | BPF_MSH, 14,
+					LABEL_NEXT, LABEL_NEXT);
+			// UDP source port and then destination port
+			for (i=0; i < 2; i++)
+			{
+				filterEmit(&b, BPF_LD | BPF_H | BPF_IND,
+						14 + (2 * i),
+						LABEL_NEXT, LABEL_NEXT);
+				for (j=0; NULL != FilterUdpPorts[j].name; j++)
+				{
+					if (rules & FilterUdpPorts[j].rule)
+					{
+						filterEmit(&b,
+						  BPF_JMP | BPF_JEQ | BPF_K,
+						  FilterUdpPorts[j].port,
+						  LABEL_DROP, LABEL_NEXT);
+					}
+				}
+			}
+		}
+	}
+	filterResolve(&b);
+	return b.len;
+}
+
+
+/***********************
+ *   FilterPacketCheck()
+ *
+ *   Inspect a receved packet in user space and check whether it need to
+ *   be filtered. Used when the BPF program could not be attached.
+ *
+ *   Arguments :
+ *	rules	- INPUT. bitmap of FILTER_xxx.
+ *	macAddr	- INPUT. If not NULL, packets not addressed to this MAC
+ *		  are filtered as well.
+ *	pkt	- INPUT. pointer to the packet buffer.
+ *	pktLen	- INPUT. leghth of packet.
+ *
+ *   Return:
+ *	EDPAT_TRUE	- packet need to be filtered/discarded
+ *	EDPAT_FALSE	- packet should not be filtered
+ *
+ ********/
+EDPAT_BOOL FilterPacketCheck(const unsigned int rules,
+			const unsigned char *macAddr,
+			const unsigned char *pkt, const int pktLen)
+{
+	unsigned short ethType;
+	unsigned short port[2];
+	int udpOffset;
+	int i, j;
+
+	if ((NULL != macAddr) && (0 != memcmp(pkt,macAddr,MAC_ADDR_LEN)))
+	{
+		VerboseStringPrint("Packet not addressed to the port "
+				"is discarded");
+		return EDPAT_TRUE;
+	}
+	if (14 > pktLen)
+	{
+		return EDPAT_FALSE;
+	}
+
+	ethType = ((pkt[12] << 8) | pkt[13]);
+	switch(ethType)
+	{
+		case 0x0806:	// ARP
+			if (rules & FILTER_ARP)
+			{
+				VerboseStringPrint(
+					"Received ARP packet filtered");
+				return EDPAT_TRUE;
+			}
+			break;
+		case 0x88CC:	//LLDP
+			if (rules & FILTER_LLDP)
+			{
+				VerboseStringPrint(
+					"Received LLDP packet filtered");
+				return EDPAT_TRUE;
+			}
+			break;
+		case 0x86dd:	// IPv6
+			if (rules & FILTER_IPV6)
+			{
+				VerboseStringPrint(
+					"Received IPv6 packet filtered");
+				return EDPAT_TRUE;
+			}
+			break;
+		case 0x0800:	// IPv4
+			if (24 > pktLen)
+			{
+				break;
+			}
+			if ((0x02 == pkt[23]) && (rules & FILTER_IGMP))
+			{
+				VerboseStringPrint(
+				    "Received IGMP packet filtered");
+				return EDPAT_TRUE;
+			}
+			udpOffset = 14 + ((pkt[14] & 0x0f) * 4);
+			if ((0x11 != pkt[23]) || ((udpOffset + 4) > pktLen))
+			{
+				break;
+			}
+			port[0] = ((pkt[udpOffset] << 8) | pkt[udpOffset+1]);
+			port[1] = ((pkt[udpOffset+2] << 8) | pkt[udpOffset+3]);
+			for (i=0; i < 2; i++)
+			{
+				for (j=0; NULL != FilterUdpPorts[j].name; j++)
+				{
+					if ((port[i] == FilterUdpPorts[j].port)&&
+					    (rules & FilterUdpPorts[j].rule))
+					{
+						VerboseStringPrint(
+						  "Received %s packet filtered",
+						  FilterUdpPorts[j].name);
+						return EDPAT_TRUE;
+					}
+				}
+			}
+			break;
+	}
+	return EDPAT_FALSE;
+}
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#ifndef __FILTER_H__
+#define __FILTER_H__ 1
+
+#include <linux/filter.h>
+
+// Noise packets that can be filtered out before they reach the test
+#define FILTER_ARP		0x0001
+#define FILTER_LLDP		0x0002
+#define FILTER_IGMP		0x0004
+#define FILTER_DHCP		0x0008
+#define FILTER_SSDP		0x0010
+#define FILTER_MDNS		0x0020
+#define FILTER_IPV6		0x0040
+#define FILTER_ALL		0x007f
+#define FILTER_NONE		0x0000
+
+#define MAX_FILTER_PROG_LEN	64	// instructions in a BPF program
+#define MAX_FILTER_STR_LEN	64
+
+EDPAT_RETVAL FilterRulesParse(const char *ruleStr, unsigned int *rules);
+const char *FilterRulesString(const unsigned int rules);
+int FilterProgramBuild(const unsigned int rules, const unsigned char *macAddr,
+			struct sock_filter *prog);
+EDPAT_BOOL FilterPacketCheck(const unsigned int rules,
+			const unsigned char *macAddr,
+			const unsigned char *pkt, const int pktLen);
+
+#endif
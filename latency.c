@@ -0,0 +1,613 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "edpat.h"
+#include "print.h"
+#include "utils.h"
+#include "latency.h"
+
+typedef struct {
+	double		percentile;	// LATENCY_BUDGET_MAX for max
+	long long	budgetNs;
+} LATENCY_BUDGET;
+
+/* Latencies of the packets received on a port, for the whole run and
+   for the current test case, and the budgets the test case set for
+   the port */
+typedef struct {
+	char		portName[MAX_ETH_PORT_NAME_LEN+1];
+	HDR_HISTOGRAM	run;
+	HDR_HISTOGRAM	testCase;
+	LATENCY_BUDGET	budget[MAX_LATENCY_BUDGET_COUNT];
+	int		budgetCount;
+} LATENCY_PORT;
+
+/* Time a packet sent left. Packets are numbered from 1 in the order of
+   the sends, and the packets of a send in the order they were built */
+typedef struct {
+	unsigned long	seq;		// 0 if none was sent
+	struct timespec	txTime;
+	EDPAT_BOOL	matched;	// with a packet received
+} LATENCY_TX;
+
+static LATENCY_PORT LatencyPort[MAX_ETH_PORT_COUNT];
+static int LatencyPortCount = 0;
+
+/* The send times of the last LATENCY_TX_FIFO_LEN packets sent, packet
+   'seq' in LatencyTx[seq % LATENCY_TX_FIFO_LEN]. The packets received
+   are matched with them in the order they left, see LatencyTxTimeGet() */
+static LATENCY_TX LatencyTx[LATENCY_TX_FIFO_LEN];
+static unsigned long LatencyTxBase = 1;	// first packet of the send
+static volatile unsigned long LatencyTxEnd = 1;	// after the last one sent
+static unsigned long LatencyTxNext = 1;	// matched with the next received
+static unsigned long LatencyTxFirst = 1; // first of the test case
+
+
+/***********************
+ *   hdrCountsIndex()
+ *
+ *   Get the index of the counter a value is counted in. Values below
+ *   HDR_SUB_BUCKET_COUNT have a counter each, above it every doubling
+ *   of the value doubles the range of values a counter covers.
+ *
+ *   Arguments :
+ *	value	- INPUT. value, 0 to HDR_MAX_VALUE.
+ *
+ *   Return:	- index into the counts of the histogram
+ *
+ ********/
+static int hdrCountsIndex(const long long value)
+{
+	int bucket;
+	int subBucket;
+
+	// position of the highest bit above the sub bucket bits
+	bucket = 64 - __builtin_clzll((unsigned long long) value |
+			(HDR_SUB_BUCKET_COUNT - 1)) - HDR_SUB_BUCKET_BITS;
+	subBucket = (int) (value >> bucket);
+	return ((bucket + 1) << HDR_SUB_BUCKET_HALF_BITS) +
+		(subBucket - HDR_SUB_BUCKET_HALF_COUNT);
+}
+
+
+/***********************
+ *   hdrHighestValue()
+ *
+ *   Get the highest value counted by a counter of the histogram.
+ *
+ *   Arguments :
+ *	idx	- INPUT. index into the counts of the histogram.
+ *
+ *   Return:	- the value
+ *
+ ********/
+static long long hdrHighestValue(const int idx)
+{
+	int bucket = (idx >> HDR_SUB_BUCKET_HALF_BITS) - 1;
+	long long subBucket = (idx & (HDR_SUB_BUCKET_HALF_COUNT - 1)) +
+				HDR_SUB_BUCKET_HALF_COUNT;
+
+	if (0 > bucket)
+	{
+		subBucket -= HDR_SUB_BUCKET_HALF_COUNT;
+		bucket = 0;
+	}
+	return (subBucket << bucket) + (1LL << bucket) - 1;
+}
+
+
+/***********************
+ *   HdrHistogramReset()
+ *
+ *   Empty a histogram.
+ *
+ *   Arguments :
+ *	h	- OUTPUT. the histogram.
+ *
+ *   Return:	- None
+ *
+ ********/
+void HdrHistogramReset(HDR_HISTOGRAM *h)
+{
+	memset(h,0,sizeof(*h));
+	return;
+}
+
+
+/***********************
+ *   HdrHistogramRecord()
+ *
+ *   Count a value in a histogram. Negative values are counted as 0 and
+ *   values above HDR_MAX_VALUE as HDR_MAX_VALUE.
+ *
+ *   Arguments :
+ *	h	- INPUT/OUTPUT. the histogram.
+ *	value	- INPUT. value to be counted.
+ *
+ *   Return:	- None
+ *
+ ********/
+void HdrHistogramRecord(HDR_HISTOGRAM *h, long long value)
+{
+	if (0 > value)
+	{
+		value = 0;
+	}
+	if (HDR_MAX_VALUE < value)
+	{
+		value = HDR_MAX_VALUE;
+	}
+	h->counts[hdrCountsIndex(value)]++;
+	if ((0 == h->totalCount) || (value < h->minValue))
+	{
+		h->minValue = value;
+	}
+	if (value > h->maxValue)
+	{
+		h->maxValue = value;
+	}
+	h->totalCount++;
+	h->sum += value;
+	return;
+}
+
+
+/***********************
+ *   HdrHistogramPercentile()
+ *
+ *   Get the value below which a percentage of the counted values are.
+ *   As the counters hold a range of values, the highest value of the
+ *   range is taken, so the result is never below the real one.
+ *
+ *   Arguments :
+ *	h		- INPUT. the histogram.
+ *	percentile	- INPUT. 0 to 100.
+ *
+ *   Return:	- the value, 0 if the histogram is empty
+ *
+ ********/
+long long HdrHistogramPercentile(const HDR_HISTOGRAM *h,
+			const double percentile)
+{
+	unsigned long target;
+	unsigned long count = 0;
+	long long value;
+	int i;
+
+	if (0 == h->totalCount)
+	{
+		return 0;
+	}
+	target = (unsigned long) ((percentile / 100.0) * h->totalCount + 0.5);
+	if (0 == target)
+	{
+		target = 1;
+	}
+	for (i=0; i < HDR_COUNTS_LEN; i++)
+	{
+		count += h->counts[i];
+		if (count >= target)
+		{
+			value = hdrHighestValue(i);
+			return (value < h->maxValue) ? value : h->maxValue;
+		}
+	}
+	return h->maxValue;
+}
+
+
+/***********************
+ *   latencyPortGet()
+ *
+ *   Find the latencies of a port, adding the port if it has none yet.
+ *
+ *   Arguments :
+ *	portName	- INPUT. Name of the port.
+ *
+ *   Return:	- pointer to the latencies of the port or NULL if there
+ *		  are too many ports
+ *
+ ********/
+static LATENCY_PORT *latencyPortGet(const char *portName)
+{
+	LATENCY_PORT *lp;
+	int i;
+
+	for (i=0; i < LatencyPortCount; i++)
+	{
+		if (0 == strcmp(LatencyPort[i].portName, portName))
+		{
+			return &LatencyPort[i];
+		}
+	}
+	if (MAX_ETH_PORT_COUNT <= LatencyPortCount)
+	{
+		ExecErrorMsgPrint("Too many ports to measure latency of '%s'",
+			portName);
+		return NULL;
+	}
+	lp = &LatencyPort[LatencyPortCount++];
+	strncpy(lp->portName, portName, MAX_ETH_PORT_NAME_LEN);
+	lp->portName[MAX_ETH_PORT_NAME_LEN] = 0;
+	HdrHistogramReset(&lp->run);
+	HdrHistogramReset(&lp->testCase);
+	lp->budgetCount = 0;
+	return lp;
+}
+
+
+/***********************
+ *   LatencyRecord()
+ *
+ *   Count the latency of a packet received on a port, for the port and
+ *   for the current test case.
+ *
+ *   Arguments :
+ *	portName	- INPUT. Name of the port the packet arrived on.
+ *	latencyNs	- INPUT. time since the packet it answers was sent.
+ *
+ *   Return:	- None
+ *
+ ********/
+void LatencyRecord(const char *portName, const long long latencyNs)
+{
+	LATENCY_PORT *lp = latencyPortGet(portName);
+
+	if (NULL == lp)
+	{
+		return;
+	}
+	HdrHistogramRecord(&lp->run, latencyNs);
+	HdrHistogramRecord(&lp->testCase, latencyNs);
+	return;
+}
+
+
+/***********************
+ *   LatencyBudgetAdd()
+ *
+ *   Set a latency budget of a port for the current test case. It is
+ *   checked against the latencies of the port in the test case when the
+ *   test case ends. A budget of the same percentile replaces the earlier
+ *   one.
+ *
+ *   Arguments :
+ *	portName	- INPUT. Name of the port.
+ *	percentile	- INPUT. percentile of the latencies to be within the
+ *			  budget, LATENCY_BUDGET_MAX for all of them.
+ *	budgetNs	- INPUT. the budget.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED
+ *
+ ********/
+EDPAT_RETVAL LatencyBudgetAdd(const char *portName, const double percentile,
+			const long long budgetNs)
+{
+	LATENCY_PORT *lp = latencyPortGet(portName);
+	int i;
+
+	if (NULL == lp)
+	{
+		return EDPAT_FAILED;
+	}
+	for (i=0; i < lp->budgetCount; i++)
+	{
+		if (percentile == lp->budget[i].percentile)
+		{
+			break;
+		}
+	}
+	if (MAX_LATENCY_BUDGET_COUNT <= i)
+	{
+		ScriptErrorMsgPrint("Too many latency budgets for '%s'. "
+			"Maximum is %d", portName, MAX_LATENCY_BUDGET_COUNT);
+		return EDPAT_FAILED;
+	}
+	lp->budget[i].percentile = percentile;
+	lp->budget[i].budgetNs = budgetNs;
+	if (i == lp->budgetCount)
+	{
+		lp->budgetCount++;
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   LatencyBudgetCheck()
+ *
+ *   Check the latencies of every port in the current test case against
+ *   the budgets the test case set. The test case fails if one is over
+ *   budget, or if no latency was measured for a budget.
+ *
+ *   Arguments : None, but sets CurrentTestResult
+ *
+ *   Return:	- None
+ *
+ ********/
+void LatencyBudgetCheck(void)
+{
+	LATENCY_PORT *lp;
+	LATENCY_BUDGET *b;
+	long long value;
+	int i, j;
+
+	for (i=0; i < LatencyPortCount; i++)
+	{
+		lp = &LatencyPort[i];
+		for (j=0; j < lp->budgetCount; j++)
+		{
+			b = &lp->budget[j];
+			if (0 == lp->testCase.totalCount)
+			{
+				CurrentTestResult = EDPAT_TEST_RESULT_FAILED;
+				TestCaseStringPrint("No latency measured at "
+					"'%s' for the p%g budget of %.3f us",
+					lp->portName, b->percentile,
+					b->budgetNs / 1000.0);
+				continue;
+			}
+			value = HdrHistogramPercentile(&lp->testCase,
+					b->percentile);
+			if (value > b->budgetNs)
+			{
+				CurrentTestResult = EDPAT_TEST_RESULT_FAILED;
+				TestCaseStringPrint("Latency at '%s' over "
+					"budget. p%g=%.3f us, budget=%.3f us",
+					lp->portName, b->percentile,
+					value / 1000.0, b->budgetNs / 1000.0);
+			}
+		}
+	}
+	return;
+}
+
+
+/***********************
+ *   LatencyTxTimeSet()
+ *
+ *   Keep the time a packet of the current send left, to measure the
+ *   latency of the packet received for it. The transmit workers of a
+ *   send call it at the same time, each for packets of its own.
+ *
+ *   Arguments :
+ *	k	- INPUT. number of the packet in the send, from 0.
+ *	txTime	- INPUT. time it left.
+ *
+ *   Return:	- None
+ *
+ ********/
+void LatencyTxTimeSet(const unsigned long k, const struct timespec *txTime)
+{
+	unsigned long seq = LatencyTxBase + k;
+	LATENCY_TX *tx = &LatencyTx[seq % LATENCY_TX_FIFO_LEN];
+	unsigned long end;
+
+	tx->txTime = *txTime;
+	tx->matched = EDPAT_FALSE;
+	tx->seq = seq;
+	// workers that send later packets may have moved it on already
+	do
+	{
+		end = LatencyTxEnd;
+	} while ((seq >= end) &&
+		 (!__sync_bool_compare_and_swap(&LatencyTxEnd, end, seq + 1)));
+	return;
+}
+
+
+/***********************
+ *   LatencyTxSendEnd()
+ *
+ *   End the current send, the packets of the next one are numbered
+ *   after the last packet it sent.
+ *
+ *   Arguments : None
+ *
+ *   Return:	- None
+ *
+ ********/
+void LatencyTxSendEnd(void)
+{
+	LatencyTxBase = LatencyTxEnd;
+	return;
+}
+
+
+/***********************
+ *   LatencyTxTimeGet()
+ *
+ *   Get the time the packet a received packet answers left. That is
+ *   the packet that left first of the packets sent in the test case not
+ *   matched yet, and that left before the packet was received. The
+ *   transmit workers of a send do not send in order, so it is looked
+ *   for in the next LATENCY_TX_MATCH_WINDOW packets. When every packet
+ *   sent is matched, it is the last one sent.
+ *
+ *   Arguments :
+ *	rxTime	- INPUT. time the packet was received.
+ *	txTime	- OUTPUT. time the packet it answers left.
+ *
+ *   Return:	- EDPAT_SUCCESS, EDPAT_NOTFOUND if no packet was sent
+ *		  before it in the test case or EDPAT_FAILED if it is not
+ *		  known, as more than LATENCY_TX_FIFO_LEN packets were
+ *		  sent after the one it answers, or it answers one that
+ *		  is matched already
+ *
+ ********/
+EDPAT_RETVAL LatencyTxTimeGet(const struct timespec *rxTime,
+			struct timespec *txTime)
+{
+	LATENCY_TX *tx;
+	LATENCY_TX *found = NULL;
+	unsigned long seq, end;
+
+	if (LatencyTxFirst == LatencyTxEnd)
+	{
+		return EDPAT_NOTFOUND;
+	}
+	if (LATENCY_TX_FIFO_LEN < (LatencyTxEnd - LatencyTxNext))
+	{
+		LatencyTxNext++;
+		return EDPAT_FAILED;
+	}
+
+	end = LatencyTxNext + LATENCY_TX_MATCH_WINDOW;
+	if (end > LatencyTxEnd)
+	{
+		end = LatencyTxEnd;
+	}
+	for (seq=LatencyTxNext; seq < end; seq++)
+	{
+		tx = &LatencyTx[seq % LATENCY_TX_FIFO_LEN];
+		if ((seq != tx->seq) || (EDPAT_TRUE == tx->matched) ||
+		    (0 > TimespecDiffNs(&tx->txTime, rxTime)))
+		{
+			continue;
+		}
+		if ((NULL == found) ||
+		    (0 > TimespecDiffNs(&found->txTime, &tx->txTime)))
+		{
+			found = tx;
+		}
+	}
+
+	if (NULL != found)
+	{
+		found->matched = EDPAT_TRUE;
+		*txTime = found->txTime;
+		// Skip the packets matched and the ones never sent
+		while (LatencyTxNext < LatencyTxEnd)
+		{
+			tx = &LatencyTx[LatencyTxNext % LATENCY_TX_FIFO_LEN];
+			if ((LatencyTxNext == tx->seq) &&
+			    (EDPAT_TRUE != tx->matched))
+			{
+				break;
+			}
+			LatencyTxNext++;
+		}
+		return EDPAT_SUCCESS;
+	}
+	if (LatencyTxNext < LatencyTxEnd)
+	{
+		// The packets not matched left after it was received
+		return (LatencyTxFirst == LatencyTxNext) ?
+			EDPAT_NOTFOUND : EDPAT_FAILED;
+	}
+
+	tx = &LatencyTx[(LatencyTxEnd - 1) % LATENCY_TX_FIFO_LEN];
+	if (((LatencyTxEnd - 1) != tx->seq) ||
+	    (0 > TimespecDiffNs(&tx->txTime, rxTime)))
+	{
+		return EDPAT_FAILED;
+	}
+	*txTime = tx->txTime;
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   latencyHistogramPrint()
+ *
+ *   Print the summary of a histogram to the report, in lines short
+ *   enough not to be wrapped.
+ *
+ *   Arguments :
+ *	testCaseId - INPUT. test case of the latencies, NULL for the run.
+ *	portName - INPUT. port the latencies are of.
+ *	h	- INPUT. the histogram.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void latencyHistogramPrint(const char *testCaseId,
+			const char *portName, const HDR_HISTOGRAM *h)
+{
+	TestCaseReportPrint("%s%s at '%s': count=%lu",
+		(NULL == testCaseId) ? "" : testCaseId,
+		(NULL == testCaseId) ? "Latency" : "\tlatency", portName,
+		h->totalCount);
+	TestCaseReportPrint("\tmin=%.3f mean=%.3f max=%.3f us",
+		h->minValue / 1000.0,
+		((double) h->sum / h->totalCount) / 1000.0,
+		h->maxValue / 1000.0);
+	TestCaseReportPrint("\tp50=%.3f p90=%.3f p99=%.3f p99.9=%.3f us",
+		HdrHistogramPercentile(h, 50.0) / 1000.0,
+		HdrHistogramPercentile(h, 90.0) / 1000.0,
+		HdrHistogramPercentile(h, 99.0) / 1000.0,
+		HdrHistogramPercentile(h, 99.9) / 1000.0);
+	return;
+}
+
+
+/***********************
+ *   LatencyTestCaseReportPrint()
+ *
+ *   Print the latencies of every port in the current test case to the
+ *   report, then clear them, the budgets and the packets sent for the
+ *   next test case.
+ *
+ *   Arguments : None, but uses CurrentTestCaseId
+ *
+ *   Return:	- None
+ *
+ ********/
+void LatencyTestCaseReportPrint(void)
+{
+	LATENCY_PORT *lp;
+	int i;
+
+	for (i=0; i < LatencyPortCount; i++)
+	{
+		lp = &LatencyPort[i];
+		if (0 != lp->testCase.totalCount)
+		{
+			latencyHistogramPrint(CurrentTestCaseId, lp->portName,
+				&lp->testCase);
+		}
+		HdrHistogramReset(&lp->testCase);
+		lp->budgetCount = 0;
+	}
+	LatencyTxBase = LatencyTxEnd;
+	LatencyTxNext = LatencyTxEnd;
+	LatencyTxFirst = LatencyTxEnd;
+	return;
+}
+
+
+/***********************
+ *   LatencyPortReportPrint()
+ *
+ *   Print the latencies of every port over all the test cases to the
+ *   report.
+ *
+ *   Arguments : None
+ *
+ *   Return:	- None
+ *
+ ********/
+void LatencyPortReportPrint(void)
+{
+	int i;
+
+	for (i=0; i < LatencyPortCount; i++)
+	{
+		if (0 != LatencyPort[i].run.totalCount)
+		{
+			latencyHistogramPrint(NULL, LatencyPort[i].portName,
+				&LatencyPort[i].run);
+		}
+	}
+	return;
+}
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__ 1
+
+#include <time.h>
+
+/* HDR histogram of latencies in ns. Every power of 2 range of values is
+   split into HDR_SUB_BUCKET_HALF_COUNT linear sub buckets, which keeps
+   2 significant digits of any value up to HDR_MAX_VALUE */
+#define HDR_SUB_BUCKET_BITS	8
+#define HDR_SUB_BUCKET_COUNT	(1 << HDR_SUB_BUCKET_BITS)
+#define HDR_SUB_BUCKET_HALF_BITS	(HDR_SUB_BUCKET_BITS - 1)
+#define HDR_SUB_BUCKET_HALF_COUNT	(1 << HDR_SUB_BUCKET_HALF_BITS)
+#define HDR_BUCKET_COUNT	29	// covers HDR_MAX_VALUE
+#define HDR_COUNTS_LEN		((HDR_BUCKET_COUNT + 1) * \
+					HDR_SUB_BUCKET_HALF_COUNT)
+#define HDR_MAX_VALUE		60000000000LL	// 60 s, larger ones clamped
+
+#define MAX_LATENCY_BUDGET_COUNT	4	// budgets per port and test case
+#define LATENCY_BUDGET_MAX	100.0	// percentile of a max budget
+#define LATENCY_TX_FIFO_LEN	65536	// send times kept, a power of 2
+#define LATENCY_TX_MATCH_WINDOW	1024	// sent packets a received one
+						// is matched among
+
+typedef struct {
+	unsigned long	counts[HDR_COUNTS_LEN];
+	unsigned long	totalCount;
+	long long	minValue;
+	long long	maxValue;
+	long long	sum;
+} HDR_HISTOGRAM;
+
+void HdrHistogramReset(HDR_HISTOGRAM *h);
+void HdrHistogramRecord(HDR_HISTOGRAM *h, long long value);
+long long HdrHistogramPercentile(const HDR_HISTOGRAM *h,
+			const double percentile);
+
+void LatencyRecord(const char *portName, const long long latencyNs);
+EDPAT_RETVAL LatencyBudgetAdd(const char *portName, const double percentile,
+			const long long budgetNs);
+void LatencyBudgetCheck(void);
+void LatencyTxTimeSet(const unsigned long k, const struct timespec *txTime);
+void LatencyTxSendEnd(void);
+EDPAT_RETVAL LatencyTxTimeGet(const struct timespec *rxTime,
+			struct timespec *txTime);
+void LatencyTestCaseReportPrint(void);
+void LatencyPortReportPrint(void);
+
+#endif
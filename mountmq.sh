@@ -1,5 +0,0 @@
-#mkdir /dev/mqueue
-#mount -t mqueue none /dev/mqueue
-
-mkdir ./mqueue
-mount -t mqueue none ./mqueue
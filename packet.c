@@ -13,11 +13,24 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #include "edpat.h"
 #include "scripts.h"
+#include "variable.h"
+#include "packet.h"
 #include "print.h"
+#include "utils.h"
+#include "latency.h"
+#include "seqtag.h"
+#include "fieldmod.h"
 #include "EthPortIO.h"
+#include "benchmark.h"
 
 
 /* packets to be send or expected to be receved are specifed in hex
@@ -38,32 +51,173 @@
 	  of previously received packet. Hence zero will be stored in
 	  SpecifiedPkt[i] and K is stored in SpecifiedPktMask[i].
 	  '?' is not valid while specifing expected packet.
+	- the bytes of a field modifier, see below, are MASK_FIELD.
+	- in a receive specification only some bits of a byte can be
+	  compared, the high nibble with '4?', the low nibble with '?4'
+	  or the bits of a mask with '45/f0'. The value is stored in
+	  SpecifiedPkt[i], MASK_BITS in SpecifiedPktMask[i] and the mask
+	  in ReadPktBits[i].
+   A receive specification can also have latency budgets, '~max=<us>'
+   for the packet and '~p<n>=<us>' for the n-th percentile of all the
+   packets received on the port in the test case. They are kept in
+   LatencyBudget[] and do not take a byte of the packet.
+   A send specification can have '~pps=<rate>' or '~bps=<rate>' along
+   with '~count=<n>' and/or '~duration=<ms>' to send the packet again
+   and again at that rate, and '~txtime' to let the qdisc pace it. They
+   are kept in Pace. 'x<n>' sends the packet n times, built once and
+   handed to the kernel SEND_REPEAT_BATCH packets at a time. With
+   more than one transmit worker (-T) it is a stream send instead,
+   spread over the workers like a paced send.
+	- a field modifier '{<op>,...}' in a send specification is a field
+	  that changes from one packet to the next, see FieldModParse().
+	  The value of the first packet is stored in SpecifiedPkt[] as a
+	  hex value would be. The next packets are made from the previous
+	  one by packetNext(). '{seq,<stream>}' is a modifier too, the
+	  sequence tag of a stream, see SeqTagWrite().
+   '~search' in a send specification makes it the frame of a zero loss
+   throughput search instead of sending it, with '~pps=' or '~bps=' as
+   the highest rate tried, '~duration=<ms>' or '~count=<n>' as the
+   length of a trial and '~sizes=<n>,...' as the frame sizes. The next
+   packet statement has to be the receive specification of the frame
+   expected, which runs the search, see packetSearch().
+   A statement is read once, when the script is compiled, by
+   PacketCompile() into a PACKET_STATEMENT. PacketExecute() points
+   SpecifiedPkt and the rest of it at its parts and loads the others
+   into the variables below each time it runs. A send packet is
+   compiled into the packet, with the checksums covering no byte that
+   changes from one send to the next computed, and SpecifiedPatch[],
+   the runs of bytes copied from the last packet received and the
+   other checksums. packetBuild() copies the packet and makes the
+   patches. A packet without patches or field modifiers is the packet
+   sent. The mask of a receive packet is compiled into
+   SpecifiedPktBits, the bits
+   compared of each byte, with the bits not compared cleared in the
+   packet, so a packet received is compared by packetMismatchFind() a
+   vector at a time.
 */
 
 
 typedef enum { OP_UNKNOWN, OP_SEND, OP_RECEIVE } OPERATION;
 
+// bytes a token can add to the packet, a sequence tag is the widest
+#define PKT_READ_SLACK		SEQ_TAG_LEN
+// hex bytes packetHexBlockDecode() takes, each 2 digits and a space
+#define PKT_HEX_BLOCK_LEN	16
+// vectors packetOnesSum() adds in 32 bit lanes before emptying them
+#define PKT_SUM_BLOCK_COUNT	8192
+
 static OPERATION Operation = OP_UNKNOWN;
 static char EthPortName[MAX_ETH_PORT_NAME_LEN+1];
 static int	BytesInSpecifiedPkt;
 static int	BytesInRecvPkt;
 static int 	cs_array_siz;
 static unsigned char RecvPkt[MAX_PKT_SIZE];
-static unsigned char SpecifiedPkt[MAX_PKT_SIZE];
-
+// read by packetRead(), with room for the last field past MAX_PKT_SIZE
+static unsigned char ReadPkt[MAX_PKT_SIZE+PKT_READ_SLACK];
+static const unsigned char *SpecifiedPkt = ReadPkt;
+static EDPAT_BOOL SpecifiedPktBuilt;	// SpecifiedPkt is the packet sent
+static struct timespec RecvTime;	// when RecvPkt arrived
+typedef struct {
+	double		percentile;	// LATENCY_BUDGET_MAX for '~max'
+	long long	budgetNs;
+} PKT_LATENCY_BUDGET;
+static PKT_LATENCY_BUDGET LatencyBudget[MAX_LATENCY_BUDGET_COUNT];
+static int	LatencyBudgetCount;
+static ETH_PORT_PACE Pace;	// rate of the send, pps and bps 0 if none
+static unsigned long RepeatCount;	// times the packet is sent
+static EDPAT_BOOL SearchRequested;	// '~search' in the send statement
+static int	SearchSizes[MAX_BENCHMARK_SIZE_COUNT];	// from '~sizes='
+static int	SearchSizeCount;
+
+
+typedef enum {
+	CS_KIND_RANGE,		// '&<start>-<end>', bytes start to end
+	CS_KIND_IP,		// '&ip', the IPv4 header
+	CS_KIND_L4		// '&l4', TCP, UDP or ICMP and pseudo header
+} CS_KIND;
 
 struct check_sum_mask	{
 	unsigned int pos;
 	unsigned int start;
 	unsigned int end;
+	CS_KIND kind;
 };
 
 struct check_sum_mask cs_arr[MAX_CS_SIZE];
-signed short SpecifiedPktMask[MAX_PKT_SIZE];
+static signed short ReadPktMask[MAX_PKT_SIZE+PKT_READ_SLACK];
+// bits compared of the bytes of ReadPktMask[] that are MASK_BITS
+static unsigned char ReadPktBits[MAX_PKT_SIZE+PKT_READ_SLACK];
+// bits compared of a packet received, NULL if every byte is compared
+static const unsigned char *SpecifiedPktBits = NULL;
 
 #define	MASK_EXACT	(-1)
 #define	MASK_SKIP	(-2)
 #define MASK_CS  	(-3)
+#define MASK_BITS	(-4)
+#define MASK_FIELD	(-5)
+
+/* A change made to the packet of a send statement each time it is
+   sent, the bytes copied are made first, then the checksums in the
+   order of cs_arr[] */
+typedef enum { PKT_PATCH_COPY, PKT_PATCH_CS } PKT_PATCH_OP;
+typedef struct {
+	PKT_PATCH_OP	op;
+	int		pos;		// first byte written
+	int		from;		// byte copied first, cs_arr[] index
+	int		len;		// bytes copied
+} PKT_PATCH;
+static const PKT_PATCH *SpecifiedPatch = NULL;
+static int	SpecifiedPatchCount;
+
+/* A packet statement compiled. Its field modifiers, mask and packet
+   follow the structure, at offsets from its start, so a statement can
+   be copied or mapped from a file as it is */
+struct packetStatement {
+	size_t		size;		// with the parts following it
+	OPERATION	operation;
+	char		portName[MAX_ETH_PORT_NAME_LEN+1];
+	int		len;
+	EDPAT_BOOL	built;		// the packet is the packet sent
+	int		fieldModOffset;	// 0 if there are no field modifiers
+	int		maskOffset;	// bits compared if received, 0 if
+					// every byte is MASK_EXACT or sent
+	int		patchOffset;	// patches of a packet sent
+	int		patchCount;
+	int		pktOffset;
+	struct check_sum_mask cs[MAX_CS_SIZE];
+	int		csCount;
+	PKT_LATENCY_BUDGET latencyBudget[MAX_LATENCY_BUDGET_COUNT];
+	int		latencyBudgetCount;
+	ETH_PORT_PACE	pace;
+	unsigned long	repeatCount;
+	EDPAT_BOOL	search;
+	int		searchSizes[MAX_BENCHMARK_SIZE_COUNT];
+	int		searchSizeCount;
+};
+#define PACKET_STATEMENT_PART(ps,offset)	\
+			((const void *) ((const char *) (ps) + (offset)))
+
+/* The send statement of a throughput search, waiting for the receive
+   statement of the frame expected */
+static struct {
+	EDPAT_BOOL	pending;
+	char		portName[MAX_ETH_PORT_NAME_LEN+1];
+	unsigned char	pkt[MAX_PKT_SIZE];
+	int		pktLen;
+	struct check_sum_mask cs[MAX_CS_SIZE];
+	int		csCount;
+	ETH_PORT_PACE	pace;
+	int		sizes[MAX_BENCHMARK_SIZE_COUNT];
+	int		sizeCount;
+} Search;
+// Frame expected by the trials of a search, for the frame size tried
+static unsigned char SearchExpectedPkt[MAX_PKT_SIZE];
+static unsigned char SearchExpectedBits[MAX_PKT_SIZE];
+static int	SearchExpectedLen;
+// RFC 2544 frame sizes of Ethernet, with the FCS
+static const int SearchDefaultSizes[] = {
+	64, 128, 256, 512, 1024, 1280, 1518
+};
 
 
 /******************
@@ -73,7 +227,10 @@ signed short SpecifiedPktMask[MAX_PKT_SIZE];
  *	
  *	After the testcase has passed check if there are any other
  *	unexpected packets left in the queue
- *	It uses receive any to read any packets left in the queue
+ *	It uses receive any to read any packets left in the queue. Each
+ *	read waits up to PacketSettleTime ms for late packets, so the check
+ *	ends once all the ports were quiet for that long. A throughput
+ *	search without the receive statement of its frame fails too.
  *	
  *	Arguments	:	void, also sets the CurrentTestResult to
  *				appropriate value
@@ -85,19 +242,31 @@ void CheckUnexpectedPackets(void)
 {
 	EDPAT_RETVAL retVal = EDPAT_SUCCESS;
 	char portName[MAX_ETH_PORT_NAME_LEN+1];
+	char timeStr[MAX_TIMESPEC_STR_LEN];
 	unsigned char pkt[MAX_PKT_SIZE];
+	struct timespec rxTime;
 	int pktLen = MAX_PKT_SIZE;
 
+	if (EDPAT_TRUE == Search.pending)
+	{
+		Search.pending = EDPAT_FALSE;
+		CurrentTestResult = EDPAT_TEST_RESULT_FAILED;
+		ScriptErrorMsgPrint("Throughput search to '%s' has no "
+			"receive statement of the frame expected",
+			Search.portName);
+	}
 	while(EDPAT_SUCCESS == retVal)
 	{
 		pktLen = MAX_PKT_SIZE;
-		retVal = EthPortReceiveAny(portName, pkt, &pktLen);
+		retVal = EthPortReceiveAny(portName, pkt, &pktLen,
+				PacketSettleTime, &rxTime);
 		if (EDPAT_SUCCESS == retVal)
 		{
 			CurrentTestResult = EDPAT_TEST_RESULT_FAILED;
 			TestCaseStringPrint(
 				"Unexpected message of len %d received "
-				"from  '%s'", pktLen,portName);
+				"from  '%s' at %s", pktLen,portName,
+				TimespecFormat(&rxTime,timeStr));
 			TestCasePacketHeaderPrint(pkt);
 			TestCasePacketPrint(pkt, pktLen);
 		}
@@ -107,216 +276,271 @@ void CheckUnexpectedPackets(void)
 
 /*********************
  *
- *	packetRead
+ *	latencyBudgetRead
  *
- *	Parse the details from the test statement, set Operation ethport
- *	and process special characters
+ *	Parse a latency budget of a receive statement, '~max=<us>' or
+ *	'~p<n>=<us>', and add it to LatencyBudget[]
  *
- *	Arguments	:	in -	Test statement under consideration 
+ *	Arguments	:	token -	the budget in the statement
  *
  *	Return 		:	EDPAT_RETVAL
  *
  *
  * ********************/
 
-static EDPAT_RETVAL packetRead(char *in)
+static EDPAT_RETVAL latencyBudgetRead(const char *token)
 {
-	static char statement[MAX_SCRIPT_STATEMENT_LEN+1];
-	char *token, *q;
-	int i;
-	EDPAT_RETVAL retVal;
-	unsigned char byte;
+	const char *p = &token[1];
+	double percentile;
+	double budgetUs;
+	char *q;
 
-	switch(in[0])
+	if (0 == strncmp(p,"max=",4))
 	{
-		case '<':
-			Operation = OP_RECEIVE;
-			break;
-		case '>':
-			Operation = OP_SEND;
-			break;
-		default:
-			ScriptErrorMsgPrint("Unexpected character '%c(%d)'",
-				in[0],in[0]);
+		percentile = LATENCY_BUDGET_MAX;
+		p += 4;
+	}
+	else
+	{
+		percentile = ('p' == p[0]) ? strtod(&p[1],&q) : 0;
+		if (('p' != p[0]) || (&p[1] == q) || ('=' != q[0]) ||
+		    (0 >= percentile) || (100 < percentile))
+		{
+			ScriptErrorMsgPrint("Invalid latency budget '%s'. "
+				"Expecting ~max=<us> or ~p<n>=<us>",token);
 			return EDPAT_FAILED;
-		
+		}
+		p = &q[1];
 	}
-
-	// Skip the     1st character Which will be operation
-	strncpy(statement,&in[1],MAX_SCRIPT_STATEMENT_LEN-1);
-	statement[MAX_SCRIPT_STATEMENT_LEN] = 0;
-	//Copy the ethport name
-	token = strtok(statement," ");
-        if (NULL == token)
-        {
-                ScriptErrorMsgPrint("Missing Ethernet Port Name");
-                return EDPAT_FAILED;
-        };
-
-	// Validate ethernet port name
-	if (MAX_ETH_PORT_NAME_LEN <= strlen(token))
+	budgetUs = strtod(p,&q);
+	if ((p == q) || (0 != q[0]) || (0 > budgetUs))
 	{
-		ScriptErrorMsgPrint("Ethernet Port Name '%s' too long. "
-			"Need to be less than %d",
-			token, MAX_ETH_PORT_NAME_LEN);
+		ScriptErrorMsgPrint("'%s' is not a latency in microseconds",p);
 		return EDPAT_FAILED;
 	}
-
-	strncpy(EthPortName,token,MAX_ETH_PORT_NAME_LEN);
-	EthPortName[MAX_ETH_PORT_NAME_LEN]=0;
-
-	/* Open the port if not already open */
-	retVal = EthPortOpen(EthPortName);
-	if ( 0 >  retVal)
-		return EDPAT_FAILED;
-
-	strncpy(statement,&in[1],MAX_SCRIPT_STATEMENT_LEN-1);
-	statement[MAX_SCRIPT_STATEMENT_LEN-1]=0;
-	token = strtok(statement," ");
-
-	BytesInSpecifiedPkt = 0;
-	cs_array_siz = 0;
-	while ((token = strtok(NULL," ")) != NULL)
+	if (MAX_LATENCY_BUDGET_COUNT <= LatencyBudgetCount)
 	{
-		switch(token[0])
-		{	
-			case '&':	// In case checksum field 
-				if (OP_SEND == Operation){
-					char *n1,*n2;
-					n1 = token+1;
-					n2 = strchr(token,'-');
-					if (n2 == NULL)	{
-						ScriptErrorMsgPrint("Expecting Checksum format"
-								"&header_start-header_end");
-					}
-					n2[0] = 0;
-					n2++;
-					int hs = strtol(n1,&q,10);
-					if (n1 ==  q){
-						ScriptErrorMsgPrint(
-						"'%s' is not an integer value",n1);
-					}
-					int he =  strtol(n2,&q,10);
-					if (n2 == q){
-						ScriptErrorMsgPrint(
-						"'%s' is not an integer value",n2);
-					}
-					cs_arr[cs_array_siz].pos = BytesInSpecifiedPkt;
-					cs_arr[cs_array_siz].start = hs;
-					cs_arr[cs_array_siz].end = he;
-
-					cs_array_siz++;
-
-					SpecifiedPktMask[BytesInSpecifiedPkt] = MASK_CS;
-					SpecifiedPkt[BytesInSpecifiedPkt++] = 0;
-					SpecifiedPkt[BytesInSpecifiedPkt] = 0;
-					SpecifiedPktMask[BytesInSpecifiedPkt] = MASK_CS;
-
-					break;
-				}
-				VerboseStringPrint("Falling thorugh to the case '*', In receive mode we are not evaluating checksum");
-					
-
-			case '*':	// Do not compare
-				if (OP_RECEIVE != Operation)
-				{
-					ScriptErrorMsgPrint(
-					    "Invalid character '*'. It is "
-					    "valid only in receive");
-					return EDPAT_FAILED;
-				}
-				/* Set the byte as zero and mark in mask
-				   as MASK_SKIP */
-				SpecifiedPkt[BytesInSpecifiedPkt]  = 0;
-				SpecifiedPktMask[BytesInSpecifiedPkt] =
-						MASK_SKIP;
-				break;
-
+		ScriptErrorMsgPrint("Too many latency budgets. Maximum is %d",
+			MAX_LATENCY_BUDGET_COUNT);
+		return EDPAT_FAILED;
+	}
+	LatencyBudget[LatencyBudgetCount].percentile = percentile;
+	LatencyBudget[LatencyBudgetCount].budgetNs =
+			(long long) (budgetUs * 1000.0 + 0.5);
+	LatencyBudgetCount++;
+	return EDPAT_SUCCESS;
+}
 
-			case '?':	// copy from last received packet
-				if (OP_SEND != Operation)
-				{
-					ScriptErrorMsgPrint(
-					    "Invalid character '?'. It is "
-					    "valid only in send packet");
-					return EDPAT_FAILED;
-				}
-				// Copy the n value after ?
-				byte = (unsigned char )
-						strtol(&token[1],&q,10);
-				if ( token == q)
-				{
-				    ScriptErrorMsgPrint(
-					"'%s' is not a integer value",
-					token);
-				    return EDPAT_FAILED;
-				};
+/*********************
+ *
+ *	paceOptionRead
+ *
+ *	Parse an option of a paced send, '~pps=<rate>', '~bps=<rate>',
+ *	'~count=<n>', '~duration=<ms>' or '~txtime', into Pace. A rate
+ *	can have a suffix of k, M or G. '~search' and '~sizes=<n>,...'
+ *	of a throughput search are parsed here too
+ *
+ *	Arguments	:	token -	the option in the statement
+ *
+ *	Return 		:	EDPAT_RETVAL
+ *
+ *
+ * ********************/
 
-				// Check if within limits
-				if ( MAX_PKT_SIZE < BytesInSpecifiedPkt)
-				{
-				    ScriptErrorMsgPrint("Pkt too large");
-				    return EDPAT_FAILED;
-				};
+static EDPAT_RETVAL paceOptionRead(const char *token)
+{
+	const char *p = &token[1];
+	double value;
+	double *rate = NULL;
+	char *q;
 
+	if (0 == strcmp(p,"txtime"))
+	{
+		Pace.launchTime = EDPAT_TRUE;
+		return EDPAT_SUCCESS;
+	}
+	if (0 == strcmp(p,"search"))
+	{
+		SearchRequested = EDPAT_TRUE;
+		return EDPAT_SUCCESS;
+	}
+	if (0 == strncmp(p,"sizes=",6))
+	{
+		SearchSizeCount = 0;
+		for (q=(char *) &p[5]; 0 != q[0]; )
+		{
+			p = &q[1];
+			if (MAX_BENCHMARK_SIZE_COUNT <= SearchSizeCount)
+			{
+				ScriptErrorMsgPrint("Too many frame sizes in "
+					"'%s'. Maximum %d",token,
+					MAX_BENCHMARK_SIZE_COUNT);
+				return EDPAT_FAILED;
+			}
+			SearchSizes[SearchSizeCount] = (int) strtol(p,&q,10);
+			if ((p == q) || ((0 != q[0]) && (',' != q[0])) ||
+			    (BENCHMARK_MIN_FRAME_SIZE >
+					SearchSizes[SearchSizeCount]) ||
+			    (BENCHMARK_MAX_FRAME_SIZE <
+					SearchSizes[SearchSizeCount]))
+			{
+				ScriptErrorMsgPrint("Invalid frame sizes '%s'. "
+					"Expecting sizes of %d to %d bytes "
+					"separated by ','", token,
+					BENCHMARK_MIN_FRAME_SIZE,
+					BENCHMARK_MAX_FRAME_SIZE);
+				return EDPAT_FAILED;
+			}
+			SearchSizeCount++;
+		}
+		return EDPAT_SUCCESS;
+	}
+	if (0 == strncmp(p,"pps=",4))
+	{
+		rate = &Pace.pps;
+	}
+	else if (0 == strncmp(p,"bps=",4))
+	{
+		rate = &Pace.bps;
+	}
+	if (NULL != rate)
+	{
+		value = strtod(&p[4],&q);
+		switch (q[0])
+		{
+			case 'k':	value *= 1e3; q++; break;
+			case 'M':	value *= 1e6; q++; break;
+			case 'G':	value *= 1e9; q++; break;
+		}
+		if ((&p[4] == q) || (0 != q[0]) || (0 >= value))
+		{
+			ScriptErrorMsgPrint("'%s' is not a rate",&p[4]);
+			return EDPAT_FAILED;
+		}
+		Pace.pps = 0;
+		Pace.bps = 0;
+		*rate = value;
+		return EDPAT_SUCCESS;
+	}
+	if (0 == strncmp(p,"count=",6))
+	{
+		Pace.count = strtoul(&p[6],&q,10);
+		if ((&p[6] == q) || (0 != q[0]) || (0 == Pace.count))
+		{
+			ScriptErrorMsgPrint("'%s' is not a count of packets",
+				&p[6]);
+			return EDPAT_FAILED;
+		}
+		return EDPAT_SUCCESS;
+	}
+	if (0 == strncmp(p,"duration=",9))
+	{
+		Pace.durationMs = (int) strtol(&p[9],&q,10);
+		if ((&p[9] == q) || (0 != q[0]) || (0 >= Pace.durationMs))
+		{
+			ScriptErrorMsgPrint("'%s' is not a duration in "
+				"milliseconds",&p[9]);
+			return EDPAT_FAILED;
+		}
+		return EDPAT_SUCCESS;
+	}
+	ScriptErrorMsgPrint("Invalid send option '%s'. Expecting ~pps=, "
+		"~bps=, ~count=, ~duration=, ~txtime, ~search or ~sizes=",
+		token);
+	return EDPAT_FAILED;
+}
 
-				// Check for tail in the packet 
-				if ((NULL != q) && (0 != q[0]))
-				{
-					ScriptErrorMsgPrint(
-						"Invalid character "
-						"at the end of '%s'",token);
-					return EDPAT_FAILED;
-				};
+/*********************
+ *
+ *	packetOnesSum
+ *
+ *	Add up bytes of a packet as 16 bit words in network order, in
+ *	ones complement. An odd byte at the end is the high byte of a word
+ *	padded with zero. The words are added a vector at a time with
+ *	AVX2 or SSE2 where they are there, in the byte order of the CPU,
+ *	little endian, and the sum is swapped, as in RFC 1071
+ *
+ *	Arguments	:	data -	the bytes
+ *				len -	number of bytes
+ *				sum -	the sum so far, 16 bits
+ *
+ *	Return 		:	the sum, 16 bits
+ *
+ * ********************/
 
-				//Set byte and mask
-				SpecifiedPkt[BytesInSpecifiedPkt]  = 0;
-				SpecifiedPktMask[BytesInSpecifiedPkt]=byte;
-				break;
-			default:
-				//Default just copy the byte in
-				byte = (unsigned char ) strtol(token,&q,16);
-				if ( token == q)
-				{
-					ScriptErrorMsgPrint(
-						"'%s' is not a hex value",
-						token);
-					return EDPAT_FAILED;
-				};
-				if ( MAX_PKT_SIZE < BytesInSpecifiedPkt)
-				{
-				       ScriptErrorMsgPrint("Pkt too large");
-					return EDPAT_FAILED;
-				};
-				if ((NULL != q) && (0 != q[0]))
-				{
-					ScriptErrorMsgPrint(
-						"Invalid character at the "
-						"end of '%s'",token);
-					return EDPAT_FAILED;
-				};
-				SpecifiedPkt[BytesInSpecifiedPkt]  = byte;
-				SpecifiedPktMask[BytesInSpecifiedPkt] =
-						MASK_EXACT;
+static unsigned int packetOnesSum(const unsigned char *data, const int len,
+			const unsigned int sum)
+{
+	unsigned long long total = sum;
+	int i = 0;
+#ifdef __SSE2__
+	unsigned long long native = 0;
+	unsigned int lane[8];
+	__m128i acc, v;
+	int j;
+#endif
+#ifdef __AVX2__
+	__m256i acc2, w;
+#endif
+
+#ifdef __AVX2__
+	while ((len - i) >= 32)
+	{
+		acc2 = _mm256_setzero_si256();
+		for (j=0; (j < PKT_SUM_BLOCK_COUNT) && ((len - i) >= 32);
+		     j++, i += 32)
+		{
+			w = _mm256_loadu_si256((const __m256i *) &data[i]);
+			acc2 = _mm256_add_epi32(acc2, _mm256_add_epi32(
+				_mm256_unpacklo_epi16(w,
+					_mm256_setzero_si256()),
+				_mm256_unpackhi_epi16(w,
+					_mm256_setzero_si256())));
+		}
+		_mm256_storeu_si256((__m256i *) lane, acc2);
+		for (j=0; j < 8; j++)
+		{
+			native += lane[j];
 		}
-		BytesInSpecifiedPkt++;
 	}
-
-	if ( 0 >= BytesInSpecifiedPkt)
+#endif
+#ifdef __SSE2__
+	while ((len - i) >= 16)
 	{
-		ScriptErrorMsgPrint("Zero byte packet is specified");
-		return EDPAT_FAILED;
+		acc = _mm_setzero_si128();
+		for (j=0; (j < PKT_SUM_BLOCK_COUNT) && ((len - i) >= 16);
+		     j++, i += 16)
+		{
+			v = _mm_loadu_si128((const __m128i *) &data[i]);
+			acc = _mm_add_epi32(acc, _mm_add_epi32(
+				_mm_unpacklo_epi16(v, _mm_setzero_si128()),
+				_mm_unpackhi_epi16(v, _mm_setzero_si128())));
+		}
+		_mm_storeu_si128((__m128i *) lane, acc);
+		for (j=0; j < 4; j++)
+		{
+			native += lane[j];
+		}
 	}
-	
-	VerboseStringPrint("Read %d bytes from script for %s Eth Port '%s'",
-			BytesInSpecifiedPkt,
-			( (OP_RECEIVE == Operation) ?
-				"receiving from" : "sending to "),
-			EthPortName);
-	VerbosePacketPrint(SpecifiedPkt, BytesInSpecifiedPkt);
-	VerbosePacketMaskPrint(SpecifiedPktMask, BytesInSpecifiedPkt);
-
-	return EDPAT_SUCCESS;
+	while (native >> 16)
+	{
+		native = (native & 0xFFFF) + (native >> 16);
+	}
+	total += ((native & 0xFF) << 8) | (native >> 8);
+#endif
+	for (; (len - i) >= 2; i += 2)
+	{
+		total += (data[i] << 8) | data[i+1];
+	}
+	if (i < len)
+	{
+		total += data[i] << 8;
+	}
+	while (total >> 16)
+	{
+		total = (total & 0xFFFF) + (total >> 16);
+	}
+	return (unsigned int) total;
 }
 
 /**************************
@@ -324,7 +548,7 @@ static EDPAT_RETVAL packetRead(char *in)
  * 	check_sum
  *
  * 	Used to calculate the IP checksum for bytes specified.
- * 	1's complement addition of 16 bit words
+ * 	1's complement addition of 16 bit words, see packetOnesSum()
  *
  * 	Arguments	:	pkt	-	pointer to packet buffer
  * 				start	-	starting position of header
@@ -334,35 +558,1479 @@ static EDPAT_RETVAL packetRead(char *in)
  *
  ***************************/
 
-static short int check_sum(unsigned char *pkt,unsigned int start,unsigned int end)	{
-	unsigned char *addr = pkt +start;
-	if (start > end)	{
-		ScriptErrorMsgPrint("start and end of header invalid");
+static short int check_sum(unsigned char *pkt,unsigned int start,unsigned int end)	{
+	if (start > end)	{
+		ScriptErrorMsgPrint("start and end of header invalid");
+		return EDPAT_FAILED;
+	}
+	//In the case that there are odd number of bytes pad with zero byte
+	unsigned short int ret = ~packetOnesSum(&pkt[start], end - start + 1, 0);
+	VerboseStringPrint(
+		"Calculated CheckSum for bytes [%d-%d] and got :: %x",
+		start,end,ret);
+	return ret;
+}
+
+/**************************
+ *
+ * 	packetIpFind
+ *
+ * 	Find the IPv4 or IPv6 header of an Ethernet frame, after up to
+ * 	two VLAN tags
+ *
+ * 	Arguments	:	pkt	-	the frame
+ * 				len	-	its length
+ * 				version	-	4 or 6 is written here
+ *
+ * 	Return		:	position of the header, -1 if there is
+ * 				none
+ *
+ ***************************/
+
+static int packetIpFind(const unsigned char *pkt, const int len, int *version)
+{
+	unsigned int type;
+	int pos = 12;
+	int tags;
+
+	for (tags=0; (pos + 2) <= len; tags++, pos += 4)
+	{
+		type = (pkt[pos] << 8) | pkt[pos+1];
+		if ((2 <= tags) || ((0x8100 != type) && (0x88A8 != type)))
+		{
+			break;
+		}
+	}
+	pos += 2;
+	if ((pos > len) || (2 < tags))
+	{
+		return (-1);
+	}
+	if ((0x0800 == type) && ((pos + 20) <= len) && (4 == (pkt[pos] >> 4)) &&
+	    (20 <= ((pkt[pos] & 0x0F) * 4)))
+	{
+		*version = 4;
+		return pos;
+	}
+	if ((0x86DD == type) && ((pos + 40) <= len) && (6 == (pkt[pos] >> 4)))
+	{
+		*version = 6;
+		return pos;
+	}
+	return (-1);
+}
+
+/**************************
+ *
+ * 	packetChecksumSpan
+ *
+ * 	Find the bytes a checksum of a kind covers in a frame, the IPv4
+ * 	header for '&ip' or the TCP, UDP, ICMP or ICMPv6 message for
+ * 	'&l4', with the sum of its pseudo header. The lengths are taken
+ * 	from the IP header, cut at the end of the frame. Extension headers
+ * 	of IPv6 before the message are skipped
+ *
+ * 	Arguments	:	pkt	-	the frame
+ * 				len	-	its length
+ * 				cs	-	the checksum
+ * 				start	-	first byte covered is written here
+ * 				end	-	last byte covered is written here
+ * 				pseudo	-	sum of the pseudo header is
+ * 						written here
+ * 				field	-	position of the checksum field
+ * 						of the header is written here
+ *
+ * 	Return		:	EDPAT_SUCCESS, EDPAT_NOTFOUND if the frame
+ * 				has no such header
+ *
+ ***************************/
+
+static EDPAT_RETVAL packetChecksumSpan(const unsigned char *pkt, const int len,
+			const struct check_sum_mask *cs, int *start, int *end,
+			unsigned int *pseudo, int *field)
+{
+	int ip, version, ipEnd;
+	int l4, l4Len;
+	int proto;
+
+	ip = packetIpFind(pkt, len, &version);
+	if ((0 > ip) || ((CS_KIND_IP == cs->kind) && (4 != version)))
+	{
+		return EDPAT_NOTFOUND;
+	}
+	if (4 == version)
+	{
+		l4 = ip + (pkt[ip] & 0x0F) * 4;
+		ipEnd = ip + ((pkt[ip+2] << 8) | pkt[ip+3]);
+		proto = pkt[ip+9];
+	}
+	else
+	{
+		l4 = ip + 40;
+		ipEnd = l4 + ((pkt[ip+4] << 8) | pkt[ip+5]);
+		proto = pkt[ip+6];
+	}
+	if ((ipEnd > len) || (ipEnd < l4))
+	{
+		ipEnd = len;
+	}
+	if (CS_KIND_IP == cs->kind)
+	{
+		*start = ip;
+		*end = l4 - 1;
+		*pseudo = 0;
+		*field = ip + 10;
+		return (l4 <= len) ? EDPAT_SUCCESS : EDPAT_NOTFOUND;
+	}
+
+	// hop by hop, routing and destination options headers
+	while ((6 == version) && ((0 == proto) || (43 == proto) ||
+		(60 == proto)) && ((l4 + 8) <= ipEnd))
+	{
+		proto = pkt[l4];
+		l4 += (pkt[l4+1] + 1) * 8;
+	}
+	l4Len = ipEnd - l4;
+	switch (proto)
+	{
+		case 6:		// TCP
+			*field = l4 + 16;
+			break;
+		case 17:	// UDP
+			*field = l4 + 6;
+			break;
+		case 1:		// ICMP, without a pseudo header
+		case 58:	// ICMPv6
+			*field = l4 + 2;
+			break;
+		default:
+			return EDPAT_NOTFOUND;
+	}
+	if ((*field + 2) > ipEnd)
+	{
+		return EDPAT_NOTFOUND;
+	}
+	*start = l4;
+	*end = ipEnd - 1;
+	*pseudo = 0;
+	if (4 == version)
+	{
+		*pseudo = (1 == proto) ? 0 : packetOnesSum(&pkt[ip+12], 8,
+				proto + l4Len);
+	}
+	else if (1 != proto)
+	{
+		*pseudo = packetOnesSum(&pkt[ip+8], 32, proto + l4Len);
+	}
+	return EDPAT_SUCCESS;
+}
+
+/**************************
+ *
+ * 	packetChecksum
+ *
+ * 	Calculate a checksum of a frame, of the bytes of a range or of
+ * 	the header of its kind. A UDP checksum of 0 is sent as ffff
+ *
+ * 	Arguments	:	pkt	-	the frame, with the field of
+ * 						the checksum 0
+ * 				len	-	its length
+ * 				cs	-	the checksum
+ *
+ * 	Return		:	the checksum, 0 if the frame has no header of
+ * 				its kind
+ *
+ ***************************/
+
+static unsigned short packetChecksum(unsigned char *pkt, const int len,
+			const struct check_sum_mask *cs)
+{
+	unsigned int pseudo;
+	unsigned short sum;
+	int start, end, field;
+
+	if (CS_KIND_RANGE == cs->kind)
+	{
+		return (unsigned short) check_sum(pkt, cs->start, cs->end);
+	}
+	if (EDPAT_SUCCESS != packetChecksumSpan(pkt, len, cs, &start, &end,
+			&pseudo, &field))
+	{
+		VerboseStringPrint("No header for the checksum at %d",
+			cs->pos);
+		return 0;
+	}
+	sum = ~packetOnesSum(&pkt[start], end - start + 1, pseudo);
+	if ((0 == sum) && (CS_KIND_L4 == cs->kind) &&
+	    ((field - start) == 6))
+	{
+		sum = 0xFFFF;
+	}
+	return sum;
+}
+
+/**************************
+ *
+ * 	packetChecksumCheck
+ *
+ * 	Check a checksum of a kind in the send packet read. It has to be
+ * 	the checksum field of its header, unless the headers are copied
+ * 	from the packet received
+ *
+ * 	Arguments	:	cs	-	the checksum
+ *
+ * 	Return		:	EDPAT_RETVAL
+ *
+ ***************************/
+
+static EDPAT_RETVAL packetChecksumCheck(const struct check_sum_mask *cs)
+{
+	unsigned int pseudo;
+	int start, end, field;
+	int i;
+
+	if (CS_KIND_RANGE == cs->kind)
+	{
+		return EDPAT_SUCCESS;
+	}
+	for (i=0; i < BytesInSpecifiedPkt; i++)
+	{
+		if (0 <= ReadPktMask[i])
+		{
+			return EDPAT_SUCCESS;
+		}
+	}
+	if (EDPAT_SUCCESS != packetChecksumSpan(ReadPkt, BytesInSpecifiedPkt,
+			cs, &start, &end, &pseudo, &field))
+	{
+		ScriptErrorMsgPrint("No %s header for the checksum at %u",
+			(CS_KIND_IP == cs->kind) ? "IPv4" :
+				"TCP, UDP or ICMP", cs->pos);
+		return EDPAT_FAILED;
+	}
+	if ((int) cs->pos != field)
+	{
+		ScriptErrorMsgPrint("Checksum at %u is not the checksum of "
+			"its header, at %d", cs->pos, field);
+		return EDPAT_FAILED;
+	}
+	return EDPAT_SUCCESS;
+}
+
+/*********************
+ *
+ *	checksumRead
+ *
+ *	Parse a checksum field of a send statement, '&<start>-<end>',
+ *	'&ip' or '&l4', and add it to cs_arr[] at the byte being read
+ *
+ *	Arguments	:	token -	the checksum in the statement
+ *
+ *	Return 		:	EDPAT_RETVAL
+ *
+ *
+ * ********************/
+
+static EDPAT_RETVAL checksumRead(const char *token)
+{
+	struct check_sum_mask *cs = &cs_arr[cs_array_siz];
+	const char *p = &token[1];
+	long start = 0;
+	long end = 0;
+	char *q;
+
+	if (MAX_CS_SIZE <= cs_array_siz)
+	{
+		ScriptErrorMsgPrint("Too many checksums. Maximum is %d",
+			MAX_CS_SIZE);
+		return EDPAT_FAILED;
+	}
+	if (0 == strcmp(p,"ip"))
+	{
+		cs->kind = CS_KIND_IP;
+	}
+	else if (0 == strcmp(p,"l4"))
+	{
+		cs->kind = CS_KIND_L4;
+	}
+	else
+	{
+		cs->kind = CS_KIND_RANGE;
+		start = strtol(p,&q,10);
+		if ((p != q) && ('-' == q[0]))
+		{
+			p = &q[1];
+			end = strtol(p,&q,10);
+		}
+		if ((p == q) || (0 != q[0]) || (0 > start) || (start > end) ||
+		    (MAX_PKT_SIZE <= end))
+		{
+			ScriptErrorMsgPrint("Invalid checksum '%s'. Expecting "
+				"&<start>-<end>, &ip or &l4",token);
+			return EDPAT_FAILED;
+		}
+	}
+	cs->pos = BytesInSpecifiedPkt;
+	cs->start = start;
+	cs->end = end;
+	cs_array_siz++;
+	return EDPAT_SUCCESS;
+}
+
+/*********************
+ *
+ *	hexDigitValue
+ *
+ *	Get the value of a hex digit
+ *
+ *	Arguments	:	c -	the character
+ *
+ *	Return 		:	0 to 15, -1 if it is not a hex digit
+ *
+ * ********************/
+
+static int hexDigitValue(unsigned char c)
+{
+	if (('0' <= c) && ('9' >= c))
+	{
+		return c - '0';
+	}
+	c |= 0x20;	// lower case
+	if (('a' <= c) && ('f' >= c))
+	{
+		return c - 'a' + 10;
+	}
+	return (-1);
+}
+
+#ifdef __SSE2__
+/*********************
+ *
+ *	packetHexBlockDecode
+ *
+ *	Decode PKT_HEX_BLOCK_LEN hex bytes of a packet, each of 2 digits
+ *	followed by a space, 16 characters at a time. The characters are
+ *	checked and made nibbles in SSE2 registers, then paired
+ *
+ *	Arguments	:	in -	3*PKT_HEX_BLOCK_LEN characters
+ *				out -	the bytes
+ *
+ *	Return 		:	EDPAT_TRUE, EDPAT_FALSE if they are not
+ *				all such bytes
+ *
+ * ********************/
+
+static EDPAT_BOOL packetHexBlockDecode(const char *in, unsigned char *out)
+{
+	// 0xFF where a space is expected, every third character
+	static const unsigned char spaceMask[3*PKT_HEX_BLOCK_LEN] = {
+		0,0,0xFF, 0,0,0xFF, 0,0,0xFF, 0,0,0xFF, 0,0,0xFF, 0,
+		0,0xFF, 0,0,0xFF, 0,0,0xFF, 0,0,0xFF, 0,0,0xFF, 0,0,
+		0xFF, 0,0,0xFF, 0,0,0xFF, 0,0,0xFF, 0,0,0xFF, 0,0,0xFF };
+	unsigned char nibble[3*PKT_HEX_BLOCK_LEN];
+	__m128i c, digit, alpha, isDigit, isAlpha, isSpace, space, ok;
+	int i;
+
+	for (i=0; i < (3*PKT_HEX_BLOCK_LEN); i += 16)
+	{
+		c = _mm_loadu_si128((const __m128i *) &in[i]);
+		space = _mm_loadu_si128((const __m128i *) &spaceMask[i]);
+
+		// c - '0' <= 9 and (c | 0x20) - 'a' <= 5, unsigned
+		digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+		isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit,
+				_mm_set1_epi8(9)), digit);
+		alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)),
+				_mm_set1_epi8('a'));
+		isAlpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha,
+				_mm_set1_epi8(5)), alpha);
+		isSpace = _mm_cmpeq_epi8(c, _mm_set1_epi8(' '));
+
+		ok = _mm_or_si128(_mm_and_si128(space, isSpace),
+			_mm_andnot_si128(space,
+				_mm_or_si128(isDigit, isAlpha)));
+		if (0xFFFF != _mm_movemask_epi8(ok))
+		{
+			return EDPAT_FALSE;
+		}
+		_mm_storeu_si128((__m128i *) &nibble[i],
+			_mm_or_si128(_mm_and_si128(isDigit, digit),
+				_mm_and_si128(isAlpha, _mm_add_epi8(alpha,
+					_mm_set1_epi8(10)))));
+	}
+	for (i=0; i < PKT_HEX_BLOCK_LEN; i++)
+	{
+		out[i] = (nibble[3*i] << 4) | nibble[3*i+1];
+	}
+	return EDPAT_TRUE;
+}
+#endif
+
+/*********************
+ *
+ *	packetHexDecode
+ *
+ *	Decode the run of hex bytes of a packet at the start of a
+ *	statement, each of 2 digits followed by a space or the end of
+ *	the statement. Most of a packet is such bytes, they are decoded
+ *	a block at a time where SSE2 is there. Anything else is left to
+ *	be read token by token
+ *
+ *	Arguments	:	in -	the statement
+ *				end -	its end
+ *				out -	the bytes
+ *				maxLen - room for bytes in out
+ *				next -	where the run ends
+ *
+ *	Return 		:	number of bytes decoded
+ *
+ * ********************/
+
+static int packetHexDecode(const char *in, const char *end,
+			unsigned char *out, const int maxLen, char **next)
+{
+	int hi, lo;
+	int n = 0;
+
+#ifdef __SSE2__
+	while (((maxLen - n) >= PKT_HEX_BLOCK_LEN) &&
+	       ((end - in) >= (3*PKT_HEX_BLOCK_LEN)) &&
+	       (EDPAT_TRUE == packetHexBlockDecode(in, &out[n])))
+	{
+		in += 3*PKT_HEX_BLOCK_LEN;
+		n += PKT_HEX_BLOCK_LEN;
+	}
+#endif
+	while ((n < maxLen) && ((end - in) >= 2))
+	{
+		hi = hexDigitValue(in[0]);
+		lo = hexDigitValue(in[1]);
+		if ((0 > hi) || (0 > lo) || ((end != &in[2]) && (' ' != in[2])))
+		{
+			break;
+		}
+		out[n++] = (hi << 4) | lo;
+		in += (end == &in[2]) ? 2 : 3;
+	}
+	*next = (char *) in;
+	return n;
+}
+
+/*********************
+ *
+ *	packetRead
+ *
+ *	Parse the details from the test statement, set Operation ethport
+ *	and process special characters. The port is opened when the
+ *	statement runs. The statement is split up in place, runs of hex
+ *	bytes are decoded by packetHexDecode() and variables left in it
+ *	are copied from their decoded bytes
+ *
+ *	Arguments	:	in -	Test statement under consideration 
+ *
+ *	Return 		:	EDPAT_RETVAL
+ *
+ *
+ * ********************/
+
+static EDPAT_RETVAL packetRead(char *in)
+{
+	char *token, *q, *p;
+	long bits;
+	char *next;
+	char *end;
+	const unsigned char *varBytes;
+	const unsigned char *varSkip;
+	int i, j;
+	EDPAT_RETVAL retVal;
+	unsigned char byte;
+
+	switch(in[0])
+	{
+		case '<':
+			Operation = OP_RECEIVE;
+			break;
+		case '>':
+			Operation = OP_SEND;
+			break;
+		default:
+			ScriptErrorMsgPrint("Unexpected character '%c(%d)'",
+				in[0],in[0]);
+			return EDPAT_FAILED;
+		
+	}
+
+	// Skip the     1st character Which will be operation
+	end = &in[strlen(in)];
+	token = &in[1];
+	token += strspn(token," ");
+	//Copy the ethport name
+        if (0 == token[0])
+        {
+                ScriptErrorMsgPrint("Missing Ethernet Port Name");
+                return EDPAT_FAILED;
+        };
+	next = token + strcspn(token," ");
+	if (0 != next[0])
+	{
+		*next++ = 0;
+	}
+
+	// Validate ethernet port name
+	if (MAX_ETH_PORT_NAME_LEN <= strlen(token))
+	{
+		ScriptErrorMsgPrint("Ethernet Port Name '%s' too long. "
+			"Need to be less than %d",
+			token, MAX_ETH_PORT_NAME_LEN);
+		return EDPAT_FAILED;
+	}
+
+	strncpy(EthPortName,token,MAX_ETH_PORT_NAME_LEN);
+	EthPortName[MAX_ETH_PORT_NAME_LEN]=0;
+
+	BytesInSpecifiedPkt = 0;
+	cs_array_siz = 0;
+	LatencyBudgetCount = 0;
+	memset(&Pace,0,sizeof(Pace));
+	FieldModReset();
+	RepeatCount = 1;
+	SearchRequested = EDPAT_FALSE;
+	SearchSizeCount = 0;
+	while (0 != next[0])
+	{
+		i = packetHexDecode(next, end, &ReadPkt[BytesInSpecifiedPkt],
+			MAX_PKT_SIZE - BytesInSpecifiedPkt, &next);
+		while (0 < i--)
+		{
+			ReadPktMask[BytesInSpecifiedPkt++] = MASK_EXACT;
+		}
+
+		// Anything else is taken a token at a time
+		token = next + strspn(next," ");
+		if (0 == token[0])
+		{
+			break;
+		}
+		next = token + strcspn(token," ");
+		if (0 != next[0])
+		{
+			*next++ = 0;
+		}
+		switch(token[0])
+		{	
+			case '~':	// latency budget or pace of send
+				retVal = (OP_SEND == Operation) ?
+					paceOptionRead(token) :
+					latencyBudgetRead(token);
+				if (EDPAT_SUCCESS != retVal)
+				{
+					return EDPAT_FAILED;
+				}
+				continue;
+
+			case '{':	// field modifier
+				if ( MAX_PKT_SIZE <= BytesInSpecifiedPkt)
+				{
+				    ScriptErrorMsgPrint("Pkt too large");
+				    return EDPAT_FAILED;
+				};
+				if (OP_SEND != Operation)
+				{
+					ScriptErrorMsgPrint(
+					    "Invalid field modifier '%s'. It "
+					    "is valid only in send",token);
+					return EDPAT_FAILED;
+				}
+				if (EDPAT_SUCCESS != FieldModParse(token,
+					BytesInSpecifiedPkt,
+					&ReadPkt[BytesInSpecifiedPkt],
+					&i))
+				{
+					return EDPAT_FAILED;
+				}
+				while (0 < i--)
+				{
+					ReadPktMask[BytesInSpecifiedPkt++] =
+						MASK_FIELD;
+				}
+				continue;
+
+			case 'x':	// repeat count of send
+				if (OP_SEND != Operation)
+				{
+					ScriptErrorMsgPrint(
+					    "Invalid repeat count '%s'. It is "
+					    "valid only in send",token);
+					return EDPAT_FAILED;
+				}
+				RepeatCount = strtoul(&token[1],&q,10);
+				if ((&token[1] == q) || (0 != q[0]) ||
+				    (0 == RepeatCount))
+				{
+					ScriptErrorMsgPrint(
+						"'%s' is not a repeat count",
+						token);
+					return EDPAT_FAILED;
+				}
+				continue;
+
+			case '&':	// In case checksum field 
+				if ( MAX_PKT_SIZE <= BytesInSpecifiedPkt)
+				{
+				    ScriptErrorMsgPrint("Pkt too large");
+				    return EDPAT_FAILED;
+				};
+				if (OP_SEND == Operation){
+					if (EDPAT_SUCCESS !=
+						checksumRead(token))
+					{
+						return EDPAT_FAILED;
+					}
+
+					ReadPktMask[BytesInSpecifiedPkt] = MASK_CS;
+					ReadPkt[BytesInSpecifiedPkt++] = 0;
+					ReadPkt[BytesInSpecifiedPkt] = 0;
+					ReadPktMask[BytesInSpecifiedPkt] = MASK_CS;
+
+					break;
+				}
+				VerboseStringPrint("Falling thorugh to the case '*', In receive mode we are not evaluating checksum");
+					
+
+			case '*':	// Do not compare
+				if (OP_RECEIVE != Operation)
+				{
+					ScriptErrorMsgPrint(
+					    "Invalid character '*'. It is "
+					    "valid only in receive");
+					return EDPAT_FAILED;
+				}
+				if ( MAX_PKT_SIZE <= BytesInSpecifiedPkt)
+				{
+				    ScriptErrorMsgPrint("Pkt too large");
+				    return EDPAT_FAILED;
+				};
+				/* Set the byte as zero and mark in mask
+				   as MASK_SKIP */
+				ReadPkt[BytesInSpecifiedPkt]  = 0;
+				ReadPktMask[BytesInSpecifiedPkt] =
+						MASK_SKIP;
+				break;
+
+
+			case '$':	// bytes of a variable
+				varBytes = VariableGetBytes(&token[1],
+						&i, &varSkip);
+				if (NULL == varBytes)
+				{
+					ScriptErrorMsgPrint(
+						"Undefined variable '%s'",
+						&token[1]);
+					return EDPAT_FAILED;
+				}
+				if ((NULL != varSkip) &&
+				    (OP_RECEIVE != Operation))
+				{
+					ScriptErrorMsgPrint(
+					    "Invalid character '*'. It is "
+					    "valid only in receive");
+					return EDPAT_FAILED;
+				}
+				if ((MAX_PKT_SIZE - BytesInSpecifiedPkt) < i)
+				{
+				    ScriptErrorMsgPrint("Pkt too large");
+				    return EDPAT_FAILED;
+				};
+				memcpy(&ReadPkt[BytesInSpecifiedPkt],
+					varBytes, i);
+				for (j=0; j < i; j++)
+				{
+					ReadPktMask[BytesInSpecifiedPkt++] =
+						((NULL != varSkip) &&
+						 (0 != varSkip[j])) ?
+						MASK_SKIP : MASK_EXACT;
+				}
+				continue;
+
+			case '?':	// copy from last received packet
+				// or the low nibble of a byte received
+				if ((OP_RECEIVE == Operation) &&
+				    (0 <= hexDigitValue(token[1])) &&
+				    (0 == token[2]))
+				{
+					if ( MAX_PKT_SIZE <= BytesInSpecifiedPkt)
+					{
+					    ScriptErrorMsgPrint("Pkt too large");
+					    return EDPAT_FAILED;
+					};
+					ReadPkt[BytesInSpecifiedPkt] =
+						hexDigitValue(token[1]);
+					ReadPktMask[BytesInSpecifiedPkt] =
+						MASK_BITS;
+					ReadPktBits[BytesInSpecifiedPkt] = 0x0F;
+					break;
+				}
+				if (OP_SEND != Operation)
+				{
+					ScriptErrorMsgPrint(
+					    "Invalid character '?'. It is "
+					    "valid only in send packet");
+					return EDPAT_FAILED;
+				}
+				// Copy the n value after ?
+				byte = (unsigned char )
+						strtol(&token[1],&q,10);
+				if ( token == q)
+				{
+				    ScriptErrorMsgPrint(
+					"'%s' is not a integer value",
+					token);
+				    return EDPAT_FAILED;
+				};
+
+				// Check if within limits
+				if ( MAX_PKT_SIZE <= BytesInSpecifiedPkt)
+				{
+				    ScriptErrorMsgPrint("Pkt too large");
+				    return EDPAT_FAILED;
+				};
+
+
+				// Check for tail in the packet 
+				if ((NULL != q) && (0 != q[0]))
+				{
+					ScriptErrorMsgPrint(
+						"Invalid character "
+						"at the end of '%s'",token);
+					return EDPAT_FAILED;
+				};
+
+				//Set byte and mask
+				ReadPkt[BytesInSpecifiedPkt]  = 0;
+				ReadPktMask[BytesInSpecifiedPkt]=byte;
+				break;
+			default:
+				//Default just copy the byte in
+				byte = (unsigned char ) strtol(token,&q,16);
+				if ( token == q)
+				{
+					ScriptErrorMsgPrint(
+						"'%s' is not a hex value",
+						token);
+					return EDPAT_FAILED;
+				};
+				if ( MAX_PKT_SIZE <= BytesInSpecifiedPkt)
+				{
+				       ScriptErrorMsgPrint("Pkt too large");
+					return EDPAT_FAILED;
+				};
+
+				/* A byte received can have only its high
+				   nibble, '4?', or some bits, '45/f0',
+				   compared */
+				bits = 0xFF;
+				if ((OP_RECEIVE == Operation) &&
+				    (&token[1] == q) && ('?' == q[0]) &&
+				    (0 == q[1]))
+				{
+					byte <<= 4;
+					bits = 0xF0;
+					q++;
+				}
+				else if ((OP_RECEIVE == Operation) &&
+					 ('/' == q[0]))
+				{
+					bits = strtol(&q[1],&p,16);
+					if ((&q[1] == p) || (0 > bits) ||
+					    (0xFF < bits))
+					{
+						ScriptErrorMsgPrint(
+							"'%s' is not a bit "
+							"mask of a byte",
+							&q[1]);
+						return EDPAT_FAILED;
+					}
+					q = p;
+				}
+				if ((NULL != q) && (0 != q[0]))
+				{
+					ScriptErrorMsgPrint(
+						"Invalid character at the "
+						"end of '%s'",token);
+					return EDPAT_FAILED;
+				};
+				ReadPkt[BytesInSpecifiedPkt]  = byte;
+				ReadPktMask[BytesInSpecifiedPkt] =
+						(0xFF == bits) ? MASK_EXACT :
+						MASK_BITS;
+				ReadPktBits[BytesInSpecifiedPkt] = bits;
+		}
+		BytesInSpecifiedPkt++;
+	}
+
+	if ( 0 >= BytesInSpecifiedPkt)
+	{
+		ScriptErrorMsgPrint("Zero byte packet is specified");
+		return EDPAT_FAILED;
+	}
+	// A field or checksum can end past the last byte there is room for
+	if ( MAX_PKT_SIZE < BytesInSpecifiedPkt)
+	{
+		ScriptErrorMsgPrint("Pkt too large");
+		return EDPAT_FAILED;
+	}
+	for (i=0; i < cs_array_siz; i++)
+	{
+		if (EDPAT_SUCCESS != packetChecksumCheck(&cs_arr[i]))
+		{
+			return EDPAT_FAILED;
+		}
+	}
+	if ((0 != SearchSizeCount) && (EDPAT_TRUE != SearchRequested))
+	{
+		ScriptErrorMsgPrint("Frame sizes are valid only in a "
+			"throughput search. Expecting ~search");
+		return EDPAT_FAILED;
+	}
+	if (EDPAT_TRUE == SearchRequested)
+	{
+		if ((0 == Pace.pps) && (0 == Pace.bps))
+		{
+			ScriptErrorMsgPrint("Highest rate of throughput search "
+				"is missing. Expecting ~pps=<rate> or "
+				"~bps=<rate>");
+			return EDPAT_FAILED;
+		}
+		if (1 < RepeatCount)
+		{
+			ScriptErrorMsgPrint("Repeat count is not valid in a "
+				"throughput search. Expecting ~count=<n> "
+				"or ~duration=<ms> for a trial");
+			return EDPAT_FAILED;
+		}
+		if (0 != FieldModCount())
+		{
+			ScriptErrorMsgPrint("Field modifiers are not valid in "
+				"a throughput search");
+			return EDPAT_FAILED;
+		}
+	}
+	else if (((0 != Pace.count) || (0 != Pace.durationMs) ||
+	     (EDPAT_TRUE == Pace.launchTime)) &&
+	    (0 == Pace.pps) && (0 == Pace.bps))
+	{
+		ScriptErrorMsgPrint("Rate of send is missing. "
+			"Expecting ~pps=<rate> or ~bps=<rate>");
+		return EDPAT_FAILED;
+	}
+	// A paced send can be given its count as a repeat count
+	if (((0 != Pace.pps) || (0 != Pace.bps)) && (0 == Pace.count) &&
+	    (1 < RepeatCount))
+	{
+		Pace.count = RepeatCount;
+	}
+	if (((0 != Pace.pps) || (0 != Pace.bps)) &&
+	    (0 == Pace.count) && (0 == Pace.durationMs) &&
+	    (EDPAT_TRUE != SearchRequested))
+	{
+		ScriptErrorMsgPrint("End of paced send is missing. "
+			"Expecting x<n>, ~count=<n> or ~duration=<ms>");
+		return EDPAT_FAILED;
+	}
+	
+	VerboseStringPrint("Read %d bytes from script for %s Eth Port '%s'",
+			BytesInSpecifiedPkt,
+			( (OP_RECEIVE == Operation) ?
+				"receiving from" : "sending to "),
+			EthPortName);
+	VerbosePacketPrint(ReadPkt, BytesInSpecifiedPkt);
+	VerbosePacketMaskPrint(ReadPktMask, BytesInSpecifiedPkt);
+
+	return EDPAT_SUCCESS;
+}
+
+/*****************************
+ *
+ *	packetNext
+ *
+ *	Make packet k of a send statement with field modifiers from an
+ *	earlier one, usually the one before. Only the bytes changed by
+ *	the modifiers are written, and the checksums covering them are
+ *	updated for the change as in RFC 1624, HC' = ~(~HC + ~m + m'),
+ *	instead of being computed again. The checksums are updated in the
+ *	order they are computed, so a checksum covering an earlier one
+ *	sees its change. It is called by the transmit workers at the same
+ *	time, on packets of their own.
+ *
+ *	Arguments	:	pkt	- the earlier packet, changed in
+ *					  place
+ *				k	- number of the packet, from 0
+ *
+ *	Return 		:	void
+ *
+ *
+ * ***************************/
+
+static void packetNext(unsigned char *pkt, const unsigned long k)
+{
+	FIELD_MOD_CHANGE change[MAX_FIELD_MOD_CHANGES + 2*MAX_CS_SIZE];
+	unsigned char oldByte[2];
+	unsigned int sum;
+	unsigned int oldWord, newWord;
+	int changeCount;
+	int i, j, pos;
+
+	changeCount = FieldModSet(pkt, k, change);
+	for (i=0; i < cs_array_siz; i++)
+	{
+		pos = cs_arr[i].pos;
+		oldByte[0] = pkt[pos];
+		oldByte[1] = pkt[pos+1];
+		sum = (~((pkt[pos] << 8) | pkt[pos+1])) & 0xFFFF;
+		// A pseudo header can change too, it is computed again, as
+		// it is sent, a UDP checksum of 0 is ffff
+		if (CS_KIND_RANGE != cs_arr[i].kind)
+		{
+			sum = (oldByte[0] << 8) | oldByte[1];
+			if (0 != changeCount)
+			{
+				pkt[pos] = 0;
+				pkt[pos+1] = 0;
+				sum = packetChecksum(pkt, BytesInSpecifiedPkt,
+						&cs_arr[i]);
+			}
+		}
+		for (j=0; (CS_KIND_RANGE == cs_arr[i].kind) &&
+			(j < changeCount); j++)
+		{
+			// The field of the checksum was 0 when computed
+			if ((change[j].pos < (int) cs_arr[i].start) ||
+			    (change[j].pos > (int) cs_arr[i].end) ||
+			    (change[j].pos == pos) || (change[j].pos == pos+1))
+			{
+				continue;
+			}
+			// Bytes at even offsets are the high byte of a word
+			if (0 == ((change[j].pos - cs_arr[i].start) % 2))
+			{
+				oldWord = change[j].oldByte << 8;
+				newWord = change[j].newByte << 8;
+			}
+			else
+			{
+				oldWord = change[j].oldByte;
+				newWord = change[j].newByte;
+			}
+			sum += ((~oldWord) & 0xFFFF) + newWord;
+		}
+		while ((CS_KIND_RANGE == cs_arr[i].kind) && (sum >> 16))
+		{
+			sum = (sum & 0xFFFF) + (sum >> 16);
+		}
+		if (CS_KIND_RANGE == cs_arr[i].kind)
+		{
+			sum = (~sum) & 0xFFFF;
+		}
+
+		// A later checksum may cover this one
+		for (j=0; j < 2; j++)
+		{
+			change[changeCount].pos = pos + j;
+			change[changeCount].oldByte = oldByte[j];
+			change[changeCount].newByte = (0 == j) ?
+				(sum >> 8) : (sum & 0xFF);
+			pkt[pos + j] = change[changeCount].newByte;
+			changeCount++;
+		}
+	}
+	return;
+}
+
+/*****************************
+ *
+ *	packetRepeatSend
+ *
+ *	Send the packet RepeatCount times, in batches of
+ *	SEND_REPEAT_BATCH. A batch that is not fully sent does not stop
+ *	the others. How many were sent is written to the log at the end.
+ *
+ *	Arguments	:	pkt	- the packet
+ *				pktLen	- length of the packet
+ *
+ *	Return 		:	EDPAT_SUCCESS if all the packets are sent
+ *
+ *
+ * ***************************/
+
+static EDPAT_RETVAL packetRepeatSend(unsigned char *pkt, const int pktLen)
+{
+	static unsigned char batchBuf[SEND_REPEAT_BATCH][MAX_PKT_SIZE];
+	static unsigned char *batchPkt[SEND_REPEAT_BATCH];
+	static int batchLen[SEND_REPEAT_BATCH];
+	static struct timespec txTime[SEND_REPEAT_BATCH];
+	unsigned long sent = 0;
+	unsigned long failed = 0;
+	unsigned long batchCount = 0;
+	unsigned long done;
+	int queuedCount, sentCount;
+	int batch, i;
+	EDPAT_RETVAL retVal;
+
+	for (i=0; i < SEND_REPEAT_BATCH; i++)
+	{
+		batchPkt[i] = pkt;
+		batchLen[i] = pktLen;
+	}
+	for (done=0; done < RepeatCount; done += batch)
+	{
+		batch = ((RepeatCount - done) < SEND_REPEAT_BATCH) ?
+			(int) (RepeatCount - done) : SEND_REPEAT_BATCH;
+		// Every packet of the batch is different with field modifiers
+		for (i=0; (0 != FieldModCount()) && (i < batch); i++)
+		{
+			if ((0 != done) || (0 != i))
+			{
+				packetNext(pkt, done + i);
+			}
+			memcpy(batchBuf[i], pkt, pktLen);
+			batchPkt[i] = batchBuf[i];
+		}
+		retVal = EthPortSendBatch(EthPortName, batchPkt, batchLen,
+				batch, &queuedCount, &sentCount, txTime);
+		if (EDPAT_NOTFOUND == retVal)
+		{
+			LatencyTxSendEnd();
+			return EDPAT_FAILED;
+		}
+		for (i=0; i < sentCount; i++)
+		{
+			LatencyTxTimeSet(done + i, &txTime[i]);
+		}
+		sent += sentCount;
+		failed += batch - sentCount;
+		batchCount++;
+	}
+	LatencyTxSendEnd();
+	FieldModSent(sent);
+
+	TestCaseStringPrint("Sent %lu of %lu packets to '%s' in %lu "
+		"batches%s", sent, RepeatCount, EthPortName, batchCount,
+		(0 != failed) ? "" : ". All sent");
+	if (0 != failed)
+	{
+		TestCaseStringPrint("Failed to send %lu packets to '%s'",
+			failed, EthPortName);
+		return EDPAT_FAILED;
+	}
+	return EDPAT_SUCCESS;
+}
+
+/*****************************
+ *
+ *	packetBuild
+ *
+ *	Make the packet of a send statement from the specified packet,
+ *	copying the bytes of the last received packet, writing the fields
+ *	of the first packet of its field modifiers and filling in the
+ *	checksums of its patches
+ *
+ *	Arguments	:	pkt	- the packet is written here
+ *				pktLen	- its length is written here
+ *
+ *	Return 		:	EDPAT_RETVAL
+ *
+ *
+ * ***************************/
+
+static EDPAT_RETVAL packetBuild(unsigned char *pkt, int *pktLen)
+{
+	FIELD_MOD_CHANGE change[MAX_FIELD_MOD_CHANGES];
+	const PKT_PATCH *patch = SpecifiedPatch;
+	const PKT_PATCH *end = &SpecifiedPatch[SpecifiedPatchCount];
+	const struct check_sum_mask *cs;
+	unsigned short sum;
+
+	memcpy(pkt, SpecifiedPkt, BytesInSpecifiedPkt);
+	for (; (patch < end) && (PKT_PATCH_COPY == patch->op); patch++)
+	{
+		/* Check whether n is within bounds of the previous
+		   packet */
+		if (BytesInRecvPkt < (patch->from + patch->len))
+		{
+			ScriptErrorMsgPrint("Copy position %d is beyond"
+				" received bytes of %d.",
+				(BytesInRecvPkt > patch->from) ?
+					BytesInRecvPkt : patch->from,
+				BytesInRecvPkt);
+			return EDPAT_FAILED;
+		}
+		memcpy(&pkt[patch->pos], &RecvPkt[patch->from], patch->len);
+	}
+
+	// A sequence tag is made only when the packet is sent
+	if (0 != FieldModCount())
+	{
+		FieldModSet(pkt, 0, change);
+	}
+
+	/* Now that the full packet is formed compute check sum and fill
+	   in various positions */
+	for (; patch < end; patch++)
+	{
+		cs = &cs_arr[patch->from];
+		sum = packetChecksum(pkt, BytesInSpecifiedPkt, cs);
+		pkt[patch->pos] = (sum >> 8) & 0xFF;
+		pkt[patch->pos + 1] = sum & 0xFF;
+	}
+	*pktLen = BytesInSpecifiedPkt;
+	return EDPAT_SUCCESS;
+}
+
+
+/*****************************
+ *
+ *	packetMismatchFind
+ *
+ *	Find the first byte of a packet received that does not match the
+ *	packet expected in the bits compared, (pkt ^ expected) & bits,
+ *	a vector at a time with AVX2 or SSE2 where they are there
+ *
+ *	Arguments	:	pkt	 - the packet received
+ *				expected - the packet expected, with the
+ *					   bits not compared cleared
+ *				bits	 - bits compared of each byte, NULL
+ *					   if all are compared
+ *				len	 - bytes to compare
+ *
+ *	Return 		:	the byte, len if they all match
+ *
+ *
+ * ***************************/
+
+static int packetMismatchFind(const unsigned char *pkt,
+			const unsigned char *expected,
+			const unsigned char *bits, const int len)
+{
+	int i = 0;
+#ifdef __AVX2__
+	__m256i d;
+#endif
+#ifdef __SSE2__
+	__m128i v;
+	unsigned int m;
+#endif
+
+#ifdef __AVX2__
+	for (; (len - i) >= 32; i += 32)
+	{
+		d = _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *) &pkt[i]),
+			_mm256_loadu_si256((const __m256i *) &expected[i]));
+		if (NULL != bits)
+		{
+			d = _mm256_and_si256(d, _mm256_loadu_si256(
+				(const __m256i *) &bits[i]));
+		}
+		m = ~((unsigned int) _mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(d, _mm256_setzero_si256())));
+		if (0 != m)
+		{
+			return i + __builtin_ctz(m);
+		}
+	}
+#endif
+#ifdef __SSE2__
+	for (; (len - i) >= 16; i += 16)
+	{
+		v = _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *) &pkt[i]),
+			_mm_loadu_si128((const __m128i *) &expected[i]));
+		if (NULL != bits)
+		{
+			v = _mm_and_si128(v, _mm_loadu_si128(
+				(const __m128i *) &bits[i]));
+		}
+		m = 0xFFFF & ~((unsigned int) _mm_movemask_epi8(
+			_mm_cmpeq_epi8(v, _mm_setzero_si128())));
+		if (0 != m)
+		{
+			return i + __builtin_ctz(m);
+		}
+	}
+#endif
+	for (; i < len; i++)
+	{
+		if (0 != ((pkt[i] ^ expected[i]) &
+				((NULL == bits) ? 0xFF : bits[i])))
+		{
+			break;
+		}
+	}
+	return i;
+}
+
+/*****************************
+ *
+ *	packetFieldSet
+ *
+ *	Write a 16 bit field of a packet, unless it is not compared in
+ *	whole in the packet
+ *
+ *	Arguments	:	pkt	- the packet
+ *				bits	- bits compared of the packet, NULL
+ *					  if none
+ *				pos	- position of the field
+ *				value	- value of the field
+ *
+ *	Return 		:	EDPAT_TRUE if the field was written
+ *
+ *
+ * ***************************/
+
+static EDPAT_BOOL packetFieldSet(unsigned char *pkt, const unsigned char *bits,
+			const int pos, const int value)
+{
+	if ((NULL != bits) && ((0xFF != bits[pos]) || (0xFF != bits[pos+1])))
+	{
+		return EDPAT_FALSE;
+	}
+	pkt[pos] = (value >> 8) & 0xFF;
+	pkt[pos+1] = value & 0xFF;
+	return EDPAT_TRUE;
+}
+
+/*****************************
+ *
+ *	packetLengthsSet
+ *
+ *	Set the total length of an IPv4 packet in an Ethernet frame, with
+ *	or without a VLAN tag, and the length of UDP in it, to fill the
+ *	frame. The header checksum of IPv4 is computed again and the UDP
+ *	checksum is left out. In a frame expected, with the bits compared,
+ *	fields not compared are left as they are and the checksums are not
+ *	compared.
+ *
+ *	Arguments	:	pkt	- the frame
+ *				bits	- bits compared of the frame, NULL
+ *					  if it is sent
+ *				len	- length of the frame
+ *
+ *	Return 		:	void
+ *
+ *
+ * ***************************/
+
+static void packetLengthsSet(unsigned char *pkt, unsigned char *bits,
+			const int len)
+{
+	int ip = 14;
+	int ihl;
+
+	if ((18 <= len) && (0x81 == pkt[12]) && (0x00 == pkt[13]))
+	{
+		ip = 18;
+	}
+	if (((ip + 20) > len) || (0x08 != pkt[ip-2]) || (0x00 != pkt[ip-1]) ||
+	    (4 != (pkt[ip] >> 4)))
+	{
+		return;
+	}
+	ihl = (pkt[ip] & 0x0F) * 4;
+	if ((EDPAT_TRUE == packetFieldSet(pkt, bits, ip+2, len - ip)) &&
+	    (NULL != bits))
+	{
+		bits[ip+10] = 0;
+		bits[ip+11] = 0;
+	}
+	if ((17 == pkt[ip+9]) && ((ip + ihl + 8) <= len) &&
+	    (EDPAT_TRUE == packetFieldSet(pkt, bits, ip+ihl+4, len-ip-ihl)))
+	{
+		if (NULL != bits)
+		{
+			bits[ip+ihl+6] = 0;
+			bits[ip+ihl+7] = 0;
+		}
+		else
+		{
+			packetFieldSet(pkt, NULL, ip+ihl+6, 0);
+		}
+	}
+	if ((NULL == bits) && ((ip + ihl) <= len))
+	{
+		packetFieldSet(pkt, NULL, ip+10, 0);
+		packetFieldSet(pkt, NULL, ip+10,
+			(unsigned short) check_sum(pkt, ip, ip+ihl-1));
+	}
+	return;
+}
+
+/*****************************
+ *
+ *	packetSearchSet
+ *
+ *	Keep the packet of the send statement of a throughput search till
+ *	the receive statement of the frame expected runs the search
+ *
+ *	Arguments	:	pkt	- the packet
+ *				pktLen	- length of the packet
+ *
+ *	Return 		:	EDPAT_RETVAL
+ *
+ *
+ * ***************************/
+
+static EDPAT_RETVAL packetSearchSet(const unsigned char *pkt, const int pktLen)
+{
+	int i;
+
+	strncpy(Search.portName, EthPortName, MAX_ETH_PORT_NAME_LEN);
+	Search.portName[MAX_ETH_PORT_NAME_LEN] = 0;
+	memcpy(Search.pkt, pkt, pktLen);
+	Search.pktLen = pktLen;
+	memcpy(Search.cs, cs_arr, cs_array_siz * sizeof(cs_arr[0]));
+	Search.csCount = cs_array_siz;
+	Search.pace = Pace;
+	Search.sizeCount = 0;
+	for (i=0; i < SearchSizeCount; i++)
+	{
+		Search.sizes[Search.sizeCount++] = SearchSizes[i];
+	}
+	for (i=0; (0 == SearchSizeCount) &&
+		(i < (int) (sizeof(SearchDefaultSizes) / sizeof(int))); i++)
+	{
+		Search.sizes[Search.sizeCount++] = SearchDefaultSizes[i];
+	}
+	Search.pending = EDPAT_TRUE;
+	VerboseStringPrint("Throughput search to '%s' waiting for the "
+		"frame expected", EthPortName);
+	return EDPAT_SUCCESS;
+}
+
+/*****************************
+ *
+ *	packetSearchMatch
+ *
+ *	Check if a packet received is the frame expected by the trials of
+ *	a throughput search, as packetReceive() would
+ *
+ *	Arguments	:	pkt	- the packet
+ *				pktLen	- length of the packet
+ *
+ *	Return 		:	EDPAT_TRUE if it is
+ *
+ *
+ * ***************************/
+
+static EDPAT_BOOL packetSearchMatch(const unsigned char *pkt, const int pktLen)
+{
+	if ((SearchExpectedLen > pktLen) ||
+	    ((60 < pktLen) && (SearchExpectedLen != pktLen)) ||
+	    (SearchExpectedLen != packetMismatchFind(pkt, SearchExpectedPkt,
+			SearchExpectedBits, SearchExpectedLen)))
+	{
+		return EDPAT_FALSE;
+	}
+	return EDPAT_TRUE;
+}
+
+/*****************************
+ *
+ *	packetSearch
+ *
+ *	Run the throughput search of the last send statement, with the
+ *	specified packet as the frame expected, for each frame size of
+ *	the search. The frame sent is padded with zeros to the size, its
+ *	IPv4 and UDP lengths are set to fill it and checksums ending at
+ *	its last byte are extended to the new end. The frame expected
+ *	grows by as much, the bytes added are not compared.
+ *
+ *	Arguments	:	void
+ *
+ *	Return 		:	EDPAT_RETVAL
+ *
+ *
+ * ***************************/
+
+static EDPAT_RETVAL packetSearch(void)
+{
+	static unsigned char pkt[MAX_PKT_SIZE];
+	BENCHMARK b;
+	struct check_sum_mask cs;
+	int len;
+	int i, j;
+
+	Search.pending = EDPAT_FALSE;
+	if (0 != LatencyBudgetCount)
+	{
+		ScriptErrorMsgPrint("Latency budgets are not valid in the "
+			"frame expected by a throughput search");
 		return EDPAT_FAILED;
 	}
-	unsigned int size = end - start;
-	unsigned int csum = 0;
-	unsigned int i = 0;
-	// Add each word in the header (16 bit addition
-	for (;i <= size;i += 2)	{
-		// Making it 16 byte addition 
-		csum += (addr[i] << 8) + addr[i+1]; 
-	}
-	//In the case that there are odd number of packets pad with zero byte
-	if (size % 2 == 0)	{	
-		csum += (addr[i]<<8) + 0x00;
-	}
-	// get rid of carry by folding 
-	
-	while (csum >> 16)	{
-		csum = (csum & 0xFFFF) + (csum>>16);
-	}
+	b.txPortName = Search.portName;
+	b.rxPortName = EthPortName;
+	b.data = pkt;
+	b.pace = Search.pace;
+	b.match = packetSearchMatch;
+	for (i=0; i < Search.sizeCount; i++)
+	{
+		len = Search.sizes[i] - BENCHMARK_FCS_LEN;
+		SearchExpectedLen = BytesInSpecifiedPkt + len - Search.pktLen;
+		if ((Search.pktLen > len) || (MAX_PKT_SIZE < SearchExpectedLen))
+		{
+			TestCaseStringPrint("Frame size %d skipped. The frame "
+				"sent is %d bytes and the frame expected %d "
+				"bytes", Search.sizes[i],
+				Search.pktLen + BENCHMARK_FCS_LEN,
+				BytesInSpecifiedPkt + BENCHMARK_FCS_LEN);
+			continue;
+		}
 
-	unsigned short int ret = ~csum;
-	VerboseStringPrint(
-		"Calculated CheckSum for bytes [%d-%d] and got :: %x",
-		start,end,ret);
-	return ret;
+		memcpy(pkt, Search.pkt, Search.pktLen);
+		memset(&pkt[Search.pktLen], 0, len - Search.pktLen);
+		packetLengthsSet(pkt, NULL, len);
+		for (j=0; j < Search.csCount; j++)
+		{
+			packetFieldSet(pkt, NULL, Search.cs[j].pos, 0);
+		}
+		for (j=0; j < Search.csCount; j++)
+		{
+			cs = Search.cs[j];
+			if ((int) cs.end == (Search.pktLen - 1))
+			{
+				cs.end = len - 1;
+			}
+			packetFieldSet(pkt, NULL, cs.pos,
+				packetChecksum(pkt, len, &cs));
+		}
+
+		memcpy(SearchExpectedPkt, SpecifiedPkt, BytesInSpecifiedPkt);
+		if (NULL == SpecifiedPktBits)
+		{
+			memset(SearchExpectedBits, 0xFF, BytesInSpecifiedPkt);
+		}
+		else
+		{
+			memcpy(SearchExpectedBits, SpecifiedPktBits,
+				BytesInSpecifiedPkt);
+		}
+		memset(&SearchExpectedPkt[BytesInSpecifiedPkt], 0,
+			SearchExpectedLen - BytesInSpecifiedPkt);
+		memset(&SearchExpectedBits[BytesInSpecifiedPkt], 0,
+			SearchExpectedLen - BytesInSpecifiedPkt);
+		packetLengthsSet(SearchExpectedPkt, SearchExpectedBits,
+			SearchExpectedLen);
+
+		b.dataLen = len;
+		VerboseStringPrint("Throughput search of %d byte frames from "
+			"'%s' to '%s'", Search.sizes[i], b.txPortName,
+			b.rxPortName);
+		VerbosePacketPrint(pkt, len);
+		if (EDPAT_SUCCESS != BenchmarkSearch(&b))
+		{
+			return EDPAT_FAILED;
+		}
+	}
+	return EDPAT_SUCCESS;
 }
 
 /*****************************
@@ -382,80 +2050,83 @@ static short int check_sum(unsigned char *pkt,unsigned int start,unsigned int en
 static EDPAT_RETVAL packetSend(void)
 {
 	static unsigned char pkt[MAX_PKT_SIZE];
-	int pktLen;
+	ETH_PORT_PACE_STATS paceStats;
+	struct timespec txTime;
+	EDPAT_BOOL paced;
+	int pktLen = BytesInSpecifiedPkt;
 	EDPAT_RETVAL retVal;
 
-	for(pktLen=0; pktLen < BytesInSpecifiedPkt; pktLen++)
+	if (EDPAT_TRUE == SpecifiedPktBuilt)
+	{
+		memcpy(pkt, SpecifiedPkt, pktLen);
+	}
+	else if (EDPAT_SUCCESS != packetBuild(pkt, &pktLen))
+	{
+		return EDPAT_FAILED;
+	}
+	if (EDPAT_TRUE == SearchRequested)
+	{
+		return packetSearchSet(pkt, pktLen);
+	}
+
+	paced = ((0 != Pace.pps) || (0 != Pace.bps)) ?
+			EDPAT_TRUE : EDPAT_FALSE;
+	if ((EDPAT_TRUE != paced) &&
+	    ((1 == RepeatCount) || (1 == TxWorkerCount)))
 	{
-		// If it is the eaxact case with no special character
-		if (MASK_EXACT == SpecifiedPktMask[pktLen])
+		if (1 < RepeatCount)
 		{
-			pkt[pktLen] = SpecifiedPkt[pktLen];
+			return packetRepeatSend(pkt, pktLen);
 		}
-		//Special character usage 
-		
-
-		// For the case that the field is checksum 
-
-		else
+		//  Send the packet
+		retVal = EthPortSend(EthPortName, pkt, pktLen, &txTime);
+		FieldModSent((EDPAT_SUCCESS == retVal) ? 1 : 0);
+		if (EDPAT_SUCCESS == retVal)
 		{
-			/* In ? <n> case mask is greater than 0 and
-			  represents postion in previous received packet */
-			if ( 0 <= SpecifiedPktMask[pktLen])
-			{
-				/* Check whether n is within bounds of the
-				   previous packet */
-				if (BytesInRecvPkt > SpecifiedPktMask[pktLen])
-				{
-					pkt[pktLen] =
-					  RecvPkt[SpecifiedPktMask[pktLen]];
-				}
-				else
-				{
-					ScriptErrorMsgPrint(
-						"Copy position %d is beyond"
-						" received bytes of %d.",
-						SpecifiedPktMask[pktLen],
-						BytesInRecvPkt);
-					return EDPAT_FAILED;
-				}
-
-			}
-
-
-			else if (SpecifiedPktMask[pktLen] == MASK_CS){
-				VerboseStringPrint(
-					"Encountered Checksum at %d",
-					pktLen);
-				continue;
-			}
-
-			else 
-			{
-				ScriptErrorMsgPrint("Unsupported mask");
-				return EDPAT_FAILED;
-			}
+			LatencyTxTimeSet(0, &txTime);
+			LatencyTxSendEnd();
 		}
+		return retVal;
 	}
 
-	/* Now that the full packet is formed compute check sum and fill
-	   in various positions */
-	for (int i = 0;i < cs_array_siz;i++){
-		VerboseStringPrint("Found checksum at %d",cs_arr[i].pos);
-		VerboseStringPrint("For %d",cs_arr[i].start,cs_arr[i].end);
+	// A repeated send is a stream spread over the transmit workers
+	if (EDPAT_TRUE != paced)
+	{
+		Pace.count = RepeatCount;
 	}
-
-	for (int i = 0;i < cs_array_siz;i++){
-		short int cs = check_sum(pkt,cs_arr[i].start,cs_arr[i].end);
-		char byte1 = (char)((cs >> 8) & 0x00FF);
-		char byte2 = (char)(cs & 0x00FF);
-		pkt[cs_arr[i].pos] 	= byte1;
-		pkt[cs_arr[i].pos + 1] 	= byte2;
+	Pace.nextPkt = (0 != FieldModCount()) ? packetNext : NULL;
+	Pace.txTimeSet = LatencyTxTimeSet;
+	retVal = EthPortSendPaced(EthPortName, pkt, pktLen, &Pace,
+			&paceStats, &txTime);
+	LatencyTxSendEnd();
+	FieldModSent(paceStats.sent);
+	TestCaseStringPrint("%s send to '%s'%s. Sent %lu packets in "
+		"%.3f ms, %.0f pps, %.3f Mbps",
+		(EDPAT_TRUE == paced) ? "Paced" : "Stream", EthPortName,
+		(EDPAT_TRUE == paceStats.launchTime) ?
+			" with launch times" : "",
+		paceStats.sent, paceStats.elapsedNs / 1000000.0,
+		paceStats.pps, paceStats.bps / 1000000.0);
+	if (1 < paceStats.workers)
+	{
+		TestCaseStringPrint("Sent by %d transmit workers",
+			paceStats.workers);
+	}
+	if ((EDPAT_TRUE == paced) &&
+	    ((unsigned long) paceStats.workers < paceStats.sent))
+	{
+		TestCaseStringPrint("Gap between packets%s %.3f us, jitter "
+			"%.3f us, furthest from target %.3f us",
+			(1 < paceStats.workers) ? " of a worker" : "",
+			paceStats.gapMeanNs / 1000.0,
+			paceStats.gapJitterNs / 1000.0,
+			paceStats.gapMaxErrNs / 1000.0);
+	}
+	if (0 != paceStats.failed)
+	{
+		TestCaseStringPrint("Failed to send %lu packets to '%s'",
+			paceStats.failed, EthPortName);
 	}
-
-	//  Send the packet
-	retVal = EthPortSend(EthPortName, pkt, pktLen);
-
 	return retVal;
 }
 
@@ -474,13 +2145,29 @@ static EDPAT_RETVAL packetSend(void)
 
 static EDPAT_RETVAL packetReceive(void)
 {
+	char timeStr[MAX_TIMESPEC_STR_LEN];
+	struct timespec txTime;
 	int pktLen,i;
-	EDPAT_RETVAL retVal;
+	long long latencyNs;
+	EDPAT_RETVAL retVal, txRetVal;
+
+	// Percentile budgets are checked at the end of the test case
+	for (i=0; i < LatencyBudgetCount; i++)
+	{
+		if ((LATENCY_BUDGET_MAX != LatencyBudget[i].percentile) &&
+		    (EDPAT_SUCCESS != LatencyBudgetAdd(EthPortName,
+				LatencyBudget[i].percentile,
+				LatencyBudget[i].budgetNs)))
+		{
+			return EDPAT_FAILED;
+		}
+	}
 
 	BytesInRecvPkt = sizeof(RecvPkt);
 	
 	//	Wait to receive packet from ethport for given waitperiod
-	retVal = EthPortReceive(EthPortName, RecvPkt, &BytesInRecvPkt);
+	retVal = EthPortReceive(EthPortName, RecvPkt, &BytesInRecvPkt,
+			&RecvTime);
 	if (EDPAT_SUCCESS != retVal)
 	{
 		if (EDPAT_NOTFOUND == retVal)
@@ -510,40 +2197,20 @@ static EDPAT_RETVAL packetReceive(void)
 		pktLen = BytesInSpecifiedPkt;
 	}
 
-	for(i=0; i < pktLen; i++)
+	i = packetMismatchFind(RecvPkt, SpecifiedPkt, SpecifiedPktBits,
+			pktLen);
+	if (i < pktLen)
 	{
-		switch(SpecifiedPktMask[i])
-		{
-			case MASK_SKIP:
-				break;
-			case MASK_EXACT:
-				if (RecvPkt[i] != SpecifiedPkt[i])
-				{
-					CurrentTestResult =
-						EDPAT_TEST_RESULT_FAILED;
-					TestCaseStringPrint(
-						"Missmatch at byte %d of "
-						"Packet received on "
-						"Eth Port'%s'",
-						i,EthPortName);
-					TestCaseStringPrint(
-						"Expected packet. Len=%d",
-						BytesInSpecifiedPkt);
-					TestCasePacketPrint(SpecifiedPkt,
-						BytesInSpecifiedPkt);
-					TestCaseStringPrint(
-						"Actual packet received. "
-						" Len=%d",
-						BytesInRecvPkt);
-					TestCasePacketPrint(RecvPkt,
-						BytesInRecvPkt);
-					return EDPAT_SUCCESS;
-				}
-				break;
-			default:
-					return EDPAT_FAILED;
-				break;
-		}
+		CurrentTestResult = EDPAT_TEST_RESULT_FAILED;
+		TestCaseStringPrint("Missmatch at byte %d of Packet received "
+			"on Eth Port'%s'", i,EthPortName);
+		TestCaseStringPrint("Expected packet. Len=%d",
+			BytesInSpecifiedPkt);
+		TestCasePacketPrint(SpecifiedPkt, BytesInSpecifiedPkt);
+		TestCaseStringPrint("Actual packet received at %s. Len=%d",
+			TimespecFormat(&RecvTime,timeStr), BytesInRecvPkt);
+		TestCasePacketPrint(RecvPkt, BytesInRecvPkt);
+		return EDPAT_SUCCESS;
 	}
 
 	/* Padding is used to make it a minimum size of  60 it its more
@@ -561,37 +2228,462 @@ static EDPAT_RETVAL packetReceive(void)
 		TestCaseStringPrint("Expected packet. Len=%d",
 			BytesInSpecifiedPkt);
 		TestCasePacketPrint(SpecifiedPkt, BytesInSpecifiedPkt);
-		TestCaseStringPrint("Actual packet received. Len=%d",
-			BytesInRecvPkt);
+		TestCaseStringPrint("Actual packet received at %s. Len=%d",
+			TimespecFormat(&RecvTime,timeStr), BytesInRecvPkt);
 		TestCasePacketPrint(RecvPkt,BytesInRecvPkt);
 		return EDPAT_SUCCESS;
 	}
 	BytesInRecvPkt = pktLen;
 
+	/* The packet answers the packet sent that left first of the ones
+	   not answered yet. Packets read from a capture file carry the
+	   time they were captured, which is before anything was sent */
+	latencyNs = (-1);
+	txRetVal = LatencyTxTimeGet(&RecvTime, &txTime);
+	if (EDPAT_SUCCESS == txRetVal)
+	{
+		latencyNs = TimespecDiffNs(&txTime,&RecvTime);
+		VerboseStringPrint("Packet at '%s' matched. Received %lld ns "
+			"after its packet was sent", EthPortName, latencyNs);
+		LatencyRecord(EthPortName, latencyNs);
+	}
+	else if (EDPAT_FAILED == txRetVal)
+	{
+		VerboseStringPrint("Packet at '%s' matched. Latency not "
+			"known, the packet it answers is not kept",
+			EthPortName);
+	}
+
+	for (i=0; i < LatencyBudgetCount; i++)
+	{
+		if ((LATENCY_BUDGET_MAX != LatencyBudget[i].percentile) ||
+		    (EDPAT_FAILED == txRetVal))
+		{
+			continue;
+		}
+		if (EDPAT_NOTFOUND == txRetVal)
+		{
+			CurrentTestResult = EDPAT_TEST_RESULT_FAILED;
+			TestCaseStringPrint("Latency of Packet at '%s' not "
+				"known. No packet was sent before it",
+				EthPortName);
+		}
+		else if (latencyNs > LatencyBudget[i].budgetNs)
+		{
+			CurrentTestResult = EDPAT_TEST_RESULT_FAILED;
+			TestCaseStringPrint("Latency of Packet at '%s' over "
+				"budget. Received %.3f us after its packet "
+				"was sent, budget=%.3f us", EthPortName,
+				latencyNs / 1000.0,
+				LatencyBudget[i].budgetNs / 1000.0);
+		}
+	}
 	return EDPAT_SUCCESS;
 }
 
 /*************************
  *
- *	PacketProcess
+ *	PacketStatementSize
+ *
+ *	Get the size of a compiled statement, with the parts following
+ *	it
+ *
+ *	Arguments:	ps -	the statement
+ *
+ *	Return 		 the size in bytes
+ *
+ *************************/
+
+size_t PacketStatementSize(const PACKET_STATEMENT *ps)
+{
+	return ps->size;
+}
+
+/*************************
+ *
+ *	packetStatementPartsCheck
+ *
+ *	Check the checksums and patches of a statement mapped from a
+ *	file, so none of them is out of its packet. The copies are before
+ *	the checksums, as packetBuild() makes them
+ *
+ *	Arguments:	ps -	the statement, its counts checked
+ *
+ *	Return 		 EDPAT_TRUE if they are in it
+ *
+ *************************/
+
+static EDPAT_BOOL packetStatementPartsCheck(const PACKET_STATEMENT *ps)
+{
+	const struct check_sum_mask *cs;
+	const PKT_PATCH *patch;
+	EDPAT_BOOL copies = EDPAT_TRUE;
+	int i;
+
+	for (i=0; i < ps->csCount; i++)
+	{
+		cs = &ps->cs[i];
+		if ((((int) cs->pos + 2) > ps->len) ||
+		    ((CS_KIND_RANGE != cs->kind) && (CS_KIND_IP != cs->kind) &&
+		     (CS_KIND_L4 != cs->kind)) ||
+		    ((CS_KIND_RANGE == cs->kind) && ((cs->start > cs->end) ||
+			(MAX_PKT_SIZE <= cs->end))))
+		{
+			return EDPAT_FALSE;
+		}
+	}
+	patch = PACKET_STATEMENT_PART(ps, ps->patchOffset);
+	for (i=0; i < ps->patchCount; i++, patch++)
+	{
+		if ((0 > patch->pos) || (0 >= patch->len) ||
+		    (patch->len > (ps->len - patch->pos)) || (0 > patch->from))
+		{
+			return EDPAT_FALSE;
+		}
+		if (PKT_PATCH_COPY == patch->op)
+		{
+			if ((EDPAT_TRUE != copies) ||
+			    (MAX_PKT_SIZE < (patch->from + patch->len)))
+			{
+				return EDPAT_FALSE;
+			}
+			continue;
+		}
+		copies = EDPAT_FALSE;
+		if ((PKT_PATCH_CS != patch->op) || (2 != patch->len) ||
+		    (ps->csCount <= patch->from) ||
+		    (patch->pos != (int) ps->cs[patch->from].pos))
+		{
+			return EDPAT_FALSE;
+		}
+	}
+	return EDPAT_TRUE;
+}
+
+/*************************
+ *
+ *	PacketStatementCheck
+ *
+ *	Check if a statement mapped from a file is one compiled by
+ *	PacketCompile(), its parts within its size
+ *
+ *	Arguments:	ps -	the statement
+ *			size -	bytes there are for it
+ *
+ *	Return 		 EDPAT_TRUE if it is
+ *
+ *************************/
+
+EDPAT_BOOL PacketStatementCheck(const PACKET_STATEMENT *ps, const size_t size)
+{
+	if ((sizeof(*ps) > size) || (size != ps->size) ||
+	    ((OP_SEND != ps->operation) && (OP_RECEIVE != ps->operation)) ||
+	    (0 >= ps->len) || (MAX_PKT_SIZE < ps->len) ||
+	    ((int) sizeof(*ps) > ps->pktOffset) ||
+	    (size != (size_t) (ps->pktOffset + ps->len)) ||
+	    ((0 != ps->maskOffset) && ((OP_RECEIVE != ps->operation) ||
+		(ps->pktOffset != (int) (ps->maskOffset + ps->len)))) ||
+	    (0 > ps->patchCount) ||
+	    ((0 != ps->patchCount) && ((OP_SEND != ps->operation) ||
+		(ps->pktOffset != (int) (ps->patchOffset +
+			ps->patchCount * sizeof(PKT_PATCH))))) ||
+	    ((0 != ps->fieldModOffset) &&
+	     ((int) sizeof(*ps) != ps->fieldModOffset)) ||
+	    (0 > ps->csCount) || (MAX_CS_SIZE < ps->csCount) ||
+	    (0 > ps->latencyBudgetCount) ||
+	    (MAX_LATENCY_BUDGET_COUNT < ps->latencyBudgetCount) ||
+	    (0 > ps->searchSizeCount) ||
+	    (MAX_BENCHMARK_SIZE_COUNT < ps->searchSizeCount) ||
+	    (0 != ps->portName[MAX_ETH_PORT_NAME_LEN]) ||
+	    ((0 != ps->patchCount) &&
+	     (0 != (ps->patchOffset % sizeof(int)))))
+	{
+		return EDPAT_FALSE;
+	}
+	return packetStatementPartsCheck(ps);
+}
+
+/*************************
+ *
+ *	PacketFree
+ *
+ *	Free a statement compiled by PacketCompile()
+ *
+ *	Arguments:	ps -	the statement, NULL if none
+ *
+ *	Return 		 void
+ *
+ *************************/
+
+void PacketFree(PACKET_STATEMENT *ps)
+{
+	free(ps);
+	return;
+}
+
+/*****************************
+ *
+ *	packetPatchesMake
+ *
+ *	Make the patches of the send packet read, the runs of bytes
+ *	copied from the last packet received and the checksums covering
+ *	bytes that change from one send to the next, or the field of a
+ *	checksum made before that does. The other checksums are computed
+ *	into ReadPkt[] when the patches are written
+ *
+ *	Arguments	:	patch	- the patches are written here, NULL
+ *					  to count them
+ *
+ *	Return 		:	number of patches
+ *
+ *
+ * ***************************/
+
+static int packetPatchesMake(PKT_PATCH *patch)
+{
+	static EDPAT_BOOL changes[MAX_PKT_SIZE+PKT_READ_SLACK];
+	EDPAT_BOOL patched[MAX_CS_SIZE];
+	const struct check_sum_mask *cs;
+	int start[MAX_CS_SIZE], end[MAX_CS_SIZE];
+	int count = 0;
+	int i, j;
+
+	for (i=0; i < BytesInSpecifiedPkt; i++)
+	{
+		changes[i] = ((MASK_FIELD == ReadPktMask[i]) ||
+				(0 <= ReadPktMask[i])) ? EDPAT_TRUE : EDPAT_FALSE;
+		if (0 > ReadPktMask[i])
+		{
+			continue;
+		}
+		// Bytes copied from the bytes after each other are a run
+		if ((0 != i) && (ReadPktMask[i] == (ReadPktMask[i-1] + 1)) &&
+		    (0 <= ReadPktMask[i-1]))
+		{
+			if (NULL != patch)
+			{
+				patch[count-1].len++;
+			}
+			continue;
+		}
+		if (NULL != patch)
+		{
+			patch[count].op = PKT_PATCH_COPY;
+			patch[count].pos = i;
+			patch[count].from = ReadPktMask[i];
+			patch[count].len = 1;
+		}
+		count++;
+	}
+
+	for (i=0; i < cs_array_siz; i++)
+	{
+		cs = &cs_arr[i];
+		// The headers of a checksum of a kind can be anywhere
+		start[i] = (CS_KIND_RANGE == cs->kind) ? (int) cs->start : 0;
+		end[i] = ((CS_KIND_RANGE == cs->kind) &&
+			  ((int) cs->end < BytesInSpecifiedPkt)) ?
+				(int) cs->end : (BytesInSpecifiedPkt - 1);
+		for (j = start[i]; (j <= end[i]) &&
+		     (EDPAT_TRUE != changes[j]); j++)
+		{
+		}
+		patched[i] = (j <= end[i]) ? EDPAT_TRUE : EDPAT_FALSE;
+		// Its field is 0 when a checksum made before covers it
+		for (j=0; (EDPAT_TRUE != patched[i]) && (j < i); j++)
+		{
+			if ((EDPAT_TRUE == patched[j]) &&
+			    (start[j] <= (int) cs->pos + 1) &&
+			    (end[j] >= (int) cs->pos))
+			{
+				patched[i] = EDPAT_TRUE;
+			}
+		}
+		if (EDPAT_TRUE != patched[i])
+		{
+			if (NULL != patch)
+			{
+				packetFieldSet(ReadPkt, NULL, cs->pos,
+					packetChecksum(ReadPkt,
+						BytesInSpecifiedPkt, cs));
+			}
+			continue;
+		}
+		changes[cs->pos] = EDPAT_TRUE;
+		changes[cs->pos + 1] = EDPAT_TRUE;
+		if (NULL != patch)
+		{
+			patch[count].op = PKT_PATCH_CS;
+			patch[count].pos = cs->pos;
+			patch[count].from = i;
+			patch[count].len = 2;
+		}
+		count++;
+	}
+	return count;
+}
+
+/*************************
+ *
+ *	PacketCompile
+ *
+ *	Compile a send or receive statement of the script, calling
+ *	packetRead to process the special chars in the packet. A send
+ *	packet is given the patches made when it is sent instead of its
+ *	mask, with the checksums that need none computed here. A receive
+ *	packet is given the bits compared of each byte
+ *
+ *	Arguments:	in -	the testcase statement, split up in place
+ *
+ *	Return 		 the statement compiled, NULL on errors. To be
+ *			 freed by PacketFree()
+ *
+ *************************/
+
+PACKET_STATEMENT *PacketCompile(char *in)
+{
+	PACKET_STATEMENT *ps;
+	EDPAT_BOOL exact = EDPAT_TRUE;
+	unsigned char *bits;
+	size_t maskSize = 0;
+	size_t size;
+	int patchCount = 0;
+	int i;
+
+	if (EDPAT_SUCCESS != packetRead(in))
+	{
+		return NULL;
+	}
+	for (i=0; (OP_RECEIVE == Operation) && (i < BytesInSpecifiedPkt);
+	     i++)
+	{
+		if (MASK_EXACT != ReadPktMask[i])
+		{
+			exact = EDPAT_FALSE;
+		}
+	}
+	if (EDPAT_TRUE != exact)
+	{
+		maskSize = BytesInSpecifiedPkt * sizeof(ReadPktBits[0]);
+	}
+	if (OP_SEND == Operation)
+	{
+		patchCount = packetPatchesMake(NULL);
+		maskSize = patchCount * sizeof(PKT_PATCH);
+	}
+	size = sizeof(*ps) + FieldModSaveSize() + maskSize +
+			BytesInSpecifiedPkt;
+	ps = calloc(1, size);
+	if (NULL == ps)
+	{
+		ExecErrorMsgPrint("Failed to allocate memory for a packet "
+			"of %d bytes", BytesInSpecifiedPkt);
+		return NULL;
+	}
+	ps->size = size;
+	ps->operation = Operation;
+	strcpy(ps->portName, EthPortName);
+	ps->len = BytesInSpecifiedPkt;
+	ps->built = ((OP_SEND == Operation) && (0 == patchCount) &&
+			(0 == FieldModCount())) ? EDPAT_TRUE : EDPAT_FALSE;
+	ps->fieldModOffset = (0 == FieldModCount()) ? 0 : sizeof(*ps);
+	ps->maskOffset = (EDPAT_TRUE == exact) ? 0 :
+			(sizeof(*ps) + FieldModSaveSize());
+	ps->patchOffset = (0 == patchCount) ? 0 :
+			(sizeof(*ps) + FieldModSaveSize());
+	ps->patchCount = patchCount;
+	ps->pktOffset = size - ps->len;
+	memcpy(ps->cs, cs_arr, cs_array_siz * sizeof(cs_arr[0]));
+	ps->csCount = cs_array_siz;
+	memcpy(ps->latencyBudget, LatencyBudget,
+		LatencyBudgetCount * sizeof(LatencyBudget[0]));
+	ps->latencyBudgetCount = LatencyBudgetCount;
+	ps->pace = Pace;
+	ps->repeatCount = RepeatCount;
+	ps->search = SearchRequested;
+	memcpy(ps->searchSizes, SearchSizes,
+		SearchSizeCount * sizeof(SearchSizes[0]));
+	ps->searchSizeCount = SearchSizeCount;
+	if (0 != ps->fieldModOffset)
+	{
+		FieldModSave((FIELD_MOD_TABLE *) &ps[1]);
+	}
+	if (0 != ps->maskOffset)
+	{
+		bits = (unsigned char *) ps + ps->maskOffset;
+		for (i=0; i < ps->len; i++)
+		{
+			bits[i] = (MASK_EXACT == ReadPktMask[i]) ? 0xFF :
+				(MASK_BITS == ReadPktMask[i]) ?
+					ReadPktBits[i] : 0;
+			ReadPkt[i] &= bits[i];
+		}
+	}
+	if (OP_SEND == Operation)
+	{
+		packetPatchesMake((PKT_PATCH *) ((char *) ps +
+			ps->patchOffset));
+	}
+	memcpy((char *) ps + ps->pktOffset, ReadPkt, ps->len);
+	return ps;
+}
+
+/*************************
+ *
+ *	PacketExecute
  *
- *	Processes each packet test case calling receive or send based on
- *	operation, calls packetRead to process 
- *	Special chars in packet and set up the ethernet ports required
+ *	Runs a compiled send or receive statement, opening its port if
+ *	not already open. The receive statement after the send statement
+ *	of a throughput search runs the search instead
  *
- *	Arguments:	in -	the testcase under consideration 
+ *	Arguments:	ps -	the statement
  *
  *	Return 		 EDPAT_RETVAL
  *
  *************************/
 
-EDPAT_RETVAL PacketProcess(char *in)
+EDPAT_RETVAL PacketExecute(const PACKET_STATEMENT *ps)
 {
 	EDPAT_RETVAL retVal;
 
-	retVal = packetRead(in);
+	Operation = ps->operation;
+	strcpy(EthPortName, ps->portName);
+	BytesInSpecifiedPkt = ps->len;
+	SpecifiedPkt = PACKET_STATEMENT_PART(ps, ps->pktOffset);
+	SpecifiedPktBits = (0 == ps->maskOffset) ? NULL :
+			PACKET_STATEMENT_PART(ps, ps->maskOffset);
+	SpecifiedPatch = (0 == ps->patchOffset) ? NULL :
+			PACKET_STATEMENT_PART(ps, ps->patchOffset);
+	SpecifiedPatchCount = ps->patchCount;
+	SpecifiedPktBuilt = ps->built;
+	memcpy(cs_arr, ps->cs, ps->csCount * sizeof(cs_arr[0]));
+	cs_array_siz = ps->csCount;
+	memcpy(LatencyBudget, ps->latencyBudget,
+		ps->latencyBudgetCount * sizeof(LatencyBudget[0]));
+	LatencyBudgetCount = ps->latencyBudgetCount;
+	Pace = ps->pace;
+	RepeatCount = ps->repeatCount;
+	SearchRequested = ps->search;
+	memcpy(SearchSizes, ps->searchSizes,
+		ps->searchSizeCount * sizeof(SearchSizes[0]));
+	SearchSizeCount = ps->searchSizeCount;
 
-	if( EDPAT_SUCCESS != retVal)
+	/* Open the port if not already open */
+	if (0 > EthPortOpen(EthPortName))
+	{
+		return EDPAT_FAILED;
+	}
+
+	if ((EDPAT_TRUE == Search.pending) && (OP_SEND == Operation))
+	{
+		Search.pending = EDPAT_FALSE;
+		ScriptErrorMsgPrint("Expecting the receive statement of the "
+			"frame expected by the throughput search to '%s'",
+			Search.portName);
+		return EDPAT_FAILED;
+	}
+	if (EDPAT_SUCCESS != FieldModLoad((0 == ps->fieldModOffset) ? NULL :
+			PACKET_STATEMENT_PART(ps, ps->fieldModOffset)))
 	{
 		return EDPAT_FAILED;
 	}
@@ -602,7 +2694,8 @@ EDPAT_RETVAL PacketProcess(char *in)
 			retVal = packetSend();
 			break;
 		case OP_RECEIVE:
-			retVal = packetReceive();
+			retVal = (EDPAT_TRUE == Search.pending) ?
+				packetSearch() : packetReceive();
 			break;
 		default:
 			ScriptErrorMsgPrint(
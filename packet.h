@@ -9,7 +9,14 @@
 #ifndef __PACKET_H__
 #define __PACKET_H__ 1
 
-EDPAT_RETVAL PacketProcess(const char *statement);
+// A send or receive statement compiled
+typedef struct packetStatement PACKET_STATEMENT;
+
+PACKET_STATEMENT *PacketCompile(char *statement);
+EDPAT_RETVAL PacketExecute(const PACKET_STATEMENT *ps);
+size_t PacketStatementSize(const PACKET_STATEMENT *ps);
+EDPAT_BOOL PacketStatementCheck(const PACKET_STATEMENT *ps, const size_t size);
+void PacketFree(PACKET_STATEMENT *ps);
 void CheckUnexpectedPackets(void);
 
 
@@ -0,0 +1,364 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ * 
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+#include "edpat.h"
+#include "print.h"
+#include "pktqueue.h"
+#include "utils.h"
+
+
+/***********************
+ *   PktQueueCreate()
+ *
+ *   Allocate a packet queue and the eventfd used to wake up the
+ *   consumer.
+ *
+ *   Arguments :
+ *	slotCount	- INPUT. Number of packets the queue can hold.
+ *			  Rounded up to a power of 2.
+ *	dataSize	- INPUT. Bytes of the packets the queue can hold.
+ *			  Rounded up to a power of 2.
+ *
+ *   Return:	- pointer to the queue or NULL on failure
+ *
+ ********/
+PKT_QUEUE *PktQueueCreate(const unsigned int slotCount,
+			const unsigned int dataSize)
+{
+	PKT_QUEUE *q;
+	unsigned int n = 1;
+	unsigned int size = CACHE_LINE_SIZE;
+
+	while (n < slotCount)
+	{
+		n <<= 1;
+	}
+	while (size < dataSize)
+	{
+		size <<= 1;
+	}
+
+	if (0 != posix_memalign((void **) &q, CACHE_LINE_SIZE, sizeof(*q)))
+	{
+		ExecErrorMsgPrint("Failed to allocate packet queue");
+		return NULL;
+	}
+	memset(q,0,sizeof(*q));
+	q->slotCount = n;
+
+	q->slots = malloc(n * sizeof(PKT_QUEUE_SLOT));
+	if (NULL == q->slots)
+	{
+		ExecErrorMsgPrint("Failed to allocate %u packet queue slots",n);
+		free(q);
+		return NULL;
+	}
+	q->dataSize = size;
+	if (0 != posix_memalign((void **) &q->data, CACHE_LINE_SIZE, size))
+	{
+		ExecErrorMsgPrint("Failed to allocate %u bytes of packet "
+			"queue data", size);
+		free(q->slots);
+		free(q);
+		return NULL;
+	}
+
+	q->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (0 > q->eventFd)
+	{
+		ExecErrorMsgPrint("eventfd() failed for packet queue");
+		free(q->data);
+		free(q->slots);
+		free(q);
+		return NULL;
+	}
+	return q;
+}
+
+
+/***********************
+ *   PktQueueDestroy()
+ *
+ *   Free a packet queue. The producer must have been stopped.
+ *
+ *   Arguments :
+ *	q	- INPUT. the queue.
+ *
+ *   Return:	- None
+ *
+ ********/
+void PktQueueDestroy(PKT_QUEUE *q)
+{
+	if (NULL == q)
+	{
+		return;
+	}
+	close(q->eventFd);
+	free(q->data);
+	free(q->slots);
+	free(q);
+	return;
+}
+
+
+/***********************
+ *   PktQueueEnqueue()
+ *
+ *   Copy a packet to the tail of the queue. Called only by the producer.
+ *   If the queue is full, or its data has no room for the packet, the
+ *   packet is dropped and counted. Packets longer than MAX_PKT_SIZE are
+ *   truncated. A packet that does not fit before the end of the data
+ *   is put at its start.
+ *
+ *   Arguments :
+ *	q	- INPUT. the queue.
+ *	pkt	- INPUT. pointer to the packet buffer.
+ *	pktLen	- INPUT. length of packet.
+ *	rxTime	- INPUT. time the packet arrived.
+ *
+ *   Return:	- EDPAT_SUCCESS or EDPAT_FAILED if the queue is full
+ *
+ ********/
+EDPAT_RETVAL PktQueueEnqueue(PKT_QUEUE *q,
+			const unsigned char *pkt, const int pktLen,
+			const struct timespec *rxTime)
+{
+	PKT_QUEUE_SLOT *slot;
+	unsigned int tail = q->tail;
+	unsigned int head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+	unsigned long dataHead = __atomic_load_n(&q->dataHead,
+					__ATOMIC_ACQUIRE);
+	unsigned long start = q->dataTail;
+	unsigned int pos = start & (q->dataSize - 1);
+	int len = pktLen;
+
+	if (MAX_PKT_SIZE < len)
+	{
+		len = MAX_PKT_SIZE;
+	}
+	if (q->dataSize - pos < (unsigned int) len)
+	{
+		start += q->dataSize - pos;
+		pos = 0;
+	}
+	if (((tail - head) >= q->slotCount) ||
+	    ((start + len - dataHead) > q->dataSize))
+	{
+		__atomic_store_n(&q->dropCount, q->dropCount + 1,
+				__ATOMIC_RELAXED);
+		return EDPAT_FAILED;
+	}
+
+	slot = &q->slots[tail & (q->slotCount - 1)];
+	memcpy(&q->data[pos], pkt, len);
+	slot->pktLen = len;
+	slot->rxTime = *rxTime;
+	slot->dataPos = pos;
+	// the next packet starts at a cache line
+	slot->dataEnd = (start + len + CACHE_LINE_SIZE - 1) &
+			~((unsigned long) CACHE_LINE_SIZE - 1);
+	q->dataTail = slot->dataEnd;
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+	q->enqueueCount++;
+
+	/* Pairs with the fence in PktQueueWaitPrepare(). Either the consumer
+	   sees the new tail or we see that it is waiting */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (0 != __atomic_load_n(&q->consumerWaiting, __ATOMIC_RELAXED))
+	{
+		eventfd_write(q->eventFd, 1);
+	}
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   PktQueueIsEmpty()
+ *
+ *   Check whether there is any packet in the queue.
+ *
+ *   Arguments :
+ *	q	- INPUT. the queue.
+ *
+ *   Return:	- EDPAT_TRUE if empty
+ *
+ ********/
+EDPAT_BOOL PktQueueIsEmpty(PKT_QUEUE *q)
+{
+	if (__atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == q->head)
+	{
+		return EDPAT_TRUE;
+	}
+	return EDPAT_FALSE;
+}
+
+
+/***********************
+ *   PktQueueHeadTimeGet()
+ *
+ *   Get the arrival time of the packet at the head of the queue without
+ *   removing it. Called only by the consumer.
+ *
+ *   Arguments :
+ *	q	- INPUT. the queue.
+ *
+ *   Return:	- pointer to the time or NULL if the queue is empty
+ *
+ ********/
+const struct timespec *PktQueueHeadTimeGet(PKT_QUEUE *q)
+{
+	if (EDPAT_TRUE == PktQueueIsEmpty(q))
+	{
+		return NULL;
+	}
+	return &q->slots[q->head & (q->slotCount - 1)].rxTime;
+}
+
+
+/***********************
+ *   PktQueueWaitPrepare()
+ *
+ *   Tell the producer that the consumer is about to sleep on the
+ *   eventfd of the queue. Must be followed by PktQueueWaitDone().
+ *
+ *   Arguments :
+ *	q	- INPUT. the queue.
+ *
+ *   Return:	- EDPAT_TRUE if a packet arrived meanwhile and the consumer
+ *		  should not sleep.
+ *
+ ********/
+EDPAT_BOOL PktQueueWaitPrepare(PKT_QUEUE *q)
+{
+	__atomic_store_n(&q->consumerWaiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return (EDPAT_TRUE == PktQueueIsEmpty(q)) ? EDPAT_FALSE : EDPAT_TRUE;
+}
+
+
+/***********************
+ *   PktQueueWaitDone()
+ *
+ *   Consumer is awake again. Stop the producer from writing the eventfd
+ *   and clear any pending wakeup.
+ *
+ *   Arguments :
+ *	q	- INPUT. the queue.
+ *
+ *   Return:	- None
+ *
+ ********/
+void PktQueueWaitDone(PKT_QUEUE *q)
+{
+	eventfd_t val;
+
+	__atomic_store_n(&q->consumerWaiting, 0, __ATOMIC_RELAXED);
+	eventfd_read(q->eventFd, &val);
+	return;
+}
+
+
+/***********************
+ *   PktQueueDequeue()
+ *
+ *   Copy the packet at the head of the queue. Called only by the
+ *   consumer. Waits up to waitMs if the queue is empty.
+ *
+ *   Arguments :
+ *	q	- INPUT. the queue.
+ *      data	- INPUT/OUTPUT. pointer to buffer where the packet is
+ *		  returned.
+ *	dataLen	- INPUT/OUTPUT. caller specify the size of'data'
+ *		  the function will return the size of packet.
+ *	waitMs	- INPUT. How long to wait for packet, in milliseconds.
+ *	rxTime	- OUTPUT. time the packet arrived. May be NULL.
+ *
+ *   Return:	- EDPAT_SUCCESS, EDPAT_NOTFOUND on timeout or EDPAT_FAILED
+ *
+ ********/
+EDPAT_RETVAL PktQueueDequeue(PKT_QUEUE *q,
+			unsigned char *data, int *dataLen, const int waitMs,
+			struct timespec *rxTime)
+{
+	PKT_QUEUE_SLOT *slot;
+	struct pollfd pfd;
+	struct timespec end;
+	int remainingMs = waitMs;
+
+	DeadlineSet(&end, waitMs);
+
+	pfd.fd = q->eventFd;
+	pfd.events = POLLIN;
+
+	while (EDPAT_TRUE == PktQueueIsEmpty(q))
+	{
+		if (0 >= remainingMs)
+		{
+			return EDPAT_NOTFOUND;
+		}
+		if (EDPAT_FALSE == PktQueueWaitPrepare(q))
+		{
+			if ((0 > poll(&pfd, 1, remainingMs)) &&
+			    (EINTR != errno))
+			{
+				PktQueueWaitDone(q);
+				ExecErrorMsgPrint("poll() failed");
+				return EDPAT_FAILED;
+			}
+		}
+		PktQueueWaitDone(q);
+
+		remainingMs = DeadlineRemainingMs(&end);
+	}
+
+	slot = &q->slots[q->head & (q->slotCount - 1)];
+	if ((*dataLen) < slot->pktLen)
+	{
+		ExecErrorMsgPrint("Receive buffer size too small(%d). "
+			"Packet of %d bytes is dropped",
+			(*dataLen), slot->pktLen);
+		__atomic_store_n(&q->dataHead, slot->dataEnd, __ATOMIC_RELEASE);
+		__atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+		return EDPAT_FAILED;
+	}
+	memcpy(data, &q->data[slot->dataPos], slot->pktLen);
+	*dataLen = slot->pktLen;
+	if (NULL != rxTime)
+	{
+		*rxTime = slot->rxTime;
+	}
+	__atomic_store_n(&q->dataHead, slot->dataEnd, __ATOMIC_RELEASE);
+	__atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   PktQueueDropCountGet()
+ *
+ *   Get the number of packets dropped as the queue was full.
+ *
+ *   Arguments :
+ *	q	- INPUT. the queue.
+ *
+ *   Return:	- drop count
+ *
+ ********/
+unsigned long PktQueueDropCountGet(PKT_QUEUE *q)
+{
+	return __atomic_load_n(&q->dropCount, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ * 
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#ifndef __PKTQUEUE_H__
+#define __PKTQUEUE_H__ 1
+
+#include <time.h>
+
+#define CACHE_LINE_SIZE		64
+
+typedef struct {
+	struct timespec	rxTime;		// CLOCK_REALTIME of arrival
+	int		pktLen;
+	unsigned int	dataPos;	// of the packet in 'data' of the queue
+	unsigned long	dataEnd;	// 'dataTail' after the packet
+} PKT_QUEUE_SLOT;
+
+/* Bounded single producer/single consumer queue of packets. The
+   producer (receiver thread) only writes 'tail', the consumer
+   (interpreter) only writes 'head'. The consumer sets 'consumerWaiting'
+   before sleeping on 'eventFd' so that the producer writes the eventfd
+   only when somebody is waiting for it.
+   The bytes of the packets are packed one after the other in 'data',
+   each from a cache line of its own, so that the queue takes what the
+   packets take and not RX_QUEUE_LEN frames of MAX_PKT_SIZE. 'dataHead'
+   and 'dataTail' count the bytes taken and freed so far, the same way
+   as 'head' and 'tail' */
+typedef struct {
+	unsigned int	head __attribute__ ((aligned (CACHE_LINE_SIZE)));
+	unsigned long	dataHead;
+	unsigned int	tail __attribute__ ((aligned (CACHE_LINE_SIZE)));
+	unsigned long	dataTail;
+	unsigned long	dropCount;
+	unsigned long	enqueueCount;
+	int		consumerWaiting __attribute__ ((aligned (CACHE_LINE_SIZE)));
+	int		eventFd;
+	unsigned int	slotCount;	// power of 2
+	PKT_QUEUE_SLOT	*slots;
+	unsigned int	dataSize;	// power of 2
+	unsigned char	*data;
+} PKT_QUEUE;
+
+PKT_QUEUE *PktQueueCreate(const unsigned int slotCount,
+			const unsigned int dataSize);
+void PktQueueDestroy(PKT_QUEUE *q);
+EDPAT_RETVAL PktQueueEnqueue(PKT_QUEUE *q,
+			const unsigned char *pkt, const int pktLen,
+			const struct timespec *rxTime);
+EDPAT_RETVAL PktQueueDequeue(PKT_QUEUE *q,
+			unsigned char *data, int *dataLen, const int waitMs,
+			struct timespec *rxTime);
+EDPAT_BOOL PktQueueIsEmpty(PKT_QUEUE *q);
+const struct timespec *PktQueueHeadTimeGet(PKT_QUEUE *q);
+EDPAT_BOOL PktQueueWaitPrepare(PKT_QUEUE *q);
+void PktQueueWaitDone(PKT_QUEUE *q);
+unsigned long PktQueueDropCountGet(PKT_QUEUE *q);
+
+#endif
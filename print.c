@@ -23,6 +23,7 @@
 #include "edpat.h"
 #include "scripts.h"
 #include "print.h"
+#include "program.h"
 
 #define MAX_MSG_LEN		10000	// Max length of a message
 #define MAX_CHAR_PER_LINE	80
@@ -300,6 +301,12 @@ void VerbosePacketMaskPrint(const void *pkt, const int pktLen)
 			case -2:
 				fprintf(LogFp,"SK ");
 				break;
+			case -4:
+				fprintf(LogFp,"BT ");
+				break;
+			case -5:
+				fprintf(LogFp,"FM ");
+				break;
 			default:
 				fprintf(LogFp,"%-3d",p[i]);
 
@@ -328,7 +335,7 @@ void ScriptErrorMsgPrint( const char *format, ...)
 
 	// construct error string from veriable argumnets
 	va_start (ap, format);
-	vsnprintf (&Msg[14], MAX_MSG_LEN, format, ap);
+	vsnprintf (&Msg[14], MAX_MSG_LEN-14, format, ap);
 	va_end (ap);
 	Msg[MAX_MSG_LEN]=0;
 	
@@ -369,6 +376,21 @@ void MsgTimestampEnable(void)
 	TimestampEnableFlag = EDPAT_TRUE;
 	printf("## Timestamp Enabled.\n");
 }
+// Lines of the report go to stdout, the log and the report file
+static void reportPrint(const char *msg)
+{
+	printf("%s\n",msg);
+	if (LogFp != stdout)
+	{
+		msgPrint(LogFp,msg);
+	}
+	if (ReportFp != stdout)
+	{
+		msgPrint(ReportFp,msg);
+	}
+	return;
+}
+
 /**********************************
  *
  *	TestCaseFinalResultPrint()
@@ -406,15 +428,32 @@ void TestCaseFinalResultPrint(void)
 			return;
 	}
 
-	printf("%s\n",result);
-	if (LogFp != stdout)
-	{
-		msgPrint(LogFp,result);
-	}
-	if (ReportFp != stdout)
-	{
-		msgPrint(ReportFp,result);
-	}
+	reportPrint(result);
+	return;
+}
+
+/**********************************
+ *
+ *	TestCaseReportPrint()
+ *
+ *	It prints a line of the report along with the result of the
+ *	test case, e.g. the latencies measured
+ *	
+ *	Arguments	: format and arguments as printf()
+ *
+ *	Return		: void
+ *
+ * ********************************/
+
+void TestCaseReportPrint( const char *format, ...)
+{
+	va_list ap;
+
+	va_start (ap, format);
+	vsnprintf (Msg, MAX_MSG_LEN, format, ap);
+	va_end (ap);
+
+	reportPrint(Msg);
 	return;
 }
 
@@ -458,22 +497,56 @@ void PrintUsageInfo(const char *exeName)
 {
 	printf("\nUsage: ");
 	printf(
-		"%s [-f] [-h] [-s] [-t] [-v] [-w <waittimeout>] <input-script> [<logfile> [<reportfile>]]\n",
+		"%s [-b <blocktimeout>] [-c] [-C] [-f] [-F <rules>] [-h] [-H] [-n <threads>] [-p] [-q] [-r <ringsize>] [-s] [-t] [-T <threads>] [-u <settletime>] [-v] [-w <waittimeout>] [-x <ringsize>] <input-script> [<logfile> [<reportfile>]]\n",
 		exeName);
 
+	printf("\n\t-b\t- Receive ring block timeout in milliseconds.");
+	printf("\n\t\t  A partly filled block is handed over after this.");
+	printf("\n\t\t  If not specified, %d ms is assumed.",
+			RxRingBlockTimeout);
+	printf("\n\t-c\t- Spread packets over the receiver threads of a");
+	printf("\n\t\t  port by CPU instead of by flow hash.");
+	printf("\n\t-C\t- Load and save the compiled script in");
+	printf("\n\t\t  <input-script>%s.", PROGRAM_CACHE_SUFFIX);
 	printf("\n\t-f\t- Do not filter broadcast packets. ");
 	printf("\n\t\t  All IPv6 packets and ARP,LLDP,IGMP,DHCP,SSDP and MDNS");
 	printf("\n\t\t  are discarded/filtered by default.");
 	printf("\n\t\t  This flag disable this filtering.");
+	printf("\n\t-F\t- Packets to be filtered. <rules> is a comma");
+	printf("\n\t\t  seperated list of arp,lldp,igmp,dhcp,ssdp,mdns,");
+	printf("\n\t\t  ipv6, all or none. Default is all.");
 	printf("\n\t-h\t- Help. Display usage info and exit.");
+	printf("\n\t-H\t- Use hardware timestamps of the NIC where supported,");
+	printf("\n\t\t  and the times packets were sent reported by the kernel.");
+	printf("\n\t-n\t- Number of receiver threads per port.");
+	printf("\n\t\t  If not specified, %d is assumed.",
+			RxThreadCount);
 	printf("\n\t-p\t- Enable promiscuous mode. Default is disabled");
+	printf("\n\t-q\t- Transmit ring bypasses the qdisc layer.");
+	printf("\n\t-r\t- Size of the per port receive ring in KB.");
+	printf("\n\t\t  0 receives with recvmsg() instead of a ring.");
+	printf("\n\t\t  At most %d KB.", MAX_RX_RING_SIZE);
+	printf("\n\t\t  If not specified, %d KB is assumed.",
+			RxRingSize);
 	printf("\n\t-s\t- Syntax checking only. Do not execute test");
 	printf("\n\t-t\t- Enable timestamping of entries in <logfile>");
+	printf("\n\t-T\t- Number of transmit worker threads per port for");
+	printf("\n\t\t  paced sends and sends with a repeat count.");
+	printf("\n\t\t  If not specified, %d is assumed.",
+			TxWorkerCount);
+	printf("\n\t-u\t- Settle time in milliseconds. At the end of a test");
+	printf("\n\t\t  case, wait till all ports are quiet for this long");
+	printf("\n\t\t  while checking for unexpected packets.");
+	printf("\n\t\t  If not specified, %d ms is assumed.",
+			PacketSettleTime);
 	printf("\n\t-v\t- Enable verbose mode in <logfile>");
 	printf("\n\t-w\t- Timeout period while waiting for receiving packet.");
 	printf("\n\t\t  <waittimeout> is specified in seconds.");
 	printf("\n\t\t  If not specified, %d seconds is assumed.",
 			PacketReceiveTimeout);
+	printf("\n\t-x\t- Size of the per port transmit ring in KB.");
+	printf("\n\t\t  If not specified or 0, sendto() is used.");
+	printf("\n\t\t  At most %d KB.", MAX_TX_RING_SIZE);
 	printf("\n<input-script>\t- input test script file. "
 			"Mandatory parameter");
 	printf("\n<logfile>\t- output file for test logs. "
@@ -29,6 +29,7 @@ void lexecErrorPrint( const char *srcFileName,
 void MsgTimestampEnable(void);
 
 void TestCaseFinalResultPrint(void);
+void TestCaseReportPrint( const char *format, ...);
 void TestCaseStringPrint( const char *format, ...);
 void TestCasePacketPrint(const void *pkt, const int pktLen);
 void TestCasePacketHeaderPrint(const void *pkt);
@@ -0,0 +1,831 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "edpat.h"
+#include "scripts.h"
+#include "testcase.h"
+#include "variable.h"
+#include "packet.h"
+#include "print.h"
+#include "setting.h"
+#include "utils.h"
+#include "program.h"
+
+/* The test script is compiled into a program before it is run. The
+   included files are compiled in place and the variables are
+   substituted as the statements are read, so only the test cases,
+   packets and settings are left as ops. A statement that does not
+   compile is an op too, which skips its test case when it is reached,
+   as the statement would have when run */
+typedef enum {
+	PROGRAM_OP_TESTCASE,	// '@'
+	PROGRAM_OP_PACKET,	// '<' or '>'
+	PROGRAM_OP_SETTING,	// '%'
+	PROGRAM_OP_INCLUDE,	// '#', the ops of the file follow it
+	PROGRAM_OP_FAILED	// statement that did not compile
+} PROGRAM_OP_TYPE;
+
+typedef struct {
+	PROGRAM_OP_TYPE	type;
+	const SCRIPT_FRAME *frame;	// file of the statement
+	int		lineNo;
+	// run even if the test case has failed, like '@'
+	EDPAT_BOOL	always;
+	int		end;		// INCLUDE, index after the last op
+	union {
+		char		testCaseId[MAX_TESTCASE_ID_LEN+1];
+		PACKET_STATEMENT *packet;
+		char		*setting;
+	} u;
+} PROGRAM_OP;
+
+static PROGRAM_OP *ProgramOp = NULL;
+static int ProgramOpCount = 0;
+static int ProgramOpAllocCount = 0;
+static int ProgramErrorCount = 0;	// statements that did not compile
+
+/* The program of a script with no errors is kept in a cache file next
+   to it. It is
+	PROGRAM_CACHE_HEADER
+	PROGRAM_CACHE_FRAME	for each script file, the script first
+	PROGRAM_CACHE_OP	for each op
+	packet statements and settings, each at a multiple of 8 bytes
+   It is only used by the same edpat executable that wrote it, as the
+   packet statements are laid out by the files it is built from, and
+   when none of the script files has changed since. The packet
+   statements and settings of a program loaded from it are used where
+   the file is mapped */
+typedef struct {
+	char		magic[8];	// PROGRAM_CACHE_MAGIC
+	uint64_t	exeHash;	// of the edpat that wrote it
+	uint64_t	size;		// of the file
+	uint64_t	hash;		// of the file after the header
+	int32_t		frameCount;
+	int32_t		opCount;
+} PROGRAM_CACHE_HEADER;
+
+typedef struct {
+	uint64_t	hash;		// of the file when compiled
+	char		fileName[MAX_FILE_NAME_LEN+1];
+	int32_t		includeLineNo;
+	int32_t		parent;		// index of the frame, -1 if none
+} PROGRAM_CACHE_FRAME;
+
+typedef struct {
+	int32_t		type;
+	int32_t		frame;		// index of the frame
+	int32_t		lineNo;
+	int32_t		always;
+	int32_t		end;
+	char		testCaseId[MAX_TESTCASE_ID_LEN+1];
+	uint64_t	offset;		// of the packet or setting in the file
+	uint64_t	len;
+} PROGRAM_CACHE_OP;
+
+static void *ProgramCacheMap = NULL;	// cache file the program is from
+static size_t ProgramCacheMapSize = 0;
+
+
+/***********************
+ *   programExeHashGet()
+ *
+ *   Hash the edpat executable running, once.
+ *
+ *   Arguments :
+ *	hash	- OUTPUT. its hash.
+ *
+ *   Return:	- EDPAT_SUCCESS, EDPAT_FAILED if it could not be read
+ *
+ ********/
+static EDPAT_RETVAL programExeHashGet(uint64_t *hash)
+{
+	static EDPAT_RETVAL ret = EDPAT_NOTFOUND;
+	static uint64_t exeHash;
+
+	if (EDPAT_NOTFOUND == ret)
+	{
+		ret = FileHashGet(PROGRAM_CACHE_EXE_FILE_NAME, &exeHash);
+	}
+	*hash = exeHash;
+	return ret;
+}
+
+
+/***********************
+ *   programOpAdd()
+ *
+ *   Add an op to the program, for the statement read last.
+ *
+ *   Arguments :
+ *	type	- INPUT. type of the op.
+ *
+ *   Return:	- the op, NULL if out of memory
+ *
+ ********/
+static PROGRAM_OP *programOpAdd(const PROGRAM_OP_TYPE type)
+{
+	PROGRAM_OP *op;
+
+	if (ProgramOpAllocCount <= ProgramOpCount)
+	{
+		op = realloc(ProgramOp, (ProgramOpAllocCount +
+			PROGRAM_OP_ALLOC_COUNT) * sizeof(PROGRAM_OP));
+		if (NULL == op)
+		{
+			ExecErrorMsgPrint("Failed to allocate memory for %d "
+				"statements", ProgramOpCount + 1);
+			return NULL;
+		}
+		ProgramOp = op;
+		ProgramOpAllocCount += PROGRAM_OP_ALLOC_COUNT;
+	}
+	op = &ProgramOp[ProgramOpCount++];
+	memset(op,0,sizeof(*op));
+	op->type = type;
+	op->frame = ScriptFrameGet(&op->lineNo);
+	return op;
+}
+
+
+/***********************
+ *   programStatementCompile()
+ *
+ *   Compile a statement of the script into ops of the program.
+ *
+ *   Arguments :
+ *	statement - INPUT. the statement, with its variables
+ *		  substituted. It is split up in place.
+ *
+ *   Return:	- EDPAT_SUCCESS, EDPAT_FAILED if the statement did not
+ *		  compile and EDPAT_NOTFOUND if out of memory
+ *
+ ********/
+static EDPAT_RETVAL programStatementCompile(char *statement)
+{
+	PROGRAM_OP *op;
+	EDPAT_RETVAL retVal;
+	int begin;
+
+	switch(statement[0])
+	{
+		case '#':
+			/* include file an recursivily compile the
+			   included file as well */
+			begin = ProgramOpCount;
+			if (NULL == programOpAdd(PROGRAM_OP_INCLUDE))
+			{
+				return EDPAT_NOTFOUND;
+			}
+			retVal = ScriptIncludeFile(statement);
+			ProgramOp[begin].end = ProgramOpCount;
+			return retVal;
+		case '@':	// test case ID
+			op = programOpAdd(PROGRAM_OP_TESTCASE);
+			if (NULL == op)
+			{
+				return EDPAT_NOTFOUND;
+			}
+			if (EDPAT_SUCCESS !=
+				TestCaseIdRead(statement,op->u.testCaseId))
+			{
+				ProgramOpCount--;
+				return EDPAT_FAILED;
+			}
+			return EDPAT_SUCCESS;
+		case '<':	// Receive packet
+		case '>':	// Send packet
+			op = programOpAdd(PROGRAM_OP_PACKET);
+			if (NULL == op)
+			{
+				return EDPAT_NOTFOUND;
+			}
+			op->u.packet = PacketCompile(statement);
+			if (NULL == op->u.packet)
+			{
+				ProgramOpCount--;
+				return EDPAT_FAILED;
+			}
+			return EDPAT_SUCCESS;
+		case '$':	// assign value to variable, in the order of
+				// the files, not of the test cases run
+			return VariableStoreValue(statement);
+		case '%':	// change a setting, when it is reached
+			op = programOpAdd(PROGRAM_OP_SETTING);
+			if (NULL == op)
+			{
+				return EDPAT_NOTFOUND;
+			}
+			op->u.setting = strdup(statement);
+			if (NULL == op->u.setting)
+			{
+				ProgramOpCount--;
+				ExecErrorMsgPrint("Failed to allocate memory "
+					"for a setting");
+				return EDPAT_NOTFOUND;
+			}
+			return EDPAT_SUCCESS;
+		default:
+			// Unknown command
+			ScriptErrorMsgPrint("Unknown statement '%c(%d)'",
+				statement[0], statement[0]);
+			return EDPAT_FAILED;
+	}
+}
+
+
+/***********************
+ *   ProgramCompile()
+ *
+ *   Read a test script statement by statement and compile it into the
+ *   program. An include statement compiles the file included by
+ *   calling it again.
+ *
+ *   Arguments :
+ *	fileName - INPUT. Name of the test script file to be compiled.
+ *
+ *   Return:	- EDPAT_SUCCESS, or EDPAT_FAILED if the file could not be
+ *		  opened or the program not kept in memory
+ *
+ ********/
+EDPAT_RETVAL ProgramCompile(const char *fileName)
+{
+	SCRIPT_INFO *script;
+	PROGRAM_OP *op;
+	char *statement;
+	EDPAT_BOOL always;
+	EDPAT_RETVAL retVal = EDPAT_SUCCESS;
+
+	/* Open the file handle for the script file and add details to
+	   the scriptinfo table */
+	script = ScriptOpen(fileName);
+	if (NULL == script)
+	{
+		return EDPAT_FAILED;
+	};
+
+	// Keep reading statements from the opened file
+	while ((EDPAT_NOTFOUND != retVal) &&
+	       (NULL != (statement = ScriptReadStatement(script))))
+	{
+		/* Substitute each occurence of a variable with its
+		   coressponding value. A statement with a variable not
+		   defined skips the test case even if it has failed.
+		   The bytes of a variable in a packet are copied by
+		   PacketCompile() */
+		always = EDPAT_TRUE;
+		retVal = EDPAT_FAILED;
+		statement = ScriptSubstituteVariables(statement,
+			(('<' == statement[0]) || ('>' == statement[0])) ?
+				EDPAT_TRUE : EDPAT_FALSE);
+		if (NULL != statement)
+		{
+			always = ('@' == statement[0]) ?
+				EDPAT_TRUE : EDPAT_FALSE;
+			retVal = programStatementCompile(statement);
+		}
+		if (EDPAT_FAILED != retVal)
+		{
+			continue;
+		}
+		op = programOpAdd(PROGRAM_OP_FAILED);
+		if (NULL == op)
+		{
+			retVal = EDPAT_NOTFOUND;
+			continue;
+		}
+		op->always = always;
+		ProgramErrorCount++;
+	};
+	ScriptClose(script);
+	return (EDPAT_NOTFOUND == retVal) ? EDPAT_FAILED : EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   programCacheFileName()
+ *
+ *   Get the name of the cache file of a test script.
+ *
+ *   Arguments :
+ *	fileName - INPUT. Name of the test script file.
+ *	cacheFileName - OUTPUT. the name, MAX_PROGRAM_CACHE_FILE_NAME_LEN
+ *		  characters at most.
+ *
+ *   Return:	- EDPAT_SUCCESS, EDPAT_FAILED if the name is too long
+ *
+ ********/
+static EDPAT_RETVAL programCacheFileName(const char *fileName,
+			char *cacheFileName)
+{
+	if (MAX_FILE_NAME_LEN < strlen(fileName))
+	{
+		return EDPAT_FAILED;
+	}
+	sprintf(cacheFileName, "%s" PROGRAM_CACHE_SUFFIX, fileName);
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   programCacheCheck()
+ *
+ *   Check if a cache file mapped is one of the test script made by
+ *   this edpat, with none of the script files changed since and all
+ *   its parts within the file.
+ *
+ *   Arguments :
+ *	fileName - INPUT. Name of the test script file.
+ *	cache	- INPUT. the cache file mapped.
+ *	size	- INPUT. its size.
+ *
+ *   Return:	- EDPAT_TRUE if the program can be loaded from it
+ *
+ ********/
+static EDPAT_BOOL programCacheCheck(const char *fileName,
+			const char *cache, const size_t size)
+{
+	const PROGRAM_CACHE_HEADER *header = (const void *) cache;
+	const PROGRAM_CACHE_FRAME *frame;
+	const PROGRAM_CACHE_OP *op;
+	uint64_t hash;
+	uint64_t exeHash;
+	size_t tableSize;
+	int i;
+
+	if ((sizeof(*header) > size) ||
+	    (0 != memcmp(header->magic, PROGRAM_CACHE_MAGIC,
+			sizeof(header->magic))) ||
+	    (EDPAT_SUCCESS != programExeHashGet(&exeHash)) ||
+	    (exeHash != header->exeHash) ||
+	    (size != header->size) ||
+	    (header->hash != HashBytes(&header[1], size - sizeof(*header),
+			HASH_INIT)) ||
+	    (0 >= header->frameCount) || (0 > header->opCount))
+	{
+		return EDPAT_FALSE;
+	}
+	tableSize = header->frameCount * sizeof(*frame) +
+			header->opCount * sizeof(*op);
+	if ((size - sizeof(*header)) < tableSize)
+	{
+		return EDPAT_FALSE;
+	}
+
+	frame = (const void *) &header[1];
+	for (i=0; i < header->frameCount; i++)
+	{
+		if ((0 != frame[i].fileName[MAX_FILE_NAME_LEN]) ||
+		    (i <= frame[i].parent) ||
+		    ((0 == i) != (0 > frame[i].parent)) ||
+		    (EDPAT_SUCCESS != FileHashGet(frame[i].fileName, &hash)) ||
+		    (hash != frame[i].hash))
+		{
+			return EDPAT_FALSE;
+		}
+	}
+	if (0 != strcmp(frame[0].fileName, fileName))
+	{
+		return EDPAT_FALSE;
+	}
+
+	op = (const void *) &frame[header->frameCount];
+	for (i=0; i < header->opCount; i++)
+	{
+		if ((0 > op[i].frame) || (header->frameCount <= op[i].frame) ||
+		    (0 != op[i].testCaseId[MAX_TESTCASE_ID_LEN]) ||
+		    (op[i].offset > size) || (op[i].len > size - op[i].offset) ||
+		    (0 != (op[i].offset % 8)))
+		{
+			return EDPAT_FALSE;
+		}
+		switch (op[i].type)
+		{
+			case PROGRAM_OP_PACKET:
+				if (EDPAT_TRUE != PacketStatementCheck(
+					(const void *) &cache[op[i].offset],
+					op[i].len))
+				{
+					return EDPAT_FALSE;
+				}
+				break;
+			case PROGRAM_OP_SETTING:
+				if ((0 == op[i].len) ||
+				    (0 != cache[op[i].offset + op[i].len - 1]))
+				{
+					return EDPAT_FALSE;
+				}
+				break;
+			case PROGRAM_OP_INCLUDE:
+				if ((i >= op[i].end) ||
+				    (header->opCount < op[i].end))
+				{
+					return EDPAT_FALSE;
+				}
+				break;
+			case PROGRAM_OP_TESTCASE:
+				break;
+			default:
+				return EDPAT_FALSE;
+		}
+	}
+	return EDPAT_TRUE;
+}
+
+
+/***********************
+ *   ProgramCacheLoad()
+ *
+ *   Load the program of a test script from its cache file, if it is
+ *   there and none of the script files have changed since. The file
+ *   is mapped, not read.
+ *
+ *   Arguments :
+ *	fileName - INPUT. Name of the test script file.
+ *
+ *   Return:	- EDPAT_SUCCESS, or EDPAT_FAILED if the script is to be
+ *		  compiled
+ *
+ ********/
+EDPAT_RETVAL ProgramCacheLoad(const char *fileName)
+{
+	char cacheFileName[MAX_PROGRAM_CACHE_FILE_NAME_LEN+1];
+	const PROGRAM_CACHE_HEADER *header;
+	const PROGRAM_CACHE_FRAME *frame;
+	const PROGRAM_CACHE_OP *cacheOp;
+	const SCRIPT_FRAME **frames;
+	PROGRAM_OP *op;
+	struct stat st;
+	char *cache;
+	int fd;
+	int i;
+
+	if (EDPAT_SUCCESS != programCacheFileName(fileName, cacheFileName))
+	{
+		return EDPAT_FAILED;
+	}
+	fd = open(cacheFileName, O_RDONLY);
+	if (0 > fd)
+	{
+		return EDPAT_FAILED;
+	}
+	if ((0 != fstat(fd, &st)) || (!S_ISREG(st.st_mode)) ||
+	    (0 == st.st_size))
+	{
+		close(fd);
+		return EDPAT_FAILED;
+	}
+	cache = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == cache)
+	{
+		return EDPAT_FAILED;
+	}
+	if (EDPAT_TRUE != programCacheCheck(fileName, cache, st.st_size))
+	{
+		VerboseStringPrint("Cache '%s' is out of date, compiling '%s'",
+			cacheFileName, fileName);
+		munmap(cache, st.st_size);
+		return EDPAT_FAILED;
+	}
+
+	header = (const void *) cache;
+	frame = (const void *) &header[1];
+	cacheOp = (const void *) &frame[header->frameCount];
+	frames = malloc(header->frameCount * sizeof(*frames));
+	op = malloc((header->opCount + 1) * sizeof(*op));
+	if ((NULL == frames) || (NULL == op))
+	{
+		ExecErrorMsgPrint("Failed to allocate memory for %d "
+			"statements", header->opCount);
+		free(frames);
+		free(op);
+		munmap(cache, st.st_size);
+		return EDPAT_FAILED;
+	}
+	for (i=0; i < header->frameCount; i++)
+	{
+		frames[i] = ScriptFrameAdd(frame[i].fileName,
+			frame[i].includeLineNo,
+			(0 > frame[i].parent) ? NULL : frames[frame[i].parent]);
+		if (NULL == frames[i])
+		{
+			free(frames);
+			free(op);
+			munmap(cache, st.st_size);
+			ScriptFramesFree();
+			return EDPAT_FAILED;
+		}
+	}
+	for (i=0; i < header->opCount; i++)
+	{
+		memset(&op[i], 0, sizeof(op[i]));
+		op[i].type = cacheOp[i].type;
+		op[i].frame = frames[cacheOp[i].frame];
+		op[i].lineNo = cacheOp[i].lineNo;
+		op[i].always = cacheOp[i].always;
+		op[i].end = cacheOp[i].end;
+		if (PROGRAM_OP_TESTCASE == op[i].type)
+		{
+			strcpy(op[i].u.testCaseId, cacheOp[i].testCaseId);
+		}
+		else if (PROGRAM_OP_PACKET == op[i].type)
+		{
+			op[i].u.packet = (void *) &cache[cacheOp[i].offset];
+		}
+		else if (PROGRAM_OP_SETTING == op[i].type)
+		{
+			op[i].u.setting = &cache[cacheOp[i].offset];
+		}
+	}
+	free(frames);
+
+	ProgramOp = op;
+	ProgramOpCount = header->opCount;
+	ProgramOpAllocCount = header->opCount + 1;
+	ProgramCacheMap = cache;
+	ProgramCacheMapSize = st.st_size;
+	VerboseStringPrint("Loaded %d statements of '%s' from cache '%s'",
+		ProgramOpCount, fileName, cacheFileName);
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   ProgramCacheSave()
+ *
+ *   Save the program compiled to the cache file of the test script, if
+ *   all of its statements compiled. The file is written under another
+ *   name and renamed, so a run at the same time never sees half of it.
+ *   A cache that cannot be written is only reported in verbose mode.
+ *
+ *   Arguments :
+ *	fileName - INPUT. Name of the test script file.
+ *
+ *   Return:	- None
+ *
+ ********/
+void ProgramCacheSave(const char *fileName)
+{
+	char cacheFileName[MAX_PROGRAM_CACHE_FILE_NAME_LEN+1];
+	char tmpFileName[MAX_PROGRAM_CACHE_FILE_NAME_LEN+
+				sizeof(PROGRAM_CACHE_TMP_SUFFIX)];
+	PROGRAM_CACHE_HEADER *header;
+	PROGRAM_CACHE_FRAME *frame;
+	PROGRAM_CACHE_OP *cacheOp;
+	const SCRIPT_FRAME *scriptFrame;
+	char *cache;
+	size_t size;
+	size_t len;
+	int frameCount;
+	FILE *fp;
+	int i;
+
+	if ((0 != ProgramErrorCount) || (NULL != ProgramCacheMap) ||
+	    (EDPAT_SUCCESS != programCacheFileName(fileName, cacheFileName)))
+	{
+		return;
+	}
+	scriptFrame = ScriptFramesGet(&frameCount);
+
+	// Size the file, the parts of the ops each at a multiple of 8
+	size = sizeof(*header) + frameCount * sizeof(*frame) +
+			ProgramOpCount * sizeof(*cacheOp);
+	for (i=0; i < ProgramOpCount; i++)
+	{
+		if (PROGRAM_OP_PACKET == ProgramOp[i].type)
+		{
+			size += (PacketStatementSize(ProgramOp[i].u.packet)
+					+ 7) & ~7;
+		}
+		else if (PROGRAM_OP_SETTING == ProgramOp[i].type)
+		{
+			size += (strlen(ProgramOp[i].u.setting) + 1 + 7) & ~7;
+		}
+	}
+	cache = calloc(1, size);
+	if (NULL == cache)
+	{
+		VerboseStringPrint("No memory to write cache '%s'",
+			cacheFileName);
+		return;
+	}
+	header = (void *) cache;
+	frame = (void *) &header[1];
+	cacheOp = (void *) &frame[frameCount];
+
+	memcpy(header->magic, PROGRAM_CACHE_MAGIC, sizeof(header->magic));
+	if (EDPAT_SUCCESS != programExeHashGet(&header->exeHash))
+	{
+		VerboseStringPrint("Failed to read '%s' to write cache '%s'",
+			PROGRAM_CACHE_EXE_FILE_NAME, cacheFileName);
+		free(cache);
+		return;
+	}
+	header->size = size;
+	header->frameCount = frameCount;
+	header->opCount = ProgramOpCount;
+	for (; NULL != scriptFrame; scriptFrame = scriptFrame->next)
+	{
+		i = scriptFrame->index;
+		strcpy(frame[i].fileName, scriptFrame->fileName);
+		frame[i].includeLineNo = scriptFrame->includeLineNo;
+		frame[i].parent = (NULL == scriptFrame->parent) ? (-1) :
+				scriptFrame->parent->index;
+		if (EDPAT_SUCCESS != FileHashGet(scriptFrame->fileName,
+				&frame[i].hash))
+		{
+			VerboseStringPrint("Failed to read '%s' to write "
+				"cache '%s'", scriptFrame->fileName,
+				cacheFileName);
+			free(cache);
+			return;
+		}
+	}
+
+	size = (char *) &cacheOp[ProgramOpCount] - cache;
+	for (i=0; i < ProgramOpCount; i++)
+	{
+		cacheOp[i].type = ProgramOp[i].type;
+		cacheOp[i].frame = ProgramOp[i].frame->index;
+		cacheOp[i].lineNo = ProgramOp[i].lineNo;
+		cacheOp[i].always = ProgramOp[i].always;
+		cacheOp[i].end = ProgramOp[i].end;
+		len = 0;
+		if (PROGRAM_OP_TESTCASE == ProgramOp[i].type)
+		{
+			strcpy(cacheOp[i].testCaseId, ProgramOp[i].u.testCaseId);
+		}
+		else if (PROGRAM_OP_PACKET == ProgramOp[i].type)
+		{
+			len = PacketStatementSize(ProgramOp[i].u.packet);
+			memcpy(&cache[size], ProgramOp[i].u.packet, len);
+		}
+		else if (PROGRAM_OP_SETTING == ProgramOp[i].type)
+		{
+			len = strlen(ProgramOp[i].u.setting) + 1;
+			memcpy(&cache[size], ProgramOp[i].u.setting, len);
+		}
+		cacheOp[i].offset = size;
+		cacheOp[i].len = len;
+		size += (len + 7) & ~7;
+	}
+	header->hash = HashBytes(&header[1], size - sizeof(*header),
+				HASH_INIT);
+
+	sprintf(tmpFileName, "%s" PROGRAM_CACHE_TMP_SUFFIX, cacheFileName);
+	fp = fopen(tmpFileName, "wb");
+	if ((NULL == fp) || (1 != fwrite(cache, size, 1, fp)) ||
+	    (0 != fclose(fp)) || (0 != rename(tmpFileName, cacheFileName)))
+	{
+		VerboseStringPrint("Failed to write cache '%s'",
+			cacheFileName);
+		if (NULL != fp)
+		{
+			remove(tmpFileName);
+		}
+	}
+	else
+	{
+		VerboseStringPrint("Saved %d statements of '%s' to cache '%s'",
+			ProgramOpCount, fileName, cacheFileName);
+	}
+	free(cache);
+	return;
+}
+
+
+/***********************
+ *   ProgramExecute()
+ *
+ *   Run the program compiled. Once a test case has failed or is
+ *   skipped, its ops are skipped till the next test case, the ops of
+ *   a file included in it along with the rest. Errors are printed with
+ *   the backtrace of the statement of the op. Packets are not sent or
+ *   received when only the syntax is checked.
+ *
+ *   Arguments : None
+ *
+ *   Return:	- None, but sets CurrentTestResult
+ *
+ ********/
+void ProgramExecute(void)
+{
+	PROGRAM_OP *op;
+	EDPAT_RETVAL retVal;
+	int i;
+
+	for (i=0; i < ProgramOpCount; i++)
+	{
+		op = &ProgramOp[i];
+		ScriptFrameSet(op->frame, op->lineNo);
+
+		/* If test case fails or is faulty skip until the next
+		   testcase ID */
+		if (( PROGRAM_OP_TESTCASE != op->type ) &&
+		    ( EDPAT_TRUE != op->always ) &&
+		    ( ( EDPAT_TEST_RESULT_SKIPPED == CurrentTestResult) ||
+		      ( EDPAT_TEST_RESULT_FAILED ==  CurrentTestResult)))
+		{
+			if (PROGRAM_OP_INCLUDE == op->type)
+			{
+				i = op->end - 1;
+			}
+			continue;
+		}
+
+		switch(op->type)
+		{
+			case PROGRAM_OP_TESTCASE:
+				TestCaseBegin(op->u.testCaseId);
+				retVal = EDPAT_SUCCESS;
+				break;
+			case PROGRAM_OP_PACKET:
+				if ( EDPAT_TEST_RESULT_UNKNOWN ==
+							CurrentTestResult)
+				{
+					/*Set to passed when you see the
+					  first send case or receive case */
+					CleanupLastTestExecution();
+					CurrentTestResult =
+						EDPAT_TEST_RESULT_PASSED;
+				}
+				retVal = (EDPAT_TRUE == SyntaxCheckOnly) ?
+					EDPAT_SUCCESS :
+					PacketExecute(op->u.packet);
+				break;
+			case PROGRAM_OP_SETTING:
+				retVal = SettingStoreValue(op->u.setting);
+				break;
+			case PROGRAM_OP_INCLUDE:
+				retVal = EDPAT_SUCCESS;
+				break;
+			case PROGRAM_OP_FAILED:
+			default:
+				retVal = EDPAT_FAILED;
+				break;
+		}
+		if ( EDPAT_SUCCESS != retVal)
+		{
+			CurrentTestResult = EDPAT_TEST_RESULT_SKIPPED;
+		}
+	}
+	ScriptFrameSet(NULL, 0);
+	return;
+}
+
+
+/***********************
+ *   ProgramFree()
+ *
+ *   Free the program compiled or loaded, the frames of its script
+ *   files and the variables.
+ *
+ *   Arguments : None
+ *
+ *   Return:	- None
+ *
+ ********/
+void ProgramFree(void)
+{
+	int i;
+
+	for (i=0; (NULL == ProgramCacheMap) && (i < ProgramOpCount); i++)
+	{
+		if (PROGRAM_OP_PACKET == ProgramOp[i].type)
+		{
+			PacketFree(ProgramOp[i].u.packet);
+		}
+		else if (PROGRAM_OP_SETTING == ProgramOp[i].type)
+		{
+			free(ProgramOp[i].u.setting);
+		}
+	}
+	if (NULL != ProgramCacheMap)
+	{
+		munmap(ProgramCacheMap, ProgramCacheMapSize);
+		ProgramCacheMap = NULL;
+		ProgramCacheMapSize = 0;
+	}
+	free(ProgramOp);
+	ProgramOp = NULL;
+	ProgramOpCount = 0;
+	ProgramOpAllocCount = 0;
+	ProgramErrorCount = 0;
+	ScriptFramesFree();
+	VariablesFree();
+	return;
+}
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#ifndef __PROGRAM_H__
+#define __PROGRAM_H__ 1
+
+#define PROGRAM_OP_ALLOC_COUNT	256	// ops the program grows by
+#define PROGRAM_CACHE_SUFFIX	".cache"	// of the cache of a script
+#define PROGRAM_CACHE_TMP_SUFFIX ".tmp"		// of a cache being written
+#define PROGRAM_CACHE_MAGIC	"EDPATPC2"
+// the cache is used only by the executable that wrote it
+#define PROGRAM_CACHE_EXE_FILE_NAME	"/proc/self/exe"
+#define MAX_PROGRAM_CACHE_FILE_NAME_LEN	\
+		(MAX_FILE_NAME_LEN + sizeof(PROGRAM_CACHE_SUFFIX) - 1)
+
+EDPAT_RETVAL ProgramCompile(const char *fileName);
+void ProgramExecute(void);
+EDPAT_RETVAL ProgramCacheLoad(const char *fileName);
+void ProgramCacheSave(const char *fileName);
+void ProgramFree(void);
+
+#endif
@@ -13,21 +13,44 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "edpat.h"
 #include "scripts.h"
 #include "variable.h"
 #include "print.h"
 #include "utils.h"
+#include "program.h"
 
-typedef struct {
+/* A script file being compiled. It is mapped privately and each
+   statement is cleaned up in place, so the kernel only copies the pages
+   of statements that are changed and there is no limit on the length
+   of a line or a statement */
+struct scriptInfo {
         char    fileName[MAX_FILE_NAME_LEN+1];
         int     lineNo;
-}  SCRIPT_INFO;
+	SCRIPT_FRAME *frame;
+	char	*data;		// the file mapped, NULL if empty
+	size_t	size;
+	size_t	pos;		// of the next statement
+	char	*tail;		// last statement if not ended by ';'
+};
+
+typedef struct {
+	char	*data;
+	size_t	size;
+} SCRIPT_BUFFER;
 
 static int ScriptFileDepth = (-1);
 static SCRIPT_INFO ScriptFileInfoTable[MAX_SCRIPT_FILE_DEPTH];
-static char ScriptLine[MAX_SCRIPT_LINE_LEN+1];
+static SCRIPT_FRAME *ScriptFrameList = NULL;	// newest first
+static int ScriptFrameCount = 0;
+// Statement being executed, NULL while the script is compiled
+static const SCRIPT_FRAME *ScriptExecFrame = NULL;
+static int ScriptExecLineNo;
+// Statement with its variables substituted
+static SCRIPT_BUFFER ScriptSubstituteBuffer;
 
 
 /***************************
@@ -35,91 +58,123 @@ static char ScriptLine[MAX_SCRIPT_LINE_LEN+1];
  *
  *	ScriptReadStatement()
  *
- *	Read a statement from the file provided
+ *	Read the next statement of the file. Comments are removed,
+ *	control characters made spaces and runs of spaces made one,
+ *	in the file mapped. The rest of a line after the ';' ending a
+ *	statement is ignored, a statement starts on a new line
  *
- *	Arguments 	: 	fp - the input file handle, also keeps
- *				     track of the current position of
- *				     the read
- *				scriptStatement - the statement that is
- *				     read is loaded to this string
- *				     scriptStatement will have comments
- *				     removed 
- *	Return 		:	the strlen or length of the statement read
+ *	Arguments 	: 	script - the script file opened, also
+ *				     keeps track of the current position
+ *				     of the read
+ *	Return 		:	the statement, NULL at the end of the
+ *				file. It is valid till the file is closed
+ *				and can be changed by the caller
  *
  *
  *
  * ************************/
 
 
-int ScriptReadStatement(FILE *fp,char *scriptStatement)
+char *ScriptReadStatement(SCRIPT_INFO *script)
 {
-	int stLen = 0;
-	int i;
 	EDPAT_BOOL wasLastCharSpace = EDPAT_TRUE;
-	
+	unsigned char c;
+	char *end;
+	char *in;
+	char *out;
+	char *statement;
 
-	scriptStatement[0] = 0;
-
-	// get each line
-	while(NULL != fgets(ScriptLine,MAX_SCRIPT_LINE_LEN,fp))
+	if (NULL == script->data)
 	{
-
-		ScriptFileInfoTable[ScriptFileDepth].lineNo++;
-		for(i=0; (0 != ScriptLine[i]); i++) 
+		return NULL;
+	}
+	end = &script->data[script->size];
+	in = &script->data[script->pos];
+	statement = in;
+	out = statement;
+	while (in < end)
+	{
+		if ((in == script->data) || ('\n' == in[-1]))
 		{
-			if (	( 32 > ScriptLine[i]) ||
-				( 126 < ScriptLine[i])   )
-			{
-				// replace any control char with space
-				ScriptLine[i] = ' ';
-			}; 
-			if ('!' == ScriptLine[i])
+			script->lineNo++;
+		}
+		c = (unsigned char) *in++;
+		if ((32 > c) || (126 < c))
+		{
+			// replace any control char with space
+			c = ' ';
+		}
+		if ('!' == c)
+		{
+			//  Skip rest of line after '!'
+			if (EDPAT_TRUE != wasLastCharSpace)
 			{
-				//  Skip rest of line after '!'
-				if (EDPAT_TRUE != wasLastCharSpace)
-				{
-					scriptStatement[stLen] = ' ';
-					stLen++;
-					wasLastCharSpace = EDPAT_TRUE;
-				}
-				break;
-			};
-			if (';' == ScriptLine[i])
+				*out++ = ' ';
+				wasLastCharSpace = EDPAT_TRUE;
+			}
+			in = memchr(in, '\n', end - in);
+			in = (NULL == in) ? end : in;
+			continue;
+		}
+		if (';' == c)
+		{
+			// end of statement marker ';' found
+			if (out == statement)
 			{
-				// end of statement marker ';' found
-				if ( 0 == stLen)
-				{
-					// nothing int the statment. Skip it
-					continue;
-				}
-				scriptStatement[stLen]=0;
-				return stLen;
-			};
-			if (' ' == ScriptLine[i])
+				// nothing int the statment. Skip it
+				statement = in;
+				out = in;
+				continue;
+			}
+			*out = 0;
+			in = memchr(in, '\n', end - in);
+			script->pos = (NULL == in) ? script->size :
+					(size_t) (in - script->data);
+			return statement;
+		}
+		if (' ' == c)
+		{
+			/* remove extra spaces jusst keep one
+			   if needed */
+			if (EDPAT_TRUE == wasLastCharSpace)
 			{
-				/* remove extra spaces jusst keep one
-				   if needed */
-				if ( EDPAT_FALSE == wasLastCharSpace) 
+				if (out == statement)
 				{
-					scriptStatement[stLen]
-						= ScriptLine[i];
-					stLen++;
+					// not even begun, start after it
+					statement = in;
+					out = in;
 				}
-				wasLastCharSpace = EDPAT_TRUE;
-			}
-			else
-			{
-				//store everything else into scriptStatement
-				scriptStatement[stLen] = ScriptLine[i];
-				stLen++;
-				wasLastCharSpace = EDPAT_FALSE;
+				continue;
 			}
+			wasLastCharSpace = EDPAT_TRUE;
 		}
+		else
+		{
+			wasLastCharSpace = EDPAT_FALSE;
+		}
+		// the page is only written if the statement has changed
+		if (c != (unsigned char) *out)
+		{
+			*out = c;
+		}
+		out++;
+	}
+	script->pos = script->size;
+	if (out == statement)
+	{
+		return NULL;
 	}
 
-	// null terminate string
-	scriptStatement[stLen]=0;
-	return stLen;
+	/* The last statement has no ';' and may end at the end of the
+	   mapping, with no room for its null */
+	free(script->tail);
+	script->tail = strndup(statement, out - statement);
+	if (NULL == script->tail)
+	{
+		ExecErrorMsgPrint("Failed to allocate memory for a statement "
+			"of %d characters", (int) (out - statement));
+	}
+	return script->tail;
 }
 
 
@@ -129,27 +184,49 @@ int ScriptReadStatement(FILE *fp,char *scriptStatement)
  *
  * 	Opens the file with name given, checks if within MAX limit
  * 	Log the scriptfile depth,name and line no in the ScriptFileInfoTable
+ *	The file is mapped for ScriptReadStatement()
  *
  *	Arguments	:	fileName - Name of the file to be opened
- *	Return 		:	the file pointer received on opening
- *				said file
+ *	Return 		:	the script file opened, NULL on errors
  *
  *
  ***************/
-FILE *ScriptOpen(const char *fileName)
+SCRIPT_INFO *ScriptOpen(const char *fileName)
 {
-	FILE *fp;
+	SCRIPT_INFO *script;
+	SCRIPT_FRAME *frame;
+	struct stat st;
+	char *data = NULL;
+	int fd;
+
 	// check whether file inclusion depth is reached
 	if ( (MAX_SCRIPT_FILE_DEPTH - 1)  <= ScriptFileDepth)
 	{
 		ScriptErrorMsgPrint("Cyclic file inclusion");
-		return EDPAT_FAILED;
+		return NULL;
 	}
 
 
-	fp = fopen(fileName,"r");
+	fd = open(fileName,O_RDONLY);
+	if ((0 <= fd) && (0 != fstat(fd,&st)))
+	{
+		close(fd);
+		fd = -1;
+	}
+	if ((0 <= fd) && (0 != st.st_size))
+	{
+		// private, the statements are cleaned up in place
+		data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE, fd, 0);
+		close(fd);
+		fd = (MAP_FAILED == data) ? -1 : 0;
+	}
+	else if (0 <= fd)
+	{
+		close(fd);
+	}
 
-	if ( NULL == fp )
+	if ( 0 > fd )
 	{
 		if (0 > ScriptFileDepth)
 		{
@@ -167,17 +244,37 @@ FILE *ScriptOpen(const char *fileName)
 		}
 		return NULL;
 	}
+
+	frame = (0 > ScriptFileDepth) ?
+		ScriptFrameAdd(fileName, 0, NULL) :
+		ScriptFrameAdd(fileName,
+			ScriptFileInfoTable[ScriptFileDepth].lineNo,
+			ScriptFileInfoTable[ScriptFileDepth].frame);
+	if (NULL == frame)
+	{
+		if (NULL != data)
+		{
+			munmap(data, st.st_size);
+		}
+		return NULL;
+	}
 	
 	/* Include the file in the scriptfileinfo table by adding its
 	   name and line no */
 	ScriptFileDepth++;
-	strncpy(ScriptFileInfoTable[ScriptFileDepth].fileName,
-		fileName,MAX_FILE_NAME_LEN);
-	ScriptFileInfoTable[ScriptFileDepth].fileName[MAX_FILE_NAME_LEN]=0;
-	ScriptFileInfoTable[ScriptFileDepth].lineNo=0;
-
-	VerboseStringPrint("Opened script '%s' with Fp=%p",fileName,fp);
-	return fp;
+	script = &ScriptFileInfoTable[ScriptFileDepth];
+	strncpy(script->fileName,fileName,MAX_FILE_NAME_LEN);
+	script->fileName[MAX_FILE_NAME_LEN]=0;
+	script->lineNo=0;
+	script->frame=frame;
+	script->data = data;
+	script->size = (NULL == data) ? 0 : st.st_size;
+	script->pos = 0;
+	script->tail = NULL;
+
+	VerboseStringPrint("Opened script '%s' of %lu bytes",fileName,
+		(unsigned long) script->size);
+	return script;
 
 }
 
@@ -185,21 +282,27 @@ FILE *ScriptOpen(const char *fileName)
  *
  * 	ScriptClose()
  *
- * 	Closes the file pointer provided 
+ * 	Closes the script file provided 
  *	Updates te ScriptFileInfoTable
  *
- *	Arguments	:	fp	-	the input filepointer
+ *	Arguments	:	script	-	the script file
  *
  * 	Return 		:	void
  *
  *
  * *************/
 
-void ScriptClose(FILE *fp)
+void ScriptClose(SCRIPT_INFO *script)
 {
-	fclose(fp);
+	if (NULL != script->data)
+	{
+		munmap(script->data, script->size);
+	}
+	free(script->tail);
+	script->data = NULL;
+	script->tail = NULL;
 	ScriptFileDepth--;
-	VerboseStringPrint("Closed script with Fp=%p",fp);
+	VerboseStringPrint("Closed script '%s'",script->fileName);
 }
 
 
@@ -208,7 +311,7 @@ void ScriptClose(FILE *fp)
  * 	ScriptIncludeFile
  *	
  *	Validates and checks the filename in the statment provided and
- *	then evaluate the included file
+ *	then compile the included file into the program
  * 	
  * 	Arguments	: in 	- the current testcase statement under
  *				  consideration 
@@ -218,19 +321,15 @@ void ScriptClose(FILE *fp)
  *
  *****************************/
 
-EDPAT_RETVAL ScriptIncludeFile(const char *in)
+EDPAT_RETVAL ScriptIncludeFile(char *in)
 {
         char *includeFileName;
-	static char line[MAX_SCRIPT_STATEMENT_LEN+1];
 	int i;
         int retVal;
-	char *p = line;
-
-	// Skip 1st character '#' and copy the rest to line
-	strncpy(line,&in[1],MAX_SCRIPT_STATEMENT_LEN); 
-	line[MAX_SCRIPT_STATEMENT_LEN]=0;
+	char *p;
 
-        includeFileName = strtok(p," ");	//Find include filename
+	// Skip 1st character '#', the statement is split in place
+        includeFileName = strtok(&in[1]," ");	//Find include filename
 
 	// Error handle
         if (NULL == includeFileName)
@@ -263,8 +362,8 @@ EDPAT_RETVAL ScriptIncludeFile(const char *in)
                 return EDPAT_FAILED;
 	}
 
-	//Process the include file 
-        retVal = TestScriptProcess(includeFileName);
+	//Compile the include file 
+        retVal = ProgramCompile(includeFileName);
         return retVal;
 }
 
@@ -274,7 +373,8 @@ EDPAT_RETVAL ScriptIncludeFile(const char *in)
  *
  *	Prints the backtrace in case something goes wrong, info all from
  *	the scriptInfo table with the names of othe files and the line
- *	number progress within the file
+ *	number progress within the file. While the program runs it is
+ *	the backtrace of the statement executed, from its frames
  *
  * 	Arguments	:	fp	-i The output file pointer 
  * 	Return 		: 	void
@@ -283,8 +383,23 @@ EDPAT_RETVAL ScriptIncludeFile(const char *in)
 
 void ScriptBacktracePrint(FILE *fp)
 {
+	const SCRIPT_FRAME *frame;
+	int lineNo;
 	int i;
 
+	if (NULL != ScriptExecFrame)
+	{
+		lineNo = ScriptExecLineNo;
+		for (frame=ScriptExecFrame; NULL != frame;
+				frame=frame->parent)
+		{
+			fprintf(fp,"\tin %s at line %d\n",
+				frame->fileName, lineNo);
+			lineNo = frame->includeLineNo;
+		}
+		return;
+	}
+
 	/* print script file name */
 	for (i=ScriptFileDepth; i >=0;  i--)
 	{
@@ -295,86 +410,270 @@ void ScriptBacktracePrint(FILE *fp)
 	return;
 }
 
+/************************
+ *
+ *	ScriptFrameAdd
+ *
+ *	Add the frame of a script file opened, or of one in a program
+ *	loaded from the cache
+ *
+ * 	Arguments	:	fileName	- name of the file
+ *				includeLineNo	- line of the file
+ *						  including it
+ *				parent		- frame of that file,
+ *						  NULL if none
+ * 	Return 		: 	the frame, NULL if out of memory
+ *
+ * **********************/
+
+SCRIPT_FRAME *ScriptFrameAdd(const char *fileName, const int includeLineNo,
+			const SCRIPT_FRAME *parent)
+{
+	SCRIPT_FRAME *frame;
+
+	frame = malloc(sizeof(*frame));
+	if (NULL == frame)
+	{
+		ExecErrorMsgPrint("Failed to allocate memory for script '%s'",
+			fileName);
+		return NULL;
+	}
+	strncpy(frame->fileName,fileName,MAX_FILE_NAME_LEN);
+	frame->fileName[MAX_FILE_NAME_LEN]=0;
+	frame->includeLineNo = includeLineNo;
+	frame->parent = parent;
+	frame->index = ScriptFrameCount++;
+	frame->next = ScriptFrameList;
+	ScriptFrameList = frame;
+	return frame;
+}
+
+/************************
+ *
+ *	ScriptFramesGet
+ *
+ *	Get the frames of all the script files opened
+ *
+ * 	Arguments	:	count	- number of frames is written here
+ * 	Return 		: 	the frames, newest first
+ *
+ * **********************/
+
+const SCRIPT_FRAME *ScriptFramesGet(int *count)
+{
+	*count = ScriptFrameCount;
+	return ScriptFrameList;
+}
+
+/************************
+ *
+ *	ScriptFrameGet
+ *
+ *	Get where the statement read last is, for the backtrace of the
+ *	program compiled from it
+ *
+ * 	Arguments	:	lineNo	- its line is written here
+ * 	Return 		: 	frame of its file
+ *
+ * **********************/
+
+const SCRIPT_FRAME *ScriptFrameGet(int *lineNo)
+{
+	*lineNo = ScriptFileInfoTable[ScriptFileDepth].lineNo;
+	return ScriptFileInfoTable[ScriptFileDepth].frame;
+}
+
+/************************
+ *
+ *	ScriptFrameSet
+ *
+ *	Set the statement executed, for the backtraces of the errors
+ *	while it runs
+ *
+ * 	Arguments	:	frame	- frame of its file, NULL when the
+ *					  program has ended
+ *				lineNo	- its line
+ * 	Return 		: 	void
+ *
+ * **********************/
+
+void ScriptFrameSet(const SCRIPT_FRAME *frame, const int lineNo)
+{
+	ScriptExecFrame = frame;
+	ScriptExecLineNo = lineNo;
+	return;
+}
+
+/************************
+ *
+ *	ScriptFramesFree
+ *
+ *	Free the frames of all the script files opened and the buffer
+ *	of the statements substituted
+ *
+ * 	Arguments	:	void
+ * 	Return 		: 	void
+ *
+ * **********************/
+
+void ScriptFramesFree(void)
+{
+	SCRIPT_FRAME *frame;
+
+	ScriptExecFrame = NULL;
+	while (NULL != ScriptFrameList)
+	{
+		frame = ScriptFrameList;
+		ScriptFrameList = frame->next;
+		free(frame);
+	}
+	ScriptFrameCount = 0;
+	free(ScriptSubstituteBuffer.data);
+	ScriptSubstituteBuffer.data = NULL;
+	ScriptSubstituteBuffer.size = 0;
+	return;
+}
+
+/*****************************
+ *
+ *	scriptBufferReserve()
+ *
+ *	Grow a buffer to hold a statement of the size given
+ *
+ *	Arguments	: buf	- the buffer
+ *			  size	- bytes needed, with the null
+ *	Return		: the data of the buffer, NULL if out of memory
+ *
+ * ***************************/
+
+static char *scriptBufferReserve(SCRIPT_BUFFER *buf, size_t size)
+{
+	char *data;
+
+	size = (size + 1023) & ~((size_t) 1023);
+	data = realloc(buf->data, size);
+	if (NULL == data)
+	{
+		ExecErrorMsgPrint("Failed to allocate memory for a statement "
+			"of %lu characters", (unsigned long) size);
+		return NULL;
+	}
+	buf->data = data;
+	buf->size = size;
+	return data;
+}
+
 /*****************************
  *
  *	ScriptSubstituteVariables()
  *
  *	Substitute the variables in the test statement with the 
- *	corressponding values in the VarList
+ *	corressponding values in the VarList, into a buffer that grows
+ *	as needed. The values were substituted when they were assigned,
+ *	so they have no variables and one pass is enough. A variable
+ *	with a value of bytes taking a whole token of a packet can be
+ *	left for packetRead() to copy its bytes
  *
- *	Arguments	: iline	- the testcase statement that is
- *				  currently under consideration
- *	Return		: substituteCount - the number of substitution made
+ *	Arguments	: statement - the testcase statement that is
+ *				  currently under consideration. It is
+ *				  changed
+ *			  keepBytes - EDPAT_TRUE to leave variables
+ *				  with bytes after the port name
+ *	Return		: the statement with the variables substituted,
+ *			  itself if it has none. NULL on errors
  *
  *
  * ***************************/
 
-int  ScriptSubstituteVariables(char *iline)
+char *ScriptSubstituteVariables(char *statement, const EDPAT_BOOL keepBytes)
 {
-	int retVal;
-	char *inPtr, *outPtr, *varPtr;
-	char *varName, *varValue;
-	int substituteCount = 0;
-	char oline[MAX_SCRIPT_STATEMENT_LEN+1];
-	int inLen;
-
-	inLen = strlen(iline);
-
-	//Copy just the first byte i.e the command to the output buffer
-        oline[0]=iline[0]; 
-        oline[1]=0;
-	//Null terminate after operation 
-
-	// Get position of the first occurence of a dollar
-        inPtr = &iline[1]; 
-        varPtr = strchr(inPtr,'$');
-        while(NULL != varPtr)
-        {
-		substituteCount++;
-		// Set the dollar character as 0 
-		varPtr[0] =0;
-		//Copy string until the varPtr into the outline
-		strcat(oline,inPtr);
-
+	SCRIPT_BUFFER *out = &ScriptSubstituteBuffer;
+	char *in = statement;
+	char *varPtr;
+	const char *varValue;
+	const char *firstToken;
+	const unsigned char *skip;
+	EDPAT_BOOL keep;
+	int byteCount;
+	char sep;
+	size_t nameLen;
+	size_t len = 0;
+	size_t size;
+
+	varPtr = strchr(&in[1],'$');
+	if (NULL == varPtr)
+	{
+		return statement;
+	}
+	firstToken = &in[1 + strspn(&in[1]," ")];
+	do
+	{
 		// Read variable name
 		varPtr++; 	// skip '$' character
-		varName = strtok(varPtr," ");
-		if (NULL ==  varName)
+		nameLen = strcspn(varPtr," ");
+		if (0 == nameLen)
 		{
 			ExecErrorMsgPrint("Variable name not found");
-			return -1;
+			return NULL;
 		}
 
 		// Check for value of variable
-		varValue = VariableGetValue(varName);
+		keep = ((EDPAT_TRUE == keepBytes) && (' ' == varPtr[-2]) &&
+			(&varPtr[-1] > firstToken)) ? EDPAT_TRUE : EDPAT_FALSE;
+		varPtr[-1] = 0;
+		sep = varPtr[nameLen];
+		varPtr[nameLen] = 0;
+		varValue = VariableGetValue(varPtr);
 		if (NULL == varValue)
 		{
 			ScriptErrorMsgPrint(
-				"Undefined variable '%s'",varName);
-			return -1;
+				"Undefined variable '%s'",varPtr);
+			return NULL;
+		}
+		if ((EDPAT_TRUE == keep) &&
+		    (NULL != VariableGetBytes(varPtr, &byteCount, &skip)))
+		{
+			varValue = &varPtr[-1];
+			varPtr[-1] = '$';
 		}
 
-		//Add value coressponding to the variable to output buffer
-		strcat(oline,varValue);
-		strcat(oline," ");
-		inPtr = varPtr + (strlen(varName) + 1);
+		/* Add the string till the variable and the value
+		   coressponding to it, with a space after it, to
+		   output buffer */
+		size = len + strlen(in) + strlen(varValue) + 2;
+		if ((out->size < size) &&
+		    (NULL == scriptBufferReserve(out, size)))
+		{
+			return NULL;
+		}
+		if (varValue == &varPtr[-1])
+		{
+			len += sprintf(&out->data[len],"%.*s%s ",
+				(int) (&varPtr[-1] - in),in,varValue);
+		}
+		else
+		{
+			len += sprintf(&out->data[len],"%s%s ",in,varValue);
+		}
+		in = &varPtr[nameLen];
+		if (0 != sep)
+		{
+			in++;	// the space after it
+		}
 
 		//Find next variable
-        	varPtr = strchr(inPtr,'$');
-        }
+		varPtr = strchr(in,'$');
+	} while (NULL != varPtr);
 
-	/* Concatenate the part left after the last variable inclued 
+	/* Add the part left after the last variable inclued 
 		inthe script */
-	if (inLen > (inPtr - iline))
+	size = len + strlen(in) + 1;
+	if ((out->size < size) &&
+	    (NULL == scriptBufferReserve(out, size)))
 	{
-		strcat(oline,inPtr);
-	};
-	if (0 !=  substituteCount)
-	{
-		strcpy(iline,oline);
-		retVal = ScriptSubstituteVariables(iline);
-		if (0 > retVal) return -1;
+		return NULL;
 	}
-	return substituteCount;
+	strcpy(&out->data[len],in);
+	return out->data;
 }
 
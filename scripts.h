@@ -9,11 +9,30 @@
 #ifndef __SCRIPTS_H__
 #define __SCRIPTS_H__ 1
 
-FILE	*ScriptOpen(const char *fileName);
-void	 ScriptClose(FILE *fp);
-int	 ScriptReadStatement(FILE *fp, char *statement);
-EDPAT_RETVAL	 ScriptIncludeFile(const char *line);
-int	 ScriptSubstituteVariables(char *line);
+/* A script file opened, kept after it is closed for the backtraces of
+   the statements compiled from it */
+typedef struct scriptFrame {
+	char		fileName[MAX_FILE_NAME_LEN+1];
+	int		includeLineNo;	// line of the file including it
+	const struct scriptFrame *parent;
+	int		index;		// order it was added in, from 0
+	struct scriptFrame *next;	// all the frames, newest first
+} SCRIPT_FRAME;
+
+typedef struct scriptInfo SCRIPT_INFO;	// script file being compiled
+
+SCRIPT_INFO *ScriptOpen(const char *fileName);
+void	 ScriptClose(SCRIPT_INFO *script);
+char	*ScriptReadStatement(SCRIPT_INFO *script);
+EDPAT_RETVAL	 ScriptIncludeFile(char *line);
+char	*ScriptSubstituteVariables(char *statement,
+			const EDPAT_BOOL keepBytes);
 void	 ScriptBacktracePrint(FILE *fp);
+SCRIPT_FRAME *ScriptFrameAdd(const char *fileName, const int includeLineNo,
+			const SCRIPT_FRAME *parent);
+const SCRIPT_FRAME *ScriptFramesGet(int *count);
+const SCRIPT_FRAME *ScriptFrameGet(int *lineNo);
+void	 ScriptFrameSet(const SCRIPT_FRAME *frame, const int lineNo);
+void	 ScriptFramesFree(void);
 
 #endif
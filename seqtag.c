@@ -0,0 +1,380 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "edpat.h"
+#include "print.h"
+#include "utils.h"
+#include "seqtag.h"
+
+/* A stream of packets with sequence tags, sent by send statements with
+   {seq,<id>} and tracked by the receiver threads of all the ports. The
+   window is a bitmap of the sequence numbers up to SEQ_TAG_WINDOW
+   before the highest one received, bit n % SEQ_TAG_WINDOW for n */
+typedef struct {
+	unsigned int	id;
+	int		pos;		// of the tag in the packets
+	pthread_mutex_t	lock;		// of the receive side
+	// send side, used only by the interpreter and the transmit workers
+	uint32_t	base;		// sequence number of packet 0
+	unsigned long long nextK;	// above the packets tagged, atomic
+	unsigned long	sent;
+	// receive side
+	unsigned long	received;	// different sequence numbers
+	unsigned long	duplicates;
+	unsigned long	reordered;	// arrived after a later one
+	unsigned long	maxReorderDist;
+	EDPAT_BOOL	seen;		// any packet received
+	uint32_t	highestSeq;
+	uint64_t	window[SEQ_TAG_WINDOW / 64];
+	long long	lastTransitNs;
+	double		jitterNs;	// inter arrival jitter of RFC 3550
+	long long	minLatencyNs;
+	long long	maxLatencyNs;
+	long long	sumLatencyNs;
+} SEQ_TAG_STREAM;
+
+static SEQ_TAG_STREAM SeqTagStream[MAX_SEQ_TAG_STREAM_COUNT];
+static volatile int SeqTagStreamCount = 0;
+static EDPAT_BOOL SeqTagLockInitFlag = EDPAT_FALSE;
+
+
+/***********************
+ *   SeqTagStreamAdd()
+ *
+ *   Get a stream of the test case, adding it if it is new.
+ *
+ *   Arguments :
+ *	id	- INPUT. the stream.
+ *	pos	- INPUT. position of the tag in its packets.
+ *
+ *   Return:	- index of the stream, -1 on errors
+ *
+ ********/
+int SeqTagStreamAdd(const unsigned int id, const int pos)
+{
+	SEQ_TAG_STREAM *s;
+	int i;
+
+	if (EDPAT_TRUE != SeqTagLockInitFlag)
+	{
+		for (i=0; i < MAX_SEQ_TAG_STREAM_COUNT; i++)
+		{
+			pthread_mutex_init(&SeqTagStream[i].lock, NULL);
+		}
+		SeqTagLockInitFlag = EDPAT_TRUE;
+	}
+	for (i=0; i < SeqTagStreamCount; i++)
+	{
+		s = &SeqTagStream[i];
+		if (id != s->id)
+		{
+			continue;
+		}
+		if (pos != s->pos)
+		{
+			ScriptErrorMsgPrint("Stream %u is tagged at byte %d, "
+				"not %d", id, s->pos, pos);
+			return (-1);
+		}
+		return i;
+	}
+	if (MAX_SEQ_TAG_STREAM_COUNT <= SeqTagStreamCount)
+	{
+		ScriptErrorMsgPrint("Too many streams in the test case. "
+			"Maximum is %d", MAX_SEQ_TAG_STREAM_COUNT);
+		return (-1);
+	}
+
+	// The receiver threads see it once it is counted
+	s = &SeqTagStream[i];
+	pthread_mutex_lock(&s->lock);
+	s->id = id;
+	s->pos = pos;
+	s->base = 0;
+	s->nextK = 0;
+	s->sent = 0;
+	s->received = 0;
+	s->duplicates = 0;
+	s->reordered = 0;
+	s->maxReorderDist = 0;
+	s->seen = EDPAT_FALSE;
+	s->jitterNs = 0;
+	pthread_mutex_unlock(&s->lock);
+	__sync_synchronize();
+	SeqTagStreamCount++;
+	return i;
+}
+
+
+/***********************
+ *   SeqTagWrite()
+ *
+ *   Make the tag of packet k of a send statement. It is called by the
+ *   transmit workers at the same time, for packets of their own.
+ *
+ *   Arguments :
+ *	stream	- INPUT. index of the stream.
+ *	k	- INPUT. number of the packet in the statement, from 0.
+ *	tag	- OUTPUT. the tag, SEQ_TAG_LEN bytes.
+ *
+ *   Return:	- None
+ *
+ ********/
+void SeqTagWrite(const int stream, const unsigned long long k,
+			unsigned char *tag)
+{
+	SEQ_TAG_STREAM *s = &SeqTagStream[stream];
+	struct timespec now;
+	unsigned long long old;
+	unsigned long long txNs;
+	uint32_t seq = s->base + (uint32_t) k;
+	int i;
+
+	old = s->nextK;
+	while ((old < (k + 1)) &&
+	       (!__sync_bool_compare_and_swap(&s->nextK, old, k + 1)))
+	{
+		old = s->nextK;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	txNs = (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+	tag[0] = SEQ_TAG_MAGIC >> 8;
+	tag[1] = SEQ_TAG_MAGIC & 0xFF;
+	tag[2] = (s->id >> 8) & 0xFF;
+	tag[3] = s->id & 0xFF;
+	for (i=7; i >= 4; i--, seq >>= 8)
+	{
+		tag[i] = seq & 0xFF;
+	}
+	for (i=15; i >= 8; i--, txNs >>= 8)
+	{
+		tag[i] = txNs & 0xFF;
+	}
+	return;
+}
+
+
+/***********************
+ *   SeqTagSent()
+ *
+ *   Count the packets a send statement sent on the stream. The next
+ *   statement goes on from the sequence number after the last packet
+ *   tagged.
+ *
+ *   Arguments :
+ *	stream	- INPUT. index of the stream.
+ *	sent	- INPUT. packets sent.
+ *
+ *   Return:	- None
+ *
+ ********/
+void SeqTagSent(const int stream, const unsigned long sent)
+{
+	SEQ_TAG_STREAM *s = &SeqTagStream[stream];
+
+	s->base += (uint32_t) s->nextK;
+	s->nextK = 0;
+	s->sent += sent;
+	return;
+}
+
+
+/***********************
+ *   seqTagTrack()
+ *
+ *   Track a sequence number received on a stream. A number above the
+ *   highest one moves the window up, one within the window is a
+ *   duplicate if its bit is set and reordered if not. Ones below the
+ *   window are counted as reordered, duplicates of them are not seen.
+ *
+ *   Arguments :
+ *	s	- INPUT/OUTPUT. the stream, locked.
+ *	seq	- INPUT. the sequence number.
+ *	transitNs - INPUT. time from sending it to receiving it.
+ *
+ *   Return:	- None
+ *
+ ********/
+static void seqTagTrack(SEQ_TAG_STREAM *s, const uint32_t seq,
+			const long long transitNs)
+{
+	uint32_t n;
+	uint32_t dist;
+	int32_t ahead;
+	uint64_t bit;
+
+	ahead = (int32_t) (seq - s->highestSeq);
+	if (EDPAT_TRUE != s->seen)
+	{
+		memset(s->window, 0, sizeof(s->window));
+		s->highestSeq = seq;
+		s->seen = EDPAT_TRUE;
+	}
+	else if (0 < ahead)
+	{
+		if (SEQ_TAG_WINDOW <= ahead)
+		{
+			memset(s->window, 0, sizeof(s->window));
+		}
+		for (n = s->highestSeq + 1; (SEQ_TAG_WINDOW > ahead) &&
+				(n != seq + 1); n++)
+		{
+			s->window[(n % SEQ_TAG_WINDOW) / 64] &=
+				~(1ULL << (n % 64));
+		}
+		s->highestSeq = seq;
+	}
+	else
+	{
+		dist = (uint32_t) (-ahead);
+		bit = 1ULL << (seq % 64);
+		if ((SEQ_TAG_WINDOW > dist) &&
+		    (0 != (s->window[(seq % SEQ_TAG_WINDOW) / 64] & bit)))
+		{
+			s->duplicates++;
+			return;
+		}
+		s->reordered++;
+		if (dist > s->maxReorderDist)
+		{
+			s->maxReorderDist = dist;
+		}
+	}
+	s->window[(seq % SEQ_TAG_WINDOW) / 64] |= 1ULL << (seq % 64);
+
+	if (0 != s->received)
+	{
+		s->jitterNs += (llabs(transitNs - s->lastTransitNs) -
+				s->jitterNs) / 16.0;
+	}
+	if ((0 == s->received) || (transitNs < s->minLatencyNs))
+	{
+		s->minLatencyNs = transitNs;
+	}
+	if ((0 == s->received) || (transitNs > s->maxLatencyNs))
+	{
+		s->maxLatencyNs = transitNs;
+	}
+	s->sumLatencyNs = (0 == s->received) ? transitNs :
+				(s->sumLatencyNs + transitNs);
+	s->lastTransitNs = transitNs;
+	s->received++;
+	return;
+}
+
+
+/***********************
+ *   SeqTagReceive()
+ *
+ *   Check if a packet received has the tag of a stream of the test
+ *   case and track it if it has. It is called by the receiver threads
+ *   of the ports before a packet is queued.
+ *
+ *   Arguments :
+ *	pkt	- INPUT. the packet.
+ *	pktLen	- INPUT. its length.
+ *	rxTime	- INPUT. time it arrived.
+ *
+ *   Return:	- EDPAT_TRUE if it is a packet of a stream, it is not to
+ *		  be queued
+ *
+ ********/
+EDPAT_BOOL SeqTagReceive(const unsigned char *pkt, const int pktLen,
+			const struct timespec *rxTime)
+{
+	SEQ_TAG_STREAM *s;
+	const unsigned char *tag;
+	unsigned long long txNs = 0;
+	uint32_t seq = 0;
+	long long rxNs;
+	int count = SeqTagStreamCount;
+	int i;
+
+	for (s=SeqTagStream; s < &SeqTagStream[count]; s++)
+	{
+		tag = &pkt[s->pos];
+		if ((pktLen < (s->pos + SEQ_TAG_LEN)) ||
+		    ((SEQ_TAG_MAGIC >> 8) != tag[0]) ||
+		    ((SEQ_TAG_MAGIC & 0xFF) != tag[1]) ||
+		    (s->id != (unsigned int) ((tag[2] << 8) | tag[3])))
+		{
+			continue;
+		}
+		for (i=4; i < 8; i++)
+		{
+			seq = (seq << 8) | tag[i];
+		}
+		for (i=8; i < SEQ_TAG_LEN; i++)
+		{
+			txNs = (txNs << 8) | tag[i];
+		}
+		rxNs = (long long) rxTime->tv_sec * 1000000000LL +
+				rxTime->tv_nsec;
+		pthread_mutex_lock(&s->lock);
+		seqTagTrack(s, seq, rxNs - (long long) txNs);
+		pthread_mutex_unlock(&s->lock);
+		return EDPAT_TRUE;
+	}
+	return EDPAT_FALSE;
+}
+
+
+/***********************
+ *   SeqTagTestCaseReportPrint()
+ *
+ *   Print the loss, reordering, duplicates and jitter of every stream
+ *   of the current test case that sent or received packets to the
+ *   report, then remove the streams for the next test case.
+ *
+ *   Arguments : None, but uses CurrentTestCaseId
+ *
+ *   Return:	- None
+ *
+ ********/
+void SeqTagTestCaseReportPrint(void)
+{
+	SEQ_TAG_STREAM *s;
+	int count = SeqTagStreamCount;
+	int i;
+
+	SeqTagStreamCount = 0;
+	__sync_synchronize();
+	for (i=0; i < count; i++)
+	{
+		s = &SeqTagStream[i];
+		if ((0 == s->sent) && (0 == s->received))
+		{
+			continue;
+		}
+		pthread_mutex_lock(&s->lock);
+		TestCaseReportPrint("%s\tstream %u: sent=%lu received=%lu "
+			"lost=%ld duplicates=%lu", CurrentTestCaseId, s->id,
+			s->sent, s->received, (long) (s->sent - s->received),
+			s->duplicates);
+		TestCaseReportPrint("\treordered=%lu max reorder distance=%lu "
+			"jitter=%.3f us", s->reordered, s->maxReorderDist,
+			s->jitterNs / 1000.0);
+		if (0 != s->received)
+		{
+			TestCaseReportPrint("\tlatency min=%.3f mean=%.3f "
+				"max=%.3f us", s->minLatencyNs / 1000.0,
+				((double) s->sumLatencyNs / s->received) /
+					1000.0,
+				s->maxLatencyNs / 1000.0);
+		}
+		pthread_mutex_unlock(&s->lock);
+	}
+	return;
+}
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ *
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+
+#ifndef __SEQTAG_H__
+#define __SEQTAG_H__ 1
+
+#include <time.h>
+
+/* A sequence tag in a packet is, big endian
+	2 bytes	SEQ_TAG_MAGIC
+	2 bytes	stream
+	4 bytes	sequence number
+	8 bytes	time it was sent, in ns */
+#define SEQ_TAG_LEN		16
+#define SEQ_TAG_MAGIC		0xED5A
+#define MAX_SEQ_TAG_STREAM_COUNT	16	// streams in a test case
+#define MAX_SEQ_TAG_STREAM_ID	0xFFFF
+// sequence numbers a stream remembers, a multiple of 64
+#define SEQ_TAG_WINDOW		1024
+
+int SeqTagStreamAdd(const unsigned int id, const int pos);
+void SeqTagWrite(const int stream, const unsigned long long k,
+			unsigned char *tag);
+void SeqTagSent(const int stream, const unsigned long sent);
+EDPAT_BOOL SeqTagReceive(const unsigned char *pkt, const int pktLen,
+			const struct timespec *rxTime);
+void SeqTagTestCaseReportPrint(void);
+
+#endif
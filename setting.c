@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: BSD-3-Clause-Clear
+ * https://spdx.org/licenses/BSD-3-Clause-Clear.html#licenseText
+ * 
+ * Copyright (c) 2020-1025 Arvind Sajeev (arvind.sajeev@gmail.com)
+ * All rights reserved.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "edpat.h"
+#include "scripts.h"
+#include "utils.h"
+#include "print.h"
+#include "filter.h"
+#include "EthPortIO.h"
+#include "setting.h"
+
+
+/***********************
+ *   settingFilterStore()
+ *
+ *   Change the packet filter rules and recompile the filters of the
+ *   ports already opened.
+ *
+ *   Arguments : value - INPUT. list of filter rules
+ *
+ *   Return:	- EDPAT_SUCESS or EDPAT_FAILED
+ *
+ ***********************/
+static EDPAT_RETVAL settingFilterStore(const char *value)
+{
+	unsigned int rules;
+
+	if (EDPAT_SUCCESS != FilterRulesParse(value,&rules))
+	{
+		ScriptErrorMsgPrint("Invalid filter rules '%s'. "
+			"Expecting a list of arp, lldp, igmp, dhcp, ssdp, "
+			"mdns, ipv6, all or none",value);
+		return EDPAT_FAILED;
+	}
+	if (EDPAT_TRUE == SyntaxCheckOnly)
+	{
+		return EDPAT_SUCCESS;
+	}
+	if (rules != PacketFilterRules)
+	{
+		PacketFilterRules = rules;
+		EthPortFilterUpdate();
+	}
+	VerboseStringPrint("Packets filtered: %s",
+			FilterRulesString(PacketFilterRules));
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   settingWireStore()
+ *
+ *   Wire a virtual port to another virtual port or to a responder.
+ *
+ *   Arguments : value - INPUT. <port>,<peer port or responder library>,
+ *		 split up in place
+ *
+ *   Return:	- EDPAT_SUCESS or EDPAT_FAILED
+ *
+ ***********************/
+static EDPAT_RETVAL settingWireStore(char *value)
+{
+	char *peer;
+
+	peer = strchr(value,',');
+	if (NULL == peer)
+	{
+		ScriptErrorMsgPrint("Expecting the format "
+			"%%wire=<port>,<port or responder>");
+		return EDPAT_FAILED;
+	}
+	peer[0] = 0; // null teminate port name
+	peer++;
+	TrimStr(value);
+	TrimStr(peer);
+	if ((MAX_ETH_PORT_NAME_LEN <= strlen(value)) || (0 == strlen(peer)))
+	{
+		ScriptErrorMsgPrint("Invalid wire '%s,%s'",value,peer);
+		return EDPAT_FAILED;
+	}
+	if (EDPAT_TRUE == SyntaxCheckOnly)
+	{
+		return EDPAT_SUCCESS;
+	}
+	return EthPortWire(value,peer);
+}
+
+
+/***********************
+ *   SettingStoreValue()
+ *
+ *   Change a setting of the tool from the test script. The settings
+ *   are the ones that can also be given on the command line.
+ *
+ *   Arguments : testScriptStatement - 	INPUT. A null terminated string
+ *			which a the Test script statement in format
+ *			%<settingName>=<value>
+ *
+ *   Return:	- EDPAT_SUCESS or EDPAT_FAILED
+ *
+ ***********************/
+EDPAT_RETVAL SettingStoreValue(const char *testScriptStatement)
+{
+        char *tmp;
+        char *name;
+        char *value;
+	EDPAT_RETVAL retVal;
+
+        tmp = strdup(&testScriptStatement[1]);
+        if (NULL == tmp)
+        {
+                ExecErrorMsgPrint("Failed to allocate memory for a "
+			"setting");
+                return EDPAT_FAILED;
+        }
+
+        name = tmp;
+        value = strchr(tmp,'=');
+        if (NULL == value)
+        {
+                ScriptErrorMsgPrint("Expecting the format %%name=value");
+                free(tmp);
+                return EDPAT_FAILED;
+        }
+        value[0] = 0; // null teminate name;
+        value++; // skil '='
+
+        TrimStr(name);
+        TrimStr(value);
+
+	if (0 == strcmp(name,"filter"))
+	{
+		retVal = settingFilterStore(value);
+	}
+	else if (0 == strcmp(name,"wire"))
+	{
+		retVal = settingWireStore(value);
+	}
+	else
+	{
+		ScriptErrorMsgPrint("Unknown setting '%s'",name);
+		retVal = EDPAT_FAILED;
+	}
+	free(tmp);
+	return retVal;
+}
@@ -19,6 +19,8 @@
 #include "scripts.h"
 #include "packet.h"
 #include "print.h"
+#include "latency.h"
+#include "seqtag.h"
 
 
 /***********************
@@ -26,7 +28,9 @@
  *	CleanupLastTestExecution()
  *
  *	It cleans the memory buffer and checks if any unwanted packets
- *	have been received
+ *	have been received and if the latencies were within budget. The
+ *	latencies and the streams of the test case are printed along with
+ *	its result
  *	
  *	Arguments 	:	void
  *	Return 		: 	void, but sets the CurrentTestResult
@@ -39,7 +43,13 @@ void CleanupLastTestExecution(void)
 	CheckUnexpectedPackets();
 	if (EDPAT_TEST_RESULT_UNKNOWN != CurrentTestResult)
 	{
+		if (EDPAT_TEST_RESULT_PASSED == CurrentTestResult)
+		{
+			LatencyBudgetCheck();
+		}
 		TestCaseFinalResultPrint();
+		LatencyTestCaseReportPrint();
+		SeqTagTestCaseReportPrint();
 	}
 	return;
 }
@@ -70,39 +80,37 @@ static const char *getTime(void)
 
 /*************************
  *
- *	GetTestCaseID
+ *	TestCaseIdRead
  *
- *	Searches for the tescaseID from the input statementn and sets
- *	CurrentTestCaseId and prints the entry message for the testcase
+ *	Read the testcase ID from the input statement when the script is
+ *	compiled
  *	
  *	Arguments	:	in 	- The input testcase statement
  *					  that is under consideration 
+ *				id	- the ID is written here, room for
+ *					  MAX_TESTCASE_ID_LEN+1
  *	Return		:	EDPAT_RETVAL	
  *
  *
  * ***********************/
-EDPAT_RETVAL GetTestCaseID(const char *in)
+EDPAT_RETVAL TestCaseIdRead(const char *in, char *id)
 {
-        char *p;
-        char *testCaseId;
+        const char *p;
+        const char *testCaseId;
         int i,len;
-	static char line[MAX_SCRIPT_STATEMENT_LEN+1];
-	
-	// copy the testcase statement 
 
-	strncpy(line,in,MAX_SCRIPT_LINE_LEN);
-	line[MAX_SCRIPT_STATEMENT_LEN]=0;
-
-        testCaseId = strtok(&line[1]," ");
+	// Skip the '@' and the space after it, if any
+        testCaseId = &in[1];
+        testCaseId += strspn(testCaseId," ");
+        len = strcspn(testCaseId," ");
 
 	// Check for whether testcase ID exists
-        if (NULL == testCaseId)
+        if (0 == len)
         {
                 ScriptErrorMsgPrint("Test case ID expected");
                 return EDPAT_FAILED;
         }
 	//Matches the prescribed format
-        len =strlen(testCaseId);
         for(i=0; i < len; i++)
         {
                 if ((!isalnum(testCaseId[i])) && ('_' != testCaseId[i]))
@@ -122,26 +130,45 @@ EDPAT_RETVAL GetTestCaseID(const char *in)
         }
 
 
-        p = strtok(NULL," ");
-        if (NULL != p)
+        p = &testCaseId[len];
+        p += strspn(p," ");
+        if (0 != p[0])
 	{
-                ScriptErrorMsgPrint("Unexpected string '%s' "
-			"after Test Case ID", p);
+                ScriptErrorMsgPrint("Unexpected string '%.*s' "
+			"after Test Case ID", (int) strcspn(p," "), p);
                 return EDPAT_FAILED;
 	}
-	
+
+        memcpy(id,testCaseId,len);
+	id[len]=0;
+        return EDPAT_SUCCESS;
+}
+
+/*************************
+ *
+ *	TestCaseBegin
+ *
+ *	Ends the previous testcase, sets CurrentTestCaseId and prints the
+ *	entry message for the testcase
+ *	
+ *	Arguments	:	id	- ID of the testcase
+ *	Return		:	void
+ *
+ *
+ * ***********************/
+void TestCaseBegin(const char *id)
+{
 	/* Print result of previous test case and clean-up */
 	CleanupLastTestExecution();
 
 	// initialize the result to passed to begin with
 	CurrentTestResult = EDPAT_TEST_RESULT_PASSED;
 
-        strncpy(CurrentTestCaseId,testCaseId,MAX_TESTCASE_ID_LEN);
+        strncpy(CurrentTestCaseId,id,MAX_TESTCASE_ID_LEN);
 	CurrentTestCaseId[MAX_TESTCASE_ID_LEN]=0;
 	TestCaseStringPrint("######### TEST CASE = %s #########",
 				CurrentTestCaseId);
 	TestCaseStringPrint("TIME %s",getTime());
-	
-        return EDPAT_SUCCESS;
+	return;
 }
 
@@ -8,7 +8,8 @@
 #ifndef __TESTCASE_H__
 #define __TESTCASE_H__ 1
 
-EDPAT_RETVAL GetTestCaseID(const char *line);
+EDPAT_RETVAL TestCaseIdRead(const char *line, char *id);
+void TestCaseBegin(const char *id);
 void CleanupLastTestExecution(void);
 
 #endif
@@ -8,6 +8,12 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "edpat.h"
 #include "print.h"
 #include "utils.h"
@@ -28,31 +34,241 @@
 
 void TrimStr(char *str)
 {
-        char tmp[MAX_SCRIPT_STATEMENT_LEN+1];
         int len, i;
 
-        strncpy(tmp,str,MAX_SCRIPT_STATEMENT_LEN);
-	tmp[MAX_SCRIPT_STATEMENT_LEN]=0;
-
-        len = strlen(tmp);
+        len = strlen(str);
 
         for(i=(len-1) ; i >= 0; i--)
         {
-                if (' ' != tmp[i])
+                if (' ' != str[i])
                         break;
         };
-        tmp[i+1] = 0; // null terminate
+        str[i+1] = 0; // null terminate
         len = i;
         for(i=0 ; i < len; i++)
         {
-                if (' ' != tmp[i])
+                if (' ' != str[i])
                 {
                         break;
                 }
         };
 
-        strcpy(str,&tmp[i]);
+        memmove(str,&str[i],strlen(&str[i])+1);
         return;
 }
 
 
+
+
+/********************
+ *
+ *   DeadlineSet()
+ *
+ *   Compute the monotonic time at which a wait of waitMs ends.
+ *
+ *   Arguments:
+ *	deadline -	OUTPUT. end of the wait.
+ *	waitMs	-	INPUT. length of the wait in milliseconds.
+ *   Return	-	None
+ *
+ ********************/
+
+void DeadlineSet(struct timespec *deadline, const int waitMs)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += waitMs / 1000;
+	deadline->tv_nsec += (waitMs % 1000) * 1000000L;
+	if (1000000000L <= deadline->tv_nsec)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+	return;
+}
+
+
+/********************
+ *
+ *   DeadlineRemainingMs()
+ *
+ *   Milliseconds left till the deadline set by DeadlineSet().
+ *
+ *   Arguments:
+ *	deadline -	INPUT. end of the wait.
+ *   Return	-	remaining time, <= 0 if the deadline has passed
+ *
+ ********************/
+
+int DeadlineRemainingMs(const struct timespec *deadline)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (deadline->tv_sec - now.tv_sec) * 1000 +
+		(deadline->tv_nsec - now.tv_nsec) / 1000000L;
+}
+
+
+/********************
+ *
+ *   TimespecFormat()
+ *
+ *   Format a wall clock time as HH:MM:SS.nnnnnnnnn local time, for the
+ *   logs. A zero time is not known and is printed as such.
+ *
+ *   Arguments:
+ *	ts	-	INPUT. time to be formatted.
+ *	buf	-	OUTPUT. buffer of MAX_TIMESPEC_STR_LEN bytes.
+ *   Return	-	buf
+ *
+ ********************/
+
+const char *TimespecFormat(const struct timespec *ts, char *buf)
+{
+	struct tm tm;
+	time_t sec = ts->tv_sec;
+
+	if ((0 == ts->tv_sec) && (0 == ts->tv_nsec))
+	{
+		strcpy(buf,"unknown");
+		return buf;
+	}
+	localtime_r(&sec, &tm);
+	snprintf(buf, MAX_TIMESPEC_STR_LEN, "%02d:%02d:%02d.%09ld",
+		tm.tm_hour, tm.tm_min, tm.tm_sec, ts->tv_nsec);
+	return buf;
+}
+
+
+/********************
+ *
+ *   TimespecDiffNs()
+ *
+ *   Nanoseconds from one time to a later one.
+ *
+ *   Arguments:
+ *	from	-	INPUT. earlier time.
+ *	to	-	INPUT. later time.
+ *   Return	-	to - from in nanoseconds
+ *
+ ********************/
+
+long long TimespecDiffNs(const struct timespec *from,
+			const struct timespec *to)
+{
+	return (long long) (to->tv_sec - from->tv_sec) * 1000000000LL +
+		(to->tv_nsec - from->tv_nsec);
+}
+
+
+/********************
+ *
+ *   TimespecAddNs()
+ *
+ *   Move a time by a number of nanoseconds.
+ *
+ *   Arguments:
+ *	ts	-	INPUT/OUTPUT. time to be moved.
+ *	ns	-	INPUT. nanoseconds to add, can be negative.
+ *   Return	-	None
+ *
+ ********************/
+
+void TimespecAddNs(struct timespec *ts, const long long ns)
+{
+	long long nsec = ts->tv_nsec + (ns % 1000000000LL);
+
+	ts->tv_sec += ns / 1000000000LL;
+	if (0 > nsec)
+	{
+		ts->tv_sec--;
+		nsec += 1000000000LL;
+	}
+	else if (1000000000LL <= nsec)
+	{
+		ts->tv_sec++;
+		nsec -= 1000000000LL;
+	}
+	ts->tv_nsec = nsec;
+	return;
+}
+
+/********************
+ *
+ *   HashBytes()
+ *
+ *   Hash a block of bytes, FNV-1a taking 8 bytes at a time. Not for
+ *   security, only to find if a file has changed.
+ *
+ *   Arguments:
+ *	data	-	INPUT. the bytes.
+ *	len	-	INPUT. number of bytes.
+ *	hash	-	INPUT. HASH_INIT, or the hash of the blocks before
+ *			this one
+ *   Return	-	the hash
+ *
+ ********************/
+
+uint64_t HashBytes(const void *data, const size_t len, uint64_t hash)
+{
+	const unsigned char *p = data;
+	uint64_t word;
+	size_t i;
+
+	for (i=0; (i + sizeof(word)) <= len; i += sizeof(word))
+	{
+		memcpy(&word, &p[i], sizeof(word));
+		hash = (hash ^ word) * 0x100000001B3ULL;
+	}
+	for (; i < len; i++)
+	{
+		hash = (hash ^ p[i]) * 0x100000001B3ULL;
+	}
+	return (hash ^ len) * 0x100000001B3ULL;
+}
+
+/********************
+ *
+ *   FileHashGet()
+ *
+ *   Hash the contents of a file, mapping it instead of reading it.
+ *
+ *   Arguments:
+ *	fileName -	INPUT. the file.
+ *	hash	-	OUTPUT. its hash.
+ *   Return	-	EDPAT_SUCCESS, EDPAT_FAILED if it could not be read
+ *
+ ********************/
+
+EDPAT_RETVAL FileHashGet(const char *fileName, uint64_t *hash)
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(fileName, O_RDONLY);
+	if (0 > fd)
+	{
+		return EDPAT_FAILED;
+	}
+	if ((0 != fstat(fd, &st)) || (!S_ISREG(st.st_mode)))
+	{
+		close(fd);
+		return EDPAT_FAILED;
+	}
+	if (0 == st.st_size)
+	{
+		close(fd);
+		*hash = HashBytes(NULL, 0, HASH_INIT);
+		return EDPAT_SUCCESS;
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == data)
+	{
+		return EDPAT_FAILED;
+	}
+	*hash = HashBytes(data, st.st_size, HASH_INIT);
+	munmap(data, st.st_size);
+	return EDPAT_SUCCESS;
+}
@@ -9,6 +9,21 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__ 1
 
+#include <time.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define MAX_TIMESPEC_STR_LEN	32	// HH:MM:SS.nnnnnnnnn
+#define HASH_INIT		0xCBF29CE484222325ULL	// FNV-1a offset basis
+
 void TrimStr(char *str);
+void DeadlineSet(struct timespec *deadline, const int waitMs);
+int DeadlineRemainingMs(const struct timespec *deadline);
+const char *TimespecFormat(const struct timespec *ts, char *buf);
+long long TimespecDiffNs(const struct timespec *from,
+			const struct timespec *to);
+void TimespecAddNs(struct timespec *ts, const long long ns);
+uint64_t HashBytes(const void *data, const size_t len, uint64_t hash);
+EDPAT_RETVAL FileHashGet(const char *fileName, uint64_t *hash);
 
 #endif
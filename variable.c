@@ -13,6 +13,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <stdint.h>
 
 #include "edpat.h"
 #include "scripts.h"
@@ -20,18 +21,295 @@
 #include "variable.h"
 #include "print.h"
 
+/* The variables are kept in the order they were added in VarList[],
+   found by name through VarIndex[], an open addressing hash table of
+   VarIndexSize slots holding the index in VarList[] plus one, 0 if
+   free. Names and values are allocated from an arena, freed only at
+   the end of the run, a value assigned again is left there. A value
+   of hex bytes and '*' is also kept decoded, for packetRead() to copy
+   in place of the variable */
 typedef struct {
-        char *varName;
-        char *varValue;
+        const char *varName;
+        const char *varValue;
+	uint64_t hash;		// of varName
+	int	byteCount;	// decoded, -1 if it is not bytes
+	const unsigned char *bytes;
+	const unsigned char *skip;	// 1 for '*', NULL if there is none
 }       VAR_INFO;
 
-static VAR_INFO VarList[MAX_VAR_COUNT];
+typedef struct varArenaChunk {
+	struct varArenaChunk *next;
+	size_t	size;		// bytes in data
+	size_t	used;
+	char	data[];
+}	VAR_ARENA_CHUNK;
+
+static VAR_INFO *VarList = NULL;
 static int NextFreeVarListIndex = 0;
+static int VarListSize = 0;
+static int *VarIndex = NULL;
+static int VarIndexSize = 0;		// a power of 2
+static VAR_ARENA_CHUNK *VarArena = NULL;	// chunk in use first
+
+
+/***********************
+ *   variableArenaAlloc()
+ *
+ *   Allocate from the arena of the variables
+ *
+ *   Arguments : len - INPUT. bytes needed
+ *
+ *   Return:	- the bytes, NULL if out of memory
+ *
+ ***********************/
+static void *variableArenaAlloc(const size_t len)
+{
+	VAR_ARENA_CHUNK *chunk = VarArena;
+	size_t size;
+	char *data;
+
+	if ((NULL == chunk) || ((chunk->size - chunk->used) < len))
+	{
+		size = (VAR_ARENA_CHUNK_SIZE > len) ? VAR_ARENA_CHUNK_SIZE :
+				len;
+		chunk = malloc(sizeof(*chunk) + size);
+		if (NULL == chunk)
+		{
+			ExecErrorMsgPrint("Failed to allocate memory for "
+				"variables");
+			return NULL;
+		}
+		chunk->size = size;
+		chunk->used = 0;
+		// a chunk of one large string leaves the one in use first
+		if ((NULL != VarArena) && (VAR_ARENA_CHUNK_SIZE <= len))
+		{
+			chunk->next = VarArena->next;
+			VarArena->next = chunk;
+		}
+		else
+		{
+			chunk->next = VarArena;
+			VarArena = chunk;
+		}
+	}
+	data = &chunk->data[chunk->used];
+	chunk->used += len;
+	return data;
+}
+
+
+/***********************
+ *   variableArenaStrdup()
+ *
+ *   Copy a string into the arena of the variables
+ *
+ *   Arguments : str - INPUT. the string
+ *
+ *   Return:	- the copy, NULL if out of memory
+ *
+ ***********************/
+static const char *variableArenaStrdup(const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *copy;
+
+	copy = variableArenaAlloc(len);
+	if (NULL != copy)
+	{
+		memcpy(copy, str, len);
+	}
+	return copy;
+}
+
+
+/***********************
+ *   variableDecode()
+ *
+ *   Decode the value of a variable if it is all bytes of a packet,
+ *   hex values and '*', read as packetRead() reads them
+ *
+ *   Arguments : var - INPUT/OUTPUT. the variable, with its value
+ *
+ *   Return:	- EDPAT_SUCESS, also if it is not bytes, or EDPAT_FAILED
+ *
+ ***********************/
+static EDPAT_RETVAL variableDecode(VAR_INFO *var)
+{
+	const char *token;
+	char *q;
+	unsigned char *bytes;
+	unsigned char *skip = NULL;
+	int count = 0;
+	int skipCount = 0;
+	int i;
+
+	var->byteCount = -1;
+	var->bytes = NULL;
+	var->skip = NULL;
+
+	// Check them all first, most values are not bytes
+	for (token = var->varValue + strspn(var->varValue," ");
+	     0 != token[0]; token += strspn(token," "))
+	{
+		if (('*' == token[0]) && ((' ' == token[1]) || (0 == token[1])))
+		{
+			skipCount++;
+		}
+		else
+		{
+			strtol(token,&q,16);
+			if ((token == q) || ((' ' != q[0]) && (0 != q[0])))
+			{
+				return EDPAT_SUCCESS;
+			}
+		}
+		token += strcspn(token," ");
+		count++;
+	}
+
+	bytes = variableArenaAlloc((0 == skipCount) ? (count + 1) :
+			(2 * count + 1));
+	if (NULL == bytes)
+	{
+		return EDPAT_FAILED;
+	}
+	if (0 != skipCount)
+	{
+		skip = &bytes[count];
+	}
+	for (token = var->varValue + strspn(var->varValue," "), i=0;
+	     i < count; token += strspn(token," "), i++)
+	{
+		if ((NULL != skip) && ('*' == token[0]))
+		{
+			bytes[i] = 0;
+			skip[i] = 1;
+		}
+		else
+		{
+			bytes[i] = (unsigned char) strtol(token,NULL,16);
+			if (NULL != skip)
+			{
+				skip[i] = 0;
+			}
+		}
+		token += strcspn(token," ");
+	}
+	var->byteCount = count;
+	var->bytes = bytes;
+	var->skip = skip;
+	return EDPAT_SUCCESS;
+}
+
+
+/***********************
+ *   variableFind()
+ *
+ *   Find the slot of a variable in VarIndex[]
+ *
+ *   Arguments : varName - INPUT. name of the variable
+ *		 hash	 - INPUT. hash of the name
+ *
+ *   Return:	- the slot, free if the variable is not there
+ *
+ ***********************/
+static int variableFind(const char *varName, const uint64_t hash)
+{
+	VAR_INFO *var;
+	int slot;
+
+	for (slot = hash & (VarIndexSize - 1); 0 != VarIndex[slot];
+	     slot = (slot + 1) & (VarIndexSize - 1))
+	{
+		var = &VarList[VarIndex[slot] - 1];
+		if ((hash == var->hash) && (0 == strcmp(varName,var->varName)))
+		{
+			break;
+		}
+	}
+	return slot;
+}
+
+
+/***********************
+ *   variableAdd()
+ *
+ *   Add a variable, growing VarList[] and VarIndex[] as needed. The
+ *   index is kept at most 3/4 full
+ *
+ *   Arguments : varName  - INPUT. name of the variable, not there
+ *		 varValue - INPUT. its value
+ *		 hash	  - INPUT. hash of the name
+ *
+ *   Return:	- EDPAT_SUCESS or EDPAT_FAILED
+ *
+ ***********************/
+static EDPAT_RETVAL variableAdd(const char *varName, const char *varValue,
+			const uint64_t hash)
+{
+	VAR_INFO *var;
+	int *index;
+	int size;
+	int i;
+
+	if (VarListSize <= NextFreeVarListIndex)
+	{
+		size = (0 == VarListSize) ? VAR_INDEX_INIT_SIZE :
+				(2 * VarListSize);
+		var = realloc(VarList, size * sizeof(*var));
+		if (NULL == var)
+		{
+			ExecErrorMsgPrint("Failed to allocate memory for %d "
+				"variables", size);
+			return EDPAT_FAILED;
+		}
+		VarList = var;
+		VarListSize = size;
+	}
+	if ((VarIndexSize * 3) <= ((NextFreeVarListIndex + 1) * 4))
+	{
+		size = (0 == VarIndexSize) ? VAR_INDEX_INIT_SIZE :
+				(2 * VarIndexSize);
+		index = calloc(size, sizeof(*index));
+		if (NULL == index)
+		{
+			ExecErrorMsgPrint("Failed to allocate memory for %d "
+				"variables", size);
+			return EDPAT_FAILED;
+		}
+		free(VarIndex);
+		VarIndex = index;
+		VarIndexSize = size;
+		for (i=0; i < NextFreeVarListIndex; i++)
+		{
+			VarIndex[variableFind(VarList[i].varName,
+				VarList[i].hash)] = i + 1;
+		}
+	}
+
+	var = &VarList[NextFreeVarListIndex];
+	var->varName = variableArenaStrdup(varName);
+	var->varValue = variableArenaStrdup(varValue);
+	if ((NULL == var->varName) || (NULL == var->varValue))
+	{
+		return EDPAT_FAILED;
+	}
+	var->hash = hash;
+	if (EDPAT_SUCCESS != variableDecode(var))
+	{
+		return EDPAT_FAILED;
+	}
+	VarIndex[variableFind(varName,hash)] = ++NextFreeVarListIndex;
+	return EDPAT_SUCCESS;
+}
+
 
 /***********************
  *   VariableStoreValue()
  *
- *   Store a variable and its value in VarList[] table
+ *   Store a variable and its value, replacing the value of a variable
+ *   already there
  *
  *   Arguments : testScriptStatement - 	INPUT. A null terminated string
  *			which a the Test script statement in format
@@ -43,21 +321,30 @@ static int NextFreeVarListIndex = 0;
 
 EDPAT_RETVAL VariableStoreValue(const char *testScriptStatement)
 {
-        char tmp[MAX_SCRIPT_STATEMENT_LEN+1];
+        char *tmp;
         char *varName;
         char *varValue;
-        int i;
+        VAR_INFO *var;
+        uint64_t hash;
+        int slot;
+        EDPAT_RETVAL retVal;
 
 	/* check syntax and seperate variable name and its value
 	   from statment */
-        strncpy(tmp,&testScriptStatement[1],MAX_SCRIPT_STATEMENT_LEN-1);
-	tmp[MAX_SCRIPT_STATEMENT_LEN]=0;
+        tmp = strdup(&testScriptStatement[1]);
+        if (NULL == tmp)
+        {
+                ExecErrorMsgPrint("Failed to allocate memory for a "
+			"variable");
+                return EDPAT_FAILED;
+        }
 
         varName = tmp;
         varValue = strchr(tmp,'=');
         if (NULL == varValue)
         {
                 ScriptErrorMsgPrint("Expecting the format $vaname=value");
+                free(tmp);
                 return EDPAT_FAILED;
         }
 	/* cz this is the point where the = sign is found puttinh a 0
@@ -71,40 +358,35 @@ EDPAT_RETVAL VariableStoreValue(const char *testScriptStatement)
 
         /* check variable is already existing. If yes, overwrite value 
 	   log this in logfile if in verbose mode */
-	
-        for(i=0; i < NextFreeVarListIndex; i++)
+        hash = HashBytes(varName, strlen(varName), HASH_INIT);
+        slot = (0 == VarIndexSize) ? (-1) : variableFind(varName,hash);
+        if ((0 <= slot) && (0 != VarIndex[slot]))
         {
-                if (0 == strcmp(varName,VarList[i].varName))
-                {
-			VerboseStringPrint("Variable '%s' value '%s' is "
-				" replace with new value '%s'.",
-                                varName,
-                                VarList[i].varValue,
-                                varValue);
-                        free(VarList[i].varValue);
-                        VarList[i].varValue = malloc(strlen(varValue)+1);
-                        strcpy(VarList[i].varValue,varValue);
-                        return EDPAT_SUCCESS;
-                }
+		var = &VarList[VarIndex[slot] - 1];
+		VerboseStringPrint("Variable '%s' value '%s' is "
+			" replace with new value '%s'.",
+			varName,
+			var->varValue,
+			varValue);
+		retVal = EDPAT_FAILED;
+		var->varValue = variableArenaStrdup(varValue);
+		if (NULL != var->varValue)
+		{
+			retVal = variableDecode(var);
+		}
+		free(tmp);
+		return retVal;
         }
-        // value does not exits. So create a new entry
 
-	if (MAX_VAR_COUNT <= (NextFreeVarListIndex+1))
-	{
-                ScriptErrorMsgPrint("Too many variables %d defined."
-			"only %d are allowed",
-			NextFreeVarListIndex, MAX_VAR_COUNT);
-			return EDPAT_FAILED;
-	}
-        VarList[NextFreeVarListIndex].varName = malloc(strlen(varName)+1);
-        VarList[NextFreeVarListIndex].varValue = malloc(strlen(varValue)+1);
-        strcpy(VarList[NextFreeVarListIndex].varName,varName);
-        strcpy(VarList[NextFreeVarListIndex].varValue,varValue);
-        NextFreeVarListIndex++;
-	VerboseStringPrint("Variable '%s' with value '%s' added.",
+        // value does not exits. So create a new entry
+        retVal = variableAdd(varName, varValue, hash);
+        if (EDPAT_SUCCESS == retVal)
+        {
+		VerboseStringPrint("Variable '%s' with value '%s' added.",
 			varName,varValue);
-	VariablePrintValues();
-        return EDPAT_SUCCESS;
+        }
+	free(tmp);
+        return retVal;
 }
 
 /***********************
@@ -118,17 +400,55 @@ EDPAT_RETVAL VariableStoreValue(const char *testScriptStatement)
  *   Return	:	value of the variable. NULL if not found.
  *
  **********************/
-char *VariableGetValue(const char *varName)
+const char *VariableGetValue(const char *varName)
 {
-	int i;
-	for(i=0; i < NextFreeVarListIndex; i++)
+	int slot;
+
+	if (0 == VarIndexSize)
 	{
-		if (0  == strcmp(VarList[i].varName,varName))
-		{
-			return VarList[i].varValue;
-		}
+		return NULL;
+	}
+	slot = variableFind(varName, HashBytes(varName, strlen(varName),
+			HASH_INIT));
+	return (0 == VarIndex[slot]) ? NULL :
+			VarList[VarIndex[slot] - 1].varValue;
+}
+
+
+/***********************
+ *   VariableGetBytes()
+ *
+ *   Get the value of a variable decoded as bytes of a packet.
+ *
+ *   Arguments	:	varName - Name for the variable for which value
+ *				  is needed.
+ *			len	- OUTPUT. number of bytes.
+ *			skip	- OUTPUT. 1 for the bytes not to be
+ *				  compared, NULL if there is none.
+ *
+ *   Return	:	the bytes. NULL if not found or not bytes.
+ *
+ **********************/
+const unsigned char *VariableGetBytes(const char *varName, int *len,
+			const unsigned char **skip)
+{
+	VAR_INFO *var;
+	int slot;
+
+	if (0 == VarIndexSize)
+	{
+		return NULL;
+	}
+	slot = variableFind(varName, HashBytes(varName, strlen(varName),
+			HASH_INIT));
+	if (0 == VarIndex[slot])
+	{
+		return NULL;
 	}
-	return NULL;
+	var = &VarList[VarIndex[slot] - 1];
+	*len = var->byteCount;
+	*skip = var->skip;
+	return var->bytes;
 }
 
 
@@ -145,31 +465,44 @@ char *VariableGetValue(const char *varName)
 void VariablePrintValues(void)
 {
 	int i;
-	static char msg[MAX_SCRIPT_STATEMENT_LEN+1];
-	static char var[MAX_SCRIPT_LINE_LEN+1];
-
-	strncpy(msg,"Variables Stored:",MAX_SCRIPT_STATEMENT_LEN);
-	msg[MAX_SCRIPT_STATEMENT_LEN]=0;
 
+	VerboseStringPrint("Variables Stored:");
 	for(i=0; i < NextFreeVarListIndex; i++)
 	{
-		sprintf(var,"\n%s='%s'",
+		VerboseStringPrint("%s='%s'",
 			VarList[i].varName,
 			VarList[i].varValue);
-		if ( MAX_SCRIPT_STATEMENT_LEN > (strlen(msg)+strlen(var)))
-		{
-			strcat(msg,var);
-		}
-		else
-		{
-			VerboseStringPrint(msg);
-			strncpy(msg,"Variables Stored(Next set):",
-				MAX_SCRIPT_LINE_LEN);
-			msg[MAX_SCRIPT_STATEMENT_LEN]=0;
-			
-		}
 	}
-	VerboseStringPrint(msg);
 	return;
 }
 
+
+/***********************
+ *   VariablesFree()
+ *
+ *   Free all the variables and their arena at the end of the run
+ *
+ *   Arguments 	:	void
+ *
+ *   Return	:	void
+ *
+ ***********************/
+void VariablesFree(void)
+{
+	VAR_ARENA_CHUNK *chunk;
+
+	while (NULL != VarArena)
+	{
+		chunk = VarArena;
+		VarArena = chunk->next;
+		free(chunk);
+	}
+	free(VarList);
+	free(VarIndex);
+	VarList = NULL;
+	VarIndex = NULL;
+	NextFreeVarListIndex = 0;
+	VarListSize = 0;
+	VarIndexSize = 0;
+	return;
+}
@@ -9,8 +9,14 @@
 #ifndef __VARIABLE_H__
 #define __VARIABLE_H__	1
 
+#define VAR_INDEX_INIT_SIZE	64		// variables, grows by doubling
+#define VAR_ARENA_CHUNK_SIZE	(64*1024)	// bytes of names and values
+
 EDPAT_RETVAL VariableStoreValue(const char *testScriptStatement);
-char *VariableGetValue(const char *varName);
+const char *VariableGetValue(const char *varName);
+const unsigned char *VariableGetBytes(const char *varName, int *len,
+			const unsigned char **skip);
 void VariablePrintValues(void);
+void VariablesFree(void);
 
 #endif